@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+#
+# Generates src/wcwidth-table.h: a two-level table with the display
+# width of every code point, used by xwcwidth(). The data comes from
+# the Unicode database shipped with Python (General_Category and
+# East_Asian_Width), so regenerate with a recent Python after a new
+# Unicode release:
+#
+#     $ ./gen-wcwidth.py > src/wcwidth-table.h
+
+import sys
+import unicodedata
+
+ZERO, NARROW, WIDE = 0, 1, 2
+PAGE_BITS = 8
+PAGE_SIZE = 1 << PAGE_BITS
+
+# Unassigned code points that are reserved for wide characters. The
+# CJK ranges are the East_Asian_Width defaults. The emoji blocks get
+# new emoji (with emoji presentation) in every release.
+DEFAULT_WIDE = [
+    (0x3400, 0x4DBF), (0x4E00, 0x9FFF), (0xF900, 0xFAFF),
+    (0x1F300, 0x1F64F), (0x1F900, 0x1FAFF),
+    (0x20000, 0x2FFFD), (0x30000, 0x3FFFD),
+]
+
+
+def width_class(cp):
+    ch = chr(cp)
+    cat = unicodedata.category(ch)
+
+    if 0x1160 <= cp <= 0x11FF or 0xD7B0 <= cp <= 0xD7FF:
+        return ZERO  # Hangul medial vowels and final consonants
+    if cat in ('Mn', 'Me') or (cat == 'Cf' and cp != 0x00AD):
+        return ZERO  # combining marks, ZWJ, ZWSP, bidi controls...
+    if unicodedata.east_asian_width(ch) in ('W', 'F'):
+        return WIDE
+    if cat == 'Cn' and any(lo <= cp <= hi for lo, hi in DEFAULT_WIDE):
+        return WIDE
+    return NARROW
+
+
+def main():
+    pages = []
+    index = {}
+    stage1 = []
+
+    for base in range(0, 0x110000, PAGE_SIZE):
+        packed = bytearray(PAGE_SIZE // 4)
+
+        for off in range(PAGE_SIZE):
+            packed[off >> 2] |= width_class(base + off) << ((off & 3) * 2)
+
+        page = bytes(packed)
+
+        if page not in index:
+            index[page] = len(pages)
+            pages.append(page)
+        stage1.append(index[page])
+
+    if len(pages) > 256:
+        sys.exit("too many distinct pages: %d" % len(pages))
+
+    out = sys.stdout
+    out.write("/* Generated by gen-wcwidth.py from Unicode %s. "
+              "Do not edit. */\n\n" % unicodedata.unidata_version)
+    out.write("#ifndef SRC_WCWIDTH_TABLE_H_\n#define SRC_WCWIDTH_TABLE_H_\n\n")
+    out.write("#define WCWIDTH_UNICODE_VERSION \"%s\"\n"
+              % unicodedata.unidata_version)
+    out.write("#define WCWIDTH_PAGE_BITS %d\n\n" % PAGE_BITS)
+    out.write("/*\n * Page number for every block of %d code points\n */\n"
+              % PAGE_SIZE)
+    out.write("static const uint8_t wcwidth_stage1[%d] = {\n" % len(stage1))
+
+    for i in range(0, len(stage1), 16):
+        out.write("\t%s,\n" % ", ".join("%d" % n for n in stage1[i:i + 16]))
+
+    out.write("};\n\n")
+    out.write("/*\n * Two bits per code point: 0 = zero width, 1 = narrow, "
+              "2 = wide\n */\n")
+    out.write("static const uint8_t wcwidth_stage2[%d][%d] = {\n"
+              % (len(pages), PAGE_SIZE // 4))
+
+    for page in pages:
+        out.write("\t{\n")
+        for i in range(0, len(page), 12):
+            out.write("\t\t%s,\n" % ", ".join("0x%02x" % b
+                                              for b in page[i:i + 12]))
+        out.write("\t},\n")
+
+    out.write("};\n\n#endif\n")
+
+
+if __name__ == '__main__':
+    main()
@@ -5,10 +5,12 @@ OBJS += $(SRC_DIR)assertAPI.o\
 	$(SRC_DIR)b64_decode.o\
 	$(SRC_DIR)b64_encode.o\
 	$(SRC_DIR)config.o\
+	$(SRC_DIR)connRace.o\
 	$(SRC_DIR)crypt.o\
 	$(SRC_DIR)curses-funcs.o\
 	$(SRC_DIR)cursesInit.o\
 	$(SRC_DIR)dataClassify.o\
+	$(SRC_DIR)diag.o\
 	$(SRC_DIR)errHand.o\
 	$(SRC_DIR)filePred.o\
 	$(SRC_DIR)get_x509_fp.o\
@@ -19,6 +21,7 @@ OBJS += $(SRC_DIR)assertAPI.o\
 	$(SRC_DIR)interpreter.o\
 	$(SRC_DIR)io-loop.o\
 	$(SRC_DIR)irc.o\
+	$(SRC_DIR)isupport.o\
 	$(SRC_DIR)libUtils.o\
 	$(SRC_DIR)log.o\
 	$(SRC_DIR)main.o\
@@ -31,11 +34,16 @@ OBJS += $(SRC_DIR)assertAPI.o\
 	$(SRC_DIR)nicklist.o\
 	$(SRC_DIR)options.o\
 	$(SRC_DIR)ossl-scripts.o\
+	$(SRC_DIR)perf.o\
 	$(SRC_DIR)printtext.o\
+	$(SRC_DIR)prefixTrie.o\
 	$(SRC_DIR)pthrMutex.o\
 	$(SRC_DIR)readline.o\
 	$(SRC_DIR)readlineAPI.o\
 	$(SRC_DIR)readlineTabCompletion.o\
+	$(SRC_DIR)rejoin.o\
+	$(SRC_DIR)resolver.o\
+	$(SRC_DIR)scrollback.o\
 	$(SRC_DIR)sig-unix.o\
 	$(SRC_DIR)socks.o\
 	$(SRC_DIR)spell.o\
@@ -47,14 +55,17 @@ OBJS += $(SRC_DIR)assertAPI.o\
 	$(SRC_DIR)strcpy.o\
 	$(SRC_DIR)strdup_printf.o\
 	$(SRC_DIR)strnlen.o\
+	$(SRC_DIR)strpool.o\
 	$(SRC_DIR)term-unix.o\
 	$(SRC_DIR)terminal.o\
 	$(SRC_DIR)textBuffer.o\
+	$(SRC_DIR)textLayout.o\
 	$(SRC_DIR)theme.o\
 	$(SRC_DIR)timingsafe_memcmp.o\
 	$(SRC_DIR)titlebar.o\
 	$(SRC_DIR)tls-server-unix.o\
 	$(SRC_DIR)tls-server.o\
+	$(SRC_DIR)utf8Decode.o\
 	$(SRC_DIR)wcscat.o\
 	$(SRC_DIR)wcscpy.o\
 	$(SRC_DIR)window.o\
@@ -64,10 +75,12 @@ SRCS = $(SRC_DIR)assertAPI.c\
 	$(SRC_DIR)b64_decode.c\
 	$(SRC_DIR)b64_encode.c\
 	$(SRC_DIR)config.cpp\
+	$(SRC_DIR)connRace.cpp\
 	$(SRC_DIR)crypt.cpp\
 	$(SRC_DIR)curses-funcs.c\
 	$(SRC_DIR)cursesInit.c\
 	$(SRC_DIR)dataClassify.c\
+	$(SRC_DIR)diag.cpp\
 	$(SRC_DIR)errHand.c\
 	$(SRC_DIR)filePred.c\
 	$(SRC_DIR)get_x509_fp.cpp\
@@ -78,6 +91,7 @@ SRCS = $(SRC_DIR)assertAPI.c\
 	$(SRC_DIR)interpreter.cpp\
 	$(SRC_DIR)io-loop.c\
 	$(SRC_DIR)irc.c\
+	$(SRC_DIR)isupport.cpp\
 	$(SRC_DIR)libUtils.c\
 	$(SRC_DIR)log.c\
 	$(SRC_DIR)main.cpp\
@@ -90,11 +104,16 @@ SRCS = $(SRC_DIR)assertAPI.c\
 	$(SRC_DIR)nicklist.cpp\
 	$(SRC_DIR)options.c\
 	$(SRC_DIR)ossl-scripts.c\
+	$(SRC_DIR)perf.cpp\
 	$(SRC_DIR)printtext.cpp\
+	$(SRC_DIR)prefixTrie.c\
 	$(SRC_DIR)pthrMutex.c\
 	$(SRC_DIR)readline.c\
 	$(SRC_DIR)readlineAPI.c\
 	$(SRC_DIR)readlineTabCompletion.c\
+	$(SRC_DIR)rejoin.cpp\
+	$(SRC_DIR)resolver.cpp\
+	$(SRC_DIR)scrollback.c\
 	$(SRC_DIR)sig-unix.c\
 	$(SRC_DIR)socks.cpp\
 	$(SRC_DIR)spell.cpp\
@@ -106,14 +125,17 @@ SRCS = $(SRC_DIR)assertAPI.c\
 	$(SRC_DIR)strcpy.c\
 	$(SRC_DIR)strdup_printf.c\
 	$(SRC_DIR)strnlen.c\
+	$(SRC_DIR)strpool.cpp\
 	$(SRC_DIR)term-unix.c\
 	$(SRC_DIR)terminal.c\
 	$(SRC_DIR)textBuffer.c\
+	$(SRC_DIR)textLayout.cpp\
 	$(SRC_DIR)theme.c\
 	$(SRC_DIR)timingsafe_memcmp.c\
 	$(SRC_DIR)titlebar.c\
 	$(SRC_DIR)tls-server-unix.cpp\
 	$(SRC_DIR)tls-server.cpp\
+	$(SRC_DIR)utf8Decode.c\
 	$(SRC_DIR)wcscat.c\
 	$(SRC_DIR)wcscpy.c\
 	$(SRC_DIR)window.c\
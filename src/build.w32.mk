@@ -8,10 +8,12 @@ OBJS = $(OBJS)\
 	$(SRC_DIR)b64_decode.obj\
 	$(SRC_DIR)b64_encode.obj\
 	$(SRC_DIR)config.obj\
+	$(SRC_DIR)connRace.obj\
 	$(SRC_DIR)crypt.obj\
 	$(SRC_DIR)curses-funcs.obj\
 	$(SRC_DIR)cursesInit.obj\
 	$(SRC_DIR)dataClassify.obj\
+	$(SRC_DIR)diag.obj\
 	$(SRC_DIR)errHand.obj\
 	$(SRC_DIR)filePred.obj\
 	$(SRC_DIR)get_x509_fp.obj\
@@ -23,6 +25,7 @@ OBJS = $(OBJS)\
 	$(SRC_DIR)interpreter.obj\
 	$(SRC_DIR)io-loop.obj\
 	$(SRC_DIR)irc.obj\
+	$(SRC_DIR)isupport.obj\
 	$(SRC_DIR)libUtils.obj\
 	$(SRC_DIR)log.obj\
 	$(SRC_DIR)main.obj\
@@ -35,10 +38,15 @@ OBJS = $(OBJS)\
 	$(SRC_DIR)nicklist.obj\
 	$(SRC_DIR)options.obj\
 	$(SRC_DIR)ossl-scripts.obj\
+	$(SRC_DIR)perf.obj\
+	$(SRC_DIR)prefixTrie.obj\
 	$(SRC_DIR)printtext.obj\
 	$(SRC_DIR)readline.obj\
 	$(SRC_DIR)readlineAPI.obj\
 	$(SRC_DIR)readlineTabCompletion.obj\
+	$(SRC_DIR)rejoin.obj\
+	$(SRC_DIR)resolver.obj\
+	$(SRC_DIR)scrollback.obj\
 	$(SRC_DIR)sig-w32.obj\
 	$(SRC_DIR)socks.obj\
 	$(SRC_DIR)spell.obj\
@@ -50,14 +58,17 @@ OBJS = $(OBJS)\
 	$(SRC_DIR)strcpy.obj\
 	$(SRC_DIR)strdup_printf.obj\
 	$(SRC_DIR)strnlen.obj\
+	$(SRC_DIR)strpool.obj\
 	$(SRC_DIR)term-w32.obj\
 	$(SRC_DIR)terminal.obj\
 	$(SRC_DIR)textBuffer.obj\
+	$(SRC_DIR)textLayout.obj\
 	$(SRC_DIR)theme.obj\
 	$(SRC_DIR)timingsafe_memcmp.obj\
 	$(SRC_DIR)titlebar.obj\
 	$(SRC_DIR)tls-server-w32.obj\
 	$(SRC_DIR)tls-server.obj\
+	$(SRC_DIR)utf8Decode.obj\
 	$(SRC_DIR)vcMutex.obj\
 	$(SRC_DIR)wcscat.obj\
 	$(SRC_DIR)wcscpy.obj\
@@ -25,6 +25,7 @@ COMMANDS_SRCS = $(COMMANDS_DIR)admin.cpp\
 	$(COMMANDS_DIR)nick.c\
 	$(COMMANDS_DIR)notice.cpp\
 	$(COMMANDS_DIR)op.c\
+	$(COMMANDS_DIR)perf.cpp\
 	$(COMMANDS_DIR)sasl-scram-sha.cpp\
 	$(COMMANDS_DIR)sasl.cpp\
 	$(COMMANDS_DIR)say.c\
@@ -37,6 +38,7 @@ COMMANDS_SRCS = $(COMMANDS_DIR)admin.cpp\
 	$(COMMANDS_DIR)utctime.cpp\
 	$(COMMANDS_DIR)voice.c\
 	$(COMMANDS_DIR)wholeft.cpp\
+	$(COMMANDS_DIR)window.cpp\
 	$(COMMANDS_DIR)znc.cpp
 
 OBJS = $(COMMANDS_DIR)admin.o\
@@ -65,6 +67,7 @@ OBJS = $(COMMANDS_DIR)admin.o\
 	$(COMMANDS_DIR)nick.o\
 	$(COMMANDS_DIR)notice.o\
 	$(COMMANDS_DIR)op.o\
+	$(COMMANDS_DIR)perf.o\
 	$(COMMANDS_DIR)sasl-scram-sha.o\
 	$(COMMANDS_DIR)sasl.o\
 	$(COMMANDS_DIR)say.o\
@@ -77,6 +80,7 @@ OBJS = $(COMMANDS_DIR)admin.o\
 	$(COMMANDS_DIR)utctime.o\
 	$(COMMANDS_DIR)voice.o\
 	$(COMMANDS_DIR)wholeft.o\
+	$(COMMANDS_DIR)window.o\
 	$(COMMANDS_DIR)znc.o
 
 CPPFLAGS += -I $(COMMANDS_DIR)
@@ -25,6 +25,7 @@ OBJS = $(COMMANDS_DIR)admin.obj\
 	$(COMMANDS_DIR)nick.obj\
 	$(COMMANDS_DIR)notice.obj\
 	$(COMMANDS_DIR)op.obj\
+	$(COMMANDS_DIR)perf.obj\
 	$(COMMANDS_DIR)sasl-scram-sha.obj\
 	$(COMMANDS_DIR)sasl.obj\
 	$(COMMANDS_DIR)say.obj\
@@ -37,6 +38,7 @@ OBJS = $(COMMANDS_DIR)admin.obj\
 	$(COMMANDS_DIR)utctime.obj\
 	$(COMMANDS_DIR)voice.obj\
 	$(COMMANDS_DIR)wholeft.obj\
+	$(COMMANDS_DIR)window.obj\
 	$(COMMANDS_DIR)znc.obj
 
 CPPFLAGS = $(CPPFLAGS) -I $(COMMANDS_DIR)
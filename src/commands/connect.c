@@ -45,6 +45,7 @@
 #include "../nestHome.h"
 #include "../network.h"
 #include "../printtext.h"
+#include "../resolver.h"
 #include "../strHand.h"
 #include "../strdup_printf.h"
 #include "../terminal.h"
@@ -737,6 +738,7 @@ cmd_disconnect(const char *data)
 	const bool	has_message = !strings_match(data, "");
 
 	quit_reconnecting = true;
+	resolver_cancel();
 
 	if (atomic_load_bool(&g_on_air)) {
 		net_request_disconnect();
@@ -52,10 +52,12 @@ namespace fs = std::filesystem;
 #if WIN32
 #include <io.h>
 #endif
+#include <mutex>
 #include <stdexcept>
 #if UNIX
 #include <unistd.h>
 #endif
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -208,6 +210,53 @@ dcc_get::operator=(dcc_get &&obj) noexcept = default;
  */
 dcc_get::dcc_get(dcc_get &&obj) noexcept = default;
 
+/*
+ * The last TLS session per peer (address and port). Offered again when
+ * getting another file from the same peer, so that the handshake can
+ * be skipped.
+ */
+static std::mutex				peer_sess_mtx;
+static std::unordered_map<uint64_t, SSL_SESSION *>
+						peer_sessions;
+
+static uint64_t
+peer_key(uint32_t addr, uint16_t port)
+{
+	return ((static_cast<uint64_t>(addr) << 16) | port);
+}
+
+static void
+peer_session_offer(SSL *ssl, uint32_t addr, uint16_t port)
+{
+	std::lock_guard<std::mutex> lock(peer_sess_mtx);
+	auto it = peer_sessions.find(peer_key(addr, port));
+
+	if (it != peer_sessions.end())
+		(void) SSL_set_session(ssl, it->second);
+}
+
+static void
+peer_session_store(SSL *ssl, uint32_t addr, uint16_t port)
+{
+	SSL_SESSION *sess;
+
+	if ((sess = SSL_get1_session(ssl)) == nullptr)
+		return;
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L && !defined(LIBRESSL_VERSION_NUMBER)
+	if (!SSL_SESSION_is_resumable(sess)) {
+		SSL_SESSION_free(sess);
+		return;
+	}
+#endif
+
+	std::lock_guard<std::mutex> lock(peer_sess_mtx);
+	SSL_SESSION *&slot = peer_sessions[peer_key(addr, port)];
+
+	if (slot != nullptr)
+		SSL_SESSION_free(slot);
+	slot = sess;
+}
+
 static void
 read_and_write(SOCKET sock, SSL *ssl, FILE *fp, intmax_t &bytes_rem)
 {
@@ -320,10 +369,13 @@ dcc_get::get_file(void)
 			throw std::runtime_error("Set FD error");
 
 		SSL_set_connect_state(this->ssl);
+		peer_session_offer(this->ssl, this->addr, this->port);
 
 		if (SSL_connect(this->ssl) != VALUE_HANDSHAKE_OK)
 			throw std::runtime_error("TLS/SSL handshake failed!");
-		else if (this->request_file() == ERR)
+		if (SSL_session_reused(this->ssl))
+			debug("%s: resumed the TLS session", __func__);
+		if (this->request_file() == ERR)
 			throw std::runtime_error("Send error");
 		else if (g_dcc_download_dir == nullptr)
 			throw std::runtime_error("Null dir");
@@ -349,6 +401,12 @@ dcc_get::get_file(void)
 		    this->bytes_rem);
 		this->stop = time(nullptr);
 
+		/*
+		 * Stored after the transfer, as a TLS 1.3 ticket arrives
+		 * after the handshake
+		 */
+		peer_session_store(this->ssl, this->addr, this->port);
+
 		fclose_and_null(addrof(this->fileptr));
 		dcc::shutdown_conn(this->ssl);
 
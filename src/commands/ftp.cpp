@@ -50,6 +50,7 @@
 #include "../nestHome.h"
 #include "../network.h"
 #include "../printtext.h"
+#include "../resolver.h"
 #include "../strHand.h"
 #include "../strdup_printf.h"
 #include "../theme.h"
@@ -126,7 +127,7 @@ ftp_ctl_conn::~ftp_ctl_conn()
 	}
 
 	if (this->res != nullptr) {
-		freeaddrinfo(this->res);
+		resolver_freeaddrinfo(this->res);
 		this->res = nullptr;
 	}
 }
@@ -188,7 +189,7 @@ ftp_ctl_conn::operator=(ftp_ctl_conn &&obj) noexcept
 		return *this;
 
 	if (this->res)
-		freeaddrinfo(this->res);
+		resolver_freeaddrinfo(this->res);
 
 	try {
 		if (!obj.reply_vec.empty()) {
@@ -636,7 +637,7 @@ ftp_data_conn::~ftp_data_conn()
 	free(this->port_str);
 
 	if (this->res != nullptr) {
-		freeaddrinfo(this->res);
+		resolver_freeaddrinfo(this->res);
 		this->res = nullptr;
 	}
 }
@@ -744,7 +745,7 @@ ftp_data_conn::operator=(ftp_data_conn &&obj) noexcept
 	if (this->sock != INVALID_SOCKET)
 		ftp_closesocket(this->sock);
 	if (this->res)
-		freeaddrinfo(this->res);
+		resolver_freeaddrinfo(this->res);
 
 	try {
 		if (!obj.vec.empty())
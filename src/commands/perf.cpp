@@ -0,0 +1,167 @@
+/* Command perf
+   Copyright (C) 2026 Markus Uhlin. All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   - Neither the name of the author nor the names of its contributors may be
+     used to endorse or promote products derived from this software without
+     specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+   BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE. */
+
+#include "common.h"
+
+#include <cinttypes>
+#include <cstdint>
+
+#include "../errHand.h"
+#include "../libUtils.h"
+#include "../main.h"
+#include "../perf.h"
+#include "../printtext.h"
+#include "../strHand.h"
+
+#include "i18n.h"
+#include "perf.h"
+
+#define TOP_EVENTS 10
+
+static chararray_t cmd = "/perf";
+
+static inline double
+to_us(const uint64_t ns)
+{
+	return (static_cast<double>(ns) / 1000.0);
+}
+
+static void
+show_stats(void)
+{
+	struct perf_event_stats ev[TOP_EVENTS];
+	size_t nev;
+
+	printtext_print("sp1", "%s: instrumentation is %s", cmd,
+	    perf_is_enabled() ? "on" : "off");
+	printtext_print("none", "%-18s %10s %10s %10s %10s %10s",
+	    "stage", "calls", "avg us", "p50 us", "p99 us", "max us");
+
+	for (int i = 0; i < PERF_STAGE_COUNT; i++) {
+		const auto stage = static_cast<enum perf_stage>(i);
+		struct perf_stage_stats st;
+
+		perf_get_stage(stage, &st);
+
+		if (stage == PERF_NET_RECV) {
+			printtext_print("none", "%-18s %10" PRIu64 " %10s "
+			    "(%" PRIu64 " bytes)", perf_stage_name(stage),
+			    st.calls, "-", st.bytes);
+			continue;
+		}
+
+		printtext_print("none", "%-18s %10" PRIu64 " %10.1f %10.1f "
+		    "%10.1f %10.1f", perf_stage_name(stage), st.calls,
+		    (st.calls ? to_us(st.total_ns) / st.calls : 0.0),
+		    to_us(perf_percentile(&st, 50)),
+		    to_us(perf_percentile(&st, 99)),
+		    to_us(st.max_ns));
+	}
+
+	if ((nev = perf_get_events(ev, ARRAY_SIZE(ev))) == 0)
+		return;
+
+	printtext_print("none", " ");
+	printtext_print("none", "%-18s %10s %10s %10s %10s",
+	    "event", "calls", "total ms", "avg us", "max us");
+
+	for (size_t i = 0; i < nev; i++) {
+		printtext_print("none", "%-18s %10" PRIu64 " %10.1f %10.1f "
+		    "%10.1f", ev[i].command, ev[i].calls,
+		    to_us(ev[i].total_ns) / 1000.0,
+		    to_us(ev[i].total_ns) / ev[i].calls,
+		    to_us(ev[i].max_ns));
+	}
+}
+
+static void
+subcmd_dump(CSTRING path)
+{
+	if (path == nullptr) {
+		printtext_print("err", _("%s: dump: missing file"), cmd);
+		return;
+	} else if (!perf_dump(path)) {
+		printtext_print("err", _("%s: dump: %s: %s"), cmd, path,
+		    errdesc_by_num(errno));
+		return;
+	}
+
+	printtext_print("success", _("%s: wrote %s"), cmd, path);
+}
+
+/*
+ * usage: /perf [on | off | reset | dump <file>]
+ */
+void
+cmd_perf(CSTRING p_data)
+{
+	CSTRING			arg[2];
+	CSTRING			subcmd;
+	STRING			dcopy;
+	auto			last = const_cast<STRING>("");
+	static chararray_t	sep = " ";
+
+	if (strings_match(p_data, "")) {
+		show_stats();
+		return;
+	}
+
+	dcopy = sw_strdup(p_data);
+
+	if ((subcmd = strtok_r(dcopy, sep, &last)) == nullptr) {
+		printf_and_free(dcopy, _("%s: too few arguments"), cmd);
+		return;
+	}
+
+	arg[0] = strtok_r(nullptr, sep, &last);
+	arg[1] = strtok_r(nullptr, sep, &last);
+
+	if (arg[1] || (arg[0] && !strings_match(subcmd, "dump"))) {
+		printf_and_free(dcopy, _("%s: too many arguments"), cmd);
+		return;
+	}
+
+	if (strings_match(subcmd, "on")) {
+		perf_enable(true);
+		printtext_print("success", _("%s: instrumentation on"), cmd);
+	} else if (strings_match(subcmd, "off")) {
+		perf_enable(false);
+		printtext_print("success", _("%s: instrumentation off"), cmd);
+	} else if (strings_match(subcmd, "reset")) {
+		perf_reset();
+		printtext_print("success", _("%s: counters reset"), cmd);
+	} else if (strings_match(subcmd, "dump")) {
+		subcmd_dump(arg[0]);
+	} else {
+		printtext_print("err", _("%s: invalid subcommand: %s"), cmd,
+		    subcmd);
+	}
+
+	free(dcopy);
+}
@@ -0,0 +1,8 @@
+#ifndef SRC_COMMANDS_PERF_H_
+#define SRC_COMMANDS_PERF_H_
+
+__SWIRC_BEGIN_DECLS
+void cmd_perf(CSTRING);
+__SWIRC_END_DECLS
+
+#endif
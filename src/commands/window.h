@@ -0,0 +1,8 @@
+#ifndef SRC_COMMANDS_WINDOW_H_
+#define SRC_COMMANDS_WINDOW_H_
+
+__SWIRC_BEGIN_DECLS
+void cmd_window(CSTRING);
+__SWIRC_END_DECLS
+
+#endif
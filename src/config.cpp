@@ -43,6 +43,7 @@
 #include "log.h"
 #include "main.h"
 #include "nestHome.h"
+#include "prefixTrie.h"
 #include "printtext.h"
 #include "readline.h"
 #include "spell.h"
@@ -121,6 +122,7 @@ static struct tagConfDefValues {
 	{ "socks_port",                TYPE_STRING,  1, "9050" },
 
 	{ "spell",                     TYPE_BOOLEAN, 2, "yes" },
+	{ "spell_inline",              TYPE_BOOLEAN, 1, "no" },
 	{ "spell_lang",                TYPE_STRING,  1, "en_US" },
 	{ "spell_syswide",             TYPE_BOOLEAN, 1, "yes" },
 
@@ -163,14 +165,23 @@ static struct tagConfDefValues {
 	{ "mouse_events",              TYPE_STRING,  3, "wheel" },
 	{ "notifications",             TYPE_BOOLEAN, 3, "yes" },
 	{ "save_backlogs_to_disk",     TYPE_STRING,  2, "both" },
+	{ "scrollback_restore_lines",  TYPE_INTEGER, 2, "200" },
 	{ "show_ping_pong",            TYPE_BOOLEAN, 3, "no" },
 	{ "skip_motd",                 TYPE_BOOLEAN, 3, "no" },
+	{ "ssl_sessions_to_disk",      TYPE_BOOLEAN, 2, "no" },
 	{ "ssl_verify_peer",           TYPE_BOOLEAN, 3, "yes" },
 	{ "startup_greeting",          TYPE_BOOLEAN, 2, "yes" },
 	{ "textbuffer_size_absolute",  TYPE_INTEGER, 1, "1500" },
+	{ "textbuffer_total_kb",       TYPE_INTEGER, 2, "65536" },
+	{ "textbuffer_window_kb",      TYPE_INTEGER, 2, "1024" },
 	{ "theme",                     TYPE_STRING,  4, "default" },
 };
 
+/*
+ * The setting names sorted for prefixRange_first()
+ */
+static const char *sorted_settings[ARRAY_SIZE(ConfDefValues)] = { nullptr };
+
 /* -------------------------------------------------- */
 
 /*lint -sem(get_hash_table_entry, r_null) */
@@ -447,25 +458,17 @@ write_config_header(FILE *fp)
 
 /* -------------------------------------------------- */
 
-PTEXTBUF
-get_list_of_matching_settings(const char *search_var)
+/**
+ * Get the setting names sorted for prefixRange_first()
+ *
+ * @param[out] count Number of names
+ * @return The names
+ */
+const char * const *
+get_sorted_settings(size_t *count)
 {
-	PTEXTBUF	matches = textBuf_new();
-	const size_t	varlen = strlen(search_var);
-
-	FOREACH_CDV() {
-		if (!strncmp(search_var, cdv_p->setting_name, varlen)) {
-			textBuf_emplace_back(__func__, matches,
-			    cdv_p->setting_name, 0);
-		}
-	}
-
-	if (textBuf_size(matches) == 0) {
-		textBuf_destroy(matches);
-		return nullptr;
-	}
-
-	return matches;
+	*count = ARRAY_SIZE(sorted_settings);
+	return sorted_settings;
 }
 
 void
@@ -479,7 +482,10 @@ config_init(void)
 	FOREACH_CDV() {
 		if ((len = strlen(cdv_p->setting_name)) > longest_set_count)
 			longest_set_count = len;
+		sorted_settings[cdv_p - &ConfDefValues[0]] =
+		    cdv_p->setting_name;
 	}
+	prefixRange_sort(sorted_settings, ARRAY_SIZE(sorted_settings));
 }
 
 void
@@ -19,9 +19,7 @@ __SWIRC_BEGIN_DECLS
 void output_values_for_all_settings(void);
 void output_values_for_all_settings_v2(void);
 
-/*lint -sem(get_list_of_matching_settings, r_null) */
-
-PTEXTBUF get_list_of_matching_settings(const char *);
+const char * const *get_sorted_settings(size_t *count);
 
 void	config_init(void);
 void	config_deinit(void);
@@ -0,0 +1,381 @@
+/* connRace.cpp  --  Happy Eyeballs (RFC 8305) connection racing
+   Copyright (C) 2026 Markus Uhlin. All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   - Neither the name of the author nor the names of its contributors may be
+     used to endorse or promote products derived from this software without
+     specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+   BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE. */
+
+#include "common.h"
+
+#if defined(UNIX)
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <unistd.h> /* close() */
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <unordered_map>
+#include <utility>
+
+#include "connRace.hpp"
+#include "errHand.h"
+#include "i18n.h"
+#include "network.h"
+
+#if defined(UNIX)
+#define SOCK_ERRNO		errno
+#define SOCK_IN_PROGRESS	EINPROGRESS
+#define SOCK_INTERRUPTED	EINTR
+#define SOCK_SELECTABLE(sock)	((sock) < FD_SETSIZE)
+#define CLOSE_SOCKET(sock)	((void) close(sock))
+#elif defined(WIN32)
+#define SOCK_ERRNO		WSAGetLastError()
+#define SOCK_IN_PROGRESS	WSAEWOULDBLOCK
+#define SOCK_INTERRUPTED	WSAEINTR
+#define SOCK_SELECTABLE(sock)	(true) /* an fd_set is a list */
+#define CLOSE_SOCKET(sock)	((void) closesocket(sock))
+#endif
+
+typedef std::chrono::steady_clock::time_point race_time_t;
+
+/*
+ * The family and address that won the last race for a host
+ */
+static std::unordered_map<std::string, std::pair<int, std::string>> winners;
+
+struct pending_attempt {
+	SOCKET		sock;
+	size_t		attempt;
+	long int	deadline_ms;
+};
+
+static long int
+elapsed_ms(const race_time_t &start)
+{
+	return static_cast<long int>(std::chrono::duration_cast<
+	    std::chrono::milliseconds>(std::chrono::steady_clock::now() -
+	    start).count());
+}
+
+static std::string
+addr_string(const struct addrinfo *ai)
+{
+	char host[NI_MAXHOST] = { '\0' };
+
+	if (getnameinfo(ai->ai_addr, ai->ai_addrlen, host, sizeof host,
+	    nullptr, 0, NI_NUMERICHOST) != 0)
+		return std::string("?");
+	return std::string(host);
+}
+
+static CSTRING
+family_name(const int family)
+{
+	return (family == AF_INET6 ? "IPv6" : (family == AF_INET ? "IPv4" :
+	    "?"));
+}
+
+static bool
+set_nonblocking(SOCKET sock, const bool on)
+{
+#if defined(UNIX)
+	const int flags = fcntl(sock, F_GETFL);
+
+	if (flags == -1)
+		return false;
+	return (fcntl(sock, F_SETFL, (on ? flags | O_NONBLOCK :
+	    flags & ~O_NONBLOCK)) != -1);
+#elif defined(WIN32)
+	u_long mode = (on ? 1 : 0);
+
+	return (ioctlsocket(sock, FIONBIO, &mode) == 0);
+#endif
+}
+
+static int
+get_sock_error(SOCKET sock)
+{
+	int		error = 0;
+	socklen_t	len = sizeof error;
+
+	if (getsockopt(sock, SOL_SOCKET, SO_ERROR,
+	    reinterpret_cast<char *>(&error), &len) != 0)
+		return SOCK_ERRNO;
+	return error;
+}
+
+conn_race::conn_race(const char *p_host)
+    : host(p_host != nullptr ? p_host : "")
+{
+	/* null */;
+}
+
+/*
+ * Orders the addresses so that the families alternate, starting with
+ * the preferred family (or the first family returned by the
+ * resolver). The preferred address, if any, is tried first.
+ */
+std::vector<const struct addrinfo *>
+conn_race::order(const struct addrinfo *res, int pref_family,
+    const std::string &pref_addr)
+{
+	std::vector<const struct addrinfo *>	first, second, ordered;
+
+	if (res == nullptr)
+		return ordered;
+	if (pref_family == AF_UNSPEC)
+		pref_family = res->ai_family;
+
+	for (const struct addrinfo *rp = res; rp != nullptr; rp = rp->ai_next)
+		(rp->ai_family == pref_family ? first : second).push_back(rp);
+
+	if (!pref_addr.empty()) {
+		auto it = std::find_if(first.begin(), first.end(),
+		    [&pref_addr](const struct addrinfo *ai) {
+			return (addr_string(ai) == pref_addr);
+		    });
+
+		if (it != first.end())
+			std::rotate(first.begin(), it, it + 1);
+	}
+
+	for (size_t i = 0; i < first.size() || i < second.size(); i++) {
+		if (i < first.size())
+			ordered.push_back(first[i]);
+		if (i < second.size())
+			ordered.push_back(second[i]);
+	}
+
+	return ordered;
+}
+
+/*
+ * Starts connecting to the addresses one by one, a new attempt every
+ * CONN_RACE_DELAY_MS or as soon as one fails, and returns the first
+ * socket to connect (in blocking mode). INVALID_SOCKET is returned if
+ * all attempts failed.
+ */
+SOCKET
+conn_race::run(const struct addrinfo *res, const struct addrinfo *bind_res,
+    long int timeout_secs)
+{
+	SOCKET					winner = INVALID_SOCKET;
+	int					pref_family = AF_UNSPEC;
+	long int				next_start_ms = 0;
+	size_t					next = 0;
+	std::string				pref_addr("");
+	race_time_t				start;
+	std::vector<pending_attempt>		inflight;
+
+	start = std::chrono::steady_clock::now();
+	this->attempts.clear();
+
+	const auto cached = winners.find(this->host);
+
+	if (cached != winners.end()) {
+		pref_family = cached->second.first;
+		pref_addr = cached->second.second;
+	}
+
+	const std::vector<const struct addrinfo *> addrs =
+	    conn_race::order(res, pref_family, pref_addr);
+
+	while (winner == INVALID_SOCKET &&
+	    (next < addrs.size() || !inflight.empty())) {
+		long int now = elapsed_ms(start);
+
+		if (next < addrs.size() &&
+		    (inflight.empty() || now >= next_start_ms)) {
+			const struct addrinfo	*ai = addrs[next++];
+			conn_attempt		 attempt;
+			SOCKET			 sock;
+
+			attempt.family = ai->ai_family;
+			attempt.addr = addr_string(ai);
+			attempt.start_ms = attempt.end_ms = now;
+			attempt.error = 0;
+			attempt.won = false;
+			next_start_ms = now + CONN_RACE_DELAY_MS;
+
+			if ((sock = socket(ai->ai_family, ai->ai_socktype,
+			    ai->ai_protocol)) == INVALID_SOCKET) {
+				attempt.error = SOCK_ERRNO;
+			} else if (!SOCK_SELECTABLE(sock)) {
+				/* FD_SET() would write out of bounds */
+				attempt.error = EMFILE;
+			} else if (bind_res != nullptr &&
+			    (bind_res->ai_family != ai->ai_family ||
+			    bind(sock, bind_res->ai_addr,
+			    bind_res->ai_addrlen) != 0)) {
+				attempt.error = (bind_res->ai_family !=
+				    ai->ai_family ? EAFNOSUPPORT : SOCK_ERRNO);
+			} else if (!set_nonblocking(sock, true)) {
+				attempt.error = SOCK_ERRNO;
+			} else if (connect(sock, ai->ai_addr, ai->ai_addrlen) !=
+			    0 && SOCK_ERRNO != SOCK_IN_PROGRESS) {
+				attempt.error = SOCK_ERRNO;
+			}
+
+			if (attempt.error != 0) {
+				if (sock != INVALID_SOCKET)
+					CLOSE_SOCKET(sock);
+				next_start_ms = now;
+			} else {
+				inflight.push_back({ sock,
+				    this->attempts.size(),
+				    now + timeout_secs * 1000 });
+			}
+
+			this->attempts.push_back(attempt);
+			continue;
+		}
+
+		fd_set		writeset, exceptset;
+		long int	wait_ms = LONG_MAX;
+		SOCKET		maxfd = 0;
+
+		FD_ZERO(&writeset);
+		FD_ZERO(&exceptset);
+
+		for (const pending_attempt &p : inflight) {
+			FD_SET(p.sock, &writeset);
+			FD_SET(p.sock, &exceptset);
+			maxfd = std::max(maxfd, p.sock);
+			wait_ms = std::min(wait_ms, p.deadline_ms - now);
+		}
+		if (next < addrs.size())
+			wait_ms = std::min(wait_ms, next_start_ms - now);
+
+		struct timeval tv;
+
+		wait_ms = std::max(wait_ms, 0L);
+		tv.tv_sec = wait_ms / 1000;
+		tv.tv_usec = (wait_ms % 1000) * 1000;
+
+		if (select(static_cast<int>(maxfd + 1), nullptr, &writeset,
+		    &exceptset, &tv) < 0) {
+			if (SOCK_ERRNO == SOCK_INTERRUPTED)
+				continue; /* the sets are undefined */
+			err_log(SOCK_ERRNO, "%s: select", __func__);
+			break;
+		}
+
+		now = elapsed_ms(start);
+
+		for (size_t i = 0; i < inflight.size();) {
+			const pending_attempt	&p = inflight[i];
+			conn_attempt		&attempt =
+						    this->attempts[p.attempt];
+
+			if (FD_ISSET(p.sock, &writeset) ||
+			    FD_ISSET(p.sock, &exceptset)) {
+				attempt.error = get_sock_error(p.sock);
+			} else if (now >= p.deadline_ms) {
+				attempt.error = ETIMEDOUT;
+			} else {
+				i++;
+				continue;
+			}
+
+			attempt.end_ms = now;
+
+			if (attempt.error == 0 && winner == INVALID_SOCKET) {
+				attempt.won = true;
+				winner = p.sock;
+			} else {
+				CLOSE_SOCKET(p.sock);
+				next_start_ms = now;
+			}
+
+			inflight.erase(inflight.begin() + i);
+		}
+	}
+
+	/*
+	 * Abandon the attempts still pending
+	 */
+	for (const pending_attempt &p : inflight) {
+		this->attempts[p.attempt].end_ms = elapsed_ms(start);
+		CLOSE_SOCKET(p.sock);
+	}
+
+	if (winner != INVALID_SOCKET) {
+		if (!set_nonblocking(winner, false)) {
+			err_log(SOCK_ERRNO, "%s: set_nonblocking", __func__);
+			CLOSE_SOCKET(winner);
+			return INVALID_SOCKET;
+		}
+
+		for (const conn_attempt &attempt : this->attempts) {
+			if (attempt.won) {
+				winners[this->host] = std::make_pair(
+				    attempt.family, attempt.addr);
+			}
+		}
+	}
+
+	return winner;
+}
+
+/*
+ * Prints the outcome and timing of each attempt
+ */
+void
+conn_race::report(PPRINTTEXT_CONTEXT ctx) const
+{
+	PRINTTEXT_CONTEXT ptext_ctx;
+
+	for (const conn_attempt &attempt : this->attempts) {
+		const long int	ms = attempt.end_ms - attempt.start_ms;
+		CSTRING		addr = attempt.addr.c_str();
+		CSTRING		family = family_name(attempt.family);
+
+		printtext_context_init(&ptext_ctx, ctx->window, TYPE_SPEC1,
+		    true);
+
+		if (attempt.won) {
+			ptext_ctx.spec_type = TYPE_SPEC1_SUCCESS;
+			printtext(&ptext_ctx, _("%s (%s): connected in %ld ms"),
+			    addr, family, ms);
+		} else if (attempt.error != 0) {
+			char strerrbuf[MAXERROR] = { '\0' };
+
+			ptext_ctx.spec_type = TYPE_SPEC1_FAILURE;
+			printtext(&ptext_ctx, _("%s (%s): failed after %ld ms: "
+			    "%s"), addr, family, ms, xstrerror(attempt.error,
+			    strerrbuf, sizeof strerrbuf));
+		} else {
+			printtext(&ptext_ctx, _("%s (%s): abandoned after %ld "
+			    "ms"), addr, family, ms);
+		}
+	}
+}
@@ -0,0 +1,87 @@
+#ifndef CONN_RACE_HPP
+#define CONN_RACE_HPP
+/* connRace.hpp  --  Happy Eyeballs (RFC 8305) connection racing
+   Copyright (C) 2026 Markus Uhlin. All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   - Neither the name of the author nor the names of its contributors may be
+     used to endorse or promote products derived from this software without
+     specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+   BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE. */
+
+#if defined(UNIX)
+#include <sys/socket.h>
+#include <netdb.h>
+#elif defined(WIN32)
+#include <ws2tcpip.h>
+#endif
+
+#include <string>
+#include <vector>
+
+#include "printtext.h"
+
+#if defined(UNIX) && !defined(_SOCKET_DEFINED)
+#define _SOCKET_DEFINED 1
+typedef int SOCKET;
+#endif
+
+/*
+ * Milliseconds before the next address is tried while the previous
+ * attempts are still pending ("Connection Attempt Delay")
+ */
+#define CONN_RACE_DELAY_MS 250
+
+struct conn_attempt {
+	int		family;
+	std::string	addr;
+	long int	start_ms;	/* since the race started */
+	long int	end_ms;
+	int		error;
+	bool		won;
+};
+
+class conn_race {
+public:
+	explicit conn_race(const char *host);
+
+	SOCKET	run(const struct addrinfo *, const struct addrinfo *bind_res,
+		    long int timeout_secs);
+	void	report(PPRINTTEXT_CONTEXT) const;
+
+	const std::vector<conn_attempt> &
+	get_attempts(void) const
+	{
+		return this->attempts;
+	}
+
+	static std::vector<const struct addrinfo *>
+		order(const struct addrinfo *, int pref_family,
+		    const std::string &pref_addr);
+
+private:
+	std::string			host;
+	std::vector<conn_attempt>	attempts;
+};
+
+#endif
@@ -240,14 +240,9 @@ init_color_pairs(void)
 	return pair_n;
 }
 
-/**
- * Initialization of the Ncurses library (done before usage)
- */
-int
-curses_init(void)
+static int
+set_up_screen(const bool interactive)
 {
-	(void) wrefresh(initscr());
-
 	g_cursesMode	= true;
 	g_endwin_fn	= endwin;
 	g_doupdate_fn	= doupdate;
@@ -265,11 +260,11 @@ curses_init(void)
 		}
 	}
 
-	if (cbreak() == ERR) {
+	if (interactive && cbreak() == ERR) {
 		err_msg("Could not enter terminal cbreak mode");
 		return ERR;
 	}
-	if (noecho() == ERR) {
+	if (interactive && noecho() == ERR) {
 		err_msg("Unable to turn echoing off!");
 		return ERR;
 	}
@@ -278,3 +273,33 @@ curses_init(void)
 		return ERR;
 	return OK;
 }
+
+/**
+ * Initialization of the Ncurses library (done before usage)
+ */
+int
+curses_init(void)
+{
+	(void) wrefresh(initscr());
+
+	return set_up_screen(true);
+}
+
+/**
+ * Initializes the library on a screen that isn't connected to a
+ * terminal. Used by the benchmarks to exercise the drawing code without
+ * a tty. (The output is usually written to the null device.)
+ */
+int
+curses_init_headless(const char *term, FILE *out, FILE *in)
+{
+	SCREEN *screen;
+
+	if ((screen = newterm(term, out, in)) == NULL) {
+		err_msg("Unable to create a screen for terminal %s", term);
+		return ERR;
+	}
+
+	(void) set_term(screen);
+	return set_up_screen(false);
+}
@@ -31,6 +31,7 @@ extern short int	g_initialized_pairs;
 
 /* returns OK or ERR */
 int curses_init(void);
+int curses_init_headless(const char *term, FILE *out, FILE *in);
 __SWIRC_END_DECLS
 
 #endif
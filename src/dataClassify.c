@@ -34,6 +34,7 @@
 #include "dataClassify.h"
 #include "errHand.h"
 #include "strHand.h"
+#include "wcwidth-table.h"
 
 static const size_t	filename_len_max = 80;
 static const size_t	hostname_len_max = 255;
@@ -266,7 +267,8 @@ is_whitespace(const char *string)
 
 /*
  * Determines the number of column positions required to display a
- * wide character.
+ * wide character. The widths come from a two-level table generated
+ * by gen-wcwidth.py, which makes the lookup O(1).
  *
  * Specifically written to be used in the printtext and readline
  * modules.
@@ -277,148 +279,11 @@ is_whitespace(const char *string)
 int
 xwcwidth(const wchar_t wc, const int fwlen)
 {
-	/*
-	 * XXX: Please keep the 'fullwidth' array sorted.
-	 */
-	static const RANGE fullwidth[] = {
-		{0x2614, 0x2614,   "Umbrella with rain drops"},
-		{0x2615, 0x2615,   "Hot beverage"},
-		{0x2648, 0x2653,   "Zodiacal symbols"},
-		{0x267F, 0x267F,   "Wheelchair symbol"},
-		{0x2693, 0x2693,   "Anchor"},
-		{0x26A1, 0x26A1,   "High voltage sign"},
-		{0x26AA, 0x26AB,   "Medium white/black circle"},
-		{0x26BD, 0x26BE,   "Sport symbols"},
-		{0x26C4, 0x26C5,   "Weather symbols"},
-		{0x26CE, 0x26CE,   "Ophiuchus (Zodiacal symbol)"},
-		{0x26D4, 0x26D4,   "No entry traffic sign"},
-		{0x26EA, 0x26EA,   "Church (Map symbol)"},
-		{0x26F2, 0x26F2,   "Fountain"},
-		{0x26F3, 0x26F3,   "Flag in hole"},
-		{0x26F5, 0x26F5,   "Sailboat"},
-		{0x26FA, 0x26FA,   "Tent"},
-		{0x26FD, 0x26FD,   "Fuel pump"},
-
-		{0x2705, 0x2705,   "White heavy check mark"},
-		{0x274C, 0x274C,   "Cross mark"},
-		{0x274E, 0x274E,   "Negative squared cross mark"},
-		{0x2795, 0x2797,   "Heavy variants of arithmetic symbols"},
-
-		{0xFF01, 0xFF5E,   "Fullwidth ASCII variants"},
-		{0xFF5F, 0xFF60,   "Fullwidth brackets"},
-		{0xFFE0, 0xFFE6,   "Fullwidth symbol variants"},
-
-		{0x1F300, 0x1F30C, "Weather, landscape, and sky symbols"},
-		{0x1F30D, 0x1F310, "Globe symbols"},
-		{0x1F311, 0x1F320, "Moon, sun, and star symbols"},
-		{0x1F32D, 0x1F32F, "Food symbols"},
-		{0x1F330, 0x1F335, "Plant symbols 1"},
-		{0x1F337, 0x1F344, "Plant symbols 2"},
-		{0x1F345, 0x1F353, "Fruit and vegetable symbols"},
-		{0x1F354, 0x1F374, "Food symbols"},
-		{0x1F375, 0x1F37C, "Beverage symbols"},
-		{0x1F37E, 0x1F37F, "Beverage and food symbols"},
-		{0x1F380, 0x1F393, "Celebration symbols"},
-		{0x1F3A0, 0x1F3AD, "Entertainment symbols"},
-		{0x1F3AE, 0x1F3B0, "Game symbols 1"},
-		{0x1F3B2, 0x1F3B4, "Game symbols 2"},
-		{0x1F3B5, 0x1F3BC, "Musical symbols"},
-		{0x1F3BD, 0x1F3CA, "Sport symbols 1"},
-		{0x1F3CF, 0x1F3D3, "Sport symbols 2"},
-		{0x1F3E0, 0x1F3F0, "Building and map symbols"},
-		{0x1F3F4, 0x1F3F4, "Waving black flag"},
-		{0x1F3F8, 0x1F3F9, "Sport symbols"},
-		{0x1F3FA, 0x1F3FA, "Amphora"},
-//		{0x1F3FB, 0x1F3FF, "Emoji modifiers"},
-
-		{0x1F400, 0x1F42C, "Animal symbols"},
-		{0x1F42D, 0x1F43D, "Animal faces"},
-		{0x1F43E, 0x1F43E, "Paw prints"},
-		{0x1F440, 0x1F440, "Eyes"},
-		{0x1F442, 0x1F445, "Facial parts symbols"},
-		{0x1F446, 0x1F450, "Hand symbols"},
-		{0x1F451, 0x1F463, "Clothing and accessories"},
-		{0x1F464, 0x1F477, "Portrait and role symbols"},
-		{0x1F478, 0x1F480, "Fairy tale symbols"},
-		{0x1F481, 0x1F483, "Role symbols"},
-		{0x1F484, 0x1F488, "Personal care symbols"},
-		{0x1F489, 0x1F48A, "Medical symbols"},
-		{0x1F48B, 0x1F492, "Romance symbols"},
-		{0x1F493, 0x1F49F, "Heart symbols"},
-		{0x1F4A0, 0x1F4AD, "Comic style symbols"},
-		{0x1F4AE, 0x1F4AF, "Japanese school grade symbols"},
-		{0x1F4B0, 0x1F4B9, "Money symbols"},
-		{0x1F4BA, 0x1F4DC, "Office symbols"},
-		{0x1F4DD, 0x1F4F6, "Communication symbols"},
-		{0x1F4F7, 0x1F4FC, "Audio and video symbols"},
-		{0x1F4FF, 0x1F4FF, "Prayer beads"},
-
-		{0x1F500, 0x1F518, "User interface symbols"},
-		{0x1F519, 0x1F51D, "Words with arrows"},
-		{0x1F51E, 0x1F51F, "Enclosed alphanumeric symbols"},
-		{0x1F520, 0x1F524, "User interface input status symbols"},
-		{0x1F525, 0x1F52E, "Tool symbols"},
-		{0x1F52F, 0x1F531, "Miscellaneous symbols"},
-		{0x1F532, 0x1F539, "Geometric shapes"},
-		{0x1F53A, 0x1F53D, "User interface symbols"},
-		{0x1F54B, 0x1F54E, "Religious symbols"},
-		{0x1F550, 0x1F567, "Clock face symbols"},
-		{0x1F57A, 0x1F57A, "Man dancing"},
-		{0x1F595, 0x1F595, "Reversed hand with middle finger extended"},
-		{0x1F596, 0x1F596, "Raised hand with part between middle and ring fingers"},
-		{0x1F5A4, 0x1F5A4, "Black heart"},
-		{0x1F5FB, 0x1F5FF, "Cultural symbols"},
-
-		{0x1F600, 0x1F64F, "Emoticons"},
-		{0x1F680, 0x1F6A4, "Vehicles"},
-		{0x1F6A5, 0x1F6A8, "Traffic signs"},
-		{0x1F6A9, 0x1F6C5, "Signage and other symbols"},
-		{0x1F6CC, 0x1F6CC, "Sleeping accommodation"},
-		{0x1F6D0, 0x1F6D2, "Signage and other symbols"},
-		{0x1F6D5, 0x1F6D7, "Map symbols"},
-		{0x1F6DD, 0x1F6DF, "Miscellaneous symbols"},
-		{0x1F6EB, 0x1F6EB, "Airplane departure"},
-		{0x1F6EC, 0x1F6EC, "Airplane arriving"},
-		{0x1F6F4, 0x1F6FC, "Vehicles"},
-
-		{0x1F90C, 0x1F90C, "Pinched fingers"},
-		{0x1F90D, 0x1F90E, "Colored heart symbols"},
-		{0x1F90F, 0x1F90F, "Pinching hand"},
-		{0x1F910, 0x1F917, "Emoticon faces"},
-		{0x1F918, 0x1F91F, "Hand symbols"},
-		{0x1F920, 0x1F92F, "Emoticon faces"},
-		{0x1F930, 0x1F937, "Portrait and role symbols"},
-		{0x1F938, 0x1F93A, "Sport symbols 1"},
-		{0x1F93C, 0x1F93F, "Sport symbols 2"},
-		{0x1F940, 0x1F945, "Miscellaneous symbols 1"},
-		{0x1F947, 0x1F94F, "Miscellaneous symbols 2"},
-		{0x1F950, 0x1F96F, "Food symbols"},
-		{0x1F970, 0x1F97A, "Faces"},
-		{0x1F97B, 0x1F97F, "Clothing"},
-		{0x1F980, 0x1F9AD, "Animal symbols"},
-		{0x1F9AE, 0x1F9AF, "Accessibility symbols"},
-//		{0x1F9B0, 0x1F9B3, "Emoji components"},
-		{0x1F9B4, 0x1F9B7, "Body parts"},
-		{0x1F9B8, 0x1F9B9, "Role symbols"},
-		{0x1F9BA, 0x1F9BF, "Accessibility symbols"},
-		{0x1F9C0, 0x1F9CB, "Food symbols"},
-		{0x1F9CC, 0x1F9CC, "Troll"},
-		{0x1F9CD, 0x1F9CF, "Portrait and accessibility symbols"},
-		{0x1F9D0, 0x1F9D8, "Portrait and role symbols"},
-		{0x1F9D9, 0x1F9DF, "Fantasy beings"},
-		{0x1F9E0, 0x1F9E6, "Miscellaneous symbols"},
-		{0x1F9E7, 0x1F9E9, "Activities"},
-		{0x1F9EA, 0x1F9FF, "Objects"},
-	};
-	static const size_t mid = ARRAY_SIZE(fullwidth) / 2;
-
 #if TEST_XWCWIDTH
 #pragma message("warning: test included (not to be used in production)")
 	if (wc == L'\0' && fwlen == 7357) {
-		for (const RANGE *rp = &fullwidth[0];
-		    rp < &fullwidth[ARRAY_SIZE(fullwidth)];
-		    rp++) {
-			if (rp->start > rp->stop)
+		for (size_t i = 0; i < ARRAY_SIZE(wcwidth_stage1); i++) {
+			if (wcwidth_stage1[i] >= ARRAY_SIZE(wcwidth_stage2))
 				err_quit("%s: test failed", __func__);
 		}
 	}
@@ -426,21 +291,25 @@ xwcwidth(const wchar_t wc, const int fwlen)
 
 	if (wc >= 0x20 && wc <= 0xFF)
 		return 1;
-	else if (wc < 0x20 || is_combined(wc))
+	else if (wc < 0x20)
 		return 0;
-	else if (wc < fullwidth[0].start ||
-	    wc > fullwidth[ARRAY_SIZE(fullwidth) - 1].stop)
-		return (is_cjk(wc) ? fwlen : 1);
+	else if ((unsigned long int) wc > 0x10FFFF)
+		return 1;
 
-	const size_t begin = (wc < fullwidth[mid].start ? 0 : mid);
-	const size_t end = (wc < fullwidth[mid].start ? mid :
-	    ARRAY_SIZE(fullwidth));
+	const unsigned long int	cp = (unsigned long int) wc;
+	const uint8_t		byte = wcwidth_stage2[wcwidth_stage1[cp >>
+				    WCWIDTH_PAGE_BITS]][(cp & 0xFF) >> 2];
 
-	for (const RANGE *rp = &fullwidth[begin]; rp < &fullwidth[end]; rp++) {
-		if (wc >= rp->start && wc <= rp->stop)
-			return fwlen;
+	switch ((byte >> ((cp & 3) * 2)) & 3) {
+	case 0:
+		return 0;
+	case 2:
+		return fwlen;
+	default:
+		break;
 	}
-	return (is_cjk(wc) ? fwlen : 1);
+
+	return 1;
 }
 
 int
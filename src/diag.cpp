@@ -0,0 +1,446 @@
+/* Asynchronous, rate-limited diagnostics logging
+   Copyright (C) 2026 Markus Uhlin. All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   - Neither the name of the author nor the names of its contributors may be
+     used to endorse or promote products derived from this software without
+     specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+   BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE. */
+
+#include "common.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include "diag.h"
+#include "libUtils.h"
+#include "main.h"
+#include "nestHome.h"
+#include "strHand.h"
+
+#define RING_SIZE		128 /* power of two */
+#define MSG_SIZE		1300
+#define SITE_SLOTS		256 /* power of two */
+#define SITE_PROBES		8
+#define FLUSH_INTERVAL_MS	250
+
+/*
+ * A slot of the ring buffer. The ring is a bounded multi-producer,
+ * single-consumer queue where 'seq' tells whether a slot is free for
+ * the producer at a position, or filled for the consumer.
+ */
+struct ring_cell {
+	std::atomic<size_t>	seq;
+	time_t			seconds;
+	enum diag_log		log;
+	char			text[MSG_SIZE];
+};
+
+struct call_site {
+	std::atomic<const void *>	site;
+	std::atomic<const char *>	fmt;
+	std::atomic<time_t>		window;
+	std::atomic<unsigned int>	count;
+	std::atomic<unsigned int>	suppressed;
+	std::atomic<int>		log;
+};
+
+struct log_file {
+	const char	*name;
+	FILE		*fp;
+	long int	 size;
+};
+
+enum diag_state {
+	STATE_IDLE,
+	STATE_RUNNING,
+	STATE_STOPPED /* messages are written synchronously */
+};
+
+static ring_cell		ring[RING_SIZE];
+static std::atomic<size_t>	enqueue_pos(0);
+static std::atomic<size_t>	dequeue_pos(0);
+static std::atomic<unsigned long int>
+				dropped(0);
+
+static call_site		sites[SITE_SLOTS];
+
+/*
+ * 'drain_mtx' serializes the consumer side of the ring and all file
+ * access
+ */
+static std::mutex		drain_mtx;
+static log_file			files[DIAG_LOG_COUNT] = {
+	{ "error.log", nullptr, 0 },
+	{ "debug.log", nullptr, 0 },
+};
+
+static std::atomic<int>		state(STATE_IDLE);
+static std::condition_variable	flusher_cond;
+static std::mutex		flusher_mtx;
+static std::once_flag		start_flag;
+static std::thread		flusher;
+static bool			flusher_stop = false;
+
+/* -------------------------------------------------- */
+
+static std::string
+get_path(const log_file &lf)
+{
+	std::string path(g_log_dir);
+
+#if defined(UNIX)
+	path.append("/");
+#elif defined(WIN32)
+	path.append("\\");
+#endif
+	path.append(lf.name);
+	return path;
+}
+
+static bool
+open_log(log_file &lf)
+{
+	if (g_log_dir == nullptr)
+		return false;
+	if ((lf.fp = xfopen(get_path(lf).c_str(), "a")) == nullptr)
+		return false;
+	if (fseek(lf.fp, 0L, SEEK_END) != 0 || (lf.size = ftell(lf.fp)) < 0)
+		lf.size = 0;
+	return true;
+}
+
+static void
+close_log(log_file &lf)
+{
+	if (lf.fp != nullptr) {
+		(void) fclose(lf.fp);
+		lf.fp = nullptr;
+	}
+}
+
+static void
+rotate_log(log_file &lf)
+{
+	const std::string path(get_path(lf));
+	const std::string old(path + ".1");
+
+	close_log(lf);
+	(void) remove(old.c_str());
+	(void) rename(path.c_str(), old.c_str());
+	(void) open_log(lf);
+}
+
+static const char *
+get_timestamp(time_t seconds)
+{
+	static char	buffer[200] = { '\0' };
+	static time_t	cached = static_cast<time_t>(-1);
+	struct tm	items = { 0 };
+
+	if (seconds == cached)
+		return &buffer[0];
+
+#if defined(UNIX)
+	if (localtime_r(&seconds, &items) == nullptr)
+		return "";
+#elif defined(WIN32)
+	if (localtime_s(&items, &seconds) != 0)
+		return "";
+#endif
+
+	if (strftime(buffer, sizeof buffer, "%c", &items) == 0)
+		return "";
+	cached = seconds;
+	return &buffer[0];
+}
+
+/*
+ * Write a line to a log. The caller holds 'drain_mtx'.
+ */
+static void
+write_line(enum diag_log log, time_t seconds, const char *msg)
+{
+	log_file	&lf = files[log];
+	int		 n;
+
+	if (lf.fp == nullptr && !open_log(lf))
+		return;
+
+	if ((n = fprintf(lf.fp, "%s %s[%ld]: %s\n", get_timestamp(seconds),
+	    g_progname, g_pid, msg)) > 0)
+		lf.size += n;
+	if (lf.size >= DIAG_ROTATE_SIZE)
+		rotate_log(lf);
+}
+
+/*
+ * Summarize the messages that were suppressed during an elapsed
+ * second. The caller holds 'drain_mtx'.
+ */
+static void
+write_summaries(time_t now)
+{
+	char		 msg[MSG_SIZE] = { '\0' };
+	const char	*fmt;
+	unsigned int	 n;
+
+	for (call_site &cs : sites) {
+		if (cs.site.load() == nullptr || cs.suppressed.load() == 0 ||
+		    cs.window.load() == now)
+			continue;
+		if ((n = cs.suppressed.exchange(0)) == 0)
+			continue;
+		if ((fmt = cs.fmt.load()) == nullptr)
+			fmt = "";
+
+		(void) snprintf(msg, sizeof msg, "(suppressed %u messages like "
+		    "\"%s\")", n, fmt);
+		write_line(static_cast<enum diag_log>(cs.log.load()), now, msg);
+	}
+}
+
+static bool
+enqueue(enum diag_log log, const char *msg)
+{
+	ring_cell	*cell;
+	size_t		 pos = enqueue_pos.load(std::memory_order_relaxed);
+
+	for (;;) {
+		cell = &ring[pos & (RING_SIZE - 1)];
+
+		const size_t seq = cell->seq.load(std::memory_order_acquire);
+		const auto diff = static_cast<intptr_t>(seq) -
+		    static_cast<intptr_t>(pos);
+
+		if (diff == 0) {
+			if (enqueue_pos.compare_exchange_weak(pos, pos + 1,
+			    std::memory_order_relaxed))
+				break;
+		} else if (diff < 0) {
+			return false; /* full */
+		} else {
+			pos = enqueue_pos.load(std::memory_order_relaxed);
+		}
+	}
+
+	cell->seconds = time(nullptr);
+	cell->log = log;
+	(void) sw_strcpy(cell->text, msg, sizeof cell->text);
+	cell->seq.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+/*
+ * Write the queued messages. The caller holds 'drain_mtx'.
+ */
+static void
+drain(void)
+{
+	for (;;) {
+		const size_t	 pos = dequeue_pos.load(
+				     std::memory_order_relaxed);
+		ring_cell	*cell = &ring[pos & (RING_SIZE - 1)];
+
+		if (cell->seq.load(std::memory_order_acquire) != pos + 1)
+			break;
+
+		write_line(cell->log, cell->seconds, cell->text);
+		cell->seq.store(pos + RING_SIZE, std::memory_order_release);
+		dequeue_pos.store(pos + 1, std::memory_order_relaxed);
+	}
+}
+
+static void
+flusher_main(void)
+{
+	std::unique_lock<std::mutex> lock(flusher_mtx);
+
+	while (!flusher_stop) {
+		flusher_cond.wait_for(lock,
+		    std::chrono::milliseconds(FLUSH_INTERVAL_MS));
+		lock.unlock();
+		diag_flush();
+		lock.lock();
+	}
+}
+
+static void
+start(void)
+{
+	for (size_t i = 0; i < RING_SIZE; i++)
+		ring[i].seq.store(i);
+
+	try {
+		flusher = std::thread(flusher_main);
+		state.store(STATE_RUNNING);
+		(void) atexit(diag_deinit);
+	} catch (const std::system_error &) {
+		state.store(STATE_STOPPED);
+	}
+}
+
+/* -------------------------------------------------- */
+
+/**
+ * Rate-limit a call site
+ *
+ * @param log  Log that the call site writes to
+ * @param site Identifies the call site, e.g. a return address
+ * @param fmt  Format string, for the summary of suppressed messages
+ * @return True if the message should be logged
+ */
+bool
+diag_admit(enum diag_log log, const void *site, const char *fmt)
+{
+	const time_t	now = time(nullptr);
+	auto		h = reinterpret_cast<uintptr_t>(site);
+	call_site	*cs = nullptr;
+
+	h ^= (h >> 17);
+	h *= 0x9e3779b1U;
+
+	for (int i = 0; i < SITE_PROBES; i++) {
+		call_site	*p = &sites[(h + i) & (SITE_SLOTS - 1)];
+		const void	*expected = nullptr;
+
+		if (p->site.load() == site ||
+		    p->site.compare_exchange_strong(expected, site) ||
+		    expected == site) {
+			cs = p;
+			break;
+		}
+	}
+
+	if (cs == nullptr)
+		return true; /* table full: no limit */
+
+	cs->fmt.store(fmt);
+	cs->log.store(log);
+
+	time_t window = cs->window.load();
+
+	if (window != now && cs->window.compare_exchange_strong(window, now))
+		cs->count.store(0);
+	if (cs->count.fetch_add(1) < DIAG_BURST)
+		return true;
+	cs->suppressed.fetch_add(1);
+	return false;
+}
+
+/**
+ * Write a message to a log. It's queued for the background flusher,
+ * which holds the logs open.
+ */
+void
+diag_write(enum diag_log log, const char *msg)
+{
+	if (msg == nullptr)
+		return;
+
+	std::call_once(start_flag, start);
+
+	if (state.load() != STATE_RUNNING) {
+		std::lock_guard<std::mutex> lock(drain_mtx);
+
+		write_line(log, time(nullptr), msg);
+		close_log(files[log]);
+		return;
+	}
+
+	if (!enqueue(log, msg))
+		dropped.fetch_add(1);
+	if (log == DIAG_ERROR_LOG || enqueue_pos.load() - dequeue_pos.load() >=
+	    RING_SIZE / 2)
+		flusher_cond.notify_one();
+}
+
+/**
+ * Write everything that's queued right away
+ */
+void
+diag_flush(void)
+{
+	std::lock_guard<std::mutex>	lock(drain_mtx);
+	unsigned long int		n;
+
+	drain();
+
+	if ((n = dropped.exchange(0)) > 0) {
+		char msg[80] = { '\0' };
+
+		(void) snprintf(msg, sizeof msg, "(%lu messages dropped: queue "
+		    "full)", n);
+		write_line(DIAG_ERROR_LOG, time(nullptr), msg);
+	}
+
+	write_summaries(time(nullptr));
+
+	for (log_file &lf : files) {
+		if (lf.fp != nullptr)
+			(void) fflush(lf.fp);
+	}
+}
+
+/**
+ * Stop the flusher, write what's queued and close the logs. Later
+ * messages are written synchronously.
+ */
+void
+diag_deinit(void)
+{
+	int running = STATE_RUNNING;
+
+	if (!state.compare_exchange_strong(running, STATE_STOPPED))
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(flusher_mtx);
+		flusher_stop = true;
+	}
+
+	flusher_cond.notify_one();
+
+	if (flusher.joinable()) {
+		if (flusher.get_id() == std::this_thread::get_id())
+			flusher.detach();
+		else
+			flusher.join();
+	}
+
+	diag_flush();
+
+	std::lock_guard<std::mutex> lock(drain_mtx);
+
+	for (log_file &lf : files)
+		close_log(lf);
+}
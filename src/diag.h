@@ -0,0 +1,28 @@
+#ifndef SRC_DIAG_H_
+#define SRC_DIAG_H_
+
+enum diag_log {
+	DIAG_ERROR_LOG,
+	DIAG_DEBUG_LOG,
+	DIAG_LOG_COUNT
+};
+
+/*
+ * Messages per call site and second. Further messages are suppressed
+ * and summarized.
+ */
+#define DIAG_BURST 20
+
+/*
+ * Size at which a log is rotated, i.e. renamed to <name>.1
+ */
+#define DIAG_ROTATE_SIZE (2L * 1024L * 1024L)
+
+__SWIRC_BEGIN_DECLS
+bool	diag_admit(enum diag_log, const void *site, const char *fmt);
+void	diag_write(enum diag_log, const char *msg);
+void	diag_flush(void);
+void	diag_deinit(void);
+__SWIRC_END_DECLS
+
+#endif
@@ -31,8 +31,8 @@
 
 #include <stdio.h>
 #include <string.h>		/* strerror_r() */
-#include <time.h>
 #ifdef WIN32
+#include <intrin.h>		/* _ReturnAddress() */
 #include <windows.h>		/* MessageBox() */
 #endif
 
@@ -40,63 +40,22 @@
 #include "assertAPI.h"
 #endif
 #include "curses-funcs.h"
+#include "diag.h"
 #include "errHand.h"
 #include "libUtils.h"
 #include "main.h"
-#include "nestHome.h"
 #include "strHand.h"
 
-static const char *
-get_timestamp(void)
-{
-	static char	buffer[200] = { '\0' };
-	struct tm	items = { 0 };
-	time_t		seconds = 0;
-
-	if (time(&seconds) == g_time_error)
-		return "";
-
-#if defined(UNIX)
-	if (localtime_r(&seconds, &items) == NULL)
-		return "";
-#elif defined(WIN32)
-	if (localtime_s(&items, &seconds) != 0)
-		return "";
-#endif
-
-	return ((strftime(buffer, sizeof buffer, "%c", &items) > 0)
-	    ? &buffer[0] : "");
-}
-
-static void
-write_to_error_log(const char *msg)
-{
-	FILE	*fp;
-	char	 path[1300] = { '\0' };
-
-	if (msg == NULL || g_log_dir == NULL || sw_strcpy(path, g_log_dir,
-	    sizeof path) != 0)
-		return;
-
-#if defined(UNIX)
-	if (sw_strcat(path, "/error.log", sizeof path) != 0)
-		return;
-#elif defined(WIN32)
-	if (sw_strcat(path, "\\error.log", sizeof path) != 0)
-		return;
-#endif
-
-	if ((fp = xfopen(path, "a")) != NULL) {
-#ifdef HAVE_BCI
-		(void) fprintf_s(fp, "%s %s[%ld]: %s\n", get_timestamp(),
-		    g_progname, g_pid, msg);
+/*
+ * Identifies the caller of err_log() and debug() for the rate limiting
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define CALL_SITE() __builtin_return_address(0)
+#elif defined(_MSC_VER)
+#define CALL_SITE() _ReturnAddress()
 #else
-		(void) fprintf(fp, "%s %s[%ld]: %s\n", get_timestamp(),
-		    g_progname, g_pid, msg);
+#define CALL_SITE() ((const void *) fmt)
 #endif
-		(void) fclose(fp);
-	}
-}
 
 static void
 err_doit(bool output_to_stderr, int error, const char *fmt, va_list ap)
@@ -116,9 +75,10 @@ err_doit(bool output_to_stderr, int error, const char *fmt, va_list ap)
 		    sizeof out);
 	}
 
-	write_to_error_log(out);
+	diag_write(DIAG_ERROR_LOG, out);
 
 	if (output_to_stderr) {
+		diag_flush();
 		escape_curses();
 
 		(void) fputs(out, stderr);
@@ -184,6 +144,9 @@ err_log(int error, const char *fmt, ...)
 {
 	va_list ap;
 
+	if (!diag_admit(DIAG_ERROR_LOG, CALL_SITE(), fmt))
+		return;
+
 	va_start(ap, fmt);
 	err_doit(false, error, fmt, ap);
 	va_end(ap);
@@ -273,9 +236,7 @@ xstrerror(int errnum, char *strerrbuf, size_t buflen)
 static void
 debug_doit(const char *fmt, va_list ap)
 {
-	FILE	*fp;
-	char	 out[1300] = { '\0' };
-	char	 path[1300] = { '\0' };
+	char out[1300] = { '\0' };
 
 #if defined(UNIX)
 	(void) vsnprintf(out, ARRAY_SIZE(out), fmt, ap);
@@ -283,34 +244,13 @@ debug_doit(const char *fmt, va_list ap)
 	(void) vsnprintf_s(out, ARRAY_SIZE(out), _TRUNCATE, fmt, ap);
 #endif
 
-	if (g_log_dir == NULL ||
-	    sw_strcpy(path, g_log_dir, ARRAY_SIZE(path)) != 0)
-		return;
-
-#if defined(UNIX)
-	if (sw_strcat(path, "/debug.log", ARRAY_SIZE(path)) != 0)
-		return;
-#elif defined(WIN32)
-	if (sw_strcat(path, "\\debug.log", ARRAY_SIZE(path)) != 0)
-		return;
-#endif
-
-	if ((fp = xfopen(path, "a")) != NULL) {
-#ifdef HAVE_BCI
-		(void) fprintf_s(fp, "%s %s[%ld]: %s\n", get_timestamp(),
-		    g_progname, g_pid, out);
-#else
-		(void) fprintf(fp, "%s %s[%ld]: %s\n", get_timestamp(),
-		    g_progname, g_pid, out);
-#endif
-		(void) fclose(fp);
-	}
+	diag_write(DIAG_DEBUG_LOG, out);
 }
 
 void
 debug(const char *fmt, ...)
 {
-	if (g_debug_logging) {
+	if (g_debug_logging && diag_admit(DIAG_DEBUG_LOG, CALL_SITE(), fmt)) {
 		va_list ap;
 
 		va_start(ap, fmt);
@@ -32,6 +32,7 @@
 #include <cstdint>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "../config.h"
@@ -40,9 +41,11 @@
 #include "../irc.h"
 #include "../printtext.h"
 #include "../strHand.h"
+#include "../strpool.h"
 #include "../theme.h"
 
 #include "batch.h"
+#include "chanstate.h"
 
 #define PRINT_NETJOIN_MSGS 0
 #define PRINT_NETSPLIT_MSGS 0
@@ -52,20 +55,58 @@ public:
 	std::vector<std::string>	params;
 	std::vector<std::string>	irc_msgs;
 
-	batch() : type(BATCH_UNKNOWN)
+	batch() : ref(nullptr), type(BATCH_UNKNOWN)
 	{
-		this->ref.assign("");
+		/* null */;
 	}
 
-	batch(CSTRING p_ref, const batch_t p_type) : type(p_type)
+	batch(CSTRING p_ref, const batch_t p_type)
+	    : ref(strpool_intern(p_ref))
+	    , type(p_type)
 	{
-		this->ref.assign(p_ref);
+		/* null */;
 	}
 
+	batch(const batch &other)
+	    : params(other.params)
+	    , irc_msgs(other.irc_msgs)
+	    , ref(strpool_ref(other.ref))
+	    , type(other.type)
+	{
+		/* null */;
+	}
+
+	batch(batch &&other) noexcept
+	    : params(std::move(other.params))
+	    , irc_msgs(std::move(other.irc_msgs))
+	    , ref(other.ref)
+	    , type(other.type)
+	{
+		other.ref = nullptr;
+	}
+
+	batch &
+	operator=(batch other) noexcept
+	{
+		this->params.swap(other.params);
+		this->irc_msgs.swap(other.irc_msgs);
+		std::swap(this->ref, other.ref);
+		std::swap(this->type, other.type);
+		return *this;
+	}
+
+	~batch()
+	{
+		strpool_release(this->ref);
+	}
+
+	/*
+	 * Returns the interned reference tag
+	 */
 	CSTRING
 	get_ref(void) const
 	{
-		return this->ref.c_str();
+		return this->ref;
 	}
 
 	batch_t
@@ -75,7 +116,7 @@ public:
 	}
 
 private:
-	std::string	ref;
+	CSTRING		ref;
 	batch_t		type;
 };
 
@@ -102,18 +143,20 @@ save_backlogs_to_disk_yesno(CSTRING label)
 	return false;
 }
 
+/*
+ * Finds a batch by its reference tag. The tags are interned, which
+ * makes the comparisons pointer comparisons.
+ */
 static bool
-get_obj_by_ref(CSTRING ref, batch &obj, std::vector<batch>::size_type &pos)
+find_batch(CSTRING ref, std::vector<batch>::size_type &pos)
 {
-	pos = 0;
+	CSTRING key;
 
-	for (const batch &x : batch_db) {
-		if (strings_match(x.get_ref(), ref)) {
-			obj = x;
+	if ((key = strpool_find(ref)) == nullptr)
+		return false;
+	for (pos = 0; pos < batch_db.size(); pos++) {
+		if (batch_db[pos].get_ref() == key)
 			return true;
-		}
-
-		pos++;
 	}
 
 	return false;
@@ -153,7 +196,7 @@ create_batch(STRING params)
 	}
 
 #if defined(__cplusplus) && __cplusplus >= 201103L
-	batch_db.emplace_back(batch_obj);
+	batch_db.emplace_back(std::move(batch_obj));
 #else
 	batch_db.push_back(batch_obj);
 #endif
@@ -213,8 +256,10 @@ netjoin(batch &obj)
 	}
 #endif // PRINT_NETJOIN_MSGS
 
+	chanstate_batch_begin();
 	for (const std::string &str : obj.irc_msgs)
 		irc_process_proto_msg(str.c_str());
+	chanstate_batch_end();
 }
 
 static void
@@ -238,8 +283,10 @@ netsplit(batch &obj)
 	}
 #endif // PRINT_NETSPLIT_MSGS
 
+	chanstate_batch_begin();
 	for (const std::string &str : obj.irc_msgs)
 		irc_process_proto_msg(str.c_str());
+	chanstate_batch_end();
 }
 
 static void
@@ -279,7 +326,6 @@ static void
 process_batch(CSTRING params)
 {
 	CSTRING ref;
-	batch obj("", BATCH_UNKNOWN);
 	std::vector<batch>::size_type pos = 0;
 
 	if (strchr(params, ' ') != nullptr)
@@ -287,8 +333,13 @@ process_batch(CSTRING params)
 
 	ref = params;
 
-	if (!get_obj_by_ref(ref, obj, pos))
+	if (!find_batch(ref, pos))
 		throw std::runtime_error("cannot find a such batch");
+
+	batch obj(std::move(batch_db.at(pos)));
+
+	batch_db.erase(batch_db.begin() + pos);
+
 	switch (obj.get_type()) {
 	case BATCH_CHATHISTORY:
 		chathistory(obj);
@@ -307,8 +358,6 @@ process_batch(CSTRING params)
 		/* unknown batch type */
 		throw std::runtime_error("process_batch: unknown batch type");
 	}
-
-	batch_db.erase(batch_db.begin() + pos);
 }
 
 void
@@ -344,10 +393,9 @@ event_batch_add_irc_msgs(CSTRING ref, CSTRING msg)
 	printtext_context_init(&ctx, g_status_window, TYPE_SPEC1_WARN, true);
 
 	try {
-		batch dummy;
 		std::vector<batch>::size_type pos = 0;
 
-		if (!get_obj_by_ref(ref, dummy, pos))
+		if (!find_batch(ref, pos))
 			throw std::runtime_error("cannot find batch");
 
 #if defined(__cplusplus) && __cplusplus >= 201103L
@@ -6,13 +6,13 @@ EVENTS_SRCS = $(EVENTS_DIR)account.cpp\
 	$(EVENTS_DIR)batch.cpp\
 	$(EVENTS_DIR)cap.c\
 	$(EVENTS_DIR)channel.cpp\
+	$(EVENTS_DIR)chanstate.cpp\
 	$(EVENTS_DIR)chghost.cpp\
 	$(EVENTS_DIR)error.c\
 	$(EVENTS_DIR)invite.cpp\
 	$(EVENTS_DIR)list.cpp\
 	$(EVENTS_DIR)misc.cpp\
 	$(EVENTS_DIR)motd.c\
-	$(EVENTS_DIR)names-htbl-modify.cpp\
 	$(EVENTS_DIR)names.cpp\
 	$(EVENTS_DIR)noop.c\
 	$(EVENTS_DIR)notice.cpp\
@@ -33,13 +33,13 @@ OBJS += $(EVENTS_DIR)account.o\
 	$(EVENTS_DIR)batch.o\
 	$(EVENTS_DIR)cap.o\
 	$(EVENTS_DIR)channel.o\
+	$(EVENTS_DIR)chanstate.o\
 	$(EVENTS_DIR)chghost.o\
 	$(EVENTS_DIR)error.o\
 	$(EVENTS_DIR)invite.o\
 	$(EVENTS_DIR)list.o\
 	$(EVENTS_DIR)misc.o\
 	$(EVENTS_DIR)motd.o\
-	$(EVENTS_DIR)names-htbl-modify.o\
 	$(EVENTS_DIR)names.o\
 	$(EVENTS_DIR)noop.o\
 	$(EVENTS_DIR)notice.o\
@@ -7,13 +7,13 @@ OBJS = $(OBJS)\
 	$(EVENTS_DIR)batch.obj\
 	$(EVENTS_DIR)cap.obj\
 	$(EVENTS_DIR)channel.obj\
+	$(EVENTS_DIR)chanstate.obj\
 	$(EVENTS_DIR)chghost.obj\
 	$(EVENTS_DIR)error.obj\
 	$(EVENTS_DIR)invite.obj\
 	$(EVENTS_DIR)list.obj\
 	$(EVENTS_DIR)misc.obj\
 	$(EVENTS_DIR)motd.obj\
-	$(EVENTS_DIR)names-htbl-modify.obj\
 	$(EVENTS_DIR)names.obj\
 	$(EVENTS_DIR)noop.obj\
 	$(EVENTS_DIR)notice.obj\
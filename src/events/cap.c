@@ -36,6 +36,8 @@
 #include "../printtext.h"
 #include "../strHand.h"
 
+#include "../commands/connect.h" /* ssl_is_enabled() */
+
 #include "cap.h"
 
 bool
@@ -64,6 +66,47 @@ get_sasl_mechanism(void)
 	return (strings_match(mechanism, "") ? "PLAIN" : mechanism);
 }
 
+/*
+ * Longest CAP REQ sent, not counting the CR-LF
+ */
+#define CAP_REQ_MAX 510
+
+struct cap_wanted {
+	const char	*name;
+	const char	*setting;
+	bool		 fallback;
+	const char	*desc;
+};
+
+/*
+ * Capabilities that are requested if the server offers them. SASL has
+ * no setting of its own.
+ */
+static const struct cap_wanted wanted_caps[] = {
+	{ "account-notify", "account_notify", true,  "Account notify" },
+	{ "account-tag",    "account_tag",    true,  "Account tag" },
+	{ "away-notify",    "away_notify",    false, "Away notify" },
+	{ "batch",          "batch",          true,  "Batch" },
+	{ "chghost",        "chghost",        true,  "Change host" },
+	{ "extended-join",  "extended_join",  true,  "Extended join" },
+	{ "invite-notify",  "invite_notify",  false, "Invite notify" },
+	{ "multi-prefix",   "multi_prefix",   true,  "Multi prefix" },
+	{ "server-time",    "server_time",    true,  "Server time" },
+	{ "sasl",           NULL,             false, "SASL authentication" },
+};
+
+/*
+ * Negotiation at registration: collecting the CAP LS reply, then
+ * waiting for the reply to the CAP REQ
+ */
+static enum {
+	CAPNEG_IDLE,
+	CAPNEG_LS,
+	CAPNEG_REQ
+} capneg_state = CAPNEG_IDLE;
+
+static char capneg_req[CAP_REQ_MAX - 8] = { '\0' };
+
 static void
 ACK(const char *feature)
 {
@@ -82,139 +125,173 @@ NAK(const char *feature)
 	printtext(&ctx, "%s rejected", feature);
 }
 
+static const struct cap_wanted *
+get_wanted(const char *name)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(wanted_caps); i++) {
+		if (strings_match(wanted_caps[i].name, name))
+			return &wanted_caps[i];
+	}
+
+	return NULL;
+}
+
 static bool
-shouldContinueCapabilityNegotiation(const size_t off)
+sasl_is_wanted(void)
 {
-	bool array[9];
-
-	array[0] = config_bool("account_tag", true);
-	array[1] = config_bool("away_notify", false);
-	array[2] = config_bool("batch", true);
-	array[3] = config_bool("chghost", true);
-	array[4] = config_bool("extended_join", true);
-	array[5] = config_bool("invite_notify", false);
-	array[6] = config_bool("multi_prefix", true);
-	array[7] = config_bool("server_time", true);
-	array[8] = sasl_is_enabled();
-
-	for (size_t i = off; i < ARRAY_SIZE(array); i++) {
-		if (array[i])
-			return true;
+	PRINTTEXT_CONTEXT ctx;
+
+	if (!sasl_is_enabled())
+		return false;
+	if (strings_match(get_sasl_mechanism(), "PLAIN") && !ssl_is_enabled()) {
+		printtext_context_init(&ctx, g_status_window, TYPE_SPEC1_WARN,
+		    true);
+		printtext(&ctx, "SASL mechanism matches PLAIN and TLS/SSL is "
+		    "not enabled. Not requesting SASL authentication.");
+		return false;
 	}
 
-	return false;
+	return true;
 }
 
+static bool
+is_wanted(const struct cap_wanted *cap)
+{
+	if (cap == NULL)
+		return false;
+	if (cap->setting == NULL)
+		return sasl_is_wanted();
+	return config_bool(cap->setting, cap->fallback);
+}
+
+/*
+ * Adds the wanted capabilities of a space-separated list (where each
+ * may have a value, as in "sasl=PLAIN,EXTERNAL") to 'req'
+ */
 static void
-handle_ack_and_nak(PPRINTTEXT_CONTEXT ctx, struct irc_message_compo *compo,
-    const char *cmd, const char *caplist, bool *continue_capneg)
+add_wanted(char *req, size_t size, char *caplist, bool after_reg)
 {
-	if (strings_match(caplist, "account-notify")) {
-		if (strings_match(cmd, "ACK"))
-			ACK("Account notify");
-		else
-			NAK("Account notify");
-		*continue_capneg = shouldContinueCapabilityNegotiation(0);
-	} else if (strings_match(caplist, "account-tag")) {
-		if (strings_match(cmd, "ACK"))
-			ACK("Account tag");
-		else
-			NAK("Account tag");
-		*continue_capneg = shouldContinueCapabilityNegotiation(1);
-	} else if (strings_match(caplist, "away-notify")) {
-		if (strings_match(cmd, "ACK"))
-			ACK("Away notify");
-		else
-			NAK("Away notify");
-		*continue_capneg = shouldContinueCapabilityNegotiation(2);
-	} else if (strings_match(caplist, "batch")) {
-		if (strings_match(cmd, "ACK"))
-			ACK("Batch");
-		else
-			NAK("Batch");
-		*continue_capneg = shouldContinueCapabilityNegotiation(3);
-	} else if (strings_match(caplist, "chghost")) {
-		if (strings_match(cmd, "ACK"))
-			ACK("Change host");
-		else
-			NAK("Change host");
-		*continue_capneg = shouldContinueCapabilityNegotiation(4);
-	} else if (strings_match(caplist, "extended-join")) {
-		if (strings_match(cmd, "ACK"))
-			ACK("Extended join");
-		else
-			NAK("Extended join");
-		*continue_capneg = shouldContinueCapabilityNegotiation(5);
-	} else if (strings_match(caplist, "invite-notify")) {
-		if (strings_match(cmd, "ACK"))
-			ACK("Invite notify");
-		else
-			NAK("Invite notify");
-		*continue_capneg = shouldContinueCapabilityNegotiation(6);
-	} else if (strings_match(caplist, "multi-prefix")) {
-		if (strings_match(cmd, "ACK"))
-			ACK("Multi prefix");
-		else
-			NAK("Multi prefix");
-		*continue_capneg = shouldContinueCapabilityNegotiation(7);
-	} else if (strings_match(caplist, "server-time")) {
-		if (strings_match(cmd, "ACK"))
-			ACK("Server time");
-		else
-			NAK("Server time");
-		*continue_capneg = shouldContinueCapabilityNegotiation(8);
-	} else if (strings_match(caplist, "sasl")) {
-		if (strings_match(cmd, "ACK")) {
-			const char *mechanism;
+	char	*last = "";
+	char	*token;
+
+	for (token = strtok_r(caplist, " ", &last); token != NULL;
+	    token = strtok_r(NULL, " ", &last)) {
+		const struct cap_wanted *cap;
+
+		token[strcspn(token, "=")] = '\0';
+
+		if ((cap = get_wanted(token)) == NULL ||
+		    (after_reg && cap->setting == NULL) || !is_wanted(cap))
+			continue;
+		if (*req != '\0' && sw_strcat(req, " ", size) != 0)
+			break;
+		if (sw_strcat(req, token, size) != 0)
+			break;
+	}
+}
 
-			ACK("SASL authentication");
+static void
+end_capneg(PPRINTTEXT_CONTEXT ctx)
+{
+	capneg_state = CAPNEG_IDLE;
+	(void) net_send("CAP END");
+	printtext(ctx, "Ended IRCv3 Client Capability Negotiation");
+}
+
+/*
+ * Called before the opening burst of a registration, which starts with
+ * CAP LS 302
+ */
+void
+cap_negotiation_begin(void)
+{
+	capneg_state = CAPNEG_LS;
+	BZERO(capneg_req, sizeof capneg_req);
+}
+
+/*
+ * The whole CAP LS reply is in. Requests every wanted capability the
+ * server offers, with a single CAP REQ.
+ */
+static void
+handle_ls_done(PPRINTTEXT_CONTEXT ctx)
+{
+	if (strings_match(capneg_req, "")) {
+		end_capneg(ctx);
+		return;
+	}
+
+	capneg_state = CAPNEG_REQ;
+	(void) net_send("CAP REQ :%s", capneg_req);
+
+	ctx->spec_type = TYPE_SPEC1_SUCCESS;
+	printtext(ctx, "Requesting: %s", capneg_req);
+}
 
-			mechanism = get_sasl_mechanism();
+static void
+handle_ack_and_nak(PPRINTTEXT_CONTEXT ctx, const char *cmd, char *caplist)
+{
+	bool	 authenticating = false;
+	char	*last = "";
+	char	*token;
+
+	for (token = strtok_r(caplist, " ", &last); token != NULL;
+	    token = strtok_r(NULL, " ", &last)) {
+		const struct cap_wanted	*cap = get_wanted(token);
+		const char		*desc = (cap ? cap->desc : token);
+
+		if (!strings_match(cmd, "ACK")) {
+			NAK(desc);
+			continue;
+		}
+
+		ACK(desc);
+
+		if (strings_match(token, "sasl")) {
+			const char *mechanism = get_sasl_mechanism();
 
 			if (!is_sasl_mechanism_supported(mechanism)) {
 				err_log(ENOSYS, "Unsupported SASL mechanism"
 				    ": '%s'", mechanism);
-				return;
+				continue;
 			}
 
-			*continue_capneg = true;
+			/*
+			 * The negotiation is ended when the
+			 * authentication is done
+			 */
+			authenticating = true;
 			(void) net_send("AUTHENTICATE %s", mechanism);
-		} else {
-			NAK("SASL authentication");
 		}
-	} else {
-		printtext(ctx, "Unknown acknowledgement during capability "
-		    "negotiation...");
-		printtext(ctx, "params = %s", compo->params);
-		printtext(ctx, "prefix = %s", (compo->prefix ? compo->prefix :
-		    "none"));
+	}
+
+	if (capneg_state == CAPNEG_REQ) {
+		if (authenticating)
+			capneg_state = CAPNEG_IDLE;
+		else
+			end_capneg(ctx);
 	}
 }
 
 static void
-handle_cap_new(const char *caplist)
+handle_cap_new(char *caplist)
 {
-	if (strings_match(caplist, "account-notify") &&
-	    config_bool("account_notify", true))
-		(void)net_send("CAP REQ :account-notify");
-	else if (strings_match(caplist, "account-tag") &&
-		 config_bool("account_tag", true))
-		(void)net_send("CAP REQ :account-tag");
-	else if (strings_match(caplist, "away-notify") &&
-		 config_bool("away_notify", false))
-		(void)net_send("CAP REQ :away-notify");
-	else if (strings_match(caplist, "extended-join") &&
-		 config_bool("extended_join", true))
-		(void)net_send("CAP REQ :extended-join");
+	char req[CAP_REQ_MAX - 8] = { '\0' };
+
+	add_wanted(req, sizeof req, caplist, true);
+
+	if (!strings_match(req, ""))
+		(void) net_send("CAP REQ :%s", req);
 	else
-		debug("%s: else branch: %s", __func__, caplist);
+		debug("%s: nothing to request", __func__);
 }
 
 /**
  * event_cap()
  *
  * Examples:
- *     :server.com CAP * LS :multi-prefix sasl
+ *     :server.com CAP * LS * :multi-prefix sasl=PLAIN
+ *     :server.com CAP * LS :server-time
  *     :server.com CAP * LIST :multi-prefix
  *     :server.com CAP * ACK :multi-prefix sasl
  *     :server.com CAP * NAK :multi-prefix sasl
@@ -223,7 +300,7 @@ void
 event_cap(struct irc_message_compo *compo)
 {
 	PRINTTEXT_CONTEXT	 ctx;
-	bool			 continue_capneg = false;
+	bool			 more = false;
 	char			*cmd, *caplist;
 	char			*last = "";
 
@@ -241,6 +318,12 @@ event_cap(struct irc_message_compo *compo)
 
 	printtext_context_init(&ctx, g_status_window, TYPE_SPEC1_WARN, true);
 
+	/* multiline reply (302) */
+	if (strncmp(caplist, "* ", 2) == 0) {
+		more = true;
+		caplist += 2;
+	}
+
 	if (*caplist == ':')
 		caplist++;
 	(void) trim(caplist);
@@ -249,16 +332,21 @@ event_cap(struct irc_message_compo *compo)
 		ctx.window	= g_active_window;
 		ctx.spec_type	= TYPE_SPEC1;
 		printtext(&ctx, "  * %s", caplist);
+
+		if (capneg_state == CAPNEG_LS) {
+			add_wanted(capneg_req, sizeof capneg_req, caplist,
+			    false);
+			if (!more) {
+				ctx.window = g_status_window;
+				handle_ls_done(&ctx);
+			}
+		}
 	} else if (strings_match(cmd, "LIST")) {
 		ctx.window	= g_active_window;
 		ctx.spec_type	= TYPE_SPEC1;
 		printtext(&ctx, "  * %s", caplist);
 	} else if (strings_match(cmd, "ACK") || strings_match(cmd, "NAK")) {
-		handle_ack_and_nak(&ctx, compo, cmd, caplist, &continue_capneg);
-		if (continue_capneg)
-			return;
-		(void) net_send("CAP END");
-		printtext(&ctx, "Ended IRCv3 Client Capability Negotiation");
+		handle_ack_and_nak(&ctx, cmd, caplist);
 	} else if (strings_match(cmd, "NEW")) {
 		ctx.spec_type = TYPE_SPEC1_SUCCESS;
 		printtext(&ctx, "%s: NEW: %s", __func__, caplist);
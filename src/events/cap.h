@@ -4,6 +4,7 @@
 __SWIRC_BEGIN_DECLS
 bool		 is_sasl_mechanism_supported(const char *);
 const char	*get_sasl_mechanism(void);
+void		 cap_negotiation_begin(void);
 void		 event_cap(struct irc_message_compo *);
 __SWIRC_END_DECLS
 
@@ -45,15 +45,13 @@
 #include "../theme.h"
 
 #include "channel.h"
+#include "chanstate.h"
 #include "i18n.h"
 #include "names.h"
 
 #define SHUTDOWN_IRC_CONNECTION_BEHAVIOR 0
 #define TM_STRUCT_MSG "unable to retrieve tm structure"
 
-#define log_unwanted_pm_state() \
-	err_log(EINVAL, "%s: error: neither +/-", __func__)
-
 struct quit_context {
 	CSTRING		message;
 	CSTRING		nick, user, host;
@@ -63,7 +61,7 @@ static void	auto_op(CSTRING, CSTRING) NONNULL;
 static void	handle_quit(PIRC_WINDOW, PPRINTTEXT_CONTEXT,
 		    struct quit_context *) NONNULL;
 static bool	is_netsplit(CSTRING, std::string &, std::string &) NONNULL;
-static void	maintain_channel_stats(const char *, const char *) NONNULL;
+static void	maintain_channel_stats(PIRC_WINDOW, const char *) NONNULL;
 
 /* event_chan_hp: 328
 
@@ -140,10 +138,9 @@ join_perform_some_tasks(CSTRING channel, CSTRING nick, CSTRING account,
 		throw std::runtime_error("unable to add user to channel list");
 	} else if (account != nullptr && rl_name != nullptr &&
 	    (n = event_names_htbl_lookup(nick, channel)) != nullptr) {
-		free(n->account);
-		free(n->rl_name);
-		n->account = sw_strdup(account);
-		n->rl_name = sw_strdup(rl_name);
+		mutex_lock(&g_win_htbl_mtx);
+		event_names_set_info(n, account, rl_name);
+		mutex_unlock(&g_win_htbl_mtx);
 	}
 }
 
@@ -320,200 +317,23 @@ event_kick(struct irc_message_compo *compo)
 	}
 }
 
-static void
-chg_status_for_owner(plus_minus_state_t pm_state, const char *nick,
-    const char *channel)
-{
-	/* On ircd-seven +q means quiet and works like +b (ban user),
-	 * but allows matching users to join the channel. However: on
-	 * InspIRCd setting +q makes user channel owner. This should
-	 * fix the problem. */
-	if (!is_valid_nickname(nick))
-		return;
-
-	switch (pm_state) {
-	case STATE_PLUS:
-		if (names_htbl_modify::owner(nick, channel, true) != OK)
-			err_log(0, "%s (+)", __func__);
-		break;
-	case STATE_MINUS:
-		if (names_htbl_modify::owner(nick, channel, false) != OK)
-			err_log(0, "%s (-)", __func__);
-		break;
-	case STATE_NEITHER_PM:
-	default:
-		log_unwanted_pm_state();
-		break;
-	}
-}
-
-static void
-chg_status_for_superop(plus_minus_state_t pm_state, const char *nick,
-    const char *channel)
-{
-	switch (pm_state) {
-	case STATE_PLUS:
-		if (names_htbl_modify::superop(nick, channel, true) != OK)
-			err_log(0, "%s (+)", __func__);
-		break;
-	case STATE_MINUS:
-		if (names_htbl_modify::superop(nick, channel, false) != OK)
-			err_log(0, "%s (-)", __func__);
-		break;
-	case STATE_NEITHER_PM:
-	default:
-		log_unwanted_pm_state();
-		break;
-	}
-}
-
-static void
-chg_status_for_op(plus_minus_state_t pm_state, const char *nick,
-    const char *channel)
-{
-	switch (pm_state) {
-	case STATE_PLUS:
-		if (names_htbl_modify::op(nick, channel, true) != OK)
-			err_log(0, "%s (+)", __func__);
-		break;
-	case STATE_MINUS:
-		if (names_htbl_modify::op(nick, channel, false) != OK)
-			err_log(0, "%s (-)", __func__);
-		break;
-	case STATE_NEITHER_PM:
-	default:
-		log_unwanted_pm_state();
-		break;
-	}
-}
-
-static void
-chg_status_for_halfop(plus_minus_state_t pm_state, const char *nick,
-    const char *channel)
-{
-	switch (pm_state) {
-	case STATE_PLUS:
-		if (names_htbl_modify::halfop(nick, channel, true) != OK)
-			err_log(0, "%s (+)", __func__);
-		break;
-	case STATE_MINUS:
-		if (names_htbl_modify::halfop(nick, channel, false) != OK)
-			err_log(0, "%s (-)", __func__);
-		break;
-	case STATE_NEITHER_PM:
-	default:
-		log_unwanted_pm_state();
-		break;
-	}
-}
-
-static void
-chg_status_for_voice(plus_minus_state_t pm_state, const char *nick,
-    const char *channel)
-{
-	switch (pm_state) {
-	case STATE_PLUS:
-		if (names_htbl_modify::voice(nick, channel, true) != OK)
-			err_log(0, "%s (+)", __func__);
-		break;
-	case STATE_MINUS:
-		if (names_htbl_modify::voice(nick, channel, false) != OK)
-			err_log(0, "%s (-)", __func__);
-		break;
-	case STATE_NEITHER_PM:
-	default:
-		log_unwanted_pm_state();
-		break;
-	}
-}
-
 /*
  * Example input: +vvv nick1 nick2 nick3
  */
 static void
-maintain_channel_stats(const char *channel, const char *input)
+maintain_channel_stats(PIRC_WINDOW window, const char *input)
 {
-	CSTRING			modes	       = nullptr;
-	STRING			input_copy;
-	STRING			nicks[15]      = { nullptr };
-	auto			state	       = const_cast<STRING>("");
-	plus_minus_state_t	pm_state       = STATE_NEITHER_PM;
-	size_t			ar_i	       = 0;
-	size_t			nicks_assigned = 0;
-	static const size_t	ar_sz	       = ARRAY_SIZE(nicks);
-
-	input_copy = sw_strdup(input);
-
-	if ((modes = strtok_r(input_copy, " ", &state)) == nullptr) {
-		err_log(EINVAL, "%s", __func__);
-		free(input_copy);
-		return;
-	}
-
-	for (nicks_assigned = 0;; nicks_assigned++) {
-		const char	*token;
-
-		if ((token = strtok_r(nullptr, " ", &state)) != nullptr &&
-		    nicks_assigned < ar_sz)
-			nicks[nicks_assigned] = sw_strdup(token);
-		else
-			break;
-	}
+	struct chanstate_change	changes[CHANSTATE_CHANGES_MAX];
+	STRING			input_copy = sw_strdup(input);
+	size_t			n;
 
-	for (const char *cp = modes; *cp && ar_i < nicks_assigned; cp++) {
-		switch (*cp) {
-		case '+':
-			pm_state = STATE_PLUS;
-			break;
-		case '-':
-			pm_state = STATE_MINUS;
-			break;
-		case 'I': /* set/remove an invitation mask */
-		case 'b': /* set/remove ban mask           */
-		case 'e': /* set/remove an exception mask  */
-		case 'k': /* set/remove the channel key    */
-			ar_i++;
-			break;
-		case 'j': /* join throttle */
-		case 'l': /* set/remove the user limit to channel */
-			if (pm_state == STATE_PLUS)
-				ar_i++;
-			break;
-		case 'q':
-			chg_status_for_owner(pm_state, nicks[ar_i++], channel);
-			break;
-		case 'a':
-			chg_status_for_superop(pm_state, nicks[ar_i++],
-			    channel);
-			break;
-		case 'o':
-			chg_status_for_op(pm_state, nicks[ar_i++], channel);
-			break;
-		case 'h':
-			chg_status_for_halfop(pm_state, nicks[ar_i++], channel);
-			break;
-		case 'v':
-			chg_status_for_voice(pm_state, nicks[ar_i++], channel);
-			break;
-		default:
-			/* No statements here ATM. */
-			break;
-		}
-	}
+	n = chanstate_parse(input_copy, changes, ARRAY_SIZE(changes));
 
-	if (strspn(modes, "+-Ibeqaohv") != strlen(modes) && net_send("MODE %s",
-	    channel) < 0)
+	if (chanstate_apply(window, changes, n) && net_send("MODE %s",
+	    window->label) < 0)
 		err_log(ENOTCONN, "%s: net_send", __func__);
 
 	free(input_copy);
-
-	/*
-	 * Destroy the array...
-	 */
-	for (char **ar_p = &nicks[0]; ar_p < &nicks[ar_sz]; ar_p++) {
-		free(*ar_p);
-		*ar_p = nullptr;
-	}
 }
 
 /* event_mode
@@ -590,7 +410,7 @@ event_mode(struct irc_message_compo *compo)
 			    LEFT_BRKT, next_token_copy, RIGHT_BRKT,
 			    COLOR2, nick, NORMAL);
 
-			maintain_channel_stats(channel, next_token_copy);
+			maintain_channel_stats(ctx.window, next_token_copy);
 		} else {
 			throw std::runtime_error("unhandled else branch");
 		}
@@ -609,8 +429,10 @@ RemoveAndInsertNick(const char *old_nick, const char *new_nick,
     const char *label)
 {
 	PNAMES		p;
-	bool		is_owner, is_superop, is_op, is_halfop, is_voice;
 	std::string	array[2];
+	unsigned int	privs;
+
+	event_names_staging_rename(old_nick, new_nick, label);
 
 	if ((p = event_names_htbl_lookup(old_nick, label)) == nullptr)
 		return ERR; /* non-fatal: old_nick not found on channel */
@@ -618,11 +440,7 @@ RemoveAndInsertNick(const char *old_nick, const char *new_nick,
 	array[0].assign(p->account ? p->account : "<no account>");
 	array[1].assign(p->rl_name ? p->rl_name : "<no rl name>");
 
-	is_owner	= p->is_owner;
-	is_superop	= p->is_superop;
-	is_op		= p->is_op;
-	is_halfop	= p->is_halfop;
-	is_voice	= p->is_voice;
+	privs = p->privs;
 
 	if (event_names_htbl_remove(old_nick, label) != OK) {
 		err_log(0, "%s: event_names_htbl_remove", __func__);
@@ -631,29 +449,19 @@ RemoveAndInsertNick(const char *old_nick, const char *new_nick,
 		err_log(0, "%s: event_names_htbl_insert", __func__);
 		return ERR;
 	} else if ((p = event_names_htbl_lookup(new_nick, label)) != nullptr) {
-		free(p->account);
-		free(p->rl_name);
-		p->account = sw_strdup(array[0].c_str());
-		p->rl_name = sw_strdup(array[1].c_str());
+		PIRC_WINDOW window = window_by_label(label);
+
+		mutex_lock(&g_win_htbl_mtx);
+		event_names_set_info(p, array[0].c_str(), array[1].c_str());
+		event_names_set_privs(window, p, privs);
+		mutex_unlock(&g_win_htbl_mtx);
+		(void) chanstate_refresh(window);
 	} else {
 		err_log(0, "%s: new nick (%s) not found on %s", __func__,
 		    new_nick, label);
 		return ERR;
 	}
 
-	/*
-	 * Reverse order...
-	 */
-	if (is_voice)
-		chg_status_for_voice(STATE_PLUS, new_nick, label);
-	if (is_halfop)
-		chg_status_for_halfop(STATE_PLUS, new_nick, label);
-	if (is_op)
-		chg_status_for_op(STATE_PLUS, new_nick, label);
-	if (is_superop)
-		chg_status_for_superop(STATE_PLUS, new_nick, label);
-	if (is_owner)
-		chg_status_for_owner(STATE_PLUS, new_nick, label);
 	return OK;
 }
 
@@ -691,6 +499,8 @@ event_nick(struct irc_message_compo *compo)
 
 		printtext_context_init(&ctx, nullptr, TYPE_SPEC1_SPEC2, true);
 
+		chanstate_batch_begin();
+
 		for (int i = 1; i <= g_ntotal_windows; i++) {
 			PIRC_WINDOW	window;
 
@@ -706,6 +516,8 @@ event_nick(struct irc_message_compo *compo)
 			}
 		}
 
+		chanstate_batch_end();
+
 		if (strings_match_ignore_case(nick, g_my_nickname))
 			irc_set_my_nickname(new_nick);
 	} catch (const std::runtime_error &e) {
@@ -899,13 +711,7 @@ handle_quit(PIRC_WINDOW window, PPRINTTEXT_CONTEXT ptext_ctx,
 			}
 		} else {
 			if (!split->join_begun()) {
-				const std::string str(ctx->nick);
-
-#if defined(__cplusplus) && __cplusplus >= 201103L
-				split->nicks.emplace_back(str);
-#else
-				split->nicks.push_back(str);
-#endif
+				split->add_nick(ctx->nick);
 			} else {
 				err_log(0, "%s: netjoin already begun (%s)",
 				    __func__, ns_ctx.chan);
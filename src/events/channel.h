@@ -1,12 +1,6 @@
 #ifndef CHANNEL_H
 #define CHANNEL_H
 
-typedef enum {
-	STATE_PLUS,
-	STATE_MINUS,
-	STATE_NEITHER_PM
-} plus_minus_state_t;
-
 __SWIRC_BEGIN_DECLS
 void	event_chan_hp(struct irc_message_compo *);
 void	event_join(struct irc_message_compo *);
@@ -0,0 +1,211 @@
+/* Channel modes and member privileges
+   Copyright (C) 2026 Markus Uhlin. All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   - Neither the name of the author nor the names of its contributors may be
+     used to endorse or promote products derived from this software without
+     specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+   BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE. */
+
+#include "common.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "../errHand.h"
+#include "../isupport.h"
+#include "../main.h"
+#include "../nicklist.h"
+#include "../strHand.h"
+
+#include "chanstate.h"
+#include "names.h"
+
+/*
+ * Nesting depth of chanstate_batch_begin() and the labels of the
+ * windows whose nicklists are to be refreshed at the end. Only touched
+ * by the thread that processes the events.
+ */
+static int				batch_depth = 0;
+static std::vector<std::string>		batch_labels;
+
+static bool
+takes_param(const char type, const bool set)
+{
+	switch (type) {
+	case 'A': /* list */
+	case 'B':
+	case 'P': /* member prefix */
+		return true;
+	case 'C':
+		return set;
+	}
+
+	return false;
+}
+
+/*
+ * Parses a MODE line, e.g. "+ov-v nick1 nick2 nick3", against the
+ * PREFIX and CHANMODES of the server. 'input' is tokenized in place
+ * and the parameters of the changes point into it. Returns the number
+ * of changes stored.
+ */
+size_t
+chanstate_parse(char *input, struct chanstate_change *changes, size_t max)
+{
+	char	*modes;
+	char	*state = const_cast<char *>("");
+	bool	 set = true;
+	size_t	 n = 0;
+
+	if (input == nullptr || changes == nullptr ||
+	    (modes = strtok_r(input, " ", &state)) == nullptr)
+		return 0;
+
+	for (const char *cp = modes; *cp != '\0' && n < max; cp++) {
+		struct chanstate_change *ch;
+
+		if (*cp == '+' || *cp == '-') {
+			set = (*cp == '+');
+			continue;
+		}
+
+		ch = &changes[n];
+		ch->mode = *cp;
+		ch->type = isupport_chanmode_type(*cp);
+		ch->set = set;
+		ch->param = nullptr;
+
+		if (takes_param(ch->type, set) &&
+		    (ch->param = strtok_r(nullptr, " ", &state)) == nullptr) {
+			err_log(0, "%s: mode '%c' lacks a parameter", __func__,
+			    *cp);
+			break;
+		}
+
+		n++;
+	}
+
+	return n;
+}
+
+/*
+ * Applies the changes of a MODE line to the members of a channel as a
+ * batch, with a single refresh of the nicklist. Returns true if the
+ * modes of the channel itself changed.
+ */
+bool
+chanstate_apply(PIRC_WINDOW window, const struct chanstate_change *changes,
+    size_t count)
+{
+	bool	chanmodes_changed = false;
+	int	members_changed = 0;
+
+	if (window == nullptr || changes == nullptr)
+		return false;
+
+	const bool have_names = (window->received_names || g_icb_mode);
+
+	mutex_lock(&g_win_htbl_mtx);
+
+	for (const struct chanstate_change *ch = &changes[0];
+	    ch < &changes[count]; ch++) {
+		PNAMES		names;
+		unsigned int	priv;
+
+		if (ch->type == 'A') {
+			continue;
+		} else if (ch->type != 'P') {
+			chanmodes_changed = true;
+			continue;
+		} else if ((priv = event_names_priv(isupport_prefix_symbol
+		    (ch->mode))) == 0) {
+			continue;
+		} else if (!have_names) {
+			/* the names may be being listed */
+			event_names_staging_set_priv(ch->param, window->label,
+			    priv, ch->set);
+			continue;
+		} else if ((names = event_names_htbl_find(window, ch->param)) ==
+		    nullptr) {
+			err_log(0, "%s: %c%c %s: not on %s", __func__,
+			    (ch->set ? '+' : '-'), ch->mode, ch->param,
+			    window->label);
+			continue;
+		}
+
+		event_names_set_privs(window, names, (ch->set ?
+		    names->privs | priv : names->privs & ~priv));
+		members_changed++;
+	}
+
+	mutex_unlock(&g_win_htbl_mtx);
+
+	if (members_changed > 0)
+		(void) chanstate_refresh(window);
+	return chanmodes_changed;
+}
+
+/*
+ * Holds back the nicklist refreshes until the matching call to
+ * chanstate_batch_end(), e.g. for the messages of a netjoin
+ */
+void
+chanstate_batch_begin(void)
+{
+	batch_depth++;
+}
+
+void
+chanstate_batch_end(void)
+{
+	if (batch_depth == 0 || --batch_depth > 0)
+		return;
+
+	for (const std::string &label : batch_labels) {
+		PIRC_WINDOW window;
+
+		if ((window = window_by_label(label.c_str())) != nullptr)
+			(void) nicklist_update(window);
+	}
+
+	batch_labels.clear();
+}
+
+/*
+ * Refreshes the nicklist of a window, or, within a batch, notes it for
+ * chanstate_batch_end()
+ */
+int
+chanstate_refresh(PIRC_WINDOW window)
+{
+	if (window == nullptr)
+		return -1;
+	if (batch_depth == 0)
+		return nicklist_update(window);
+	if (std::find(batch_labels.begin(), batch_labels.end(),
+	    window->label) == batch_labels.end())
+		batch_labels.emplace_back(window->label);
+	return 0;
+}
@@ -0,0 +1,29 @@
+#ifndef CHANSTATE_H
+#define CHANSTATE_H
+
+#include "../window.h"
+
+/*
+ * Most changes of a MODE line that are handled
+ */
+#define CHANSTATE_CHANGES_MAX 64
+
+struct chanstate_change {
+	char		 mode;
+	char		 type;	/* per isupport_chanmode_type() */
+	bool		 set;
+	const char	*param;	/* or NULL */
+};
+
+__SWIRC_BEGIN_DECLS
+size_t	chanstate_parse(char *input, struct chanstate_change *,
+	    size_t max);
+bool	chanstate_apply(PIRC_WINDOW, const struct chanstate_change *,
+	    size_t count);
+
+void	chanstate_batch_begin(void);
+void	chanstate_batch_end(void);
+int	chanstate_refresh(PIRC_WINDOW);
+__SWIRC_END_DECLS
+
+#endif
@@ -36,10 +36,12 @@
 #include "../dataClassify.h"
 #include "../errHand.h"
 #include "../irc.h"
+#include "../isupport.h"
 #include "../libUtils.h"
 #include "../network.h"
 #include "../printtext.h"
 #include "../readline.h"
+#include "../rejoin.h"
 #include "../statusbar.h"
 #include "../strHand.h"
 #include "../theme.h"
@@ -125,6 +127,28 @@ event_allaround_extract_remove_colon(struct irc_message_compo *compo)
 	free(msg_copy);
 }
 
+/*
+ * Hands the ISUPPORT tokens of a 005 message to those that use them
+ */
+static void
+feed_isupport(CSTRING msg)
+{
+	STRING			msg_copy = sw_strdup(msg);
+	auto			state	 = const_cast<STRING>("");
+	const enum casemapping	cm	 = isupport_casemapping();
+
+	for (CSTRING token = strtok_r(msg_copy, " ", &state);
+	    token != nullptr && *token != ':';
+	    token = strtok_r(nullptr, " ", &state)) {
+		isupport_feed(token);
+		rejoin_isupport(token);
+	}
+	free(msg_copy);
+
+	if (isupport_casemapping() != cm)
+		window_refold_labels();
+}
+
 /* event_serverFeatures: 005 (RPL_ISUPPORT)
 
    Lists features supported by the server.
@@ -155,6 +179,8 @@ event_serverFeatures(struct irc_message_compo *compo)
 			throw std::runtime_error("no message!");
 		if (*msg == ':')
 			msg++;
+		if (*msg)
+			feed_isupport(msg);
 		if (*msg) {
 			static const char *ar[] = {
 				":are available on this server",
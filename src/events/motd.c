@@ -2,12 +2,16 @@
 
 #include "../config.h"
 #include "../irc.h"
+#include "../rejoin.h"
+#include "../strHand.h"
 
 #include "motd.h"
 
 void
 event_motd(struct irc_message_compo *compo)
 {
+	if (strings_match(compo->command, "376"))
+		rejoin_motd_done();
 	if (config_bool("skip_motd", false))
 		return;
 	irc_extract_msg(compo, g_status_window, 1, false);
@@ -30,22 +30,34 @@
 #include "common.h"
 
 #include <stdexcept>
-
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef UNIT_TESTING
+#undef UNIT_TESTING
+#include "cmocka-c++.h"
+#define UNIT_TESTING 1
+#endif
 #include "../dataClassify.h"
 #include "../errHand.h"
 #include "../irc.h"
+#include "../isupport.h"
 #include "../libUtils.h"
 #include "../main.h"
 #include "../network.h"
 #include "../nicklist.h"
 #include "../printtext.h"
+#include "../rejoin.h"
 #include "../strHand.h"
 #include "../strdup_printf.h"
+#include "../strpool.h"
 #include "../theme.h"
 
+#include "chanstate.h"
 #include "names.h"
 
-#define hash(str) hash_djb_g(str, true, NAMES_HASH_TABLE_SIZE)
+#define BUCKET(hashval) ((hashval) % NAMES_HASH_TABLE_SIZE)
 
 /****************************************************************
 *                                                               *
@@ -54,65 +66,70 @@
 ****************************************************************/
 
 struct hInstall_context {
-	STRING	 channel;
-	STRING	 nick;
-
-	bool	 is_owner;
-	bool	 is_superop;
-	bool	 is_op;
-	bool	 is_halfop;
-	bool	 is_voice;
+	STRING		channel;
+	STRING		nick;
+	unsigned int	privs;
 
 	hInstall_context()
 	    : channel(nullptr)
 	    , nick(nullptr)
-	    , is_owner(false)
-	    , is_superop(false)
-	    , is_op(false)
-	    , is_halfop(false)
-	    , is_voice(false)
+	    , privs(0)
 	{
 		/* null */;
 	}
 
-	hInstall_context(STRING p_channel, STRING p_nick, const char c)
+	hInstall_context(STRING p_channel, STRING p_nick,
+	    const unsigned int p_privs)
 	    : channel(p_channel)
 	    , nick(p_nick)
-	    , is_owner(c == '~')
-	    , is_superop(c == '&')
-	    , is_op(c == '@')
-	    , is_halfop(c == '%')
-	    , is_voice(c == '+')
+	    , privs(p_privs)
 	{
 		/* null */;
 	}
+};
 
-	hInstall_context(STRING p_channel, STRING p_nick, CSTRING privs)
-	    : channel(p_channel)
-	    , nick(p_nick)
-	    , is_owner(false)
-	    , is_superop(false)
-	    , is_op(false)
-	    , is_halfop(false)
-	    , is_voice(false)
+/*
+ * A name of a NAMES reply that is held until the end of the list
+ */
+struct staged_name {
+	std::string	nick;
+	unsigned int	privs;
+
+	staged_name(CSTRING p_nick, size_t len, const unsigned int p_privs)
+	    : nick(p_nick, len)
+	    , privs(p_privs)
 	{
-		for (const char *cp = privs; *cp != '\0'; cp++) {
-			if (*cp == '~')
-				this->is_owner = true;
-			else if (*cp == '&')
-				this->is_superop = true;
-			else if (*cp == '@')
-				this->is_op = true;
-			else if (*cp == '%')
-				this->is_halfop = true;
-			else if (*cp == '+')
-				this->is_voice = true;
-			else {
-				err_log(0, "%s: invalid privilege '%c' "
-				    "(privs: %s)", __func__, *cp, privs);
-			}
-		}
+		/* null */;
+	}
+};
+
+/*
+ * Non-strict checking.
+ * But we cannot allow:
+ *     ~&@%+
+ */
+class name_chars_table {
+public:
+	constexpr name_chars_table()
+	    : ok()
+	{
+		constexpr char chars[] =
+		    "!#$'()*,-./0123456789:;<=>?"
+		    "ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`"
+		    "abcdefghijklmnopqrstuvwxyz{|}";
+
+		for (const char *cp = &chars[0]; *cp != '\0'; cp++)
+			this->ok[static_cast<unsigned char>(*cp)] = true;
+	}
+
+	constexpr bool
+	operator[](const char c) const
+	{
+		return this->ok[static_cast<unsigned char>(c)];
 	}
+
+private:
+	bool ok[256];
 };
 
 /****************************************************************
@@ -122,6 +139,18 @@ struct hInstall_context {
 ****************************************************************/
 
 static char names_channel[1000] = { '\0' };
+static constexpr name_chars_table name_chars;
+
+/*
+ * Names of the channel in 'names_channel', installed all at once by
+ * event_eof_names()
+ */
+static std::vector<staged_name> names_staging;
+
+/*
+ * Positions in 'names_staging', keyed by the folded nicknames
+ */
+static std::unordered_map<std::string, size_t> names_staged_pos;
 
 /****************************************************************
 *                                                               *
@@ -129,34 +158,65 @@ static char names_channel[1000] = { '\0' };
 *                                                               *
 ****************************************************************/
 
-static inline bool
-already_is_in_names_hash(CSTRING nick, PIRC_WINDOW window)
+/*
+ * Returns the counter of the highest of the given privileges
+ */
+static int *
+counter(PIRC_WINDOW window, const unsigned int privs)
+{
+	static int IRC_WINDOW::* const counters[] = {
+		&IRC_WINDOW::num_normal,
+		&IRC_WINDOW::num_voices,
+		&IRC_WINDOW::num_halfops,
+		&IRC_WINDOW::num_ops,
+		&IRC_WINDOW::num_superops,
+		&IRC_WINDOW::num_owners,
+	};
+
+	return &(window->*counters[event_names_rank(privs)]);
+}
+
+/*
+ * Returns the prefix of the highest of the given privileges
+ */
+static char
+prefix(const unsigned int privs)
+{
+	static const char prefixes[] = " +%@&~";
+
+	return prefixes[event_names_rank(privs)];
+}
+
+/*
+ * Folds a nickname into 'key' and returns the hash of it
+ */
+static inline unsigned int
+names_key(CSTRING nick, char *key, size_t size)
+{
+	return isupport_key_hash(isupport_fold(nick, key, size), UINT_MAX);
+}
+
+static PNAMES
+find_by_key(PIRC_WINDOW window, CSTRING key, const unsigned int hashval)
 {
-	for (PNAMES names = window->names_hash[hash(nick)];
+	const size_t len = strlen(key);
+
+	for (PNAMES names = window->names_hash[BUCKET(hashval)];
 	    names != nullptr;
 	    names = names->next) {
-		if (strings_match_ignore_case(nick, names->nick))
-			return true;
+		if (names->hash == hashval && names->len == len &&
+		    memcmp(NAMES_KEY(names), key, len) == 0)
+			return names;
 	}
 
-	return false;
+	return nullptr;
 }
 
-/*
- * Non-strict checking.
- * But we cannot allow:
- *     ~&@%+
- */
 static inline bool
 name_chars_ok(CSTRING name)
 {
-	static chararray_t chars =
-	    "!#$'()*,-./0123456789:;<=>?"
-	    "ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`"
-	    "abcdefghijklmnopqrstuvwxyz{|}";
-
 	for (const char *cp = name; *cp != '\0'; cp++) {
-		if (strchr(chars, *cp) == nullptr)
+		if (!name_chars[*cp])
 			return false;
 	}
 
@@ -166,25 +226,17 @@ name_chars_ok(CSTRING name)
 static inline bool
 name_len_ok(CSTRING name)
 {
-	static const size_t maxlen = 45;
-
-	return (xstrnlen(name, maxlen + 1) <= maxlen);
+	return (xstrnlen(name, NAMES_NICK_MAX + 1) <= NAMES_NICK_MAX);
 }
 
 static int
-hInstall(const struct hInstall_context *ctx)
+hInstall_window(PIRC_WINDOW window, const struct hInstall_context *ctx)
 {
-	PIRC_WINDOW	window;
 	PNAMES		names;
+	char		key[ISUPPORT_KEY_MAX];
 	unsigned int	hashval;
 
-	if (ctx == nullptr || ctx->channel == nullptr) {
-		return ERR;
-	} else if ((window = window_by_label(ctx->channel)) == nullptr) {
-		debug("%s: %s: cannot find window labelled \"%s\"", __FILE__,
-		    __func__, ctx->channel);
-		return ERR;
-	} else if (ctx->nick == nullptr || strings_match(ctx->nick, "")) {
+	if (ctx->nick == nullptr || strings_match(ctx->nick, "")) {
 		debug("%s: %s: no nickname (channel=%s)", __FILE__, __func__,
 		    ctx->channel);
 		return ERR;
@@ -194,73 +246,149 @@ hInstall(const struct hInstall_context *ctx)
 	} else if (!name_chars_ok(ctx->nick)) {
 		debug("%s: %s: name is invalid", __FILE__, __func__);
 		return ERR;
-	} else if (already_is_in_names_hash(ctx->nick, window)) {
+	} else if (find_by_key(window, key,
+	    (hashval = names_key(ctx->nick, key, sizeof key))) != nullptr) {
 		debug("%s: %s: busy nickname: \"%s\" (channel=%s)", __FILE__,
 		    __func__, ctx->nick, ctx->channel);
 		return ERR;
 	}
 
-	names = static_cast<PNAMES>(xcalloc(sizeof *names, 1));
-	names->nick		= sw_strdup(ctx->nick);
+	const size_t len = strlen(ctx->nick);
+
+	names = static_cast<PNAMES>(xcalloc(sizeof *names + 2 * (len + 1),
+	    1));
 	names->account		= nullptr;
 	names->rl_name		= nullptr;
-	names->is_owner		= ctx->is_owner;
-	names->is_superop	= ctx->is_superop;
-	names->is_op		= ctx->is_op;
-	names->is_halfop	= ctx->is_halfop;
-	names->is_voice		= ctx->is_voice;
-
-	hashval = hash(ctx->nick);
-	names->next = window->names_hash[hashval];
-	window->names_hash[hashval] = names;
-
-	if (ctx->is_owner)
-		window->num_owners++;
-	else if (ctx->is_superop)
-		window->num_superops++;
-	else if (ctx->is_op)
-		window->num_ops++;
-	else if (ctx->is_halfop)
-		window->num_halfops++;
-	else if (ctx->is_voice)
-		window->num_voices++;
-	else
-		window->num_normal++;
+	names->hash		= hashval;
+	names->privs		= static_cast<unsigned char>(ctx->privs);
+	names->prefix		= prefix(ctx->privs);
+	names->len		= static_cast<unsigned char>(len);
+	memcpy(names->nick, ctx->nick, len + 1);
+	memcpy(NAMES_KEY(names), key, len + 1);
+
+	names->next = window->names_hash[BUCKET(hashval)];
+	window->names_hash[BUCKET(hashval)] = names;
+	(void) prefixTrie_insert(window->names_trie, ctx->nick);
+
+	(*counter(window, names->privs))++;
 	window->num_total++;
 	return OK;
 }
 
+static int
+hInstall(const struct hInstall_context *ctx)
+{
+	PIRC_WINDOW window;
+
+	if (ctx == nullptr || ctx->channel == nullptr) {
+		return ERR;
+	} else if ((window = window_by_label(ctx->channel)) == nullptr) {
+		debug("%s: %s: cannot find window labelled \"%s\"", __FILE__,
+		    __func__, ctx->channel);
+		return ERR;
+	}
+
+	return hInstall_window(window, ctx);
+}
+
+static void
+names_staging_clear(void)
+{
+	BZERO(names_channel, sizeof names_channel);
+	names_staging.clear();
+	names_staging.shrink_to_fit();
+	names_staged_pos.clear();
+}
+
+/*
+ * Stages a name, unless it's already staged
+ */
+static void
+stage_name(CSTRING nick, size_t len, const unsigned int privs)
+{
+	char key[ISUPPORT_KEY_MAX];
+
+	if (!names_staged_pos.emplace(isupport_fold(nick, key, sizeof key),
+	    names_staging.size()).second)
+		return;
+#if defined(__cplusplus) && __cplusplus >= 201103L
+	names_staging.emplace_back(nick, len, privs);
+#else
+	names_staging.push_back(staged_name(nick, len, privs));
+#endif
+}
+
+/*
+ * Finds the position of a staged name, provided that the names of the
+ * given channel are being listed
+ */
+static std::unordered_map<std::string, size_t>::iterator
+find_staged(CSTRING nick, CSTRING channel)
+{
+	char key[ISUPPORT_KEY_MAX];
+
+	if (nick == nullptr || names_staged_pos.empty() ||
+	    !isupport_match(channel, names_channel))
+		return names_staged_pos.end();
+	return names_staged_pos.find(isupport_fold(nick, key, sizeof key));
+}
+
+/*
+ * Forgets a staged name that left while the names were listed
+ */
+static void
+unstage_name(CSTRING nick, CSTRING channel)
+{
+	const auto staged = find_staged(nick, channel);
+
+	if (staged == names_staged_pos.end())
+		return;
+	names_staging[staged->second].nick.clear();
+	(void) names_staged_pos.erase(staged);
+}
+
+/*
+ * Installs the staged names with a single lookup of the window and a
+ * single lock
+ */
+static void
+install_staged_names(PIRC_WINDOW window)
+{
+	mutex_lock(&g_win_htbl_mtx);
+
+	for (const staged_name &name : names_staging) {
+		if (name.nick.empty())
+			continue; /* left while the names were listed */
+
+		struct hInstall_context ctx(window->label,
+		    const_cast<STRING>(name.nick.c_str()), name.privs);
+
+		(void) hInstall_window(window, &ctx);
+	}
+
+	mutex_unlock(&g_win_htbl_mtx);
+	names_staging_clear();
+}
+
 static void
 hUndef(PIRC_WINDOW window, PNAMES entry)
 {
 	PNAMES *indirect;
 
-	if (window == nullptr || entry == nullptr || entry->nick == nullptr ||
-	    strings_match(entry->nick, ""))
+	if (window == nullptr || entry == nullptr)
 		return;
 
-	indirect = addrof(window->names_hash[hash(entry->nick)]);
+	indirect = addrof(window->names_hash[BUCKET(entry->hash)]);
 
 	while (*indirect != entry)
 		indirect = addrof((*indirect)->next);
 
 	*indirect = entry->next;
-	free(entry->nick);
-	free(entry->account);
-	free(entry->rl_name);
-
-	if (entry->is_owner)
-		window->num_owners--;
-	else if (entry->is_superop)
-		window->num_superops--;
-	else if (entry->is_op)
-		window->num_ops--;
-	else if (entry->is_halfop)
-		window->num_halfops--;
-	else if (entry->is_voice)
-		window->num_voices--;
-	else
-		window->num_normal--;
+	(void) prefixTrie_remove(window->names_trie, entry->nick);
+	strpool_release(entry->account);
+	strpool_release(entry->rl_name);
+
+	(*counter(window, entry->privs))--;
 
 	window->num_total--;
 	free(entry);
@@ -357,34 +485,22 @@ cmd_stats(CSTRING data)
 	}
 }
 
+/**
+ * Get a list of the users in a channel whose nicknames start with the
+ * given search variable. Users that recently spoke are listed first.
+ */
 PTEXTBUF
 get_list_of_matching_channel_users(CSTRING chan, CSTRING search_var)
 {
 	PIRC_WINDOW	window;
 	PTEXTBUF	matches;
-	size_t		varlen;
 
+	mutex_lock(&g_win_htbl_mtx);
 	if ((window = window_by_label(chan)) == nullptr)
-		return nullptr;
-
-	matches = textBuf_new();
-	varlen = strlen(search_var);
-
-	for (size_t n = 0; n < ARRAY_SIZE(window->names_hash); n++) {
-		for (PNAMES names = window->names_hash[n];
-		    names != nullptr;
-		    names = names->next) {
-			if (!strncmp(search_var, names->nick, varlen)) {
-				textBuf_emplace_back(__func__, matches,
-				    names->nick, 0);
-			}
-		}
-	}
-
-	if (textBuf_size(matches) == 0) {
-		textBuf_destroy(matches);
-		return nullptr;
-	}
+		matches = nullptr;
+	else
+		matches = prefixTrie_matches(window->names_trie, search_var);
+	mutex_unlock(&g_win_htbl_mtx);
 
 	return matches;
 }
@@ -395,7 +511,7 @@ get_list_of_matching_channel_users(CSTRING chan, CSTRING search_var)
 void
 event_names_init(void)
 {
-	BZERO(names_channel, sizeof names_channel);
+	names_staging_clear();
 }
 
 /**
@@ -404,27 +520,85 @@ event_names_init(void)
 void
 event_names_deinit(void)
 {
+	names_staging_clear();
 	window_foreach_destroy_names();
 }
 
+/**
+ * Find a nickname in the names of a window. The nickname is folded
+ * once and then compared with the keys of its bucket.
+ */
 PNAMES
-event_names_htbl_lookup(CSTRING nick, CSTRING channel)
+event_names_htbl_find(PIRC_WINDOW window, CSTRING nick)
 {
-	PIRC_WINDOW	window;
-	PNAMES		names;
+	char		key[ISUPPORT_KEY_MAX];
+	unsigned int	hashval;
 
-	if (nick == nullptr || strings_match(nick, "") ||
-	    (window = window_by_label(channel)) == nullptr)
+	if (window == nullptr || nick == nullptr || strings_match(nick, ""))
 		return nullptr;
+	hashval = names_key(nick, key, sizeof key);
+	return find_by_key(window, key, hashval);
+}
 
-	for (names = window->names_hash[hash(nick)];
-	    names != nullptr;
-	    names = names->next) {
-		if (strings_match_ignore_case(nick, names->nick))
-			return names;
+/**
+ * Return the privilege of a nickname prefix, e.g. NAMES_PRIV_OP for
+ * '@', or zero if it isn't one
+ */
+unsigned int
+event_names_priv(const char symbol)
+{
+	switch (symbol) {
+	case '~':
+		return NAMES_PRIV_OWNER;
+	case '&':
+		return NAMES_PRIV_SUPEROP;
+	case '@':
+		return NAMES_PRIV_OP;
+	case '%':
+		return NAMES_PRIV_HALFOP;
+	case '+':
+		return NAMES_PRIV_VOICE;
 	}
 
-	return nullptr;
+	return 0;
+}
+
+/**
+ * Set the privileges of a name and keep the counters of the window
+ * in step. Called with 'g_win_htbl_mtx' locked.
+ */
+void
+event_names_set_privs(PIRC_WINDOW window, PNAMES names,
+    const unsigned int privs)
+{
+	if (names->privs == privs)
+		return;
+	(*counter(window, names->privs))--;
+	names->privs = static_cast<unsigned char>(privs);
+	names->prefix = prefix(privs);
+	(*counter(window, names->privs))++;
+}
+
+/**
+ * Set the account and real name of a name. They're interned, i.e. one
+ * copy is shared by the members of all channels. Called with
+ * 'g_win_htbl_mtx' locked.
+ */
+void
+event_names_set_info(PNAMES names, CSTRING account, CSTRING rl_name)
+{
+	CSTRING prev[2] = { names->account, names->rl_name };
+
+	names->account = strpool_intern(account);
+	names->rl_name = strpool_intern(rl_name);
+	strpool_release(prev[0]);
+	strpool_release(prev[1]);
+}
+
+PNAMES
+event_names_htbl_lookup(CSTRING nick, CSTRING channel)
+{
+	return event_names_htbl_find(window_by_label(channel), nick);
 }
 
 int
@@ -446,11 +620,29 @@ event_names_htbl_insert(CSTRING nick, CSTRING channel)
 
 	if (ret == ERR)
 		return ERR;
-	if (nicklist_update(window_by_label(channel)) != 0)
-		debug("event_names_htbl_insert: nicklist_update: error");
+	if (chanstate_refresh(window_by_label(channel)) != 0)
+		debug("event_names_htbl_insert: chanstate_refresh: error");
 	return OK;
 }
 
+/**
+ * Mark a nickname as the most recently active one in the given
+ * channel (tab completion order)
+ */
+void
+event_names_htbl_touch(CSTRING nick, CSTRING channel)
+{
+	PIRC_WINDOW window;
+
+	if (nick == nullptr || strings_match(nick, ""))
+		return;
+
+	mutex_lock(&g_win_htbl_mtx);
+	if ((window = window_by_label(channel)) != nullptr)
+		(void) prefixTrie_touch(window->names_trie, nick);
+	mutex_unlock(&g_win_htbl_mtx);
+}
+
 int
 event_names_htbl_remove(CSTRING nick, CSTRING channel)
 {
@@ -461,24 +653,64 @@ event_names_htbl_remove(CSTRING nick, CSTRING channel)
 	    (window = window_by_label(channel)) == nullptr)
 		return ERR;
 
-	for (names = window->names_hash[hash(nick)];
-	    names != nullptr;
-	    names = names->next) {
-		if (strings_match_ignore_case(nick, names->nick)) {
-			mutex_lock(&g_win_htbl_mtx);
-			hUndef(window, names);
-			mutex_unlock(&g_win_htbl_mtx);
-
-			if (nicklist_update(window) != 0) {
-				debug("event_names_htbl_remove: "
-				    "nicklist_update: error");
-			}
+	unstage_name(nick, channel);
 
-			return OK;
-		}
-	}
+	if ((names = event_names_htbl_find(window, nick)) == nullptr)
+		return ERR;
+
+	mutex_lock(&g_win_htbl_mtx);
+	hUndef(window, names);
+	mutex_unlock(&g_win_htbl_mtx);
+
+	if (chanstate_refresh(window) != 0)
+		debug("event_names_htbl_remove: chanstate_refresh: error");
+	return OK;
+}
+
+/**
+ * Rename a nickname that changed its nick while the names of the
+ * channel were listed
+ */
+void
+event_names_staging_rename(CSTRING old_nick, CSTRING new_nick,
+    CSTRING channel)
+{
+	char key[ISUPPORT_KEY_MAX];
 
-	return ERR;
+	if (new_nick == nullptr || strings_match(new_nick, ""))
+		return;
+
+	const auto staged = find_staged(old_nick, channel);
+
+	if (staged == names_staged_pos.end())
+		return;
+
+	const size_t pos = staged->second;
+
+	(void) names_staged_pos.erase(staged);
+	if (names_staged_pos.emplace(isupport_fold(new_nick, key, sizeof key),
+	    pos).second)
+		names_staging[pos].nick.assign(new_nick);
+	else
+		names_staging[pos].nick.clear();
+}
+
+/**
+ * Give or take a privilege from a nickname whose mode changed while
+ * the names of the channel were listed
+ */
+void
+event_names_staging_set_priv(CSTRING nick, CSTRING channel,
+    const unsigned int priv, bool set)
+{
+	const auto staged = find_staged(nick, channel);
+
+	if (staged == names_staged_pos.end())
+		return;
+	if (set)
+		names_staging[staged->second].privs |= priv;
+	else
+		names_staging[staged->second].privs &= ~priv;
 }
 
 /* event_eof_names: 366
@@ -510,7 +742,7 @@ event_eof_names(struct irc_message_compo *compo)
 			throw std::runtime_error("invalid channel");
 		} else if (eof_msg == nullptr) {
 			throw std::runtime_error("null message");
-		} else if (!strings_match_ignore_case(channel, names_channel)) {
+		} else if (!isupport_match(channel, names_channel)) {
 			throw std::runtime_error("unable to parse names of two "
 			    "(or more) channels simultaneously");
 		} else {
@@ -518,14 +750,18 @@ event_eof_names(struct irc_message_compo *compo)
 		}
 
 		if ((win = window_by_label(channel)) == nullptr) {
+			names_staging_clear();
 			throw std::runtime_error("window lookup error");
 		} else if (win->received_names) {
 			err_log(0, "warning: server sent event 366 "
 			    "(RPL_ENDOFNAMES): already received names for "
 			    "channel %s", channel);
+			names_staging_clear();
 			return;
 		} else {
+			install_staged_names(win);
 			win->received_names = true;
+			rejoin_joined(channel);
 		}
 
 		if (nicklist_new(win) != 0)
@@ -599,7 +835,7 @@ event_names(struct irc_message_compo *compo)
 		    != 0) {
 			throw std::runtime_error("unable to "
 			    "store names channel");
-		} else if (!strings_match_ignore_case(names_channel, channel)) {
+		} else if (!isupport_match(names_channel, channel)) {
 			throw std::runtime_error("unable to parse names of two "
 			    "(or more) channels simultaneously");
 		} else if ((win = window_by_label(channel)) == nullptr) {
@@ -615,34 +851,27 @@ event_names(struct irc_message_compo *compo)
 		}
 
 		for (char *cp = &names_copy[0];; cp = nullptr) {
-			STRING	token, nick;
-			char	privs[6] = { '\0' };
-			size_t	ret;
+			STRING		token, nick;
+			unsigned int	privs = 0;
 
 			if ((token = strtok_r(cp, " ", &state[1])) == nullptr)
 				break;
 
-			ret = strspn(token, "~&@%+");
+			for (nick = token; event_names_priv(*nick) != 0; nick++)
+				privs |= event_names_priv(*nick);
 
-			if (ret >= sizeof privs) {
-				debug("%s: privileges too long", __func__);
-				continue;
-			} else if (ret > 0) {
-				memcpy(privs, token, ret);
-				privs[ret] = '\0';
-				nick = &token[ret];
-			} else
-				nick = &token[0];
-
-			struct hInstall_context ctx(channel, nick, (ret > 0
-			    ? privs : ""));
+			const size_t len = strlen(nick);
 
-			mutex_lock(&g_win_htbl_mtx);
-			const int iret = hInstall(&ctx);
-			mutex_unlock(&g_win_htbl_mtx);
-
-			if (iret != OK)
+			if (len == 0 || !name_len_ok(nick)) {
+				debug("%s: bad name length (channel=%s)",
+				    __func__, channel);
+				continue;
+			} else if (!name_chars_ok(nick)) {
+				debug("%s: name is invalid", __func__);
 				continue;
+			}
+
+			stage_name(nick, len, privs);
 		}
 	} catch (const std::runtime_error &e) {
 		PRINTTEXT_CONTEXT ptext_ctx;
@@ -690,4 +919,164 @@ event_names_htbl_remove_all(PIRC_WINDOW window)
 	window->received_names = false;
 	reset_counters(window);
 }
+
+#ifdef UNIT_TESTING
+static PIRC_WINDOW
+new_test_window(CSTRING label)
+{
+	auto window = static_cast<PIRC_WINDOW>(xcalloc(sizeof(IRC_WINDOW),
+	    1));
+
+	window->label = sw_strdup(label);
+	window->names_trie = prefixTrie_new();
+	return window;
+}
+
+static void
+free_test_window(PIRC_WINDOW window)
+{
+	event_names_htbl_remove_all(window);
+	prefixTrie_destroy(window->names_trie);
+	free(window->label);
+	free(window);
+}
+
+void
+event_names_staging_test1(void **state)
+{
+	PIRC_WINDOW	window;
+	PNAMES		names;
+
+	isupport_reset();
+	isupport_feed("CASEMAPPING=rfc1459");
+	mutex_new(&g_win_htbl_mtx);
+	window = new_test_window("#chan");
+
+	names_staging_clear();
+	(void) sw_strcpy(names_channel, "#Chan", sizeof names_channel);
+	stage_name("alice", 5, NAMES_PRIV_OP);
+	stage_name("bob", 3, 0);
+	stage_name("dave", 4, NAMES_PRIV_VOICE);
+	stage_name("erin[m]", 7, 0);
+	stage_name("ALICE", 5, 0); /* already staged */
+
+	/* changes during the list */
+	event_names_staging_rename("bob", "carol", "#CHAN");
+	event_names_staging_rename("alice", "mallory", "#other");
+	event_names_staging_set_priv("carol", "#chan", NAMES_PRIV_VOICE,
+	    true);
+	event_names_staging_set_priv("Alice", "#chan", NAMES_PRIV_OP, false);
+	event_names_staging_set_priv("alice", "#chan", NAMES_PRIV_HALFOP,
+	    true);
+	unstage_name("DAVE", "#chan");
+	unstage_name("ERIN{M}", "#chan");
+
+	install_staged_names(window);
+	assert_true(names_staging.empty());
+	assert_true(names_staged_pos.empty());
+
+	assert_non_null((names = event_names_htbl_find(window, "ALICE")));
+	assert_string_equal(names->nick, "alice");
+	assert_int_equal(names->privs, NAMES_PRIV_HALFOP);
+	assert_non_null((names = event_names_htbl_find(window, "carol")));
+	assert_int_equal(names->prefix, '+');
+	assert_null(event_names_htbl_find(window, "bob"));
+	assert_null(event_names_htbl_find(window, "dave"));
+	assert_null(event_names_htbl_find(window, "erin[m]"));
+	assert_null(event_names_htbl_find(window, "mallory"));
+	assert_int_equal(window->num_total, 2);
+	assert_int_equal(window->num_halfops, 1);
+	assert_int_equal(window->num_voices, 1);
+
+	free_test_window(window);
+	mutex_destroy(&g_win_htbl_mtx);
+	isupport_reset();
+	UNUSED_PARAM(state);
+}
+
+void
+event_names_record_test1(void **state)
+{
+	PIRC_WINDOW	window;
+	PNAMES		names, other;
+	char		longnick[NAMES_NICK_MAX + 2] = { '\0' };
+
+	isupport_reset();
+	isupport_feed("CASEMAPPING=rfc1459");
+	mutex_new(&g_win_htbl_mtx);
+	window = new_test_window("#chan");
+
+	struct hInstall_context ctx1(window->label,
+	    const_cast<STRING>("Nick[a]"), NAMES_PRIV_OP | NAMES_PRIV_VOICE);
+	struct hInstall_context ctx2(window->label,
+	    const_cast<STRING>("NICK{A}"), 0);
+	struct hInstall_context ctx3(window->label,
+	    const_cast<STRING>("bad~nick"), 0);
+	struct hInstall_context ctx4(window->label, &longnick[0], 0);
+	struct hInstall_context ctx5(window->label,
+	    const_cast<STRING>("other"), NAMES_PRIV_OWNER);
+
+	/* nick and folded key inline, prefix of the highest privilege */
+	assert_int_equal(hInstall_window(window, &ctx1), OK);
+	assert_non_null((names = event_names_htbl_find(window, "nick{a}")));
+	assert_string_equal(names->nick, "Nick[a]");
+	assert_string_equal(NAMES_KEY(names), "nick{a}");
+	assert_int_equal(names->len, 7);
+	assert_int_equal(names->prefix, '@');
+	assert_int_equal(window->num_ops, 1);
+
+	assert_int_equal(hInstall_window(window, &ctx2), ERR);
+	assert_int_equal(hInstall_window(window, &ctx3), ERR);
+	memset(longnick, 'x', NAMES_NICK_MAX + 1);
+	assert_int_equal(hInstall_window(window, &ctx4), ERR);
+	assert_int_equal(window->num_total, 1);
+
+	/* the counters follow the privileges */
+	event_names_set_privs(window, names, NAMES_PRIV_VOICE);
+	assert_int_equal(names->prefix, '+');
+	assert_int_equal(window->num_ops, 0);
+	assert_int_equal(window->num_voices, 1);
+
+	/* the account and real name are shared */
+	assert_int_equal(hInstall_window(window, &ctx5), OK);
+	assert_non_null((other = event_names_htbl_find(window, "OTHER")));
+	assert_int_equal(other->prefix, '~');
+	assert_int_equal(window->num_owners, 1);
+	event_names_set_info(names, "acct", "Real Name");
+	event_names_set_info(other, "acct", "Real Name");
+	assert_string_equal(names->account, "acct");
+	assert_ptr_equal(names->account, other->account);
+	assert_ptr_equal(names->rl_name, other->rl_name);
+
+	free_test_window(window);
+	mutex_destroy(&g_win_htbl_mtx);
+	isupport_reset();
+	UNUSED_PARAM(state);
+}
+
+void
+event_names_rank_test1(void **state)
+{
+	assert_int_equal(event_names_rank(0), 0);
+	assert_int_equal(event_names_rank(NAMES_PRIV_VOICE), 1);
+	assert_int_equal(event_names_rank(NAMES_PRIV_HALFOP |
+	    NAMES_PRIV_VOICE), 2);
+	assert_int_equal(event_names_rank(NAMES_PRIV_OP), 3);
+	assert_int_equal(event_names_rank(NAMES_PRIV_SUPEROP |
+	    NAMES_PRIV_HALFOP), 4);
+	assert_int_equal(event_names_rank(NAMES_PRIV_OWNER |
+	    NAMES_PRIV_OP), 5);
+
+	static const char symbols[] = "+%@&~";
+
+	for (int i = 0; symbols[i] != '\0'; i++) {
+		assert_int_equal(event_names_rank(event_names_priv(symbols[i])),
+		    i + 1);
+		assert_int_equal(prefix(event_names_priv(symbols[i])),
+		    symbols[i]);
+	}
+	assert_int_equal(event_names_priv('x'), 0);
+	UNUSED_PARAM(state);
+}
+#endif // UNIT_TESTING
 /* EOF */
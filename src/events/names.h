@@ -2,7 +2,24 @@
 #define NAMES_H
 
 #include "../textBuffer.h"
-#include "names-htbl-modify.h"
+#include "../window.h"
+
+/*
+ * Rank of the highest of the given privileges, from zero (none) to
+ * five (owner)
+ */
+static SW_INLINE int
+event_names_rank(unsigned int privs)
+{
+	int rank = 0;
+
+	while (privs != 0) {
+		rank++;
+		privs >>= 1;
+	}
+
+	return rank;
+}
 
 __SWIRC_BEGIN_DECLS
 
@@ -15,11 +32,30 @@ PTEXTBUF	get_list_of_matching_channel_users(CSTRING chan,
 void	event_names_init(void);
 void	event_names_deinit(void);
 
+#ifdef UNIT_TESTING
+void	event_names_rank_test1(void **);
+void	event_names_record_test1(void **);
+void	event_names_staging_test1(void **);
+#endif
+
+unsigned int	event_names_priv(const char symbol);
+void		event_names_set_privs(PIRC_WINDOW, PNAMES,
+		    const unsigned int privs);
+void		event_names_set_info(PNAMES, CSTRING account,
+		    CSTRING rl_name);
+
+/*lint -sem(event_names_htbl_find, r_null) */
 /*lint -sem(event_names_htbl_lookup, r_null) */
 
+PNAMES	event_names_htbl_find(PIRC_WINDOW, CSTRING nick);
 PNAMES	event_names_htbl_lookup(CSTRING nick, CSTRING channel);
 int	event_names_htbl_insert(CSTRING nick, CSTRING channel);
 int	event_names_htbl_remove(CSTRING nick, CSTRING channel);
+void	event_names_htbl_touch(CSTRING nick, CSTRING channel);
+void	event_names_staging_rename(CSTRING old_nick, CSTRING new_nick,
+	    CSTRING channel);
+void	event_names_staging_set_priv(CSTRING nick, CSTRING channel,
+	    const unsigned int priv, bool set);
 void	event_eof_names(struct irc_message_compo *);
 void	event_names(struct irc_message_compo *);
 void	event_names_htbl_remove_all(PIRC_WINDOW);
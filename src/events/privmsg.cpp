@@ -397,18 +397,9 @@ handle_chan_msgs(PPRINTTEXT_CONTEXT ctx, CSTRING nick, CSTRING dest,
 	if ((ctx->window = window_by_label(dest)) == nullptr) {
 		throw std::runtime_error("bogus window label");
 	} else if ((n = event_names_htbl_lookup(nick, dest)) != nullptr) {
-		if (n->is_owner)
-			c = '~';
-		else if (n->is_superop)
-			c = '&';
-		else if (n->is_op)
-			c = '@';
-		else if (n->is_halfop)
-			c = '%';
-		else if (n->is_voice)
-			c = '+';
-		else
-			c = ' ';
+		c = n->prefix;
+
+		event_names_htbl_touch(nick, dest);
 	}
 
 	if (shouldHighlightMessage_case1(msg) ||
@@ -94,6 +94,7 @@ event_welcome(struct irc_message_compo *compo)
 		CSTRING		nick = nullptr;
 		CSTRING		srv_host = nullptr;
 		auto		state = const_cast<STRING>("");
+		long int	reg_time;
 
 		if (config_bool("identd", false))
 			identd::stop();
@@ -128,6 +129,11 @@ event_welcome(struct irc_message_compo *compo)
 		printtext_context_init(&ctx, g_status_window, TYPE_SPEC1, true);
 		printtext(&ctx, "%s", msg);
 
+		if ((reg_time = net_take_reg_time()) >= 0) {
+			printtext(&ctx, "Registered in %ld ms (TCP connect to "
+			    "welcome)", reg_time);
+		}
+
 		event_welcome_signalit();
 		g_received_welcome = true;
 
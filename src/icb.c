@@ -393,7 +393,7 @@ deal_with_category_timeout(const char *data)
 	    idle_mod.group)) == NULL) {
 		err_reason = "no such mod";
 		goto err;
-	} else if (!names->is_op) {
+	} else if (!(names->privs & NAMES_PRIV_OP)) {
 		err_reason = "mod not mod";
 		goto err;
 	} else if (event_names_htbl_lookup(new_mod, idle_mod.group) == NULL) {
@@ -29,6 +29,7 @@
 
 #include "common.h"
 
+#include <fcntl.h>
 #include <pthread.h>
 
 #include "assertAPI.h"
@@ -47,37 +48,29 @@ accept_thread(void *arg)
 	return nullptr;
 }
 
-static void *
-com_thread(void *arg)
+NORETURN void
+identd::exit_thread(void)
 {
-	auto cli = static_cast<ident_client *>(arg);
-
-	identd::enter_loop(cli);
-	delete cli;
-	identd::exit_thread();
+	int dummy = 0;
 
-	/* NOTREACHED */
-	return nullptr;
+	pthread_exit(&dummy);
+	sw_assert_not_reached();
 }
 
-void
-identd::com_with_client(ident_client *cli)
+bool
+identd::set_nonblocking(SOCKET p_sock)
 {
-	pthread_t tid;
+	int flags;
 
-	if ((errno = pthread_create(&tid, nullptr, com_thread, cli)) != 0)
-		err_sys("%s: pthread_create", __func__);
-	else if ((errno = pthread_detach(tid)) != 0)
-		err_sys("%s: pthread_detach", __func__);
-}
+	errno = 0;
 
-NORETURN void
-identd::exit_thread(void)
-{
-	int dummy = 0;
+	if ((flags = fcntl(p_sock, F_GETFL)) == -1 ||
+	    fcntl(p_sock, F_SETFL, flags | O_NONBLOCK) == -1) {
+		err_log(errno, "%s: fcntl error", __func__);
+		return false;
+	}
 
-	pthread_exit(&dummy);
-	sw_assert_not_reached();
+	return true;
 }
 
 void
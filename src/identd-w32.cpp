@@ -47,23 +47,6 @@ accept_thread(void *arg)
 	identd::exit_thread();
 }
 
-static VoidCdecl
-com_thread(void *arg)
-{
-	auto cli = static_cast<ident_client *>(arg);
-
-	identd::enter_loop(cli);
-	delete cli;
-	identd::exit_thread();
-}
-
-void
-identd::com_with_client(ident_client *cli)
-{
-	if (_beginthread(com_thread, 0, cli) == g_beginthread_failed)
-		err_sys("%s: _beginthread", __func__);
-}
-
 NORETURN void
 identd::exit_thread(void)
 {
@@ -71,6 +54,20 @@ identd::exit_thread(void)
 	sw_assert_not_reached();
 }
 
+bool
+identd::set_nonblocking(SOCKET p_sock)
+{
+	u_long mode = 1;
+
+	if (ioctlsocket(p_sock, FIONBIO, &mode) != 0) {
+		err_log(0, "%s: ioctlsocket error (code = %d)", __func__,
+		    WSAGetLastError());
+		return false;
+	}
+
+	return true;
+}
+
 void
 identd::set_reuseaddr(SOCKET p_sock)
 {
@@ -30,18 +30,26 @@
 #include "common.h"
 
 #if UNIX
-#include <sys/select.h>
+#include <poll.h>
 #endif
 
+#include <algorithm>
+#include <atomic>
 #include <cinttypes>
+#include <list>
+#include <memory>
 #ifndef BSD
 #include <random>
 #endif
 #include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "config.h"
 #include "dataClassify.h"
 #include "errHand.h"
+#include "identd.h"
 #include "identd.hpp"
 #include "libUtils.h"
 #include "main.h"
@@ -52,12 +60,60 @@
 #include "strHand.h"
 #include "strdup_printf.h"
 
+#if defined(UNIX)
+#define SOCK_ERRNO		errno
+#define SOCK_WOULD_BLOCK(e)	((e) == EAGAIN || (e) == EWOULDBLOCK)
+#elif defined(WIN32)
+#define poll WSAPoll
+#define SOCK_ERRNO		WSAGetLastError()
+#define SOCK_WOULD_BLOCK(e)	((e) == WSAEWOULDBLOCK)
+#endif
+
+/*
+ * Longest query accepted ("65535 , 65535\r\n" plus some space)
+ */
+#define QUERY_MAX 20
+
+/*
+ * Forget the limits of idle addresses once this many are tracked
+ */
+#define IP_LIMITS_PRUNE 256
+
+/*
+ * A client that hasn't been answered yet
+ */
+struct pending_client {
+	std::unique_ptr<ident_client>	cli;
+	std::string			ip;
+	char				buf[QUERY_MAX];
+	size_t				len;
+	time_t				deadline;
+};
+
+/*
+ * Clients connected from an address and the tokens left in its bucket
+ */
+struct ip_limit {
+	int	clients;
+	int	tokens;
+	time_t	refilled;
+};
+
 char		 identd::fakename[FAKENAME_LEN] = { '\0' };
 _Atomic(bool)	 identd::listening = false;
-_Atomic(bool)	 identd::loop = false;
 const char	*identd::name = "identd";
 SOCKET		 identd::sock = INVALID_SOCKET;
 
+static std::unordered_map<std::string, ip_limit> ip_limits;
+
+static std::atomic<int>			ip_burst(IDENTD_IP_BURST);
+static std::atomic<int>			ip_rate(IDENTD_IP_RATE);
+
+static std::atomic<unsigned long int>	n_answered(0);
+static std::atomic<unsigned long int>	n_refused(0);
+static std::atomic<unsigned long int>	n_timed_out(0);
+static std::atomic<int>			n_clients(0);
+
 static void
 clean_up_socket(SOCKET &sock)
 {
@@ -78,16 +134,6 @@ clean_up_socket(SOCKET &sock)
 	}
 }
 
-static inline int
-get_maxfdp1(void)
-{
-#if defined(UNIX)
-	return (identd::sock + 1);
-#elif defined(WIN32)
-	return -1;
-#endif
-}
-
 //lint -sem(get_servport, r_null)
 static char *
 get_servport(void)
@@ -192,10 +238,9 @@ handle_ident_query(const char *server_port, const char *client_port,
 {
 	char *port;
 
-	if ((port = get_servport()) == nullptr)
-		err_log(0, "%s: get_servport() error", __func__);
-	else if (strings_match(port, server_port) && strings_match(client_port,
-	    g_last_port))
+	if ((port = get_servport()) != nullptr &&
+	    strings_match(port, server_port) &&
+	    strings_match(client_port, g_last_port))
 		identd::send_response(server_port, client_port, cli);
 	else
 		identd::send_err_resp(server_port, client_port, cli);
@@ -215,56 +260,209 @@ query_chars_ok(const char *recvbuf, const int bytes_received)
 	return true;
 }
 
-void
-identd::enter_loop(ident_client *cli)
+/*
+ * Parses a query in place. Returns false if it's invalid.
+ */
+static bool
+parse_query(char *query, const char *&server_port, const char *&client_port)
 {
-	char recvbuf[20] = { '\0' };
-	int bytes_received;
-	struct network_recv_context ctx(cli->get_sock(), 0, 3, 0);
+	char			*last = const_cast<char *>("");
+	static const char	 sep[] = "\r\n ,";
 
-	printtext_print("success", "%s: %s connected", identd::name,
-	    cli->get_ip());
-	block_signals();
+	server_port = strtok_r(query, sep, &last);
+	client_port = strtok_r(nullptr, sep, &last);
+
+	return !(server_port == nullptr || client_port == nullptr ||
+	    strtok_r(nullptr, sep, &last) != nullptr ||
+	    !is_numeric(server_port) || !is_numeric(client_port) ||
+	    *server_port == '0' || *client_port == '0');
+}
+
+/*
+ * Admits a client from the given address, unless it has too many
+ * clients connected or has run out of tokens. A token is refilled
+ * every 1/ip_rate second, up to ip_burst.
+ */
+static bool
+ip_admit(const std::string &ip, const time_t now)
+{
+	const int burst = ip_burst.load();
+	const int rate = ip_rate.load();
+
+	if (ip_limits.size() >= IP_LIMITS_PRUNE) {
+		for (auto it = ip_limits.begin(); it != ip_limits.end();) {
+			if (it->second.clients == 0 && (now -
+			    it->second.refilled) * rate + it->second.tokens >=
+			    burst)
+				it = ip_limits.erase(it);
+			else
+				++it;
+		}
+	}
+
+	auto res = ip_limits.emplace(ip, ip_limit{ 0, burst, now });
+	ip_limit &lim = res.first->second;
+
+	if (!res.second && now > lim.refilled) {
+		lim.tokens = static_cast<int>(std::min(static_cast<long long
+		    int>(burst), lim.tokens + static_cast<long long int>(now -
+		    lim.refilled) * rate));
+		lim.refilled = now;
+	}
+	if (lim.clients >= IDENTD_IP_CLIENTS_MAX || lim.tokens <= 0)
+		return false;
+
+	lim.clients++;
+	lim.tokens--;
+	return true;
+}
+
+static void
+ip_release(const std::string &ip)
+{
+	auto it = ip_limits.find(ip);
+
+	if (it != ip_limits.end() && it->second.clients > 0)
+		it->second.clients--;
+}
+
+static void
+drop_client(pending_client &pc)
+{
+	xclosesocket(pc.cli->get_sock());
+	ip_release(pc.ip);
+	n_clients--;
+}
+
+/*
+ * Accepts the pending connections. Those over the limits are closed
+ * at once, without an answer.
+ */
+static void
+accept_clients(std::list<pending_client> &clients)
+{
+	for (;;) {
+		SOCKET			clisock;
+		socklen_t		len = sizeof(struct sockaddr_storage);
+		struct sockaddr_storage	cliaddr;
+
+		if ((clisock = accept(identd::sock, reinterpret_cast
+		    <struct sockaddr *>(&cliaddr), &len)) == INVALID_SOCKET)
+			return;
+
+		std::unique_ptr<ident_client> cli(new ident_client(clisock,
+		    cliaddr));
+		std::string ip(cli->get_ip());
+		const time_t now = time(nullptr);
+
+		if (clients.size() >= IDENTD_CLIENTS_MAX ||
+		    !ip_admit(ip, now)) {
+			debug("%s: %s: refused %s", identd::name, __func__,
+			    ip.c_str());
+			xclosesocket(clisock);
+			n_refused++;
+			continue;
+		} else if (!identd::set_nonblocking(clisock)) {
+			xclosesocket(clisock);
+			ip_release(ip);
+			continue;
+		}
+
+		pending_client pc;
+
+		pc.cli = std::move(cli);
+		pc.ip = ip;
+		pc.len = 0;
+		pc.deadline = now + IDENTD_TIMEOUT;
+		clients.push_back(std::move(pc));
+		n_clients++;
+	}
+}
 
-	while (identd::loop) {
-		if ((bytes_received = net_recv_plain(&ctx, &recvbuf[0],
-		    sizeof recvbuf - 1)) < 0) {
-			break;
-		} else if (bytes_received > 0) {
-			char *last = const_cast<char *>("");
-			const char *server_port, *client_port;
-			static const char sep[] = "\r\n ,";
-
-			if (!query_chars_ok(recvbuf, bytes_received)) {
-				printtext_print("err", "%s: forbidden chars in "
-				    "query", identd::name);
-				break;
-			}
-
-			recvbuf[bytes_received] = '\0';
-
-			server_port = strtok_r(&recvbuf[0], sep, &last);
-			client_port = strtok_r(nullptr, sep, &last);
-
-			if (server_port == nullptr || client_port == nullptr ||
-			    strtok_r(nullptr, sep, &last) != nullptr ||
-			    !is_numeric(server_port) ||
-			    !is_numeric(client_port) ||
-			    *server_port == '0' || *client_port == '0') {
-				printtext_print("err", "%s: invalid query",
-				    identd::name);
-				break;
-			}
-
-			handle_ident_query(server_port, client_port, cli);
-			break;
+/*
+ * Reads what the client has sent and answers once the query is
+ * complete. Returns true if the client is done with.
+ */
+static bool
+read_query(pending_client &pc)
+{
+	const char	*client_port, *server_port;
+	int		 ret;
+
+	errno = 0;
+
+	if ((ret = static_cast<int>(recv(pc.cli->get_sock(), &pc.buf[pc.len],
+	    static_cast<int>(sizeof pc.buf - pc.len - 1), 0))) < 0)
+		return !SOCK_WOULD_BLOCK(SOCK_ERRNO);
+	else if (ret == 0)
+		return true;
+
+	if (!query_chars_ok(&pc.buf[pc.len], ret)) {
+		printtext_print("err", "%s: forbidden chars in query from %s",
+		    identd::name, pc.ip.c_str());
+		return true;
+	}
+
+	pc.len += ret;
+	pc.buf[pc.len] = '\0';
+
+	if (strpbrk(pc.buf, "\r\n") == nullptr) {
+		if (pc.len < sizeof pc.buf - 1)
+			return false;
+	} else if (parse_query(pc.buf, server_port, client_port)) {
+		handle_ident_query(server_port, client_port, pc.cli.get());
+		printtext_print("success", "%s: answered %s", identd::name,
+		    pc.ip.c_str());
+		n_answered++;
+		return true;
+	}
+
+	printtext_print("err", "%s: invalid query from %s", identd::name,
+	    pc.ip.c_str());
+	return true;
+}
+
+static void
+serve_clients(std::list<pending_client> &clients)
+{
+	const time_t			now = time(nullptr);
+	std::vector<struct pollfd>	fds;
+	struct pollfd			pfd;
+
+	pfd.fd = identd::sock;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	fds.push_back(pfd);
+
+	for (auto it = clients.begin(); it != clients.end();) {
+		if (now >= it->deadline) {
+			drop_client(*it);
+			it = clients.erase(it);
+			n_timed_out++;
+			continue;
 		}
+
+		pfd.fd = it->cli->get_sock();
+		fds.push_back(pfd);
+		++it;
 	}
 
-	if (cli->get_sock() != INVALID_SOCKET)
-		xclosesocket(cli->get_sock());
-	printtext_print("warn", "%s: %s disconnected", identd::name,
-	    cli->get_ip());
+	if (poll(fds.data(), fds.size(), 1000) <= 0)
+		return;
+
+	size_t i = 1;
+
+	for (auto it = clients.begin(); it != clients.end(); i++) {
+		if (fds[i].revents != 0 && read_query(*it)) {
+			drop_client(*it);
+			it = clients.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	if (fds[0].revents != 0)
+		accept_clients(clients);
 }
 
 void
@@ -288,9 +486,12 @@ identd::listen_on_port(const int port)
 		if (bind(identd::sock, sa, sa_size) != 0) {
 			throw std::runtime_error("unable to bind a name to "
 			    "a socket");
-		} else if (listen(identd::sock, 10) != 0) {
+		} else if (listen(identd::sock, SOMAXCONN) != 0) {
 			throw std::runtime_error("unable to listen for "
 			    "connections on a socket");
+		} else if (!identd::set_nonblocking(identd::sock)) {
+			throw std::runtime_error("unable to make the socket "
+			    "non-blocking");
 		}
 	} catch (const std::runtime_error &e) {
 		clean_up_socket(identd::sock);
@@ -306,43 +507,15 @@ identd::listen_on_port(const int port)
 	    port);
 	block_signals();
 	identd::listening = true;
-	identd::loop = true;
-
-	while (identd::listening) {
-		SOCKET			clisock;
-		fd_set			readset;
-		socklen_t		len = sizeof(struct sockaddr_storage);
-		struct sockaddr_storage	cliaddr;
-		struct timeval		tv = { 0 };
-
-		FD_ZERO(&readset);
-		FD_SET(identd::sock, &readset);
-
-		errno = 0;
-
-		tv.tv_sec	= 3;
-		tv.tv_usec	= 111;
-
-		if (select(get_maxfdp1(), &readset, nullptr, nullptr, &tv) ==
-		    SOCKET_ERROR) {
-			if (errno == EINTR)
-				continue;
-			break;
-		} else if (!FD_ISSET(identd::sock, &readset)) {
-			/*
-			 * No connection to accept()
-			 */
 
-			continue;
-		} else if ((clisock = accept(identd::sock, reinterpret_cast
-		    <struct sockaddr *>(&cliaddr), &len)) < 0) {
-			(void) napms(222);
-			continue;
-		}
+	std::list<pending_client> clients;
 
-		identd::com_with_client(new ident_client(clisock, cliaddr));
-	}
+	while (identd::listening)
+		serve_clients(clients);
 
+	for (pending_client &pc : clients)
+		drop_client(pc);
+	ip_limits.clear();
 	clean_up_socket(identd::sock);
 	printtext_print("warn", "%s: stopped listening", identd::name);
 }
@@ -406,7 +579,6 @@ identd::stop(void)
 	printtext_print("warn", "%s: stopping daemon...", identd::name);
 
 	identd::listening = false;
-	identd::loop = false;
 
 	if (identd::sock != INVALID_SOCKET) {
 		errno = 0;
@@ -422,3 +594,32 @@ identd::stop(void)
 #endif
 	}
 }
+
+void
+identd_get_stats(struct identd_stats *stats)
+{
+	stats->answered = n_answered.load();
+	stats->refused = n_refused.load();
+	stats->timed_out = n_timed_out.load();
+	stats->clients = n_clients.load();
+	stats->listening = identd::listening;
+}
+
+void
+identd_set_ip_limits(const int burst, const int rate)
+{
+	ip_burst = burst;
+	ip_rate = rate;
+}
+
+void
+identd_start(const int port)
+{
+	identd::start(port);
+}
+
+void
+identd_stop(void)
+{
+	identd::stop();
+}
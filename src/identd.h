@@ -0,0 +1,29 @@
+#ifndef SRC_IDENTD_H_
+#define SRC_IDENTD_H_
+
+/*
+ * The daemon serves all clients from one thread. Clients over these
+ * limits are disconnected without an answer.
+ */
+#define IDENTD_CLIENTS_MAX	32	/* connected at once */
+#define IDENTD_IP_CLIENTS_MAX	4	/* connected at once per address */
+#define IDENTD_IP_BURST		10	/* queries per address... */
+#define IDENTD_IP_RATE		2	/* ...refilled per second */
+#define IDENTD_TIMEOUT		10	/* seconds to send the query */
+
+struct identd_stats {
+	unsigned long int	answered;
+	unsigned long int	refused;
+	unsigned long int	timed_out;
+	int			clients;
+	bool			listening;
+};
+
+__SWIRC_BEGIN_DECLS
+void	identd_get_stats(struct identd_stats *);
+void	identd_set_ip_limits(const int burst, const int rate);
+void	identd_start(const int port);
+void	identd_stop(void);
+__SWIRC_END_DECLS
+
+#endif
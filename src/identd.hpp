@@ -143,7 +143,6 @@ namespace identd
 {
 	extern char		 fakename[FAKENAME_LEN];
 	extern _Atomic(bool)	 listening;
-	extern _Atomic(bool)	 loop;
 	extern const char	*name;
 	extern SOCKET		 sock;
 
@@ -151,13 +150,12 @@ namespace identd
 	void	start(const int);
 	void	stop(void);
 
-	void	com_with_client(ident_client *);
-	void	enter_loop(ident_client *);
 	NORETURN void
 		exit_thread(void);
 	void	listen_on_port(const int);
 	void	send_err_resp(const char *, const char *, ident_client *);
 	void	send_response(const char *, const char *, ident_client *);
+	bool	set_nonblocking(SOCKET);
 	void	set_reuseaddr(SOCKET);
 }
 
@@ -635,6 +635,20 @@ static usage_t passmod_usage = {
   "",
 };
 
+static usage_t perf_usage = {
+  N_("usage: /perf [on | off | reset | dump <file>]"),
+  "",
+  N_("Shows call counts and latencies for the hot stages of the client,\n"
+     "e.g. line framing, event dispatch, text rendering and logging. The\n"
+     "instrumentation is off by default and can be switched on/off at\n"
+     "runtime. Without arguments the current figures and the most\n"
+     "expensive protocol events are printed."),
+  "",
+  (TXT_BOLD "dump" TXT_BOLD),
+  N_("    Writes the counters and latency histograms to a file as JSON."),
+  "",
+};
+
 static usage_t qbot_usage = {
   N_("usage: /qbot <[service hostname | --]> <command> [...]"),
   "",
@@ -946,6 +960,15 @@ static usage_t wholeft_usage = {
   "",
 };
 
+static usage_t window_usage = {
+  N_("usage: /window [list | stats]"),
+  "",
+  N_("Lists the open windows. With 'stats' the number of lines and the\n"
+     "memory held by the scrollback of each window is shown, together with\n"
+     "the budgets set by 'textbuffer_window_kb' and 'textbuffer_total_kb'."),
+  "",
+};
+
 static usage_t znc_usage = {
   N_("usage: /znc [*module] <command>"),
   "",
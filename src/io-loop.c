@@ -43,6 +43,7 @@
 #include "main.h"
 #include "nestHome.h"
 #include "network.h"
+#include "prefixTrie.h"
 #include "printtext.h"
 #include "readline.h"
 #include "strHand.h"
@@ -74,6 +75,7 @@
 #include "commands/nick.h"
 #include "commands/notice.h"
 #include "commands/op.h"
+#include "commands/perf.h"
 #include "commands/sasl.h"
 #include "commands/say.h"
 #include "commands/services.h"
@@ -85,6 +87,7 @@
 #include "commands/utctime.h"
 #include "commands/voice.h"
 #include "commands/wholeft.h"
+#include "commands/window.h"
 #include "commands/znc.h"
 
 #include "events/names.h"
@@ -159,6 +162,7 @@ static struct cmds_tag {
 	{ "p",           cmd_part,        true,  part_usage,        ARRAY_SIZE(part_usage),        true  },
 	{ "part",        cmd_part,        true,  part_usage,        ARRAY_SIZE(part_usage),        true  },
 	{ "passmod",     cmd_passmod,     true,  passmod_usage,     ARRAY_SIZE(passmod_usage),     false },
+	{ "perf",        cmd_perf,        false, perf_usage,        ARRAY_SIZE(perf_usage),        false },
 	{ "qbot",        cmd_qbot,        true,  qbot_usage,        ARRAY_SIZE(qbot_usage),        true  },
 	{ "query",       cmd_query,       false, query_usage,       ARRAY_SIZE(query_usage),       false },
 	{ "quit",        cmd_quit,        false, quit_usage,        ARRAY_SIZE(quit_usage),        false },
@@ -186,6 +190,7 @@ static struct cmds_tag {
 	{ "who",         cmd_who,         true,  who_usage,         ARRAY_SIZE(who_usage),         true  },
 	{ "whois",       cmd_whois,       true,  whois_usage,       ARRAY_SIZE(whois_usage),       true  },
 	{ "wholeft",     cmd_wholeft,     true,  wholeft_usage,     ARRAY_SIZE(wholeft_usage),     true  },
+	{ "window",      cmd_window,      false, window_usage,      ARRAY_SIZE(window_usage),      false },
 	{ "wl",          cmd_wholeft,     true,  wholeft_usage,     ARRAY_SIZE(wholeft_usage),     true  },
 	{ "znc",         cmd_znc,         true,  znc_usage,         ARRAY_SIZE(znc_usage),         true  },
 };
@@ -625,23 +630,27 @@ swirc_greeting(void)
 	printtext(&ctx, " ");
 }
 
-PTEXTBUF
-get_list_of_matching_commands(CSTRING search_var)
+/**
+ * Get the command names sorted for prefixRange_first()
+ *
+ * @param[out] count Number of names
+ * @return The names
+ */
+const char * const *
+get_sorted_commands(size_t *count)
 {
-	PTEXTBUF	matches = textBuf_new();
-	const size_t	varlen = strlen(search_var);
-
-	FOREACH_COMMAND() {
-		if (!strncmp(search_var, sp->cmd, varlen))
-			textBuf_emplace_back(__func__, matches, sp->cmd, 0);
+	static const char	*sorted[ARRAY_SIZE(cmds)] = { NULL };
+	static bool		 is_sorted = false;
+
+	if (!is_sorted) {
+		FOREACH_COMMAND()
+			sorted[sp - &cmds[0]] = sp->cmd;
+		prefixRange_sort(sorted, ARRAY_SIZE(sorted));
+		is_sorted = true;
 	}
 
-	if (textBuf_size(matches) == 0) {
-		textBuf_destroy(matches);
-		return NULL;
-	}
-
-	return matches;
+	*count = ARRAY_SIZE(sorted);
+	return sorted;
 }
 
 STRING
@@ -827,18 +836,7 @@ transmit_user_input(CSTRING winlabel, CSTRING input)
 			return;
 		}
 
-		if (n->is_owner)
-			c = '~';
-		else if (n->is_superop)
-			c = '&';
-		else if (n->is_op)
-			c = '@';
-		else if (n->is_halfop)
-			c = '%';
-		else if (n->is_voice)
-			c = '+';
-		else
-			c = ' ';
+		c = n->prefix;
 
 		printtext(&ctx, "%s%c%s%s%c%s %s",
 		    cp[0], c, COLOR1, g_my_nickname, NORMAL, cp[1],
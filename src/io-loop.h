@@ -12,9 +12,8 @@ __SWIRC_BEGIN_DECLS
 extern bool	g_io_loop;
 extern wchar_t	g_push_back_buf[MAX_PBB];
 
-/*lint -sem(get_list_of_matching_commands, r_null) */
-
-PTEXTBUF	 get_list_of_matching_commands(CSTRING search_var);
+const char * const
+		*get_sorted_commands(size_t *count);
 STRING		 get_prompt(void);
 void		 cmd_help(CSTRING);
 void		 enter_io_loop(void);
@@ -40,10 +40,12 @@
 #include "messagetags.h"
 #include "nestHome.h"
 #include "network.h"
+#include "perf.h"
 #include "printtext.h"
 #include "readline.h"		/* readline_top_panel() */
 #include "statusbar.h"
 #include "strHand.h"
+#include "strpool.h"
 
 #include "events/account.h"
 #include "events/auth.h"
@@ -98,6 +100,11 @@ static pthread_mutex_t	nickname_mtx;
 static HANDLE		nickname_mtx;
 #endif
 
+/*
+ * Time spent in ProcessProtoMsg(), subtracted from the framing stage
+ */
+static uint64_t		dispatch_ns = 0;
+
 static struct normal_events_tag {
 	CSTRING			normal_event;
 	event_handler_fn	event_handler;
@@ -575,7 +582,7 @@ SortMsgCompo(const char *protocol_message)
 static void
 FreeMsgCompo(struct irc_message_compo *compo)
 {
-	free(compo->account);
+	strpool_release(compo->account);
 
 	free(compo->prefix);
 	free(compo->command);
@@ -676,11 +683,19 @@ irc_search_and_route_event(struct irc_message_compo *compo)
 static void
 ProcessProtoMsg(const char *token)
 {
-	struct irc_message_compo *compo;
+	perf_tick_t			 start;
+	struct irc_message_compo	*compo;
 
-	if ((compo = SortMsgCompo(token)) == NULL)
+	start = perf_begin();
+	if ((compo = SortMsgCompo(token)) == NULL) {
+		dispatch_ns += perf_end(PERF_SORT_MSG_COMPO, start);
 		return;
+	}
+	dispatch_ns += perf_end(PERF_SORT_MSG_COMPO, start);
+
+	start = perf_begin();
 	irc_search_and_route_event(compo);
+	dispatch_ns += perf_end_event(compo->command, start);
 	FreeMsgCompo(compo);
 }
 
@@ -716,7 +731,9 @@ irc_handle_interpret_events(char *recvbuffer, char **message_concat,
 	char			*cp = NULL, *tokstate = "";
 	char			*last_token = NULL;
 	long int		 loop_count = 0;
+	perf_tick_t		 start;
 	static const char	 separators[] = "\r\n";
+	uint64_t		 nested_ns;
 
 	if (recvbuffer == NULL || message_concat == NULL || state == NULL)
 		err_exit(EINVAL, "%s", __func__);
@@ -724,6 +741,9 @@ irc_handle_interpret_events(char *recvbuffer, char **message_concat,
 		 strpbrk(recvbuffer, separators) == NULL)
 		return;
 
+	start = perf_begin();
+	nested_ns = dispatch_ns;
+
 	if (*state == CONCAT_BUFFER_CONTAIN_DATA &&
 	    recvbuffer[0] == '\r' && recvbuffer[1] == '\n') {
 		ProcessProtoMsg(*message_concat);
@@ -760,6 +780,8 @@ irc_handle_interpret_events(char *recvbuffer, char **message_concat,
 			 * (incomplete) irc message will be
 			 * concatenated...
 			 */
+			perf_end_excluding(PERF_FRAMING, start,
+			    dispatch_ns - nested_ns);
 			return;
 		} else if (loop_count == 0 &&
 		    *state == CONCAT_BUFFER_CONTAIN_DATA) {
@@ -779,6 +801,7 @@ irc_handle_interpret_events(char *recvbuffer, char **message_concat,
 	} /* while */
 
 	free(last_token);
+	perf_end_excluding(PERF_FRAMING, start, dispatch_ns - nested_ns);
 }
 
 void
@@ -4,7 +4,7 @@
 #include "window.h"
 
 struct irc_message_compo {
-	STRING account;
+	CSTRING account; /* interned */
 
 	int year;
 	int month;
@@ -0,0 +1,525 @@
+/* Server features (RPL_ISUPPORT) and casemapping
+   Copyright (C) 2026 Markus Uhlin. All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   - Neither the name of the author nor the names of its contributors may be
+     used to endorse or promote products derived from this software without
+     specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+   BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE. */
+
+#include "common.h"
+
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "isupport.h"
+#include "libUtils.h"
+#include "strHand.h"
+
+class casemap_tables {
+public:
+	unsigned char ascii[256];
+	unsigned char rfc1459[256];
+	unsigned char strict_rfc1459[256];
+
+	casemap_tables()
+	{
+		for (int c = 0; c < 256; c++) {
+			const unsigned char lc = static_cast<unsigned char>
+			    (c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c);
+
+			this->ascii[c] = this->rfc1459[c] =
+			    this->strict_rfc1459[c] = lc;
+		}
+
+		this->rfc1459['['] = this->strict_rfc1459['['] = '{';
+		this->rfc1459[']'] = this->strict_rfc1459[']'] = '}';
+		this->rfc1459['\\'] = this->strict_rfc1459['\\'] = '|';
+		this->rfc1459['~'] = '^';
+	}
+};
+
+static const casemap_tables	tables;
+static std::atomic<int>		casemapping(CASEMAPPING_RFC1459);
+
+static std::mutex					isupport_mtx;
+static std::unordered_map<std::string, std::string>	features;
+
+/*
+ * Derived from the features above. Protected by 'isupport_mtx'.
+ */
+static std::string				chantypes;
+static std::string				chanmodes[4];
+static std::string				prefix_modes;
+static std::string				prefix_symbols;
+static size_t					nicklen = 0;
+static std::unordered_map<std::string, size_t>	targmax;
+static std::unordered_map<char, size_t>		maxlist;
+
+static const unsigned char *
+get_table(void)
+{
+	switch (casemapping.load()) {
+	case CASEMAPPING_ASCII:
+		return &tables.ascii[0];
+	case CASEMAPPING_STRICT_RFC1459:
+		return &tables.strict_rfc1459[0];
+	default:
+		break;
+	}
+
+	return &tables.rfc1459[0];
+}
+
+static size_t
+parse_size(const char *str)
+{
+	char		*ep = nullptr;
+	unsigned long	 val;
+
+	if (str == nullptr || *str == '\0')
+		return 0;
+	errno = 0;
+	val = strtoul(str, &ep, 10);
+	if (errno != 0 || ep == str)
+		return 0;
+	return static_cast<size_t>(val);
+}
+
+static bool
+is_hex(const char c)
+{
+	return isxdigit(static_cast<unsigned char>(c)) != 0;
+}
+
+static char
+upper(const char c)
+{
+	return static_cast<char>(toupper(static_cast<unsigned char>(c)));
+}
+
+/*
+ * Values may contain \xHH escapes
+ */
+static std::string
+unescape(const char *value)
+{
+	std::string str("");
+
+	for (const char *cp = value; *cp != '\0'; cp++) {
+		if (cp[0] == '\\' && cp[1] == 'x' && is_hex(cp[2]) &&
+		    is_hex(cp[3])) {
+			const char hex[3] = { cp[2], cp[3], '\0' };
+
+			str.push_back(static_cast<char>(strtol(hex, nullptr,
+			    16)));
+			cp += 3;
+		} else {
+			str.push_back(*cp);
+		}
+	}
+
+	return str;
+}
+
+/*
+ * Calls 'fn' with each "key:value" pair of a comma-separated list
+ */
+template<typename Fn>
+static void
+foreach_pair(const std::string &list, Fn fn)
+{
+	size_t pos = 0;
+
+	while (pos < list.size()) {
+		size_t		end = list.find(',', pos);
+		std::string	item;
+		size_t		colon;
+
+		if (end == std::string::npos)
+			end = list.size();
+		item = list.substr(pos, end - pos);
+		if ((colon = item.find(':')) != std::string::npos)
+			fn(item.substr(0, colon), item.c_str() + colon + 1);
+		pos = end + 1;
+	}
+}
+
+static void
+set_casemapping(const std::string &value)
+{
+	if (value == "ascii")
+		casemapping = CASEMAPPING_ASCII;
+	else if (value == "strict-rfc1459")
+		casemapping = CASEMAPPING_STRICT_RFC1459;
+	else
+		casemapping = CASEMAPPING_RFC1459;
+}
+
+static void
+set_chanmodes(const std::string &value)
+{
+	size_t pos = 0;
+
+	for (std::string &group : chanmodes) {
+		const size_t end = value.find(',', pos);
+
+		if (pos > value.size()) {
+			group.clear();
+			continue;
+		}
+		group = value.substr(pos, (end == std::string::npos ?
+		    std::string::npos : end - pos));
+		pos = (end == std::string::npos ? value.size() + 1 : end + 1);
+	}
+}
+
+static void
+set_prefix(const std::string &value)
+{
+	size_t close;
+
+	prefix_modes.clear();
+	prefix_symbols.clear();
+
+	if (value.empty())
+		return;
+	if (value[0] != '(' || (close = value.find(')')) ==
+	    std::string::npos || value.size() - close - 1 != close - 1)
+		return;
+	prefix_modes = value.substr(1, close - 1);
+	prefix_symbols = value.substr(close + 1);
+}
+
+/*
+ * Called with 'isupport_mtx' locked
+ */
+static void
+derive(const std::string &name, const std::string &value)
+{
+	if (name == "CASEMAPPING") {
+		set_casemapping(value);
+	} else if (name == "CHANTYPES") {
+		chantypes = value;
+	} else if (name == "CHANMODES") {
+		set_chanmodes(value);
+	} else if (name == "PREFIX") {
+		set_prefix(value);
+	} else if (name == "NICKLEN") {
+		nicklen = parse_size(value.c_str());
+	} else if (name == "TARGMAX") {
+		targmax.clear();
+		foreach_pair(value, [](const std::string &key, const char *val)
+		{
+			std::string cmd(key);
+
+			for (char &c : cmd)
+				c = upper(c);
+			targmax[cmd] = parse_size(val);
+		});
+	} else if (name == "MAXLIST") {
+		maxlist.clear();
+		foreach_pair(value, [](const std::string &key, const char *val)
+		{
+			for (const char c : key)
+				maxlist[c] = parse_size(val);
+		});
+	}
+}
+
+/*
+ * Called with 'isupport_mtx' locked
+ */
+static void
+set_defaults(void)
+{
+	features.clear();
+	casemapping = CASEMAPPING_RFC1459;
+	chantypes.assign(ISUPPORT_DEFAULT_CHANTYPES);
+	set_chanmodes(ISUPPORT_DEFAULT_CHANMODES);
+	set_prefix(ISUPPORT_DEFAULT_PREFIX);
+	nicklen = 0;
+	targmax.clear();
+	maxlist.clear();
+}
+
+static bool
+init_once(void)
+{
+	set_defaults();
+	return true;
+}
+
+static std::unique_lock<std::mutex>
+lock_features(void)
+{
+	static const bool init_done = init_once();
+
+	(void) init_done;
+	return std::unique_lock<std::mutex>(isupport_mtx);
+}
+
+/*
+ * Takes a token of a 005 message, e.g. "CASEMAPPING=rfc1459". A token
+ * starting with a minus sign withdraws a feature.
+ */
+void
+isupport_feed(const char *token)
+{
+	if (token == nullptr || *token == '\0' || *token == ':')
+		return;
+
+	auto		 lock = lock_features();
+	const char	*eq = strchr(token, '=');
+	std::string	 name;
+
+	if (*token == '-') {
+		name.assign(token + 1);
+		features.erase(name);
+
+		if (name == "CASEMAPPING")
+			casemapping = CASEMAPPING_RFC1459;
+		else if (name == "CHANTYPES")
+			chantypes.assign(ISUPPORT_DEFAULT_CHANTYPES);
+		else if (name == "CHANMODES")
+			set_chanmodes(ISUPPORT_DEFAULT_CHANMODES);
+		else if (name == "PREFIX")
+			set_prefix(ISUPPORT_DEFAULT_PREFIX);
+		else
+			derive(name, "");
+		return;
+	}
+
+	name.assign(token, (eq ? static_cast<size_t>(eq - token) :
+	    strlen(token)));
+	features[name] = unescape(eq ? eq + 1 : "");
+	derive(name, features[name]);
+}
+
+/*
+ * Forgets the features of the previous server
+ */
+void
+isupport_reset(void)
+{
+	auto lock = lock_features();
+
+	set_defaults();
+}
+
+/*
+ * Copies the value of a feature. Returns false if the server hasn't
+ * advertised it.
+ */
+bool
+isupport_get(const char *name, char *value, size_t size)
+{
+	auto lock = lock_features();
+	const auto it = features.find(name);
+
+	if (it == features.end())
+		return false;
+	if (value != nullptr && size > 0) {
+		(void) snprintf(value, size, "%s", it->second.c_str());
+	}
+	return true;
+}
+
+enum casemapping
+isupport_casemapping(void)
+{
+	return static_cast<enum casemapping>(casemapping.load());
+}
+
+/*
+ * Returns the type of a channel mode: 'A' (list), 'B' (always has a
+ * parameter), 'C' (has a parameter when set), 'D' (never has a
+ * parameter) or 'P' (a member prefix). Zero if unknown.
+ */
+char
+isupport_chanmode_type(const char mode)
+{
+	auto lock = lock_features();
+
+	if (prefix_modes.find(mode) != std::string::npos)
+		return 'P';
+	for (size_t i = 0; i < ARRAY_SIZE(chanmodes); i++) {
+		if (chanmodes[i].find(mode) != std::string::npos)
+			return static_cast<char>('A' + i);
+	}
+	return '\0';
+}
+
+bool
+isupport_is_chantype(const char c)
+{
+	auto lock = lock_features();
+
+	return (c != '\0' && chantypes.find(c) != std::string::npos);
+}
+
+/*
+ * Returns the most entries of list mode 'mode', or zero if unknown
+ */
+size_t
+isupport_maxlist(const char mode)
+{
+	auto lock = lock_features();
+	const auto it = maxlist.find(mode);
+
+	return (it != maxlist.end() ? it->second : 0);
+}
+
+/*
+ * Returns the longest nickname allowed, or zero if unknown
+ */
+size_t
+isupport_nicklen(void)
+{
+	auto lock = lock_features();
+
+	return nicklen;
+}
+
+/*
+ * Returns the mode of a member prefix symbol, e.g. 'o' for '@', or
+ * zero if it's not a prefix
+ */
+char
+isupport_prefix_mode(const char symbol)
+{
+	auto lock = lock_features();
+	const size_t pos = (symbol ? prefix_symbols.find(symbol) :
+	    std::string::npos);
+
+	return (pos != std::string::npos ? prefix_modes[pos] : '\0');
+}
+
+/*
+ * Returns the rank of a member prefix mode, where zero is the highest,
+ * or -1 if it's not a prefix
+ */
+int
+isupport_prefix_rank(const char mode)
+{
+	auto lock = lock_features();
+	const size_t pos = (mode ? prefix_modes.find(mode) :
+	    std::string::npos);
+
+	return (pos != std::string::npos ? static_cast<int>(pos) : -1);
+}
+
+char
+isupport_prefix_symbol(const char mode)
+{
+	auto lock = lock_features();
+	const size_t pos = (mode ? prefix_modes.find(mode) :
+	    std::string::npos);
+
+	return (pos != std::string::npos ? prefix_symbols[pos] : '\0');
+}
+
+/*
+ * Returns the most targets of 'command', or zero if there's no limit
+ * or it's unknown
+ */
+size_t
+isupport_targmax(const char *command)
+{
+	auto		lock = lock_features();
+	std::string	cmd(command ? command : "");
+
+	for (char &c : cmd)
+		c = upper(c);
+
+	const auto it = targmax.find(cmd);
+
+	return (it != targmax.end() ? it->second : 0);
+}
+
+/* ----------------------------------------------------------------- */
+
+int
+isupport_tolower(const int c)
+{
+	return get_table()[static_cast<unsigned char>(c)];
+}
+
+/*
+ * Folds a nickname or channel name into its lower case form per the
+ * server's casemapping. Names that fold equally are the same name.
+ */
+char *
+isupport_fold(const char *str, char *key, size_t size)
+{
+	const unsigned char	*table = get_table();
+	size_t			 i = 0;
+
+	if (key == nullptr || size == 0)
+		return key;
+	for (; str != nullptr && str[i] != '\0' && i < size - 1; i++)
+		key[i] = static_cast<char>(table[static_cast<unsigned char>
+		    (str[i])]);
+	key[i] = '\0';
+	return key;
+}
+
+/*
+ * Hashes a folded key
+ */
+unsigned int
+isupport_key_hash(const char *key, size_t upper_bound)
+{
+	return hash_djb_g(key, false, upper_bound);
+}
+
+bool
+isupport_match(const char *s1, const char *s2)
+{
+	const unsigned char *table = get_table();
+
+	if (s1 == nullptr || s2 == nullptr)
+		return false;
+	for (; *s1 != '\0'; s1++, s2++) {
+		if (table[static_cast<unsigned char>(*s1)] !=
+		    table[static_cast<unsigned char>(*s2)])
+			return false;
+	}
+	return (*s2 == '\0');
+}
+
+std::string
+isupport_fold_str(const char *str)
+{
+	const unsigned char	*table = get_table();
+	std::string		 key(str ? str : "");
+
+	for (char &c : key)
+		c = static_cast<char>(table[static_cast<unsigned char>(c)]);
+	return key;
+}
@@ -0,0 +1,53 @@
+#ifndef SRC_ISUPPORT_H_
+#define SRC_ISUPPORT_H_
+
+/*
+ * Server features, as advertised by RPL_ISUPPORT (005). They're
+ * forgotten when a connection starts and the defaults below apply
+ * until the server says otherwise.
+ */
+
+enum casemapping {
+	CASEMAPPING_ASCII,
+	CASEMAPPING_RFC1459,		/* []\~ are the lower case of {}|^ */
+	CASEMAPPING_STRICT_RFC1459	/* the same, without ~ and ^ */
+};
+
+#define ISUPPORT_DEFAULT_CHANTYPES	"#&"
+#define ISUPPORT_DEFAULT_PREFIX		"(ov)@+"
+#define ISUPPORT_DEFAULT_CHANMODES	"beI,k,l,imnpst"
+
+/*
+ * Longest key isupport_fold() is asked to produce by the lookups. The
+ * keys of longer names are truncated.
+ */
+#define ISUPPORT_KEY_MAX 256
+
+__SWIRC_BEGIN_DECLS
+void		 isupport_feed(const char *token);
+void		 isupport_reset(void);
+
+bool		 isupport_get(const char *name, char *value, size_t size);
+enum casemapping isupport_casemapping(void);
+char		 isupport_chanmode_type(const char mode);
+bool		 isupport_is_chantype(const char c);
+size_t		 isupport_maxlist(const char mode);
+size_t		 isupport_nicklen(void);
+char		 isupport_prefix_mode(const char symbol);
+int		 isupport_prefix_rank(const char mode);
+char		 isupport_prefix_symbol(const char mode);
+size_t		 isupport_targmax(const char *command);
+
+int		 isupport_tolower(const int c);
+char		*isupport_fold(const char *str, char *key, size_t size);
+unsigned int	 isupport_key_hash(const char *key, size_t upper_bound);
+bool		 isupport_match(const char *s1, const char *s2);
+__SWIRC_END_DECLS
+
+#ifdef __cplusplus
+#include <string>
+
+std::string	isupport_fold_str(const char *);
+#endif
+
+#endif
@@ -29,6 +29,7 @@
 
 #include "common.h"
 
+#include <ctype.h>
 #include <limits.h>
 #include <stdint.h>
 #include <string.h>
@@ -337,35 +338,30 @@ unsigned int
 hash_djb_g(const char *str, const bool lc, const size_t upper_bound)
 {
 #define MAGIC_NUMBER 5381
-	char		*str_copy, *cp;
-	char		 c;
-	unsigned int	 hashval;
+	char		c;
+	unsigned int	hashval = MAGIC_NUMBER;
 
-	str_copy	= (lc ? strToLower(sw_strdup(str)) : sw_strdup(str));
-	cp		= &str_copy[0];
-	hashval		= MAGIC_NUMBER;
-
-	while ((c = *cp++) != '\0')
+	for (const char *cp = &str[0]; (c = *cp) != '\0'; cp++) {
+		if (lc && sw_isupper(c))
+			c = tolower(c);
 		hashval = ((hashval << 5) + hashval) + c;
+	}
 
-	free(str_copy);
 	return (hashval % upper_bound);
 }
 
 unsigned int
 hash_pjw_g(const char *str, const bool lc, const size_t upper_bound)
 {
-	char		*str_copy, *cp;
-	char		 c;
-	unsigned int	 hashval;
+	char		c;
+	unsigned int	hashval = 0;
 
-	str_copy	= (lc ? strToLower(sw_strdup(str)) : sw_strdup(str));
-	cp		= &str_copy[0];
-	hashval		= 0;
-
-	while ((c = *cp++) != '\0') {
+	for (const char *cp = &str[0]; (c = *cp) != '\0'; cp++) {
 		unsigned int tmp;
 
+		if (lc && sw_isupper(c))
+			c = tolower(c);
+
 		hashval = (hashval << 4) + c;
 		tmp = (hashval & 0xf0000000);
 
@@ -375,7 +371,6 @@ hash_pjw_g(const char *str, const bool lc, const size_t upper_bound)
 		}
 	}
 
-	free(str_copy);
 	return (hashval % upper_bound);
 }
 
@@ -38,6 +38,7 @@
 #include "libUtils.h"
 #include "log.h"
 #include "nestHome.h"
+#include "perf.h"
 #include "printtext.h"
 #include "readline.h"
 #include "statusbar.h"
@@ -201,12 +202,15 @@ log_get_path(const char *server_host, const char *label)
 void
 log_msg(const char *path, const char *text)
 {
-	FILE	*fp;
-	int	 fd;
+	FILE		*fp;
+	int		 fd;
+	perf_tick_t	 start;
 
 	if (path == NULL || text == NULL)
 		return;
 
+	start = perf_begin();
+
 #if defined(UNIX)
 	if ((fd = open(path, g_open_flags[OPFL_APPEND], g_open_modes)) < 0)
 		return;
@@ -231,6 +235,8 @@ log_msg(const char *path, const char *text)
 	} else {
 		(void) close(fd);
 	}
+
+	(void) perf_end(PERF_LOG_MSG, start);
 }
 
 void
@@ -60,6 +60,7 @@
 #include "curses-funcs.h"
 #include "cursesInit.h"
 #include "dataClassify.h"
+#include "diag.h"
 #include "elapsed-time.hpp"
 #include "errHand.h"
 #include "i18n.h"
@@ -71,6 +72,8 @@
 #include "network.h"
 #include "options.h"
 #include "readline.h"
+#include "resolver.h"
+#include "scrollback.h"
 #include "sig.h"
 #include "statusbar.h"
 #include "strHand.h"
@@ -843,15 +846,18 @@ main(int argc, char *argv[])
 	 */
 	dcc_deinit();
 	ftp_deinit();
+	resolver_deinit();
 	net_ssl_deinit();
 #ifdef WIN32
 	winsock_deinit();
 #endif
 	readline_deinit();
 	windowSystem_deinit();
+	scrollback_deinit();
 	statusbar_deinit();
 	titlebar_deinit();
 	escape_curses();
+	diag_deinit();
 	nestHome_deinit();
 	term_deinit();
 
@@ -40,6 +40,7 @@
 #include "printtext.h"
 #include "strHand.h"
 #include "strdup_printf.h"
+#include "strpool.h"
 
 static struct tag_list_ {
 	CSTRING		name;
@@ -54,9 +55,9 @@ static void
 set_var(CSTRING name, CSTRING value, struct messagetags *tags)
 {
 	if (strings_match(name, "account="))
-		tags->account = sw_strdup(value);
+		tags->account = strpool_intern(value);
 	else if (strings_match(name, "batch="))
-		tags->batch = sw_strdup(value);
+		tags->batch = strpool_intern(value);
 	else if (strings_match(name, "time="))
 		tags->srv_time = sw_strdup(value);
 	else
@@ -96,8 +97,8 @@ void
 msgtags_free(struct messagetags *tags)
 {
 	if (tags) {
-		free(tags->account);
-		free(tags->batch);
+		strpool_release(tags->account);
+		strpool_release(tags->batch);
 		free(tags->srv_time);
 		free(tags);
 	}
@@ -123,20 +124,12 @@ msgtags_handle_batch(CSTRING pmsg, const struct messagetags *tags)
 	free(str);
 }
 
-static bool
-no_change(CSTRING str1, CSTRING str2)
-{
-	if (str1 == NULL || str2 == NULL)
-		return false;
-	return (strcmp(str1, str2) == 0);
-}
-
 void
 msgtags_process(struct irc_message_compo *compo, struct messagetags *tags)
 {
-	if (tags->account && !no_change(compo->account, tags->account)) {
-		free(compo->account);
-		compo->account = sw_strdup(tags->account);
+	if (tags->account && compo->account != tags->account) {
+		strpool_release(compo->account);
+		compo->account = strpool_ref(tags->account);
 	}
 	if (tags->srv_time) {
 		if (xsscanf(tags->srv_time, "%d-%d-%dT%d:%d:%d.%dZ",
@@ -2,8 +2,8 @@
 #define SRC_MESSAGETAGS_H_
 
 struct messagetags {
-	STRING	account;
-	STRING	batch;
+	CSTRING	account;	/* interned */
+	CSTRING	batch;		/* interned */
 	STRING	srv_time;
 };
 
@@ -29,16 +29,96 @@
 
 #include "common.h"
 
+#include <algorithm>
+#include <map>
 #include <stdexcept>
+#include <unordered_map>
 
 #include "errHand.h"
+#include "isupport.h"
 #include "libUtils.h"
 #include "netsplit.h"
 #include "printtext.h"
 #include "strHand.h"
 #include "strdup_printf.h"
+#include "strpool.h"
 #include "theme.h"
 
+enum netsplit_event {
+	NETSPLIT_ANNOUNCE,
+	NETSPLIT_EXPIRE,
+	NETSPLIT_NETJOIN
+};
+
+struct netsplit_timer {
+	uintmax_t		id;
+	time_t			when;
+	enum netsplit_event	event;
+};
+
+/*
+ * What is printed for all channels of a server pair at once
+ */
+struct netsplit_summary {
+	std::string			serv1, serv2;
+	std::vector<std::string>	channels;
+	uintmax_t			nicks;
+	uintmax_t			total;
+	time_t				elapsed;
+
+	netsplit_summary() : nicks(0), total(0), elapsed(0)
+	{
+		/* null */;
+	}
+};
+
+typedef std::map<std::string, netsplit_summary> summary_map_t;
+
+static const time_t	keep_split_secs = 900;
+static const time_t	secs_split_stop = 5;
+
+/*
+ * The timer wheel has a slot per second and must span the longest
+ * timeout
+ */
+static const size_t	WHEEL_SLOTS = 1024;
+
+static uintmax_t	netsplit_serial = 0;
+
+/*
+ * The Netsplit database and its indexes:
+ * split_index  (server pair, channel) -> split
+ * chan_index   channel -> splits
+ * split_ids    id -> split
+ */
+static std::vector<netsplit *> netsplit_db;
+static std::unordered_map<std::string, netsplit *>		split_index;
+static std::unordered_multimap<std::string, netsplit *>	chan_index;
+static std::unordered_map<uintmax_t, netsplit *>		split_ids;
+
+static std::vector<netsplit_timer>	wheel[WHEEL_SLOTS];
+static time_t				wheel_time = g_time_error;
+
+static std::string
+split_key(CSTRING chan, CSTRING serv1, CSTRING serv2)
+{
+	std::string key(isupport_fold_str(serv1));
+
+	key.append(" ").append(isupport_fold_str(serv2));
+	key.append(" ").append(isupport_fold_str(chan));
+	return key;
+}
+
+static void
+schedule(const netsplit *split, const time_t when,
+    const enum netsplit_event event)
+{
+	if (wheel_time == g_time_error)
+		wheel_time = time(nullptr);
+	wheel[static_cast<size_t>(when) % WHEEL_SLOTS].push_back({
+	    split->get_id(), when, event});
+}
+
 netsplit::netsplit() : announced(false)
 {
 	this->channel.assign("");
@@ -46,6 +126,7 @@ netsplit::netsplit() : announced(false)
 	this->server[1].assign("*.split");
 	this->secs[0] = g_time_error;
 	this->secs[1] = g_time_error;
+	this->id = ++netsplit_serial;
 }
 
 netsplit::netsplit(const struct netsplit_context *ctx, CSTRING nick)
@@ -54,111 +135,97 @@ netsplit::netsplit(const struct netsplit_context *ctx, CSTRING nick)
 	this->channel.assign(ctx->chan);
 	this->server[0].assign(ctx->serv1);
 	this->server[1].assign(ctx->serv2);
-#if defined(__cplusplus) && __cplusplus >= 201103L
-	this->nicks.emplace_back(nick);
-#else
-	this->nicks.push_back(nick);
-#endif
 	this->secs[0] = time(nullptr);
 	this->secs[1] = g_time_error;
+	this->id = ++netsplit_serial;
+	this->add_nick(nick);
 }
 
-void
-netsplit::announce_netjoin(void) const
+netsplit::~netsplit()
 {
-	CSTRING			host[2];
-	PRINTTEXT_CONTEXT	ctx;
-	immutable_cp_t		chan = this->channel.c_str();
-	uintmax_t		array[3];
-
-	host[0] = this->server[0].c_str();
-	host[1] = this->server[1].c_str();
-
-	printtext_context_init(&ctx, nullptr, TYPE_SPEC1_SUCCESS, true);
-
-	array[0] = static_cast<uintmax_t>(this->nicks.size());
-	array[1] = static_cast<uintmax_t>(this->rem_nicks.size());
-	array[2] = array[0] + array[1];
-
-	if ((ctx.window = window_by_label(chan)) == nullptr)
-		ctx.window = g_status_window;
-	printtext(&ctx, "%sNetJoin%s %s%s%s %s %s %s %s%ju users returned "
-	    "out of %ju%s",
-	    COLOR3, TXT_NORMAL,
-	    LEFT_BRKT, chan, RIGHT_BRKT,
-	    host[0], THE_SPEC2, host[1],
-	    LEFT_BRKT, array[1], array[2], RIGHT_BRKT);
+	for (CSTRING key : this->nick_keys)
+		strpool_release(key);
 }
 
 void
-netsplit::announce_split(void)
+netsplit::set_join_time(const time_t p_secs)
 {
-	CSTRING			host[2];
-	PRINTTEXT_CONTEXT	ctx;
-	immutable_cp_t		chan = this->channel.c_str();
-	uintmax_t		no_nicks;
-
-	host[0] = this->server[0].c_str();
-	host[1] = this->server[1].c_str();
-
-	printtext_context_init(&ctx, nullptr, TYPE_SPEC1_WARN, true);
+	this->secs[1] = p_secs;
+	schedule(this, p_secs + secs_split_stop, NETSPLIT_NETJOIN);
+}
 
-	no_nicks = static_cast<uintmax_t>(this->nicks.size());
+void
+netsplit::add_nick(CSTRING p_nick)
+{
+	CSTRING key = strpool_intern_key(p_nick);
 
-	if ((ctx.window = window_by_label(chan)) == nullptr)
-		ctx.window = g_status_window;
-	printtext(&ctx, "%sNetSplit%s %s%s%s %s %s %s %s%ju nicks%s",
-	    COLOR3, TXT_NORMAL,
-	    LEFT_BRKT, chan, RIGHT_BRKT,
-	    host[0], THE_SPEC2, host[1],
-	    LEFT_BRKT, no_nicks, RIGHT_BRKT);
-	this->announced = true;
+	if (!this->nick_pos.emplace(key, this->nicks.size()).second) {
+		strpool_release(key);
+		return;
+	}
+#if defined(__cplusplus) && __cplusplus >= 201103L
+	this->nicks.emplace_back(p_nick);
+#else
+	this->nicks.push_back(p_nick);
+#endif
+	this->nick_keys.push_back(key);
 }
 
 bool
-netsplit::find_nick(CSTRING p_nick)
+netsplit::find_nick(CSTRING p_nick) const
 {
-	for (auto it = this->nicks.begin(); it != this->nicks.end(); ++it) {
-		if (strings_match_ignore_case(it->c_str(), p_nick))
-			return true;
-	}
+	CSTRING key = strpool_find_key(p_nick);
 
-	return false;
+	return (key != nullptr &&
+	    this->nick_pos.find(key) != this->nick_pos.end());
 }
 
 bool
 netsplit::remove_nick(CSTRING p_nick)
 {
-	std::vector<std::string>::iterator	it = this->nicks.begin(); // NOLINT
-	std::vector<std::string>::size_type	count = 0;
+	CSTRING key = strpool_find_key(p_nick);
+	const auto it = this->nick_pos.find(key);
 
-	while (it != this->nicks.end()) {
-		if (strings_match_ignore_case(it->c_str(), p_nick)) {
-			// Saved the removed nick
-			const std::string str(it->c_str());
-#if defined(__cplusplus) && __cplusplus >= 201103L
-			this->rem_nicks.emplace_back(str);
-#else
-			this->rem_nicks.push_back(str);
-#endif
+	if (key == nullptr || it == this->nick_pos.end())
+		return false;
 
-			it = this->nicks.erase(it);
-			count++;
-		} else
-			++it;
-	}
+	const size_t pos = it->second;
 
-	if (count > 1) {
-		err_log(0, "%s: count=%ju (%s)", __func__,
-		    static_cast<uintmax_t>(count), p_nick);
+	// Saved the removed nick
+	this->rem_nicks.emplace_back(std::move(this->nicks[pos]));
+	this->nick_pos.erase(it);
+
+	if (pos != this->nicks.size() - 1) {
+		this->nicks[pos] = std::move(this->nicks.back());
+		this->nick_keys[pos] = this->nick_keys.back();
+		this->nick_pos[this->nick_keys[pos]] = pos;
 	}
-	return (count > 0 ? true : false);
+	this->nicks.pop_back();
+	this->nick_keys.pop_back();
+	strpool_release(key);
+	return true;
 }
 
-/*
- * The Netsplit database
- */
-static std::vector<netsplit *> netsplit_db;
+static void
+destroy_split(netsplit *split)
+{
+	const std::string chan(isupport_fold_str(split->channel.c_str()));
+	const auto range = chan_index.equal_range(chan);
+
+	for (auto it = range.first; it != range.second; ++it) {
+		if (it->second == split) {
+			chan_index.erase(it);
+			break;
+		}
+	}
+
+	split_index.erase(split_key(split->channel.c_str(),
+	    split->server[0].c_str(), split->server[1].c_str()));
+	split_ids.erase(split->get_id());
+	netsplit_db.erase(std::find(netsplit_db.begin(), netsplit_db.end(),
+	    split));
+	delete split;
+}
 
 /*
  * Creates a new Netsplit
@@ -167,7 +234,18 @@ int
 netsplit_create(const struct netsplit_context *ctx, CSTRING nick)
 {
 	try {
-		netsplit_db.push_back(new netsplit(ctx, nick));
+		netsplit *split = new netsplit(ctx, nick);
+
+		netsplit_db.push_back(split);
+		split_index.emplace(split_key(ctx->chan, ctx->serv1,
+		    ctx->serv2), split);
+		chan_index.emplace(isupport_fold_str(ctx->chan), split);
+		split_ids.emplace(split->get_id(), split);
+
+		schedule(split, split->get_split_time() + secs_split_stop,
+		    NETSPLIT_ANNOUNCE);
+		schedule(split, split->get_split_time() + keep_split_secs + 1,
+		    NETSPLIT_EXPIRE);
 	} catch (const std::bad_alloc &e) {
 		err_exit(ENOMEM, "%s: fatal: %s", __func__, e.what());
 	} catch (...) {
@@ -188,22 +266,26 @@ netsplit_db_empty(void)
 void
 netsplit_destroy_all(void)
 {
-	if (netsplit_db.empty())
-		return;
 	for (auto it = netsplit_db.begin(); it != netsplit_db.end(); ++it)
 		delete *it;
 	netsplit_db.clear();
+	split_index.clear();
+	chan_index.clear();
+	split_ids.clear();
+
+	for (std::vector<netsplit_timer> &slot : wheel)
+		slot.clear();
+	wheel_time = g_time_error;
 }
 
 netsplit *
 netsplit_find(CSTRING nick, CSTRING channel)
 {
-	for (auto it = netsplit_db.begin(); it != netsplit_db.end(); ++it) {
-		immutable_cp_t db_chan = (*it)->channel.c_str();
+	const auto range = chan_index.equal_range(isupport_fold_str(channel));
 
-		if (strings_match_ignore_case(db_chan, channel) &&
-		    (*it)->find_nick(nick))
-			return (*it);
+	for (auto it = range.first; it != range.second; ++it) {
+		if (it->second->find_nick(nick))
+			return (it->second);
 	}
 
 	return nullptr;
@@ -218,20 +300,115 @@ netsplit_get_db(void)
 netsplit *
 netsplit_get_split(const struct netsplit_context *ctx)
 {
-	for (auto it = netsplit_db.begin(); it != netsplit_db.end(); ++it) {
-		CSTRING		db_chan = (*it)->channel.c_str();
-		CSTRING		serv1, serv2;
+	const auto it = split_index.find(split_key(ctx->chan, ctx->serv1,
+	    ctx->serv2));
+
+	return (it != split_index.end() ? it->second : nullptr);
+}
+
+static netsplit_summary &
+get_summary(summary_map_t &summaries, const netsplit *split)
+{
+	netsplit_summary &summary = summaries[split_key("",
+	    split->server[0].c_str(), split->server[1].c_str())];
+
+	if (summary.channels.empty()) {
+		summary.serv1.assign(split->server[0]);
+		summary.serv2.assign(split->server[1]);
+	}
+	summary.channels.emplace_back(split->channel);
+	return summary;
+}
 
-		serv1 = (*it)->server[0].c_str();
-		serv2 = (*it)->server[1].c_str();
+static std::string
+get_channel_list(const std::vector<std::string> &channels)
+{
+	static const size_t	max_listed = 5;
+	std::string		list;
 
-		if (strings_match_ignore_case(db_chan, ctx->chan) &&
-		    strings_match_ignore_case(serv1, ctx->serv1) &&
-		    strings_match_ignore_case(serv2, ctx->serv2))
-			return (*it);
+	for (size_t i = 0; i < channels.size() && i < max_listed; i++) {
+		if (i > 0)
+			list.append(" ");
+		list.append(channels[i]);
 	}
+	if (channels.size() > max_listed) {
+		list.append(" (+").append(std::to_string(channels.size() -
+		    max_listed)).append(" more)");
+	}
+	return list;
+}
 
-	return nullptr;
+/*
+ * Prints a summary in the channel window if it's about a single
+ * channel. Otherwise it's printed in the status window, and also in
+ * the active window if that's one of the channels.
+ */
+static void
+print_summary(const netsplit_summary &summary,
+    const enum message_specifier_type spec_type, CSTRING msg)
+{
+	PIRC_WINDOW		window;
+	PRINTTEXT_CONTEXT	ctx;
+
+	printtext_context_init(&ctx, g_status_window, spec_type, true);
+
+	if (summary.channels.size() == 1 &&
+	    (window = window_by_label(summary.channels[0].c_str())) !=
+	    nullptr) {
+		ctx.window = window;
+		printtext(&ctx, "%s", msg);
+		return;
+	}
+
+	printtext(&ctx, "%s", msg);
+
+	if ((window = g_active_window) == nullptr || window == g_status_window)
+		return;
+	for (const std::string &chan : summary.channels) {
+		if (strings_match_ignore_case(chan.c_str(), window->label)) {
+			ctx.window = window;
+			printtext(&ctx, "%s", msg);
+			break;
+		}
+	}
+}
+
+static void
+announce_splits(const summary_map_t &summaries)
+{
+	for (const auto &pair : summaries) {
+		const netsplit_summary	&summary = pair.second;
+		STRING			 msg;
+
+		msg = strdup_printf("%sNetSplit%s %s %s %s %s%ju nicks in %ju "
+		    "channels: %s%s",
+		    COLOR3, TXT_NORMAL,
+		    summary.serv1.c_str(), THE_SPEC2, summary.serv2.c_str(),
+		    LEFT_BRKT, summary.nicks,
+		    static_cast<uintmax_t>(summary.channels.size()),
+		    get_channel_list(summary.channels).c_str(), RIGHT_BRKT);
+		print_summary(summary, TYPE_SPEC1_WARN, msg);
+		free(msg);
+	}
+}
+
+static void
+announce_netjoins(const summary_map_t &summaries)
+{
+	for (const auto &pair : summaries) {
+		const netsplit_summary	&summary = pair.second;
+		STRING			 msg;
+
+		msg = strdup_printf("%sNetJoin%s %s %s %s %s%ju users returned "
+		    "out of %ju in %ju channels: %s%s",
+		    COLOR3, TXT_NORMAL,
+		    summary.serv1.c_str(), THE_SPEC2, summary.serv2.c_str(),
+		    LEFT_BRKT, summary.nicks, summary.total,
+		    static_cast<uintmax_t>(summary.channels.size()),
+		    get_channel_list(summary.channels).c_str(), RIGHT_BRKT);
+		print_summary(summary, TYPE_SPEC1_SUCCESS, msg);
+		free(msg);
+	}
 }
 
 static STRING
@@ -248,83 +425,133 @@ get_removal_msg(const struct netsplit_context *ctx, const intmax_t (&array)[2])
 	return (msg);
 }
 
+static void
+announce_removals(const summary_map_t &summaries)
+{
+	PRINTTEXT_CONTEXT ptext_ctx;
+
+	printtext_context_init(&ptext_ctx, g_status_window, TYPE_SPEC1_WARN,
+	    true);
+
+	for (const auto &pair : summaries) {
+		const netsplit_summary	&summary = pair.second;
+		const std::string	 chans =
+		    get_channel_list(summary.channels);
+		intmax_t		 array[2];
+		STRING			 msg;
+		struct netsplit_context	 ns_ctx(chans.c_str(),
+		    summary.serv1.c_str(), summary.serv2.c_str());
+
+		array[0] = static_cast<intmax_t>(keep_split_secs);
+		array[1] = static_cast<intmax_t>(summary.elapsed);
+
+		msg = get_removal_msg(&ns_ctx, array);
+		printtext(&ptext_ctx, "%s", msg);
+		free(msg);
+	}
+}
+
+/*
+ * Moves the timers that are due out of the wheel
+ */
+static void
+advance_wheel(const time_t now, std::vector<netsplit_timer> &due)
+{
+	time_t t = wheel_time + 1;
+
+	if (now - wheel_time >= static_cast<time_t>(WHEEL_SLOTS))
+		t = now - static_cast<time_t>(WHEEL_SLOTS) + 1;
+
+	for (; t <= now; t++) {
+		std::vector<netsplit_timer> &slot =
+		    wheel[static_cast<size_t>(t) % WHEEL_SLOTS];
+
+		for (size_t i = 0; i < slot.size();) {
+			if (slot[i].when <= now) {
+				due.push_back(slot[i]);
+				slot[i] = slot.back();
+				slot.pop_back();
+			} else {
+				i++;
+			}
+		}
+	}
+
+	wheel_time = now;
+}
+
 void
 netsplit_run_bkgd_task(void)
 {
-	PRINTTEXT_CONTEXT			ptext_ctx;
-	static const time_t			keep_split_secs = 900;
-	static const time_t			secs_split_stop = 5;
-	std::vector<netsplit *>::iterator	it;
+	std::vector<netsplit *>		expired;
+	std::vector<netsplit_timer>	due;
+	summary_map_t			netjoins, removals, splits;
 
-	if (netsplit_db.empty())
+	if (netsplit_db.empty() || wheel_time == g_time_error)
 		return;
 
-	printtext_context_init(&ptext_ctx, g_status_window, TYPE_SPEC1_FAILURE,
-	    true);
 	const time_t now = time(nullptr);
-	it = netsplit_db.begin();
-
-	while (it != netsplit_db.end()) {
-		immutable_cp_t	chan = (*it)->channel.c_str();
-		time_t		diff;
-
-		if (!(*it)->join_begun()) {
-			if ((*it)->get_split_time() > now) {
-				printtext(&ptext_ctx, "%s: %s: unexpected "
-				    "split time (too large)", __func__, chan);
-				delete *it;
-				it = netsplit_db.erase(it);
-				continue;
-			}
 
-			diff = now - (*it)->get_split_time();
-
-			if (diff > keep_split_secs) {
-				intmax_t			array[2];
-				STRING				msg;
-				struct netsplit_context		ns_ctx(chan,
-				    (*it)->server[0].c_str(),
-				    (*it)->server[1].c_str());
-
-				array[0] = static_cast<intmax_t>(keep_split_secs);
-				array[1] = static_cast<intmax_t>(diff);
-
-				msg = get_removal_msg(&ns_ctx, array);
-
-				ptext_ctx.spec_type = TYPE_SPEC1_WARN;
-				printtext(&ptext_ctx, "%s", msg);
-				free(msg);
-
-				delete *it;
-				it = netsplit_db.erase(it);
-				continue;
-			} else if (diff >= secs_split_stop &&
-				   !(*it)->has_announced_split())
-				(*it)->announce_split();
-			++it;
-		} else {
-			/*
-			 * join begun...
-			 */
-			if ((*it)->get_join_time() > now) {
-				printtext(&ptext_ctx, "%s: %s: unexpected "
-				    "join time (too large)", __func__, chan);
-				delete *it;
-				it = netsplit_db.erase(it);
-				continue;
-			}
+	if (now <= wheel_time) {
+		/* the clock was set back */
+		wheel_time = now;
+		return;
+	}
+
+	advance_wheel(now, due);
+	std::sort(due.begin(), due.end(),
+	    [](const netsplit_timer &t1, const netsplit_timer &t2) {
+		return (t1.when < t2.when);
+	    });
 
-			diff = now - (*it)->get_join_time();
+	for (const netsplit_timer &timer : due) {
+		const auto it = split_ids.find(timer.id);
 
-			if (diff >= secs_split_stop) {
-				(*it)->announce_netjoin();
-				delete *it;
-				it = netsplit_db.erase(it);
-				continue;
-			} else
-				++it;
+		if (it == split_ids.end())
+			continue;
+
+		netsplit *split = it->second;
+
+		switch (timer.event) {
+		case NETSPLIT_ANNOUNCE:
+			if (!split->join_begun() &&
+			    !split->has_announced_split()) {
+				get_summary(splits, split).nicks +=
+				    split->nicks.size();
+				split->set_announced();
+			}
+			break;
+		case NETSPLIT_EXPIRE:
+			if (!split->join_begun()) {
+				netsplit_summary &summary =
+				    get_summary(removals, split);
+
+				summary.elapsed = std::max(summary.elapsed,
+				    now - split->get_split_time());
+				split_ids.erase(it);
+				expired.push_back(split);
+			}
+			break;
+		case NETSPLIT_NETJOIN: {
+			netsplit_summary &summary =
+			    get_summary(netjoins, split);
+
+			summary.nicks += split->rem_nicks.size();
+			summary.total += split->rem_nicks.size() +
+			    split->nicks.size();
+			split_ids.erase(it);
+			expired.push_back(split);
+			break;
+		}
 		}
 	}
+
+	announce_splits(splits);
+	announce_netjoins(netjoins);
+	announce_removals(removals);
+
+	for (netsplit *split : expired)
+		destroy_split(split);
 }
 
 /* ----------------------------------------------------------------- */
@@ -32,6 +32,7 @@
 #include <time.h>
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "libUtils.h"
@@ -66,6 +67,10 @@ public:
 
 	netsplit();
 	netsplit(const struct netsplit_context *, CSTRING);
+	~netsplit();
+
+	netsplit(const netsplit &) = delete;
+	netsplit &operator=(const netsplit &) = delete;
 
 	time_t
 	get_split_time(void) const
@@ -83,17 +88,18 @@ public:
 	{
 		return (this->secs[1]);
 	}
-	void
-	set_join_time(const time_t p_secs)
-	{
-		this->secs[1] = p_secs;
-	}
+	void	set_join_time(const time_t);
 
 	bool
 	has_announced_split(void) const
 	{
 		return (this->announced);
 	}
+	void
+	set_announced(void)
+	{
+		this->announced = true;
+	}
 
 	bool
 	join_begun(void) const
@@ -101,14 +107,24 @@ public:
 		return (this->secs[1] != g_time_error);
 	}
 
-	void	announce_netjoin(void) const;
-	void	announce_split(void);
-	bool	find_nick(CSTRING);
+	uintmax_t
+	get_id(void) const
+	{
+		return (this->id);
+	}
+
+	void	add_nick(CSTRING);
+	bool	find_nick(CSTRING) const;
 	bool	remove_nick(CSTRING);
 
 private:
 	/*
-	 * True if announce_split() has been called.
+	 * Identifies the split to its timers, which outlive it.
+	 */
+	uintmax_t	id;
+
+	/*
+	 * True if the split has been announced.
 	 */
 	bool	announced;
 
@@ -118,6 +134,13 @@ private:
 	 *          returned. (not updated, only set once)
 	 */
 	time_t	secs[2];
+
+	/*
+	 * Interned key of a nick (see strpool.h) -> position in 'nicks',
+	 * and the keys in the order of 'nicks'
+	 */
+	std::unordered_map<const char *, size_t>	nick_pos;
+	std::vector<const char *>			nick_keys;
 };
 
 //lint -sem(netsplit_find, r_null)
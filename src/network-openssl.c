@@ -26,15 +26,19 @@
 #include <openssl/ssl.h>
 #include <openssl/x509.h>
 #include <openssl/x509_vfy.h>
+#include <openssl/x509v3.h> /* a2i_IPADDRESS() */
 
 #include <limits.h>
 
 #include "assertAPI.h"
+#include "base64.h"
 #include "config.h"
+#include "crypt.h"
 #include "dataClassify.h"
 #include "errHand.h"
 #include "filePred.h"
 #include "libUtils.h"
+#include "log.h" /* g_open_flags, g_open_modes */
 #include "main.h"
 #include "nestHome.h"
 #include "network.h"
@@ -55,15 +59,412 @@ static SSL_CTX *ssl_ctx = NULL;
 static SSL *ssl = NULL;
 
 static volatile bool ssl_object_is_null = true;
+static volatile bool ssl_session_reused = false;
 
 #if defined(UNIX)
 static pthread_once_t	init_done = PTHREAD_ONCE_INIT;
 static pthread_mutex_t	ssl_obj_mtx;
+static pthread_mutex_t	sess_cache_mtx;
 #elif defined(WIN32)
 static init_once_t	init_done = ONCE_INITIALIZER;
 static HANDLE		ssl_obj_mtx;
+static HANDLE		sess_cache_mtx;
 #endif
 
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+#define SESS_CACHE 1
+#endif
+
+/*
+ * Client-side session cache. Holds the last session per (host, port,
+ * SNI) so that a reconnect can be resumed instead of paying for a
+ * full handshake. The sessions may optionally be kept on disk,
+ * encrypted with a random key, between runs.
+ */
+#define SESS_CACHE_SIZE		16
+#define SESS_CACHE_FILE		"tls_sessions"
+#define SESS_CACHE_KEYFILE	"tls_sessions.key"
+#define SESS_CACHE_KEYLEN	32
+#define SESS_CACHE_LINE_MAX	16384
+#define SESS_CACHE_KEY_MAX	(sizeof g_last_server * 2 + sizeof g_last_port)
+
+struct sess_cache_entry {
+	char		 key[SESS_CACHE_KEY_MAX];
+	SSL_SESSION	*sess;
+	time_t		 stored;
+};
+
+static struct sess_cache_entry	sess_cache[SESS_CACHE_SIZE];
+static char			sess_cache_curkey[SESS_CACHE_KEY_MAX];
+
+static bool
+is_ip_literal(CSTRING host)
+{
+	ASN1_OCTET_STRING *ip;
+
+	if ((ip = a2i_IPADDRESS(host)) == NULL)
+		return false;
+	ASN1_OCTET_STRING_free(ip);
+	return true;
+}
+
+#ifdef SESS_CACHE
+static bool
+sess_is_usable(SSL_SESSION *sess)
+{
+	const long int expires = SSL_SESSION_get_time(sess) +
+	    SSL_SESSION_get_timeout(sess);
+
+	return (SSL_SESSION_is_resumable(sess) && expires > time(NULL));
+}
+
+static struct sess_cache_entry *
+sess_cache_lookup(CSTRING key)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(sess_cache); i++) {
+		if (sess_cache[i].sess != NULL &&
+		    strings_match(sess_cache[i].key, key))
+			return addrof(sess_cache[i]);
+	}
+
+	return NULL;
+}
+
+/*
+ * Takes ownership of 'sess'. If there's no entry for 'key' the oldest
+ * one is replaced. Call with the cache locked.
+ */
+static void
+sess_cache_store(CSTRING key, SSL_SESSION *sess, time_t stored)
+{
+	struct sess_cache_entry *entry;
+
+	if ((entry = sess_cache_lookup(key)) == NULL) {
+		entry = addrof(sess_cache[0]);
+
+		for (size_t i = 0; i < ARRAY_SIZE(sess_cache); i++) {
+			if (sess_cache[i].sess == NULL) {
+				entry = addrof(sess_cache[i]);
+				break;
+			} else if (sess_cache[i].stored < entry->stored) {
+				entry = addrof(sess_cache[i]);
+			}
+		}
+	}
+
+	if (entry->sess)
+		SSL_SESSION_free(entry->sess);
+	(void) snprintf(entry->key, sizeof entry->key, "%s", key);
+	entry->sess = sess;
+	entry->stored = stored;
+}
+
+static int
+new_session_cb(SSL *obj, SSL_SESSION *sess)
+{
+	int ret = 0;
+
+	UNUSED_PARAM(obj);
+
+	if (!SSL_SESSION_is_resumable(sess))
+		return 0;
+
+	mutex_lock(&sess_cache_mtx);
+	if (!strings_match(sess_cache_curkey, "")) {
+		sess_cache_store(sess_cache_curkey, sess, time(NULL));
+		ret = 1;
+	}
+	mutex_unlock(&sess_cache_mtx);
+	return ret;
+}
+
+/*
+ * Returns a session to resume, or NULL. A TLS 1.3 ticket is only used
+ * once (the server hands out new ones) and thus leaves the cache.
+ */
+static SSL_SESSION *
+sess_cache_get(CSTRING key)
+{
+	SSL_SESSION		*sess = NULL;
+	struct sess_cache_entry	*entry;
+
+	mutex_lock(&sess_cache_mtx);
+
+	if ((entry = sess_cache_lookup(key)) == NULL) {
+		/* null */;
+	} else if (!sess_is_usable(entry->sess)) {
+		SSL_SESSION_free(entry->sess);
+		entry->sess = NULL;
+	} else if (SSL_SESSION_get_protocol_version(entry->sess) >=
+	    TLS1_3_VERSION) {
+		sess = entry->sess;
+		entry->sess = NULL;
+	} else if (SSL_SESSION_up_ref(entry->sess)) {
+		sess = entry->sess;
+	}
+
+	mutex_unlock(&sess_cache_mtx);
+	return sess;
+}
+
+static void
+sess_cache_clear(void)
+{
+	mutex_lock(&sess_cache_mtx);
+
+	for (size_t i = 0; i < ARRAY_SIZE(sess_cache); i++) {
+		if (sess_cache[i].sess)
+			SSL_SESSION_free(sess_cache[i].sess);
+		sess_cache[i].sess = NULL;
+	}
+
+	BZERO(sess_cache_curkey, sizeof sess_cache_curkey);
+	mutex_unlock(&sess_cache_mtx);
+}
+
+static STRING
+sess_cache_path(CSTRING name)
+{
+	return strdup_printf("%s%s%s", g_home_dir, SLASH, name);
+}
+
+static FILE *
+open_private(CSTRING path)
+{
+	FILE	*fp;
+	int	 fd;
+
+#if defined(UNIX)
+	if ((fd = open(path, g_open_flags[OPFL_WRITE], g_open_modes)) < 0)
+		return NULL;
+#elif defined(WIN32)
+	if ((errno = _sopen_s(&fd, path, g_open_flags[OPFL_WRITE], _SH_DENYWR,
+	    g_open_modes)) != 0)
+		return NULL;
+#endif
+	if ((fp = fdopen(fd, "w")) == NULL)
+		(void) close(fd);
+	return fp;
+}
+
+/*
+ * Reads the key that the sessions on disk are encrypted with. If
+ * 'create' is true, and there's no usable key, a random one is made.
+ */
+static bool
+sess_cache_password(char *pass, size_t size, bool create)
+{
+	FILE		*fp;
+	STRING		 path = sess_cache_path(SESS_CACHE_KEYFILE);
+	bool		 ok = false;
+	unsigned char	 raw[SESS_CACHE_KEYLEN];
+
+	if (size < sizeof raw * 2 + 1) {
+		free(path);
+		return false;
+	}
+
+	if ((fp = xfopen(path, "r")) != NULL) {
+		ok = (fgets(pass, (int) size, fp) != NULL);
+		(void) fclose(fp);
+		pass[strcspn(pass, "\r\n")] = '\0';
+		ok = (ok && strlen(pass) == sizeof raw * 2);
+	}
+
+	if (!ok && create && RAND_bytes(raw, sizeof raw) == 1 &&
+	    (fp = open_private(path)) != NULL) {
+		for (size_t i = 0; i < sizeof raw; i++) {
+			(void) snprintf(&pass[i * 2], size - i * 2, "%02x",
+			    raw[i]);
+		}
+
+		ok = (fprintf(fp, "%s\n", pass) > 0);
+		ok = (fclose(fp) == 0 && ok);
+		OPENSSL_cleanse(raw, sizeof raw);
+	}
+
+	free(path);
+	return ok;
+}
+
+/*
+ * A record is: <host> <port> <sni> <time stored> <DER in base64>
+ */
+static void
+sess_cache_add_record(STRING rec)
+{
+	SSL_SESSION		*sess;
+	char			*b64, *stored;
+	const unsigned char	*p;
+	int			 len, size;
+	unsigned char		*der;
+
+	if ((b64 = strrchr(rec, ' ')) == NULL)
+		return;
+	*b64++ = '\0';
+	if ((stored = strrchr(rec, ' ')) == NULL)
+		return;
+	*stored++ = '\0';
+	if ((size = crypt_get_base64_decode_length(b64)) <= 0)
+		return;
+
+	der = xmalloc(size);
+
+	if ((len = b64_decode(b64, der, (size_t) size)) > 0) {
+		p = der;
+
+		if ((sess = d2i_SSL_SESSION(NULL, &p, len)) == NULL) {
+			/* null */;
+		} else if (!sess_is_usable(sess)) {
+			SSL_SESSION_free(sess);
+		} else {
+			sess_cache_store(rec, sess,
+			    (time_t) strtol(stored, NULL, 10));
+		}
+	}
+
+	crypt_freezero(der, (size_t) size);
+}
+
+static void
+sess_cache_load(void)
+{
+	FILE	*fp;
+	STRING	 line, path, plain;
+	char	 pass[SESS_CACHE_KEYLEN * 2 + 1] = { '\0' };
+
+	if (g_home_dir == NULL || !config_bool("ssl_sessions_to_disk", false))
+		return;
+
+	path = sess_cache_path(SESS_CACHE_FILE);
+
+	if ((fp = xfopen(path, "r")) == NULL) {
+		free(path);
+		return;
+	} else if (!sess_cache_password(pass, sizeof pass, false)) {
+		(void) fclose(fp);
+		free(path);
+		return;
+	}
+
+	line = xmalloc(SESS_CACHE_LINE_MAX);
+	mutex_lock(&sess_cache_mtx);
+
+	while (fgets(line, SESS_CACHE_LINE_MAX, fp) != NULL) {
+		line[strcspn(line, "\r\n")] = '\0';
+
+		if ((plain = crypt_decrypt_str(line, (cryptstr_const_t)
+		    addrof(pass[0]), false)) == NULL)
+			continue;
+		sess_cache_add_record(plain);
+		crypt_freezero(plain, strlen(plain));
+	}
+
+	mutex_unlock(&sess_cache_mtx);
+	(void) fclose(fp);
+	free(line);
+	free(path);
+	OPENSSL_cleanse(pass, sizeof pass);
+}
+
+static void
+sess_cache_write(FILE *fp, CSTRING pass, const struct sess_cache_entry *entry)
+{
+	STRING		 b64, enc, rec;
+	int		 len;
+	uint32_t	 size;
+	unsigned char	*der = NULL;
+
+	if ((len = i2d_SSL_SESSION(entry->sess, &der)) <= 0)
+		return;
+
+	size = crypt_get_base64_encode_length((uint32_t) len);
+	b64 = xmalloc(size);
+
+	if (b64_encode(der, (size_t) len, b64, size) != -1) {
+		rec = strdup_printf("%s %ld %s", entry->key,
+		    (long int) entry->stored, b64);
+
+		if ((enc = crypt_encrypt_str((cryptstr_const_t) rec,
+		    (cryptstr_const_t) pass, false)) != NULL) {
+			(void) fprintf(fp, "%s\n", enc);
+			free(enc);
+		}
+
+		crypt_freezero(rec, strlen(rec));
+	}
+
+	crypt_freezero(b64, size);
+	OPENSSL_clear_free(der, (size_t) len);
+}
+
+static void
+sess_cache_save(void)
+{
+	FILE	*fp;
+	STRING	 path;
+	char	 pass[SESS_CACHE_KEYLEN * 2 + 1] = { '\0' };
+
+	if (g_home_dir == NULL || !config_bool("ssl_sessions_to_disk", false))
+		return;
+	if (!sess_cache_password(pass, sizeof pass, true)) {
+		err_log(0, "%s: unable to get a key", __func__);
+		return;
+	}
+
+	path = sess_cache_path(SESS_CACHE_FILE);
+
+	if ((fp = open_private(path)) == NULL) {
+		err_log(errno, "%s: %s", __func__, path);
+	} else {
+		mutex_lock(&sess_cache_mtx);
+
+		for (size_t i = 0; i < ARRAY_SIZE(sess_cache); i++) {
+			if (sess_cache[i].sess != NULL &&
+			    sess_is_usable(sess_cache[i].sess))
+				sess_cache_write(fp, pass, &sess_cache[i]);
+		}
+
+		mutex_unlock(&sess_cache_mtx);
+		(void) fclose(fp);
+	}
+
+	free(path);
+	OPENSSL_cleanse(pass, sizeof pass);
+}
+#endif /* SESS_CACHE */
+
+/*
+ * Sets the server name and, if there's a cached session for the
+ * server, offers it for resumption.
+ */
+static void
+set_sni_and_session(void)
+{
+	const bool is_ip = is_ip_literal(g_last_server);
+
+	if (!is_ip && !strings_match(g_last_server, "") &&
+	    !SSL_set_tlsext_host_name(ssl, g_last_server))
+		debug("%s: unable to set the server name", __func__);
+
+#ifdef SESS_CACHE
+	SSL_SESSION *sess;
+
+	mutex_lock(&sess_cache_mtx);
+	(void) snprintf(sess_cache_curkey, sizeof sess_cache_curkey,
+	    "%s %s %s", g_last_server, g_last_port, (is_ip ? "-" :
+	    g_last_server));
+	sess = sess_cache_get(sess_cache_curkey);
+	mutex_unlock(&sess_cache_mtx);
+
+	if (sess != NULL) {
+		if (!SSL_set_session(ssl, sess))
+			debug("%s: unable to set the session", __func__);
+		SSL_SESSION_free(sess);
+	}
+#endif
+}
+
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L
 static void
 create_ssl_context_obj(void)
@@ -85,6 +486,17 @@ create_ssl_context_obj(void)
 		err_log(0, "%s: error setting minimum supported "
 		    "protocol version", __func__);
 	}
+
+#ifdef SESS_CACHE
+	/*
+	 * TLS 1.3 hands out its tickets after the handshake, so the
+	 * sessions are picked up by a callback rather than being
+	 * fetched when connected.
+	 */
+	(void) SSL_CTX_set_session_cache_mode(ssl_ctx, SSL_SESS_CACHE_CLIENT |
+	    SSL_SESS_CACHE_NO_INTERNAL_STORE);
+	SSL_CTX_sess_set_new_cb(ssl_ctx, new_session_cb);
+#endif
 }
 #else
 /* -------------------------------- */
@@ -162,6 +574,7 @@ static void
 ssl_obj_mtx_init(void)
 {
 	mutex_new(&ssl_obj_mtx);
+	mutex_new(&sess_cache_mtx);
 }
 
 static int
@@ -223,6 +636,7 @@ net_ssl_begin(void)
 	}
 
 	SSL_set_connect_state(ssl);
+	set_sni_and_session();
 	ERR_clear_error();
 
 	if (SSL_connect(ssl) != VALUE_HANDSHAKE_OK) {
@@ -230,6 +644,12 @@ net_ssl_begin(void)
 		goto err;
 	}
 
+	(void) atomic_swap_bool(&ssl_session_reused, SSL_session_reused(ssl));
+	printtext_context_init(&ptext_ctx, g_status_window, TYPE_SPEC1_SUCCESS,
+	    true);
+	printtext(&ptext_ctx, "%s (%s)", (atomic_load_bool(&ssl_session_reused)
+	    ? "TLS session resumed" : "TLS handshake complete"),
+	    SSL_get_version(ssl));
 	return 0;
 
   err:
@@ -269,6 +689,7 @@ net_ssl_end(void)
 		}
 	}
 	(void) atomic_swap_bool(&ssl_object_is_null, true);
+	(void) atomic_swap_bool(&ssl_session_reused, false);
 	SSL_free(ssl);
 	ssl = NULL;
 	mutex_unlock(&ssl_obj_mtx);
@@ -294,6 +715,16 @@ net_ssl_check_hostname(CSTRING host, unsigned int flags)
 	return ret;
 }
 
+/*
+ * Whether the current connection resumed a cached session, whose
+ * certificate was verified when it was established
+ */
+bool
+net_ssl_session_reused(void)
+{
+	return atomic_load_bool(&ssl_session_reused);
+}
+
 SSL *
 net_ssl_getobj(void)
 {
@@ -533,6 +964,10 @@ net_ssl_init(void)
 	if ((errno = init_once(&init_done, ssl_obj_mtx_init)) != 0)
 		err_sys("%s: init_once", __func__);
 #endif
+
+#ifdef SESS_CACHE
+	sess_cache_load();
+#endif
 }
 
 void
@@ -540,6 +975,11 @@ net_ssl_deinit(void)
 {
 	net_ssl_end();
 
+#ifdef SESS_CACHE
+	sess_cache_save();
+	sess_cache_clear();
+#endif
+
 	if (ssl_ctx) {
 		SSL_CTX_free(ssl_ctx);
 		ssl_ctx = NULL;
@@ -37,23 +37,31 @@
 #include <unistd.h> /* close() */
 #endif
 
+#include <atomic>
+#include <chrono>
 #include <cstring>
 #include <exception>
 #include <stdexcept>
+#include <string>
 
 #include "assertAPI.h"
 #include "config.h"
+#include "connRace.hpp"
 #include "dataClassify.h"
 #include "errHand.h"
 #include "i18n.h"
 #include "icb.h"
 #include "identd.hpp"
 #include "irc.h"
+#include "isupport.h"
 #include "libUtils.h"
 #include "main.h"
 #include "netsplit.h"
 #include "network.h"
+#include "perf.h"
 #include "printtext.h"
+#include "rejoin.h"
+#include "resolver.h"
 #include "sig.h"
 #include "socks.hpp"
 #include "strHand.h"
@@ -165,6 +173,12 @@ reconn_ctx() noexcept
 
 static const int RECVBUF_SIZE = 2048;
 
+/*
+ * When the TCP connection was made (in ms on the steady clock), for
+ * timing the registration. Negative if there's nothing to time.
+ */
+static std::atomic<long long int> reg_start_ms(-1);
+
 /****************************************************************
 *                                                               *
 *  ---------------------    Functions    ---------------------  *
@@ -190,7 +204,7 @@ check_hostname(CSTRING host, PPRINTTEXT_CONTEXT ctx)
 	if (ssl_is_enabled() && config_bool("hostname_checking", true)) {
 		if (net_ssl_check_hostname(host, 0) != OK)
 			throw std::runtime_error(_("Hostname checking failed!"));
-		else
+		else if (!net_ssl_session_reused())
 			printtext(ctx, "%s", _("Hostname checking OK!"));
 	}
 }
@@ -230,6 +244,13 @@ destroy_null_bytes(STRING recvbuf, const int bytes_received)
 	}
 }
 
+static long long int
+steady_ms()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>
+	    (std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 static void
 connect_hook(void)
 {
@@ -237,7 +258,7 @@ connect_hook(void)
 }
 
 static void
-establish_conn(struct addrinfo *res, PPRINTTEXT_CONTEXT ctx)
+establish_conn(struct addrinfo *res, CSTRING host, PPRINTTEXT_CONTEXT ctx)
 {
 	struct addrinfo *bind_res = nullptr;
 
@@ -257,52 +278,41 @@ establish_conn(struct addrinfo *res, PPRINTTEXT_CONTEXT ctx)
 		hints.ai_canonname = nullptr;
 		hints.ai_next      = nullptr;
 
-		if ((gai_ret = getaddrinfo(g_cmdline_opts->hostname, nullptr,
-		    &hints, &bind_res)) != 0) {
-			printtext_print("err", "%s: getaddrinfo: %s: %s",
+		if ((gai_ret = resolver_lookup(g_cmdline_opts->hostname,
+		    nullptr, &hints, &bind_res)) != 0) {
+			printtext_print("err", "%s: resolver_lookup: %s: %s",
 			    __func__,
 			    g_cmdline_opts->hostname,
-			    gai_strerror(gai_ret));
+			    resolver_strerror(gai_ret));
 			return;
 		}
 	}
-	for (struct addrinfo *rp = res; rp; rp = rp->ai_next) {
-		if ((g_socket = socket(rp->ai_family, rp->ai_socktype,
-		    rp->ai_protocol)) == INVALID_SOCKET)
-			continue;
 
-		net_set_recv_timeout(TEMP_RECV_TIMEOUT);
-		net_set_send_timeout(TEMP_SEND_TIMEOUT);
+	/*
+	 * Race the addresses (RFC 8305) instead of waiting for each
+	 * connect() in turn
+	 */
+	conn_race race(host);
 
-		if (bind_res) {
-			errno = 0;
+	g_socket = race.run(res, bind_res, TEMP_SEND_TIMEOUT);
+	race.report(ctx);
 
-			if (bind(g_socket, bind_res->ai_addr,
-			    bind_res->ai_addrlen) != 0) {
-				char strerrbuf[MAXERROR] = { '\0' };
-
-				printtext_print("err", "bind() error: %s",
-				    xstrerror(errno, strerrbuf, MAXERROR));
-				CLOSE_GLOBAL_SOCKET();
-				g_socket = INVALID_SOCKET;
-				break;
-			}
-		}
-		if (connect(g_socket, rp->ai_addr, rp->ai_addrlen) == 0) {
-			printtext(ctx, "%s", _("Connected!"));
+	if (g_socket != INVALID_SOCKET) {
+		printtext(ctx, "%s", _("Connected!"));
 
-			atomic_swap_bool(&g_on_air, true);
+		atomic_swap_bool(&g_on_air, true);
+		reg_start_ms.store(steady_ms());
 
-			net_set_recv_timeout(DEFAULT_RECV_TIMEOUT);
-			net_set_send_timeout(DEFAULT_SEND_TIMEOUT);
-			break;
-		} else {
-			CLOSE_GLOBAL_SOCKET();
-			g_socket = INVALID_SOCKET;
-		}
-	} /* for */
+		net_set_recv_timeout(DEFAULT_RECV_TIMEOUT);
+		net_set_send_timeout(DEFAULT_SEND_TIMEOUT);
+	} else {
+		/*
+		 * The cached addresses may be stale
+		 */
+		resolver_forget(host);
+	}
 	if (bind_res)
-		freeaddrinfo(bind_res);
+		resolver_freeaddrinfo(bind_res);
 }
 
 static int
@@ -478,73 +488,30 @@ send_icb_login_packet(const struct network_connect_context *ctx)
 		err_log(ENOTCONN, "%s", __func__);
 }
 
+/*
+ * Writes the opening burst at once, so that it goes out in a single
+ * write (and TLS record). The capabilities are requested when the
+ * server has told which ones it supports, see event_cap().
+ */
 static void
 send_reg_cmds(const struct network_connect_context *ctx)
 {
-	PRINTTEXT_CONTEXT ptext_ctx;
+	std::string burst("");
 
-	if (g_ircv3_extensions)
-		(void) net_send("CAP LS 302");
-
-	if (ctx->password)
-		(void) net_send("PASS %s", ctx->password);
-	(void) net_send("NICK %s", ctx->nickname);
-	(void) net_send("USER %s 8 * :%s", ctx->username, ctx->rl_name);
-
-	if (!g_ircv3_extensions)
-		return;
-	printtext_context_init(&ptext_ctx, g_status_window, TYPE_SPEC1_SUCCESS,
-	    true);
-	if (config_bool("account_notify", true)) {
-		if (net_send("CAP REQ :account-notify") > 0)
-			printtext(&ptext_ctx, "Requesting account notify");
-	}
-	if (config_bool("account_tag", true)) {
-		if (net_send("CAP REQ :account-tag") > 0)
-			printtext(&ptext_ctx, "Requesting account tag");
-	}
-	if (config_bool("away_notify", false)) {
-		if (net_send("CAP REQ :away-notify") > 0)
-			printtext(&ptext_ctx, "Requesting away notify");
+	if (g_ircv3_extensions) {
+		cap_negotiation_begin();
+		(void) burst.append("CAP LS 302\r\n");
 	}
-	if (config_bool("batch", true)) {
-		if (net_send("CAP REQ :batch") > 0)
-			printtext(&ptext_ctx, "Requesting batch");
-	}
-	if (config_bool("chghost", true)) {
-		if (net_send("CAP REQ :chghost") > 0)
-			printtext(&ptext_ctx, "Requesting change host");
-	}
-	if (config_bool("extended_join", true)) {
-		if (net_send("CAP REQ :extended-join") > 0)
-			printtext(&ptext_ctx, "Requesting extended join");
-	}
-	if (config_bool("invite_notify", false)) {
-		if (net_send("CAP REQ :invite-notify") > 0)
-			printtext(&ptext_ctx, "Requesting invite notify");
-	}
-	if (config_bool("multi_prefix", true)) {
-		if (net_send("CAP REQ :multi-prefix") > 0)
-			printtext(&ptext_ctx, "Requesting multi prefix");
-	}
-	if (config_bool("server_time", true)) {
-		if (net_send("CAP REQ :server-time") > 0)
-			printtext(&ptext_ctx, "Requesting server time");
-	}
-	if (sasl_is_enabled()) {
-		if (strings_match(get_sasl_mechanism(), "PLAIN") &&
-		    !ssl_is_enabled()) {
-			ptext_ctx.spec_type = TYPE_SPEC1_WARN;
-			printtext(&ptext_ctx, "SASL mechanism matches PLAIN "
-			    "and TLS/SSL is not enabled. Not requesting SASL "
-			    "authentication.");
-		} else {
-			if (net_send("CAP REQ :sasl") > 0) {
-				printtext(&ptext_ctx, "Requesting SASL "
-				    "authentication");
-			}
-		}
+
+	if (ctx->password) {
+		(void) burst.append("PASS ").append(ctx->password)
+		    .append("\r\n");
 	}
+	(void) burst.append("NICK ").append(ctx->nickname).append("\r\n");
+	(void) burst.append("USER ").append(ctx->username).append(" 8 * :")
+	    .append(ctx->rl_name);
+
+	(void) net_send("%s", burst.c_str());
 }
 
 static bool
@@ -561,6 +528,20 @@ should_check_connection()
 	return false;
 }
 
+/*
+ * Returns the milliseconds from the TCP connect until now, once per
+ * connection, or -1
+ */
+long int
+net_take_reg_time(void)
+{
+	const long long int start = reg_start_ms.exchange(-1);
+
+	if (start < 0)
+		return -1;
+	return static_cast<long int>(steady_ms() - start);
+}
+
 bool
 sasl_is_enabled(void)
 {
@@ -611,10 +592,11 @@ net_connect(const struct network_connect_context *ctx,
 			    &ptext_ctx);
 		}
 
-		establish_conn(res, &ptext_ctx);
+		establish_conn(res, (socks::yesno() ? Config("socks_host") :
+		    ctx->server), &ptext_ctx);
 
 		if (res)
-			freeaddrinfo(res);
+			resolver_freeaddrinfo(res);
 		if (socks::yesno()) {
 			std::string err("");
 
@@ -692,7 +674,7 @@ net_addr_resolve(CSTRING host, CSTRING port)
 	hints.ai_canonname = nullptr;
 	hints.ai_next      = nullptr;
 
-	return (getaddrinfo(host, port, &hints, &res) != 0 ? nullptr : res);
+	return (resolver_lookup(host, port, &hints, &res) != 0 ? nullptr : res);
 }
 
 struct server *
@@ -753,6 +735,8 @@ icb(int &bytes_received, struct network_recv_context *ctx, STRING recvbuf)
 			return ERR;
 		}
 	} else if (bytes_received > 0) {
+		perf_count_bytes(PERF_NET_RECV, bytes_received);
+
 		if (memchr(recvbuf, 0, bytes_received) != nullptr)
 			destroy_null_bytes(recvbuf, bytes_received);
 
@@ -773,6 +757,8 @@ irc(int &bytes_received, struct network_recv_context *ctx, STRING recvbuf,
 	if ((bytes_received = net_recv(ctx, recvbuf, RECVBUF_SIZE)) == -1) {
 		(void) atomic_swap_bool(&g_connection_lost, true);
 	} else if (bytes_received > 0) {
+		perf_count_bytes(PERF_NET_RECV, bytes_received);
+
 		if (memchr(recvbuf, 0, bytes_received) != nullptr)
 			destroy_null_bytes(recvbuf, bytes_received);
 
@@ -794,6 +780,7 @@ net_irc_listen(bool *connection_lost)
 	enum message_concat_state	 state = CONCAT_BUFFER_IS_EMPTY;
 	int				 bytes_received = -1;
 	struct network_recv_context	 ctx(g_socket, 0, 5, 0);
+	const enum casemapping		 cm = isupport_casemapping();
 
 	if (atomic_load_bool(&g_irc_listening))
 		return;
@@ -807,6 +794,10 @@ net_irc_listen(bool *connection_lost)
 	recvbuf[RECVBUF_SIZE] = '\0';
 	irc_init();
 	netsplit_init();
+	rejoin_init();
+	isupport_reset();
+	if (isupport_casemapping() != cm)
+		window_refold_labels();
 
 	do {
 		OPENSSL_cleanse(recvbuf, RECVBUF_SIZE);
@@ -851,6 +842,14 @@ net_irc_listen(bool *connection_lost)
 			err_log(0, "%s: netsplit_run_bkgd_task: %s", __func__,
 			    e.what());
 		}
+
+		try {
+			// Pace rejoining channels
+			rejoin_run_bkgd_task();
+		} catch (const std::exception &e) {
+			err_log(0, "%s: rejoin_run_bkgd_task: %s", __func__,
+			    e.what());
+		}
 	} while (atomic_load_bool(&g_on_air) &&
 		 !atomic_load_bool(&g_connection_lost));
 
@@ -868,6 +867,7 @@ net_irc_listen(bool *connection_lost)
 	}
 	irc_deinit();
 	netsplit_deinit();
+	rejoin_deinit();
 	free_and_null(&recvbuf);
 	free_and_null(&message_concat);
 	printtext(&ptext_ctx, "%s", _("Disconnected"));
@@ -80,6 +80,7 @@ bool		 sasl_is_enabled(void);
 conn_res_t	 net_connect(const struct network_connect_context *,
 		     long int *sleep_time_seconds);
 int		 net_send_fake(CSTRING, ...);
+long int	 net_take_reg_time(void);
 struct addrinfo *net_addr_resolve(CSTRING host, CSTRING port);
 struct server	*server_new(CSTRING host, CSTRING port, CSTRING pass);
 void		 destroy_null_bytes_exported(STRING, const int);
@@ -95,6 +96,7 @@ void	net_set_sock_addr_family_ipv6(void);
 int	 net_ssl_begin(void);
 void	 net_ssl_end(void);
 int	 net_ssl_check_hostname(CSTRING, unsigned int);
+bool	 net_ssl_session_reused(void);
 SSL	*net_ssl_getobj(void);
 int	 net_ssl_send(CSTRING, ...);
 int	 net_ssl_recv(struct network_recv_context *, STRING, int);
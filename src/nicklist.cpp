@@ -29,15 +29,17 @@
 
 #include "common.h"
 
+#include <algorithm>
 #include <cstring>
-#include <list>
-#include <string>
+#include <vector>
 
 #include "dataClassify.h"
 #include "errHand.h"
+#include "events/names.h"
 #include "irc.h"
 #include "libUtils.h"
 #include "nicklist.h"
+#include "perf.h"
 #include "printtext.h"
 #include "readline.h"
 #include "statusbar.h"
@@ -58,89 +60,41 @@ can_scroll(const IRC_WINDOW *win)
 	return true;
 }
 
-static bool
-cmp_fn(const std::string &nick1, const std::string &nick2)
-{
-	/*
-	 * nick1
-	 */
-	switch (nick1.at(0)) {
-	case '~':
-		if (nick2.at(0) == '&' || nick2.at(0) == '@' ||
-		    nick2.at(0) == '%' || nick2.at(0) == '+' ||
-		    nick2.at(0) == ' ')
-			return true;
-		break;
-	case '&':
-		if (nick2.at(0) == '@' || nick2.at(0) == '%' ||
-		    nick2.at(0) == '+' || nick2.at(0) == ' ')
-			return true;
-		break;
-	case '@':
-		if (nick2.at(0) == '%' || nick2.at(0) == '+' ||
-		    nick2.at(0) == ' ')
-			return true;
-		break;
-	case '%':
-		if (nick2.at(0) == '+' || nick2.at(0) == ' ')
-			return true;
-		break;
-	case '+':
-		if (nick2.at(0) == ' ')
-			return true;
-		break;
-	case ' ':
-	default:
-		/* empty */
-		break;
-	}
-
-	/*
-	 * nick2
-	 */
-	switch (nick2.at(0)) {
-	case '~':
-		if (nick1.at(0) == '&' || nick1.at(0) == '@' ||
-		    nick1.at(0) == '%' || nick1.at(0) == '+' ||
-		    nick1.at(0) == ' ')
-			return false;
-		break;
-	case '&':
-		if (nick1.at(0) == '@' || nick1.at(0) == '%' ||
-		    nick1.at(0) == '+' || nick1.at(0) == ' ')
-			return false;
-		break;
-	case '@':
-		if (nick1.at(0) == '%' || nick1.at(0) == '+' ||
-		    nick1.at(0) == ' ')
-			return false;
-		break;
-	case '%':
-		if (nick1.at(0) == '+' || nick1.at(0) == ' ')
-			return false;
-		break;
-	case '+':
-		if (nick1.at(0) == ' ')
-			return false;
-		break;
-	case ' ':
-	default:
-		/* empty */
-		break;
+/*
+ * A row of the nicklist: the prefix and the nickname, followed by the
+ * key of the nickname. Copied from the member records so that the
+ * list can be sorted and drawn without holding 'g_win_htbl_mtx'.
+ */
+struct nicklist_row {
+	unsigned char	rank;
+	unsigned char	len;
+	char		text[2 * (NAMES_NICK_MAX + 1) + 1];
+
+	explicit nicklist_row(const NAMES *names)
+	    : rank(static_cast<unsigned char>(event_names_rank(names->privs)))
+	    , len(names->len)
+	{
+		this->text[0] = names->prefix;
+		memcpy(&this->text[1], names->nick, 2 * (names->len + 1));
 	}
 
-	for (size_t i = 1; i < nick1.length() && i < nick2.length(); i++) {
-		int c1, c2;
-
-		c1 = sw_isupper(nick1[i]) ? tolower(nick1[i]) : nick1[i];
-		c2 = sw_isupper(nick2[i]) ? tolower(nick2[i]) : nick2[i];
-		if (c1 < c2)
-			return true;
-		else if (c1 > c2)
-			return false;
+	const char *
+	key(void) const
+	{
+		return &this->text[this->len + 2];
 	}
+};
 
-	return (nick1.length() < nick2.length() ? true : false);
+/*
+ * Sort order: the highest privilege first (~&@%+ and none), then the
+ * keys of the nicknames
+ */
+static bool
+cmp_fn(const nicklist_row &row1, const nicklist_row &row2)
+{
+	if (row1.rank != row2.rank)
+		return (row1.rank > row2.rank);
+	return (strcmp(row1.key(), row2.key()) < 0);
 }
 
 static void
@@ -150,46 +104,44 @@ draw_hook()
 	readline_top_panel();
 }
 
-static std::list<std::string>
-get_list(const IRC_WINDOW *window, const bool sort)
+static std::vector<nicklist_row>
+get_list(const IRC_WINDOW *window)
 {
-	std::list<std::string> list;
+	std::vector<nicklist_row> list;
+
+	mutex_lock(&g_win_htbl_mtx);
+	list.reserve(static_cast<size_t>(window->num_total));
 
 	for (size_t i = 0; i < ARRAY_SIZE(window->names_hash); i++) {
 		for (PNAMES names = window->names_hash[i];
 		    names != nullptr;
-		    names = names->next) {
-			char c;
-
-			if (names->is_owner)
-				c = '~';
-			else if (names->is_superop)
-				c = '&';
-			else if (names->is_op)
-				c = '@';
-			else if (names->is_halfop)
-				c = '%';
-			else if (names->is_voice)
-				c = '+';
-			else
-				c = ' ';
-
-			std::string str("");
-			str.push_back(c);
-			str.append(names->nick);
-#if defined(__cplusplus) && __cplusplus >= 201103L
-			list.emplace_back(str);
-#else
-			list.push_back(str);
-#endif
-		}
+		    names = names->next)
+			list.emplace_back(names);
 	}
 
-	if (sort)
-		list.sort(cmp_fn);
+	mutex_unlock(&g_win_htbl_mtx);
 	return list;
 }
 
+/*
+ * Only the rows that are drawn are sorted, i.e. the 'count' entries
+ * that start at 'first' in sort order, in linear time on average.
+ */
+static void
+sort_rows(std::vector<nicklist_row> &list, const size_t first,
+    const size_t count)
+{
+	if (first >= list.size())
+		return;
+
+	const auto begin = list.begin() + first;
+	const auto end = list.begin() + std::min(first + count, list.size());
+
+	if (first > 0)
+		std::nth_element(list.begin(), begin, list.end(), cmp_fn);
+	std::partial_sort(begin, end, list.end(), cmp_fn);
+}
+
 static void
 addvline(WINDOW *win, short int bg)
 {
@@ -261,16 +213,17 @@ printnick(WINDOW *win, const int row, const int col, const char *nick)
 
 static void
 list_fits_yes(PIRC_WINDOW win, WINDOW *nl_win, const int HEIGHT,
-    std::list<std::string> &list)
+    std::vector<nicklist_row> &list)
 {
 	(void) werase(nl_win);
 	win->nicklist.scroll_pos = 0;
+	sort_rows(list, 0, list.size());
 
 	auto	it = list.begin();
 	int	count = 0;
 
 	while (it != list.end() && count < HEIGHT) {
-		printnick(nl_win, count, 0, it->c_str());
+		printnick(nl_win, count, 0, it->text);
 		++it;
 		++count;
 	}
@@ -285,35 +238,25 @@ list_fits_yes(PIRC_WINDOW win, WINDOW *nl_win, const int HEIGHT,
 
 static void
 list_fits_no(PIRC_WINDOW win, WINDOW *nl_win, const int HEIGHT,
-    std::list<std::string> &list)
+    std::vector<nicklist_row> &list)
 {
-	std::list<std::string>::iterator it;
-	int count;
+	const int size = size_to_int(list.size());
 
 	(void) werase(nl_win);
 
-	if (win->nicklist.scroll_pos < 0) {
+	if (win->nicklist.scroll_pos < 0)
 		win->nicklist.scroll_pos = 0;
-	} else {
-		it = list.begin();
-		count = 0;
+	else if (size - win->nicklist.scroll_pos < HEIGHT)
+		win->nicklist.scroll_pos = (size - HEIGHT);
 
-		std::advance(it, win->nicklist.scroll_pos);
+	sort_rows(list, static_cast<size_t>(win->nicklist.scroll_pos),
+	    static_cast<size_t>(HEIGHT));
 
-		for (; it != list.end(); ++it)
-			count++;
-		if (count < HEIGHT)
-			win->nicklist.scroll_pos -= (HEIGHT - count);
-	}
-
-	it = list.begin();
-	count = 0;
-
-	if (win->nicklist.scroll_pos)
-		std::advance(it, win->nicklist.scroll_pos);
+	auto	it = list.begin() + win->nicklist.scroll_pos;
+	int	count = 0;
 
 	while (it != list.end() && count < HEIGHT) {
-		printnick(nl_win, count, 0, it->c_str());
+		printnick(nl_win, count, 0, it->text);
 		++it;
 		++count;
 	}
@@ -353,13 +296,15 @@ nicklist_draw(PIRC_WINDOW win, const int rows)
 	if (win == nullptr || rows < 0 || !win->received_names ||
 	    win->nicklist.pan == nullptr) {
 		return -1;
+	} else if (win->geometry_dirty) {
+		return 0; /* drawn when the window is relayouted */
 	} else if (term_is_too_small()) {
 		(void) napms(30);
 		return -1;
 	}
 
 	const int HEIGHT = (rows - 3);
-	std::list<std::string> list(get_list(win, true));
+	std::vector<nicklist_row> list(get_list(win));
 
 	if ((nl_win = panel_window(win->nicklist.pan)) == nullptr ||
 	    HEIGHT < 0 ||
@@ -390,8 +335,8 @@ nicklist_get_width(const PIRC_WINDOW window)
 		for (PNAMES names = window->names_hash[i];
 		    names != nullptr;
 		    names = names->next) {
-			if (strlen(names->nick) > len)
-				len = strlen(names->nick);
+			if (names->len > len)
+				len = names->len;
 		}
 	}
 
@@ -438,11 +383,16 @@ nicklist_update(PIRC_WINDOW win)
 	    !win->received_names)
 		return -1;
 
+	perf_scope scope(PERF_NICKLIST_UPDATE);
 	const bool width_changed = (nicklist_get_width(win) !=
 	    win->nicklist.width);
 
 	if (!width_changed)
 		return nicklist_draw(win, LINES);
+	else if (!is_the_active_window(win)) {
+		win->geometry_dirty = true;
+		return 0;
+	}
 
 	window_recreate_exported(win, LINES, COLS);
 	return 0;
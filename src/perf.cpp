@@ -0,0 +1,451 @@
+/* Low-overhead performance counters and latency histograms
+   Copyright (C) 2026 Markus Uhlin. All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   - Neither the name of the author nor the names of its contributors may be
+     used to endorse or promote products derived from this software without
+     specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+   BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE. */
+
+#include "common.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <mutex>
+
+#include "dataClassify.h"
+#include "libUtils.h"
+#include "perf.h"
+#include "strHand.h"
+
+#define PERF_EVENT_SLOTS 256
+#define PERF_HIST_SHIFT 10 /* first bucket: < 1024 ns */
+
+struct stage_counters {
+	std::atomic<uint64_t>	calls;
+	std::atomic<uint64_t>	total_ns;
+	std::atomic<uint64_t>	max_ns;
+	std::atomic<uint64_t>	bytes;
+	std::atomic<uint64_t>	hist[PERF_HIST_BUCKETS];
+};
+
+static std::atomic<bool>	enabled(false);
+static stage_counters		stages[PERF_STAGE_COUNT];
+
+static std::mutex		events_mtx;
+static perf_event_stats		events[PERF_EVENT_SLOTS];
+
+static const char *stage_names[PERF_STAGE_COUNT] = {
+	"net_recv",
+	"framing",
+	"sort_msg_compo",
+	"event_dispatch",
+	"vprinttext",
+	"printtext_puts",
+	"log_msg",
+	"nicklist_update",
+	"statusbar_update",
+};
+
+static inline uint64_t
+now_ns(void)
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast
+	    <std::chrono::nanoseconds>(std::chrono::steady_clock::now().
+	    time_since_epoch()).count());
+}
+
+static int
+get_bucket(uint64_t ns)
+{
+	int bucket = 0;
+
+	ns >>= PERF_HIST_SHIFT;
+
+	while (ns != 0 && bucket < (PERF_HIST_BUCKETS - 1)) {
+		ns >>= 1;
+		bucket++;
+	}
+
+	return bucket;
+}
+
+static void
+update_max(std::atomic<uint64_t> &max, const uint64_t ns)
+{
+	uint64_t cur = max.load(std::memory_order_relaxed);
+
+	while (ns > cur && !max.compare_exchange_weak(cur, ns,
+	    std::memory_order_relaxed))
+		/* null */;
+}
+
+static void
+record(const enum perf_stage stage, const uint64_t ns)
+{
+	stage_counters &sc = stages[stage];
+
+	sc.calls.fetch_add(1, std::memory_order_relaxed);
+	sc.total_ns.fetch_add(ns, std::memory_order_relaxed);
+	sc.hist[get_bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+	update_max(sc.max_ns, ns);
+}
+
+static uint64_t
+elapsed_since(const perf_tick_t start)
+{
+	const uint64_t now = now_ns();
+
+	return (now > start ? now - start : 0);
+}
+
+static unsigned int
+hash_command(const char *command)
+{
+	unsigned int hash = 5381;
+
+	while (*command)
+		hash = ((hash << 5) + hash) + static_cast<unsigned char>
+		    (*command++);
+	return hash;
+}
+
+bool
+perf_is_enabled(void)
+{
+	return enabled.load(std::memory_order_relaxed);
+}
+
+void
+perf_enable(bool on)
+{
+	enabled.store(on, std::memory_order_relaxed);
+}
+
+void
+perf_reset(void)
+{
+	for (stage_counters &sc : stages) {
+		sc.calls.store(0, std::memory_order_relaxed);
+		sc.total_ns.store(0, std::memory_order_relaxed);
+		sc.max_ns.store(0, std::memory_order_relaxed);
+		sc.bytes.store(0, std::memory_order_relaxed);
+
+		for (std::atomic<uint64_t> &bucket : sc.hist)
+			bucket.store(0, std::memory_order_relaxed);
+	}
+
+	std::lock_guard<std::mutex> lock(events_mtx);
+
+	BZERO(events, sizeof events);
+}
+
+/*
+ * Returns zero if instrumentation is off. All perf_end*() functions
+ * treat a zero start as "not measured" which keeps the disabled case
+ * down to a single relaxed load.
+ */
+perf_tick_t
+perf_begin(void)
+{
+	perf_tick_t	tick;
+
+	if (!enabled.load(std::memory_order_relaxed))
+		return 0;
+	tick = now_ns();
+	return (tick != 0 ? tick : 1);
+}
+
+uint64_t
+perf_end(enum perf_stage stage, perf_tick_t start)
+{
+	uint64_t	ns;
+
+	if (start == 0 || stage < 0 || stage >= PERF_STAGE_COUNT)
+		return 0;
+	ns = elapsed_since(start);
+	record(stage, ns);
+	return ns;
+}
+
+/*
+ * Records the time spent in 'PERF_EVENT_DISPATCH' and also keeps
+ * track of it per protocol command
+ */
+uint64_t
+perf_end_event(const char *command, perf_tick_t start)
+{
+	uint64_t	ns;
+
+	if (start == 0)
+		return 0;
+	ns = elapsed_since(start);
+	record(PERF_EVENT_DISPATCH, ns);
+
+	if (command == nullptr || strings_match(command, ""))
+		return ns;
+
+	std::lock_guard<std::mutex> lock(events_mtx);
+	unsigned int slot = hash_command(command) % PERF_EVENT_SLOTS;
+
+	for (size_t n = 0; n < PERF_EVENT_SLOTS; n++) {
+		perf_event_stats &ev = events[slot];
+
+		if (ev.command[0] == '\0') {
+			if (sw_strcpy(ev.command, command, sizeof ev.command)
+			    != 0)
+				return ns;
+		} else if (!strings_match(ev.command, command)) {
+			slot = (slot + 1) % PERF_EVENT_SLOTS;
+			continue;
+		}
+
+		ev.calls++;
+		ev.total_ns += ns;
+		if (ns > ev.max_ns)
+			ev.max_ns = ns;
+		break;
+	}
+
+	return ns;
+}
+
+/*
+ * Like perf_end() but subtracts time already accounted for by nested
+ * stages
+ */
+void
+perf_end_excluding(enum perf_stage stage, perf_tick_t start,
+    uint64_t nested_ns)
+{
+	uint64_t	ns;
+
+	if (start == 0 || stage < 0 || stage >= PERF_STAGE_COUNT)
+		return;
+	ns = elapsed_since(start);
+	record(stage, (ns > nested_ns ? ns - nested_ns : 0));
+}
+
+void
+perf_count_bytes(enum perf_stage stage, uint64_t bytes)
+{
+	if (!enabled.load(std::memory_order_relaxed) ||
+	    stage < 0 || stage >= PERF_STAGE_COUNT)
+		return;
+	stages[stage].calls.fetch_add(1, std::memory_order_relaxed);
+	stages[stage].bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+const char *
+perf_stage_name(enum perf_stage stage)
+{
+	if (stage < 0 || stage >= PERF_STAGE_COUNT)
+		return "unknown";
+	return stage_names[stage];
+}
+
+/*
+ * Exclusive upper bound, in nanoseconds, of histogram bucket 'n'. The
+ * last bucket is open-ended.
+ */
+uint64_t
+perf_hist_bound(int n)
+{
+	if (n < 0)
+		return 0;
+	else if (n >= (PERF_HIST_BUCKETS - 1))
+		return UINT64_MAX;
+	return (UINT64_C(1) << (n + PERF_HIST_SHIFT));
+}
+
+/*
+ * Estimates a percentile from the histogram. The result is the upper
+ * bound of the bucket holding the requested rank, capped at the
+ * largest recorded sample.
+ */
+uint64_t
+perf_percentile(const struct perf_stage_stats *st, int pct)
+{
+	uint64_t	count = 0;
+	uint64_t	rank;
+
+	if (st == nullptr || st->calls == 0 || pct <= 0 || pct > 100)
+		return 0;
+	for (const uint64_t &bucket : st->hist)
+		count += bucket;
+	if (count == 0)
+		return 0;
+
+	rank = (count * pct + 99) / 100;
+	count = 0;
+
+	for (int n = 0; n < PERF_HIST_BUCKETS; n++) {
+		if ((count += st->hist[n]) >= rank) {
+			const uint64_t bound = perf_hist_bound(n);
+
+			return (bound < st->max_ns ? bound : st->max_ns);
+		}
+	}
+
+	return st->max_ns;
+}
+
+void
+perf_get_stage(enum perf_stage stage, struct perf_stage_stats *st)
+{
+	if (st == nullptr)
+		return;
+
+	BZERO(st, sizeof *st);
+
+	if (stage < 0 || stage >= PERF_STAGE_COUNT)
+		return;
+
+	const stage_counters &sc = stages[stage];
+
+	st->calls	= sc.calls.load(std::memory_order_relaxed);
+	st->total_ns	= sc.total_ns.load(std::memory_order_relaxed);
+	st->max_ns	= sc.max_ns.load(std::memory_order_relaxed);
+	st->bytes	= sc.bytes.load(std::memory_order_relaxed);
+
+	for (int n = 0; n < PERF_HIST_BUCKETS; n++)
+		st->hist[n] = sc.hist[n].load(std::memory_order_relaxed);
+}
+
+/*
+ * Copies out at most 'max' per-command records sorted by total time,
+ * descending. Returns the number of records copied.
+ */
+size_t
+perf_get_events(struct perf_event_stats *out, size_t max)
+{
+	size_t	count = 0;
+
+	if (out == nullptr || max == 0)
+		return 0;
+
+	std::lock_guard<std::mutex> lock(events_mtx);
+
+	for (const perf_event_stats &ev : events) {
+		size_t	pos;
+
+		if (ev.command[0] == '\0')
+			continue;
+		for (pos = count; pos > 0; pos--) {
+			if (out[pos - 1].total_ns >= ev.total_ns)
+				break;
+			if (pos < max)
+				out[pos] = out[pos - 1];
+		}
+		if (pos < max) {
+			out[pos] = ev;
+			if (count < max)
+				count++;
+		}
+	}
+
+	return count;
+}
+
+static void
+put_json_string(FILE *fp, const char *str)
+{
+	(void) fputc('"', fp);
+
+	for (const char *cp = str; *cp; cp++) {
+		if (*cp == '"' || *cp == '\\')
+			(void) fprintf(fp, "\\%c", *cp);
+		else if (sw_isprint(*cp))
+			(void) fputc(*cp, fp);
+		else
+			(void) fprintf(fp, "\\u%04x",
+			    static_cast<unsigned char>(*cp));
+	}
+
+	(void) fputc('"', fp);
+}
+
+bool
+perf_dump(const char *path)
+{
+	FILE			*fp;
+	struct perf_event_stats	 ev[PERF_EVENT_SLOTS];
+	size_t			 nev;
+
+	if ((fp = xfopen(path, "w")) == nullptr)
+		return false;
+
+	(void) fprintf(fp, "{\n  \"enabled\": %s,\n  \"stages\": [\n",
+	    perf_is_enabled() ? "true" : "false");
+
+	for (int i = 0; i < PERF_STAGE_COUNT; i++) {
+		struct perf_stage_stats	st;
+
+		perf_get_stage(static_cast<perf_stage>(i), &st);
+		(void) fputs("    { \"name\": ", fp);
+		put_json_string(fp, stage_names[i]);
+		(void) fprintf(fp, ", \"calls\": %" PRIu64 ", "
+		    "\"total_ns\": %" PRIu64 ", \"max_ns\": %" PRIu64 ", "
+		    "\"bytes\": %" PRIu64 ", \"p50_ns\": %" PRIu64 ", "
+		    "\"p99_ns\": %" PRIu64 ",\n      \"histogram\": [",
+		    st.calls, st.total_ns, st.max_ns, st.bytes,
+		    perf_percentile(&st, 50), perf_percentile(&st, 99));
+
+		for (int n = 0; n < PERF_HIST_BUCKETS; n++) {
+			if (n == PERF_HIST_BUCKETS - 1) {
+				(void) fprintf(fp, "{ \"le_ns\": null, "
+				    "\"count\": %" PRIu64 " }", st.hist[n]);
+			} else {
+				(void) fprintf(fp, "{ \"le_ns\": %" PRIu64 ", "
+				    "\"count\": %" PRIu64 " }, ",
+				    perf_hist_bound(n), st.hist[n]);
+			}
+		}
+
+		(void) fprintf(fp, "] }%s\n",
+		    (i + 1 < PERF_STAGE_COUNT ? "," : ""));
+	}
+
+	(void) fputs("  ],\n  \"events\": [\n", fp);
+	nev = perf_get_events(ev, ARRAY_SIZE(ev));
+
+	for (size_t i = 0; i < nev; i++) {
+		(void) fputs("    { \"command\": ", fp);
+		put_json_string(fp, ev[i].command);
+		(void) fprintf(fp, ", \"calls\": %" PRIu64 ", "
+		    "\"total_ns\": %" PRIu64 ", \"max_ns\": %" PRIu64 " }%s\n",
+		    ev[i].calls, ev[i].total_ns, ev[i].max_ns,
+		    (i + 1 < nev ? "," : ""));
+	}
+
+	(void) fputs("  ]\n}\n", fp);
+
+	if (ferror(fp)) {
+		(void) fclose(fp);
+		return false;
+	}
+	return (fclose(fp) == 0);
+}
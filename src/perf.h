@@ -0,0 +1,87 @@
+#ifndef SRC_PERF_H_
+#define SRC_PERF_H_
+
+#include <stdint.h>
+
+/*
+ * Instrumented stages. Keep in sync with 'stage_names' in perf.cpp.
+ */
+enum perf_stage {
+	PERF_NET_RECV,
+	PERF_FRAMING,
+	PERF_SORT_MSG_COMPO,
+	PERF_EVENT_DISPATCH,
+	PERF_VPRINTTEXT,
+	PERF_PRINTTEXT_PUTS,
+	PERF_LOG_MSG,
+	PERF_NICKLIST_UPDATE,
+	PERF_STATUSBAR_UPDATE,
+	PERF_STAGE_COUNT
+};
+
+#define PERF_HIST_BUCKETS 24
+
+typedef uint64_t perf_tick_t;
+
+struct perf_stage_stats {
+	uint64_t	calls;
+	uint64_t	total_ns;
+	uint64_t	max_ns;
+	uint64_t	bytes;
+	uint64_t	hist[PERF_HIST_BUCKETS];
+};
+
+struct perf_event_stats {
+	char		command[32];
+	uint64_t	calls;
+	uint64_t	total_ns;
+	uint64_t	max_ns;
+};
+
+__SWIRC_BEGIN_DECLS
+bool		perf_is_enabled(void);
+void		perf_enable(bool);
+void		perf_reset(void);
+
+perf_tick_t	perf_begin(void);
+uint64_t	perf_end(enum perf_stage, perf_tick_t);
+uint64_t	perf_end_event(const char *command, perf_tick_t);
+void		perf_end_excluding(enum perf_stage, perf_tick_t, uint64_t);
+void		perf_count_bytes(enum perf_stage, uint64_t);
+
+const char	*perf_stage_name(enum perf_stage);
+uint64_t	 perf_hist_bound(int);
+uint64_t	 perf_percentile(const struct perf_stage_stats *, int);
+void		 perf_get_stage(enum perf_stage, struct perf_stage_stats *);
+size_t		 perf_get_events(struct perf_event_stats *, size_t);
+bool		 perf_dump(const char *path);
+__SWIRC_END_DECLS
+
+#ifdef __cplusplus
+/*
+ * Times the enclosing scope
+ */
+class perf_scope {
+public:
+	explicit perf_scope(enum perf_stage p_stage)
+	    : stage(p_stage)
+	    , start(perf_begin())
+	{
+		/* null */;
+	}
+
+	~perf_scope()
+	{
+		(void) perf_end(this->stage, this->start);
+	}
+
+	perf_scope(const perf_scope &) = delete;
+	perf_scope &operator=(const perf_scope &) = delete;
+
+private:
+	enum perf_stage	stage;
+	perf_tick_t	start;
+};
+#endif
+
+#endif
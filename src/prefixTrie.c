@@ -0,0 +1,536 @@
+/* Case-folded radix trie used for prefix completion
+   Copyright (C) 2026 Markus Uhlin. All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   - Neither the name of the author nor the names of its contributors may be
+     used to endorse or promote products derived from this software without
+     specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+   BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE. */
+
+#include "common.h"
+
+#include "libUtils.h"
+#include "prefixTrie.h"
+#include "strHand.h"
+
+struct trie_node {
+	char		*edge;		/* case-folded edge label */
+	size_t		 edgelen;
+	char		*value;		/* non-NULL for terminal nodes */
+	unsigned long	 stamp;		/* last activity (0 = never) */
+	struct trie_node *child;	/* sorted by the first edge byte */
+	struct trie_node *sibling;
+};
+
+struct tagPREFIX_TRIE {
+	struct trie_node	root;
+	size_t			size;
+	unsigned long		clock;
+};
+
+struct match {
+	const char	*value;
+	unsigned long	 stamp;
+	size_t		 seq;
+};
+
+struct match_vec {
+	struct match	*v;
+	size_t		 len;
+	size_t		 cap;
+};
+
+static SW_INLINE unsigned char
+fold(const char c)
+{
+	const unsigned char uc = (unsigned char) c;
+
+	return (uc >= 'A' && uc <= 'Z' ? (unsigned char) (uc + 32) : uc);
+}
+
+static char *
+folded_copy(const char *s, size_t len)
+{
+	char *copy = xmalloc(len + 1);
+
+	for (size_t i = 0; i < len; i++)
+		copy[i] = (char) fold(s[i]);
+	copy[len] = '\0';
+	return copy;
+}
+
+static struct trie_node *
+node_new(const char *edge, size_t edgelen, const char *value)
+{
+	struct trie_node *node = xcalloc(sizeof *node, 1);
+
+	node->edge	= folded_copy(edge, edgelen);
+	node->edgelen	= edgelen;
+	node->value	= (value != NULL ? sw_strdup(value) : NULL);
+	node->stamp	= 0;
+	node->child	= NULL;
+	node->sibling	= NULL;
+	return node;
+}
+
+static void
+node_free_children(struct trie_node *node)
+{
+	struct trie_node *p, *tmp;
+
+	for (p = node->child; p != NULL; p = tmp) {
+		tmp = p->sibling;
+		node_free_children(p);
+		free(p->edge);
+		free(p->value);
+		free(p);
+	}
+
+	node->child = NULL;
+}
+
+/*
+ * Return the address of the link that points to the child of 'node'
+ * whose edge begins with 'c' -- or, if no such child exists, the
+ * address where it should be linked in to keep the children sorted.
+ */
+static struct trie_node **
+child_link(struct trie_node *node, unsigned char c)
+{
+	struct trie_node **link = addrof(node->child);
+
+	while (*link != NULL && (unsigned char) (*link)->edge[0] < c)
+		link = addrof((*link)->sibling);
+	return link;
+}
+
+static size_t
+common_len(const struct trie_node *node, const char *s)
+{
+	size_t n = 0;
+
+	while (n < node->edgelen && s[n] != '\0' &&
+	    (unsigned char) node->edge[n] == fold(s[n]))
+		n++;
+	return n;
+}
+
+/*
+ * Merge a valueless node with its only child
+ */
+static void
+merge_with_child(struct trie_node *node)
+{
+	struct trie_node *child = node->child;
+	char *edge;
+
+	edge = xmalloc(node->edgelen + child->edgelen + 1);
+	memcpy(edge, node->edge, node->edgelen);
+	memcpy(&edge[node->edgelen], child->edge, child->edgelen + 1);
+
+	free(node->edge);
+	node->edge	= edge;
+	node->edgelen	+= child->edgelen;
+	node->value	= child->value;
+	node->stamp	= child->stamp;
+	node->child	= child->child;
+
+	free(child->edge);
+	free(child);
+}
+
+/*
+ * Return the node that exactly represents 'key' -- or NULL
+ */
+static struct trie_node *
+find_exact(const PREFIX_TRIE *trie, const char *key)
+{
+	struct trie_node *node = (struct trie_node *) addrof(trie->root);
+
+	while (*key != '\0') {
+		struct trie_node *child = *child_link(node, fold(*key));
+		size_t n;
+
+		if (child == NULL ||
+		    (unsigned char) child->edge[0] != fold(*key))
+			return NULL;
+		if ((n = common_len(child, key)) != child->edgelen)
+			return NULL;
+		node = child;
+		key += n;
+	}
+
+	return (node->value != NULL ? node : NULL);
+}
+
+static void
+vec_push(struct match_vec *vec, const struct trie_node *node)
+{
+	if (vec->v == NULL) {
+		vec->cap = 16;
+		vec->v = xmalloc(size_product(vec->cap, sizeof *vec->v));
+	} else if (vec->len == vec->cap) {
+		vec->cap *= 2;
+		vec->v = xrealloc(vec->v, size_product(vec->cap,
+		    sizeof *vec->v));
+	}
+
+	vec->v[vec->len].value = node->value;
+	vec->v[vec->len].stamp = node->stamp;
+	vec->v[vec->len].seq = vec->len;
+	vec->len++;
+}
+
+/*
+ * Depth-first walk. Since the children are kept sorted the matches
+ * are collected in case-folded lexicographic order.
+ */
+static void
+collect(const struct trie_node *node, struct match_vec *vec)
+{
+	if (node->value != NULL)
+		vec_push(vec, node);
+	for (const struct trie_node *p = node->child; p != NULL;
+	    p = p->sibling)
+		collect(p, vec);
+}
+
+/*
+ * Most recently active first. Entries that never had any activity
+ * keep their lexicographic order.
+ */
+static int
+match_cmp(const void *p1, const void *p2)
+{
+	const struct match *m1 = p1;
+	const struct match *m2 = p2;
+
+	if (m1->stamp != m2->stamp)
+		return (m1->stamp > m2->stamp ? -1 : 1);
+	return (m1->seq < m2->seq ? -1 : (m1->seq > m2->seq ? 1 : 0));
+}
+
+PPREFIX_TRIE
+prefixTrie_new(void)
+{
+	PPREFIX_TRIE trie = xcalloc(sizeof *trie, 1);
+
+	trie->root.edge		= sw_strdup("");
+	trie->root.edgelen	= 0;
+	trie->root.value	= NULL;
+	trie->root.stamp	= 0;
+	trie->root.child	= NULL;
+	trie->root.sibling	= NULL;
+	trie->size		= 0;
+	trie->clock		= 0;
+	return trie;
+}
+
+/**
+ * Get a list of all entries whose key starts with 'prefix'
+ * (case-insensitively). The list is ordered with the most recently
+ * active entries first.
+ *
+ * @param trie   Trie
+ * @param prefix Prefix to search for
+ * @return A text buffer that the caller is responsible for
+ *         destroying -- or NULL if there were no matches
+ */
+PTEXTBUF
+prefixTrie_matches(const PREFIX_TRIE *trie, const char *prefix)
+{
+	PTEXTBUF		 matches;
+	const char		*p = prefix;
+	const struct trie_node	*node;
+	struct match_vec	 vec = { NULL, 0, 0 };
+
+	if (trie == NULL || prefix == NULL)
+		return NULL;
+
+	node = addrof(trie->root);
+
+	while (*p != '\0') {
+		const struct trie_node *child =
+		    *child_link((struct trie_node *) node, fold(*p));
+		const size_t n = (child != NULL ? common_len(child, p) : 0);
+
+		if (n == 0)
+			return NULL;
+		else if (p[n] == '\0')
+			node = child; /* prefix exhausted (possibly mid-edge) */
+		else if (n != child->edgelen)
+			return NULL;
+		else
+			node = child;
+		p += n;
+	}
+
+	collect(node, &vec);
+
+	if (vec.len == 0) {
+		free(vec.v);
+		return NULL;
+	}
+
+	qsort(vec.v, vec.len, sizeof *vec.v, match_cmp);
+	matches = textBuf_new();
+
+	for (size_t i = 0; i < vec.len; i++)
+		textBuf_emplace_back(__func__, matches, vec.v[i].value, 0);
+
+	free(vec.v);
+	return matches;
+}
+
+/**
+ * Insert a key. The original case is preserved in the completions.
+ *
+ * @return True if inserted, false if it already existed
+ */
+bool
+prefixTrie_insert(PPREFIX_TRIE trie, const char *key)
+{
+	const char		*p = key;
+	struct trie_node	*node;
+
+	if (trie == NULL || key == NULL || *key == '\0')
+		return false;
+
+	node = addrof(trie->root);
+
+	while (*p != '\0') {
+		struct trie_node **link = child_link(node, fold(*p));
+		struct trie_node *child = *link;
+		size_t n;
+
+		if (child == NULL ||
+		    (unsigned char) child->edge[0] != fold(*p)) {
+			struct trie_node *leaf = node_new(p, strlen(p), key);
+
+			leaf->sibling = child;
+			*link = leaf;
+			trie->size++;
+			return true;
+		}
+
+		if ((n = common_len(child, p)) < child->edgelen) {
+			/*
+			 * Split the edge
+			 */
+			struct trie_node *mid = node_new(child->edge, n, NULL);
+
+			memmove(child->edge, &child->edge[n],
+			    child->edgelen - n + 1);
+			child->edgelen -= n;
+
+			mid->sibling	= child->sibling;
+			mid->child	= child;
+			child->sibling	= NULL;
+			*link		= mid;
+			child		= mid;
+		}
+
+		node = child;
+		p += n;
+	}
+
+	if (node->value != NULL)
+		return false;
+	node->value = sw_strdup(key);
+	node->stamp = 0;
+	trie->size++;
+	return true;
+}
+
+/**
+ * Remove a key
+ *
+ * @return True if removed, false if not found
+ */
+bool
+prefixTrie_remove(PPREFIX_TRIE trie, const char *key)
+{
+	const char		*p = key;
+	struct trie_node	*parent = NULL;
+	struct trie_node	*node;
+	struct trie_node	**link = NULL;
+
+	if (trie == NULL || key == NULL || *key == '\0')
+		return false;
+
+	node = addrof(trie->root);
+
+	while (*p != '\0') {
+		struct trie_node **next_link = child_link(node, fold(*p));
+		struct trie_node *child = *next_link;
+		size_t n;
+
+		if (child == NULL ||
+		    (unsigned char) child->edge[0] != fold(*p) ||
+		    (n = common_len(child, p)) != child->edgelen)
+			return false;
+
+		link		= next_link;
+		parent		= node;
+		node		= child;
+		p += n;
+	}
+
+	if (node->value == NULL || link == NULL)
+		return false;
+
+	free(node->value);
+	node->value = NULL;
+	node->stamp = 0;
+	trie->size--;
+
+	if (node->child == NULL) {
+		*link = node->sibling;
+		free(node->edge);
+		free(node);
+
+		if (parent != addrof(trie->root) && parent->value == NULL &&
+		    parent->child != NULL && parent->child->sibling == NULL)
+			merge_with_child(parent);
+	} else if (node->child->sibling == NULL) {
+		merge_with_child(node);
+	}
+
+	return true;
+}
+
+/**
+ * Mark a key as the most recently active one
+ *
+ * @return True on success, false if not found
+ */
+bool
+prefixTrie_touch(PPREFIX_TRIE trie, const char *key)
+{
+	struct trie_node *node;
+
+	if (trie == NULL || key == NULL ||
+	    (node = find_exact(trie, key)) == NULL)
+		return false;
+	node->stamp = ++(trie->clock);
+	return true;
+}
+
+size_t
+prefixTrie_size(const PREFIX_TRIE *trie)
+{
+	return (trie != NULL ? trie->size : 0);
+}
+
+void
+prefixTrie_clear(PPREFIX_TRIE trie)
+{
+	if (trie == NULL)
+		return;
+	node_free_children(addrof(trie->root));
+	trie->size = 0;
+	trie->clock = 0;
+}
+
+void
+prefixTrie_destroy(PPREFIX_TRIE trie)
+{
+	if (trie == NULL)
+		return;
+	prefixTrie_clear(trie);
+	free(trie->root.edge);
+	free(trie);
+}
+
+static int
+name_cmp(const void *p1, const void *p2)
+{
+	return strcmp(*(const char * const *) p1, *(const char * const *) p2);
+}
+
+/**
+ * Sort a table of names for prefixRange_first()
+ */
+void
+prefixRange_sort(const char **names, size_t count)
+{
+	qsort(names, count, sizeof *names, name_cmp);
+}
+
+/**
+ * Start a walk over the names of a sorted table that start with
+ * 'prefix' (case-sensitively). The first of them is found with a
+ * binary search, and the others are visited by prefixRange_next().
+ *
+ * @param range  Walk
+ * @param sorted Names sorted by prefixRange_sort()
+ * @param count  Number of names
+ * @param prefix Prefix to search for. Must outlive the walk.
+ * @return The first match, or NULL if there were no matches
+ */
+const char *
+prefixRange_first(PPREFIX_RANGE range, const char * const *sorted,
+    size_t count, const char *prefix)
+{
+	size_t lo = 0;
+	size_t hi = count;
+
+	while (lo < hi) {
+		const size_t mid = lo + (hi - lo) / 2;
+
+		if (strcmp(sorted[mid], prefix) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	range->next = &sorted[lo];
+	range->end = &sorted[count];
+	range->prefix = prefix;
+	range->prefixlen = strlen(prefix);
+
+	if (range->next == range->end ||
+	    strncmp(*range->next, prefix, range->prefixlen) != 0) {
+		range->next = range->end;
+		return NULL;
+	}
+
+	return *range->next;
+}
+
+/**
+ * Get the next match of a walk
+ *
+ * @return The match, or NULL if there are no more matches
+ */
+const char *
+prefixRange_next(PPREFIX_RANGE range)
+{
+	if (range->next == range->end || ++range->next == range->end ||
+	    strncmp(*range->next, range->prefix, range->prefixlen) != 0) {
+		range->next = range->end;
+		return NULL;
+	}
+
+	return *range->next;
+}
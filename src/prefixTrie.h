@@ -0,0 +1,38 @@
+#ifndef PREFIX_TRIE_H
+#define PREFIX_TRIE_H
+
+#include "textBuffer.h"
+
+typedef struct tagPREFIX_TRIE PREFIX_TRIE, *PPREFIX_TRIE;
+
+/*
+ * A walk over the names of a table, sorted with strcmp(), that start
+ * with a prefix. Tables that never change are searched this way
+ * instead of with a trie.
+ */
+typedef struct tagPREFIX_RANGE {
+	const char * const	*next;
+	const char * const	*end;
+	const char		*prefix;
+	size_t			 prefixlen;
+} PREFIX_RANGE, *PPREFIX_RANGE;
+
+/*lint -sem(prefixTrie_matches, r_null) */
+
+__SWIRC_BEGIN_DECLS
+PPREFIX_TRIE	prefixTrie_new(void);
+PTEXTBUF	prefixTrie_matches(const PREFIX_TRIE *, const char *prefix);
+bool		prefixTrie_insert(PPREFIX_TRIE, const char *key);
+bool		prefixTrie_remove(PPREFIX_TRIE, const char *key);
+bool		prefixTrie_touch(PPREFIX_TRIE, const char *key);
+size_t		prefixTrie_size(const PREFIX_TRIE *);
+void		prefixTrie_clear(PPREFIX_TRIE);
+void		prefixTrie_destroy(PPREFIX_TRIE);
+
+const char	*prefixRange_first(PPREFIX_RANGE, const char * const *sorted,
+		    size_t count, const char *prefix);
+const char	*prefixRange_next(PPREFIX_RANGE);
+void		 prefixRange_sort(const char **names, size_t count);
+__SWIRC_END_DECLS
+
+#endif
@@ -29,7 +29,6 @@
 
 #include "common.h"
 
-#include <clocale>
 #include <cwctype>
 #include <stdexcept>
 #include <string>
@@ -56,12 +55,16 @@
 #include "log.h"
 #include "main.h"
 #include "network.h"
+#include "perf.h"
 #include "printtext.h"
 #include "readline.h"
+#include "scrollback.h"
 #include "strHand.h"
 #include "strdup_printf.h"
 #include "terminal.h"
+#include "textLayout.h"
 #include "theme.h"
+#include "utf8Decode.h"
 
 #define WADDCH(win, c)        ((void) waddch(win, c))
 #define WATTR_OFF(win, attrs) ((void) wattr_off(win, attrs, nullptr))
@@ -181,40 +184,6 @@ struct text_decoration_bools {
 	}
 };
 
-struct case_default_context {
-	WINDOW		*win;
-	wchar_t		 wc;
-	bool		 nextchar_empty;
-	int		 indent;
-	int		 max_lines;
-	ptrdiff_t	 diff;
-
-	case_default_context() : win(nullptr)
-	    , wc(L'\0')
-	    , nextchar_empty(false)
-	    , indent(0)
-	    , max_lines(0)
-	    , diff(0)
-	{
-		/* empty */;
-	}
-
-	case_default_context(WINDOW *p_win,
-	    wchar_t p_wc,
-	    bool p_nextchar_empty,
-	    int p_indent,
-	    int p_max_lines,
-	    ptrdiff_t p_diff) : win(p_win)
-	    , wc(p_wc)
-	    , nextchar_empty(p_nextchar_empty)
-	    , indent(p_indent)
-	    , max_lines(p_max_lines)
-	    , diff(p_diff)
-	{
-		/* empty */;
-	}
-};
-
 /****************************************************************
 *                                                               *
 *  -------------- Objects with external linkage --------------  *
@@ -322,32 +291,6 @@ static struct ptext_colorMap_tag {
 static void	 set_indent(int *, CSTRING, ...) PRINTFLIKE(2);
 static char	*get_buffer(CSTRING) NONNULL;
 
-static void
-addmbs(WINDOW *win, const uint8_t *mbs)
-{
-#if defined(UNIX)
-	chtype c;
-	const uint8_t *p = mbs;
-
-	while ((c = *p++) != '\0')
-		WADDCH(win, c);
-#elif defined(WIN32)
-	(void) waddnstr(win, reinterpret_cast<CSTRING>(mbs), -1);
-#endif
-}
-
-static void
-append_newline(wchar_t **wc_buf)
-{
-	const size_t newsize = size_product(wcslen(*wc_buf) + sizeof "\n",
-	    sizeof(wchar_t));
-
-	*wc_buf = static_cast<wchar_t *>(xrealloc(*wc_buf, newsize));
-
-	if ((errno = sw_wcscat(*wc_buf, L"\n", newsize)) != 0)
-		err_sys("%s", __func__);
-}
-
 /**
  * Toggle blink ON/OFF. Don't actually use A_BLINK because it's
  * annoying.
@@ -386,223 +329,6 @@ case_bold(WINDOW *win, bool *is_bold)
 	}
 }
 
-/**
- * Convert a wide-character to a multibyte sequence. The storage for
- * the multibyte sequence is allocated on the heap and must be
- * free()'d.
- *
- * @param wc Wide-character
- * @param bytes_out How many bytes is the wc?
- * @return The result
- */
-static UCHARPTR
-convert_wc(wchar_t wc, size_t &bytes_out)
-{
-	const size_t	 size = MB_LEN_MAX;
-	auto		 mbs = static_cast<UCHARPTR>(xmalloc(size + 1));
-	mbstate_t	 ps;
-	size_t		 bytes_written = 0;
-
-	BZERO(&ps, sizeof(mbstate_t));
-	mbs[size] = '\0';
-
-#ifdef HAVE_BCI
-	if (wc == L'\0' ||
-	    (errno = wcrtomb_s(&bytes_written, reinterpret_cast<STRING>(mbs),
-	    size, wc, &ps)) != 0 ||
-	    bytes_written == g_conversion_failed ||
-	    bytes_written > size) {
-		if (wc != L'\0' && errno != 0)
-			err_log(errno, "printtext: %s: wcrtomb_s", __func__);
-		*mbs = '\0';
-		bytes_out = 0;
-		return mbs;
-	}
-#else
-	if (wc == L'\0' ||
-	    (bytes_written = wcrtomb(reinterpret_cast<STRING>(mbs), wc, &ps)) ==
-	    g_conversion_failed ||
-	    bytes_written > size) {
-		if (wc != L'\0')
-			err_log(EILSEQ, "printtext: %s: wcrtomb", __func__);
-		*mbs = '\0';
-		bytes_out = 0;
-		return mbs;
-	}
-#endif
-
-	mbs[bytes_written] = '\0';
-	bytes_out = bytes_written;
-	return static_cast<UCHARPTR>(xrealloc(mbs, bytes_written + 1));
-}
-
-static inline void
-putbyte(char *cp, const uint8_t b)
-{
-	cp[0] = static_cast<char>(b);
-	cp[1] = '\0';
-}
-
-/***************************************************
- *
- * check for ^CN
- *
- ***************************************************/
-static cc_check_t
-check_for_part1(wchar_t **bufp, char *fg)
-{
-	size_t		 bytes_out = 0;
-	UCHARPTR	 mbs;
-
-	if (!*++(*bufp))
-		return BUF_EOF;
-
-	mbs = convert_wc(**bufp, bytes_out);
-
-	if (bytes_out != 1 || !sw_isdigit(*mbs)) {
-		--(*bufp);
-		free(mbs);
-		return STOP_INTERPRETING;
-	}
-
-	fg[0] = static_cast<char>(*mbs);
-	fg[1] = '\0';
-	free(mbs);
-	return GO_ON;
-}
-
-/***************************************************
- *
- * check for ^CNN or ^CN,
- *
- ***************************************************/
-static cc_check_t
-check_for_part2(wchar_t **bufp, char *fg, bool *has_comma)
-{
-	size_t		 bytes_out = 0;
-	UCHARPTR	 mbs;
-
-	if (!*++(*bufp))
-		return BUF_EOF;
-
-	mbs = convert_wc(**bufp, bytes_out);
-
-	if (bytes_out != 1 || (!sw_isdigit(*mbs) && *mbs != ',')) {
-		--(*bufp);
-		free(mbs);
-		return STOP_INTERPRETING;
-	}
-
-	if (sw_isdigit(*mbs))
-		putbyte(fg, *mbs);
-	else if (*mbs == ',')
-		*has_comma = true;
-	else
-		sw_assert_not_reached();
-
-	free(mbs);
-	return GO_ON;
-}
-
-/***************************************************
- *
- * check for ^CNN, or ^CN,N
- *
- ***************************************************/
-static cc_check_t
-check_for_part3(wchar_t **bufp, bool *has_comma, bool fg_complete, char *bg)
-{
-	size_t		 bytes_out = 0;
-	UCHARPTR	 mbs;
-
-	if (!*++(*bufp))
-		return BUF_EOF;
-
-	mbs = convert_wc(**bufp, bytes_out);
-
-	if (bytes_out != 1 || (*mbs != ',' && !sw_isdigit(*mbs))) {
-		--(*bufp);
-		free(mbs);
-		return STOP_INTERPRETING;
-	} else if (*mbs == ',' && *has_comma) {
-		--(*bufp);
-		free(mbs);
-		return STOP_INTERPRETING;
-	} else if (*mbs != ',' && fg_complete) {
-		--(*bufp);
-		free(mbs);
-		return STOP_INTERPRETING;
-	}
-
-	if (*mbs == ',')
-		*has_comma = true;
-	else if (sw_isdigit(*mbs))
-		putbyte(bg, *mbs);
-	else
-		sw_assert_not_reached();
-
-	free(mbs);
-	return GO_ON;
-}
-
-/***************************************************
- *
- * check for ^CNN,N or ^CN,NN
- *
- ***************************************************/
-static cc_check_t
-check_for_part4(wchar_t **bufp, bool got_digit_bg, char *bg)
-{
-	size_t		 bytes_out = 0;
-	UCHARPTR	 mbs;
-
-	if (!*++(*bufp))
-		return BUF_EOF;
-
-	mbs = convert_wc(**bufp, bytes_out);
-
-	if (bytes_out != 1 || !sw_isdigit(*mbs)) {
-		--(*bufp);
-		free(mbs);
-		return STOP_INTERPRETING;
-	} else if (got_digit_bg) {
-		putbyte(++bg, *mbs);
-		free(mbs);
-		return STOP_INTERPRETING;
-	}
-
-	putbyte(bg, *mbs);
-	free(mbs);
-	return GO_ON;
-}
-
-/***************************************************
- *
- * check for ^CNN,NN
- *
- ***************************************************/
-static cc_check_t
-check_for_part5(wchar_t **bufp, char *bg)
-{
-	size_t		 bytes_out = 0;
-	UCHARPTR	 mbs;
-
-	if (!*++(*bufp))
-		return BUF_EOF;
-
-	mbs = convert_wc(**bufp, bytes_out);
-
-	if (bytes_out != 1 || !sw_isdigit(*mbs)) {
-		--(*bufp);
-		free(mbs);
-		return STOP_INTERPRETING;
-	}
-
-	putbyte(bg, *mbs);
-	free(mbs);
-	return GO_ON;
-}
-
 static void
 map_color(short int *inout, const short int i, const short int colorMap_size,
     attr_t *attr_out)
@@ -691,55 +417,43 @@ init_numbers(CSTRING fg, CSTRING bg, short int &num1, short int &num2)
  *
  * @param win      Window
  * @param is_color Is color state
- * @param bufp     Buffer pointer
+ * @param bufp     Buffer pointer. Moved to the last character of the
+ *                 color code.
  * @return Void
  */
 static void
-case_color(WINDOW *win, bool *is_color, wchar_t **bufp)
+case_color(WINDOW *win, bool *is_color, const wchar_t **bufp)
 {
-	bool		has_comma = false;
-	cc_check_t	res;
-	char		bg[10] = { 0 };
-	char		fg[10] = { 0 };
-	short int	num1 = -1;
-	short int	num2 = -1;
+	const size_t	 len = textLayout_color_len(*bufp);
+	char		 bg[3] = { 0 };
+	char		 fg[3] = { 0 };
+	short int	 num1 = -1;
+	short int	 num2 = -1;
+	size_t		 i, n;
 
 	if (*is_color) {
 		WCOLOR_SET(win, 0);
 		*is_color = false;
 	}
 
-	if (check_for_part1(bufp, &fg[0]) != GO_ON)
-		return;
-	else if ((res = check_for_part2(bufp, &fg[1], &has_comma)) == BUF_EOF)
-		return;
-	else if (res == STOP_INTERPRETING)
-		/* null */;
-	else if ((res = check_for_part3(bufp, &has_comma, fg[1] != '\0',
-	    &bg[0])) == BUF_EOF)
-		return;
-	else if (res == STOP_INTERPRETING)
-		/* null */;
-	else if ((res = check_for_part4(bufp, bg[0] != '\0', &bg[0])) ==
-	    BUF_EOF)
-		return;
-	else if (res == STOP_INTERPRETING)
-		/* null */;
-	else if (check_for_part5(bufp, &bg[1]) == BUF_EOF)
+	if (len == 1)
 		return;
 
+	for (i = 1, n = 0; i < len && (*bufp)[i] != L','; i++)
+		fg[n++] = static_cast<char>((*bufp)[i]);
+	for (i++, n = 0; i < len; i++)
+		bg[n++] = static_cast<char>((*bufp)[i]);
+
 	init_numbers(&fg[0], &bg[0], num1, num2);
 	printtext_set_color(win, is_color, num1, num2);
-
-	if (has_comma && !(bg[0]))
-		--(*bufp);
+	*bufp += len - 1;
 }
 
 /**
  * Do indent
  */
 static void
-do_indent(WINDOW *win, const int indent, int *insert_count)
+do_indent(WINDOW *win, const int indent)
 {
 	attr_t		 attrs = 0;
 	short int	 pair = 0;
@@ -749,107 +463,22 @@ do_indent(WINDOW *win, const int indent, int *insert_count)
 	/* turn off all attributes during indentation */
 	(void) wattr_set(win, A_NORMAL, 0, nullptr);
 
-	for (int i = 0; i < indent; i++) {
+	for (int i = 0; i < indent; i++)
 		WADDCH(win, ' ');
-		(*insert_count)++;
-	}
 
 	/* restore attributes after indenting */
 	(void) wattr_set(win, attrs, pair, nullptr);
 }
 
 static void
-new_row(WINDOW *win, int *insert_count, int *rep_count)
+new_row(WINDOW *win, int *rep_count)
 {
 	WADDCH(win, '\n');
-	*insert_count = 0;
 
 	if (isValid(rep_count))
 		(*rep_count)++; // NOLINT: false positive
 }
 
-/**
- * Start on a new row?
- */
-static bool
-start_on_a_new_row(const ptrdiff_t sum, WINDOW *win)
-{
-	return (sum < getmaxx(win) ? false : true);
-}
-
-/**
- * Handles switch default in printtext_puts()
- *
- * @param[in]     ctx          Context structure
- * @param[in,out] rep_count    "Represent" count
- * @param[out]    lines_count  Lines count
- * @param[out]    insert_count Insert count
- * @return Void
- */
-static void
-case_default(const struct case_default_context *ctx, int *rep_count,
-    int *lines_count, int *insert_count)
-{
-	size_t		 dummy;
-	UCHARPTR	 mbs;
-
-	if (!iswprint(ctx->wc) && ctx->wc != L'\n')
-		return;
-
-	mbs = convert_wc(ctx->wc, dummy);
-	UNUSED_VAR(dummy);
-
-	if (!is_scrollok(ctx->win)) {
-		addmbs(ctx->win, mbs);
-		free(mbs);
-		return;
-	}
-
-	/* -------------------------------------------------- */
-
-	const bool care_about_indent = (ctx->indent > 0);
-	const bool care_about_max_lines = (ctx->max_lines > 0);
-
-	if (ctx->wc == L'\n') {
-		new_row(ctx->win, insert_count, rep_count);
-
-		if (care_about_max_lines &&
-		    !(++ (*lines_count) < ctx->max_lines)) {
-			free(mbs);
-			return;
-		}
-
-		if (!ctx->nextchar_empty && care_about_indent)
-			do_indent(ctx->win, ctx->indent, insert_count);
-	} else if (!start_on_a_new_row((*insert_count) + ctx->diff + 1,
-		    ctx->win)) {
-		addmbs(ctx->win, mbs);
-		(*insert_count) += xwcwidth(ctx->wc, 2); // XXX
-	} else {
-		/*
-		 * Start on a new row
-		 */
-
-		new_row(ctx->win, insert_count, rep_count);
-
-		if (care_about_max_lines &&
-		    !(++ (*lines_count) < ctx->max_lines)) {
-			free(mbs);
-			return;
-		}
-
-		if (care_about_indent)
-			do_indent(ctx->win, ctx->indent, insert_count);
-
-		if (ctx->wc != L' ') {
-			addmbs(ctx->win, mbs);
-			(*insert_count) += xwcwidth(ctx->wc, 2);
-		}
-	}
-
-	free(mbs);
-}
-
 /**
  * Toggle reverse ON/OFF
  *
@@ -888,6 +517,64 @@ case_underline(WINDOW *win, bool *is_underline)
 	}
 }
 
+/**
+ * Output the characters [start, end) of a decoded line and interpret
+ * the text decoration. Runs of printable characters are added with a
+ * single call.
+ *
+ * @param[in]     win      Target window
+ * @param[in]     text     Decoded line
+ * @param[in]     start    Index of the first character
+ * @param[in]     end      One past the last character
+ * @param[in,out] booleans Text decoration state
+ * @return Void
+ */
+static void
+emit_text(WINDOW *win, const wchar_t *text, size_t start, size_t end,
+    struct text_decoration_bools &booleans)
+{
+	const wchar_t		*wcp = &text[start];
+	const wchar_t *const	 stop = &text[end];
+
+	while (wcp < stop) {
+		const wchar_t *run = wcp;
+
+		while (wcp < stop && (*wcp == L'\n' || iswprint(*wcp)))
+			wcp++;
+		if (wcp > run)
+			(void) waddnwstr(win, run, static_cast<int>(wcp - run));
+		if (wcp >= stop)
+			break;
+
+		switch (*wcp) {
+		case BLINK:
+			case_blink(win, &booleans.is_blink);
+			break;
+		case BOLD:
+			case_bold(win, &booleans.is_bold);
+			break;
+		case COLOR:
+			case_color(win, &booleans.is_color, &wcp);
+			break;
+		case NORMAL:
+			booleans.reset();
+			(void) wattrset(win, A_NORMAL);
+			break;
+		case REVERSE:
+			case_reverse(win, &booleans.is_reverse);
+			break;
+		case UNDERLINE:
+			case_underline(win, &booleans.is_underline);
+			break;
+		default:
+			/* not printable */
+			break;
+		}
+
+		++wcp;
+	}
+}
+
 static void
 set_indent(int *indent, CSTRING fmt, ...) // NOLINT
 {
@@ -1043,206 +730,56 @@ message_components::get_msg(CSTRING unproc_msg,
 }
 
 /**
- * WIN32 specific: attempt to convert multibyte character string to
- * wide-character string by using UTF-8. The storage is obtained with
- * xcalloc().
- *
- * @param buf Buffer to convert.
- * @return A wide-character string, or NULL on error.
+ * Create mutex "g_puts_mutex".
  */
-#if WIN32
-static wchar_t *
-windows_convert_to_utf8(CSTRING buf)
-{
-	const int	 size = static_cast<int>(strlen(buf) + 1);
-	wchar_t		*out = static_cast<wchar_t *>(xcalloc(size,
-			     sizeof *out));
-
-	if (MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, buf, -1, out,
-	    size) > 0)
-		return out;
-	free(out);
-	return nullptr;
-}
-#endif
-
 static void
-restore_original(CSTRING locale)
+puts_mutex_init(void)
 {
-	if (xsetlocale(LC_CTYPE, locale) == nullptr) {
-		err_log(0, "%s: cannot restore original locale (%s)", __func__,
-		    locale);
-	}
+	mutex_new(&g_puts_mutex);
 }
 
 static void
-try_convert_clean_up(struct locale_info *li, STRING orig, STRING tmp)
-{
-	free_locale_info(li);
-	free(orig);
-	free(tmp);
-}
-
-/**
- * Attempt convert multibyte character string to wide-character string
- * by using a specific codeset. The storage is dynamically allocated.
- *
- * @param buf     Buffer to convert
- * @param codeset Codeset to use
- * @return A wide-character string, or NULL on error.
- */
-static wchar_t *
-try_convert_buf_with_cs(CSTRING buf, CSTRING codeset)
+replace_characters_with_spaces(wchar_t *wc_buf, const wchar_t *set)
 {
-	STRING			 original_locale = nullptr;
-	STRING			 tmp_locale = nullptr;
-	struct locale_info	*li = nullptr;
-	wchar_t			*out = nullptr;
-
-	try {
-		size_t bytes_convert = 0;
-
-		li = get_locale_info(LC_CTYPE);
-
-		if (buf == nullptr || codeset == nullptr) {
-			throw std::runtime_error("invalid arguments");
-		} else if (li->lang_and_territory == nullptr ||
-			   li->codeset == nullptr) {
-			throw std::runtime_error("failed to get locale "
-			    "information");
-		}
-
-		original_locale = strdup_printf("%s.%s", li->lang_and_territory,
-		    li->codeset);
-		tmp_locale = strdup_printf("%s.%s", li->lang_and_territory,
-		    codeset);
-
-		const size_t size = strlen(buf) + 1;
-		out = static_cast<wchar_t *>(xcalloc(size, sizeof *out));
-
-		if (xsetlocale(LC_CTYPE, tmp_locale) == nullptr ||
-		    (bytes_convert = xmbstowcs(out, buf, size - 1)) ==
-		    g_conversion_failed) {
-			restore_original(original_locale);
-			throw std::runtime_error("conversion failed");
-		}
-
-		if (bytes_convert >= (size - 1))
-			out[size - 1] = 0L;
-		restore_original(original_locale);
-
-		try_convert_clean_up(li, original_locale, tmp_locale);
-		return out;
-	} catch (const std::bad_alloc &e) {
-		err_exit(ENOMEM, "%s: %s", __func__, e.what());
-	} catch (const std::runtime_error &e) {
-		debug("%s: %s", __func__, e.what());
-		try_convert_clean_up(li, original_locale, tmp_locale);
-		free(out);
-	} catch (...) {
-		sw_assert_not_reached();
-	}
+	wchar_t *wcp;
 
-	return nullptr;
+	while ((wcp = wcspbrk(wc_buf, set)) != nullptr)
+		*wcp = L' ';
 }
 
 /**
- * Convert multibyte character string to wide-character string, using
- * different encodings. The storage is dynamically allocated.
+ * Convert a line to a wide-character string. The text is decoded as
+ * UTF-8 and bytes that aren't part of a valid sequence are decoded as
+ * ISO 8859-1 (unless iconv recognizes the line in another codeset).
+ * The locale is never consulted.
  *
- * @param in_buf In buffer.
- * @return A wide-character string.
+ * @param[in]  buf Line
+ * @param[out] out Wide-character string
+ * @return Void
  */
-static wchar_t *
-perform_convert_buffer(const char **in_buf)
+static void
+decode_line(CSTRING buf, std::wstring &out)
 {
-	bool		 chars_lost = false;
-	stringarray_t	 ar = {
-#if defined(UNIX)
-		"UTF-8", "utf8",
-		"ISO-8859-1", "ISO8859-1", "iso88591",
-		"ISO-8859-15", "ISO8859-15", "iso885915",
-#elif defined(WIN32)
-		"65001", /* UTF-8 */
-		"28591", /* ISO 8859-1 Latin 1 */
-		"28605", /* ISO 8859-15 Latin 9 */
-#endif
-	};
-	mbstate_t	 ps;
-	size_t		 outlen = 0;
-	size_t		 size = 0;
-	wchar_t		*out = nullptr;
-
-#if WIN32
-	if ((out = windows_convert_to_utf8(*in_buf)) != nullptr)
-		return out;
-#endif
+	char	*tmpbuf = nullptr;
+	size_t	 len = strlen(buf);
 
-	for (const char **ar_p = &ar[0]; ar_p < &ar[ARRAY_SIZE(ar)]; ar_p++) {
-		if ((out = try_convert_buf_with_cs(*in_buf, *ar_p)) !=
-		    nullptr) {
-			/*
-			 * success
-			 */
-			return out;
-		}
+	if (!utf8_is_valid(buf, len)) {
+		tmpbuf = get_buffer(buf);
+		buf = tmpbuf;
+		len = strlen(buf);
 	}
 
-	/* fallback solution... */
-	size = strlen(*in_buf) + 1;
-	out = static_cast<wchar_t *>(xcalloc(size, sizeof *out));
-	BZERO(&ps, sizeof(mbstate_t));
-
-/*
- * mbsrtowcs() is complex enough to use
- */
-#if WIN32
-#pragma warning(disable: 4996)
-#endif
-
-	while (errno = 0, true) {
-		outlen = wcslen(out);
-
-		if (mbsrtowcs(&out[outlen], in_buf, (size - outlen) - 1, &ps) ==
-		    g_conversion_failed &&
-		    errno == EILSEQ) {
-			chars_lost = true;
-			(*in_buf)++;
-		} else
-			break;
-	}
-
-/*
- * Reset warning behavior to its default value
- */
-#if WIN32
-#pragma warning(default: 4996)
-#endif
-
-	out[size - 1] = 0L;
-
-	if (chars_lost)
-		err_log(EILSEQ, "In %s: characters lost", __func__);
-	return out;
+	out.resize(len);
+	out.resize(utf8_decode(&out[0], buf, len, nullptr));
+	free(tmpbuf);
+	replace_characters_with_spaces(&out[0], L"\f\t\v");
 }
 
-/**
- * Create mutex "g_puts_mutex".
+/*
+ * Layouts of recently output lines, so that redraws don't decode and
+ * wrap them again. Protected by 'g_puts_mutex'.
  */
-static void
-puts_mutex_init(void)
-{
-	mutex_new(&g_puts_mutex);
-}
-
-static void
-replace_characters_with_spaces(wchar_t *wc_buf, const wchar_t *set)
-{
-	wchar_t *wcp;
-
-	while ((wcp = wcspbrk(wc_buf, set)) != nullptr)
-		*wcp = L' ';
-}
+static text_layout_cache layout_cache(decode_line, 512);
 
 /**
  * Create mutex "vprinttext_mutex".
@@ -1368,46 +905,32 @@ printtext(PPRINTTEXT_CONTEXT ctx, CSTRING fmt, ...)
 
 #ifdef UNIT_TESTING
 void
-printtext_convert_wc_test1(void **state)
+printtext_decode_line_test1(void **state)
 {
-	const wchar_t array[] =
-	    L"0123456789"
-	    L"ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-	    L"abcdefghijklmnopqrstuvwxyz";
-	const size_t array_len = wcslen(array);
-
-	for (size_t i = 0; i < array_len; i++) {
-		size_t		 bytes_out = 0;
-		UCHARPTR	 mbs;
-
-		mbs = convert_wc(array[i], bytes_out);
-		assert_non_null(mbs);
-		assert_true(bytes_out == 1);
-		free(mbs);
-	}
+	std::wstring out;
+
+	decode_line("0123456789 ABCDEFGHIJKLMNOPQRSTUVWXYZ "
+	    "abcdefghijklmnopqrstuvwxyz", out);
+	assert_true(out == L"0123456789 ABCDEFGHIJKLMNOPQRSTUVWXYZ "
+	    L"abcdefghijklmnopqrstuvwxyz");
+
+	/* formfeeds and tabs take a column each */
+	decode_line("a\tb\fc\vd", out);
+	assert_true(out == L"a b c d");
 	UNUSED_PARAM(state);
 }
 
 void
-printtext_convert_wc_test2(void **state)
+printtext_decode_line_test2(void **state)
 {
-	const wchar_t array[] = {L'Å',L'Ä',L'Ö',L'å',L'ä',L'ö'};
-
-	for (size_t i = 0; i < ARRAY_SIZE(array); i++) {
-		size_t		 bytes_out = 0;
-		UCHARPTR	 mbs;
-
-		mbs = convert_wc(array[i], bytes_out);
-		assert_non_null(mbs);
-		if (!*mbs) {
-			assert_true(bytes_out == 0);
-		} else {
-			assert_true(bytes_out > 1);
-			print_message("%s: in=%lc out=%s\r\n", __func__,
-			    array[i], mbs);
-		}
-		free(mbs);
-	}
+	std::wstring out;
+
+	decode_line("\xc3\x85\xc3\x84\xc3\x96\xc3\xa5\xc3\xa4\xc3\xb6", out);
+	assert_true(out == L"\u00c5\u00c4\u00d6\u00e5\u00e4\u00f6");
+
+	/* the same in ISO 8859-1 */
+	decode_line("\xc5\xc4\xd6\xe5\xe4\xf6", out);
+	assert_true(out == L"\u00c5\u00c4\u00d6\u00e5\u00e4\u00f6");
 	UNUSED_PARAM(state);
 }
 #endif // UNIT_TESTING
@@ -1462,7 +985,8 @@ get_buffer(CSTRING orig)
 		"WINDOWS-1252",
 	};
 
-	if (!config_bool("iconv_conversion", true))
+	if (!config_bool("iconv_conversion", true) ||
+	    utf8_is_valid(orig, strlen(orig)))
 		return sw_strdup(orig);
 
 	for (immutable_cp_t str : fromcode) {
@@ -1539,13 +1063,10 @@ void
 printtext_puts(WINDOW *pwin, CSTRING buf, int indent, int max_lines,
     int *rep_count)
 {
-	char		*tmpbuf = nullptr;
-	const char	*tmpbuf_p = nullptr;
-	int		 insert_count = 0;
 	int		 lines_count = 0;
 	struct text_decoration_bools
 			 booleans; // calls constructor
-	wchar_t		*wc_buf = nullptr;
+	perf_scope	 scope(PERF_PRINTTEXT_PUTS);
 
 	puts_mutex_init_doit();
 
@@ -1557,95 +1078,34 @@ printtext_puts(WINDOW *pwin, CSTRING buf, int indent, int max_lines,
 		return;
 
 	mutex_lock(&g_puts_mutex);
-	tmpbuf = get_buffer(buf);
-	tmpbuf_p = addrof(tmpbuf[0]);
-	wc_buf = perform_convert_buffer(&tmpbuf_p);
-	free(tmpbuf);
-
-	if (is_scrollok(pwin))
-		append_newline(&wc_buf);
 
-	replace_characters_with_spaces(wc_buf, L"\f\t\v");
+	if (!is_scrollok(pwin)) {
+		std::wstring text;
 
-	wchar_t *wc_bufp = &wc_buf[0];
-	bool max_lines_flagged = false;
-
-	while (*wc_bufp && !max_lines_flagged) {
-		wchar_t wc = *wc_bufp;
+		decode_line(buf, text);
+		emit_text(pwin, text.c_str(), 0, text.size(), booleans);
+	} else {
+		/*
+		 * Keep the last column free. Writing there moves the
+		 * cursor to the next row.
+		 */
+		const text_layout &layout = layout_cache.get(buf,
+		    getmaxx(pwin) - 1, indent);
 
-		switch (wc) {
-		case BLINK:
-			case_blink(pwin, &booleans.is_blink);
-			break;
-		case BOLD:
-			case_bold(pwin, &booleans.is_bold);
-			break;
-		case COLOR:
-			case_color(pwin, &booleans.is_color, &wc_bufp);
-			break;
-		case NORMAL:
-			booleans.reset();
-			(void) wattrset(pwin, A_NORMAL);
-			break;
-		case REVERSE:
-			case_reverse(pwin, &booleans.is_reverse);
-			break;
-		case UNDERLINE:
-			case_underline(pwin, &booleans.is_underline);
-			break;
-		default:
-		{
-			const wchar_t	*wcp = nullptr;
-			ptrdiff_t	 diff = 0;
-
-			if (wc == L' ' && (wcp = wcschr(wc_bufp + 1, L' ')) !=
-			    nullptr) {
-				static wchar_t		str[4096] = { L'\0' };
-				static const auto	ARSZ =
-				    static_cast<ptrdiff_t>(ARRAY_SIZE(str));
-
-				if ((diff = (wcp - wc_bufp)) > ARSZ - 1)
-					diff = ARSZ - 1;
-				sw_assert(diff > 0);
-#if defined(UNIX)
-				(void) wcsncpy(str, wc_bufp, diff);
-				str[diff] = L'\0';
-#elif defined(WIN32)
-				switch (wcsncpy_s(str, ARSZ, wc_bufp, diff)) {
-				case 0:
-					/* copying ok */
-					break;
-				case STRUNCATE:
-					err_log(0, "%s: wcsncpy_s: truncated",
-					    __func__);
-					break;
-				default:
-					sw_assert_not_reached();
-					break;
-				}
-#endif
-				if ((diff = xwcswidth(wcspbrk(str,
-				    L"\035\002\003\017\026\037") ?
-				    squeeze_text_deco_wide(str) : str, 2)) < 0)
-					diff = 0;
-			}
-			struct case_default_context def_ctx(pwin, wc,
-			    !wcscmp(wc_bufp + 1, L""), indent, max_lines, diff);
-			case_default(&def_ctx, rep_count, &lines_count,
-			    &insert_count);
-			break;
-		} /* case default */
-		} /* switch block */
+		for (size_t n = 0; n < layout.rows.size(); n++) {
+			if (n > 0 && layout.indent > 0)
+				do_indent(pwin, layout.indent);
 
-		++ wc_bufp;
+			emit_text(pwin, layout.text.c_str(),
+			    layout.rows[n].start, layout.rows[n].end,
+			    booleans);
+			new_row(pwin, rep_count);
 
-		if (is_scrollok(pwin) && max_lines > 0)
-			max_lines_flagged = lines_count >= max_lines;
+			if (max_lines > 0 && !(++lines_count < max_lines))
+				break;
+		}
 	}
 
-	free(wc_buf);
-	wc_buf = nullptr;
-
 	if (!atomic_load_bool(&g_redrawing_window) &&
 	    !atomic_load_bool(&g_resizing_term)) {
 		update_panels();
@@ -1708,6 +1168,10 @@ vprinttext(PPRINTTEXT_CONTEXT ctx, CSTRING fmt, va_list ap)
 
 	vprinttext_mutex_init_doit();
 	mutex_lock(&vprinttext_mutex);
+
+	const perf_tick_t start = perf_begin();
+	const size_t prev_bytes = textBuf_bytes(ctx->window->buf);
+
 	fmt_copy = strdup_vprintf(fmt, ap);
 	pout.get_msg(fmt_copy, ctx->spec_type, ctx->include_ts,
 	    (ctx->has_server_time ? ctx->server_time : nullptr));
@@ -1718,6 +1182,8 @@ vprinttext(PPRINTTEXT_CONTEXT ctx, CSTRING fmt, va_list ap)
 
 	textBuf_emplace_back(__func__, ctx->window->buf, pout.text,
 	    pout.indent);
+	window_scrollback_account(ctx->window, prev_bytes);
+	(void) perf_end(PERF_VPRINTTEXT, start);
 
 	const bool shouldOutData = !(ctx->window->scroll_mode);
 
@@ -1740,9 +1206,32 @@ vprinttext(PPRINTTEXT_CONTEXT ctx, CSTRING fmt, va_list ap)
 		if ((logpath = log_get_path(g_server_hostname,
 		    ctx->window->label)) != nullptr) {
 			log_msg(logpath, pout.text);
+
+			if (scrollback_lines() > 0) {
+				(void) scrollback_msg(logpath, time(nullptr),
+				    pout.text, pout.indent);
+			}
+
 			free(logpath);
 		}
 	}
 
 	mutex_unlock(&vprinttext_mutex);
 }
+
+/**
+ * Lock the text buffers of the windows, i.e. keep vprinttext() from
+ * changing them until printtext_unlock_buffers() is called
+ */
+void
+printtext_lock_buffers(void)
+{
+	vprinttext_mutex_init_doit();
+	mutex_lock(&vprinttext_mutex);
+}
+
+void
+printtext_unlock_buffers(void)
+{
+	mutex_unlock(&vprinttext_mutex);
+}
@@ -87,12 +87,14 @@ void	 print_and_free(CSTRING msg, char *);
 void	 printf_and_free(char *, CSTRING, ...) PRINTFLIKE(2);
 void	 printtext(PPRINTTEXT_CONTEXT, CSTRING, ...) PRINTFLIKE(2);
 #ifdef UNIT_TESTING
-void	 printtext_convert_wc_test1(void **);
-void	 printtext_convert_wc_test2(void **);
+void	 printtext_decode_line_test1(void **);
+void	 printtext_decode_line_test2(void **);
 #endif
+void	 printtext_lock_buffers(void);
 void	 printtext_print(CSTRING what, CSTRING, ...) PRINTFLIKE(2);
 void	 printtext_puts(WINDOW *, CSTRING buf, int indent, int, int *);
 void	 printtext_set_color(WINDOW *, bool *, short int, short int);
+void	 printtext_unlock_buffers(void);
 void	 set_timestamp(char *dest, size_t destsize,
 	     const struct irc_message_compo *) NONNULL;
 void	 vprinttext(PPRINTTEXT_CONTEXT, CSTRING fmt, va_list);
@@ -57,16 +57,6 @@
 
 #include "commands/misc.h"
 
-/*
- * Full-width length, i.e. the number of column positions required to
- * display a full width wide character. (Windows behaves differently.)
- */
-#if defined(UNIX)
-#define FWLEN 2
-#elif defined(WIN32)
-#define FWLEN 1
-#endif
-
 /****************************************************************
 *                                                               *
 *  -------------- Objects with external linkage --------------  *
@@ -694,6 +684,10 @@ process(volatile struct readline_session_context *ctx)
 			mutex_unlock(&g_puts_mutex);
 
 			if (ret == ERR) {
+#ifdef HAVE_HUNSPELL
+				spell_readline_poll(ctx);
+#endif
+				window_scrollback_trim();
 				(void) napms(sleep_time_milliseconds);
 				continue;
 			}
@@ -856,6 +850,11 @@ process(volatile struct readline_session_context *ctx)
 			break;
 		case KEY_RESIZE:
 		case MY_KEY_RESIZE:
+			/*
+			 * The key has been taken off the queue, so a
+			 * later SIGWINCH must queue another one.
+			 */
+			(void) atomic_swap_bool(&g_resize_pending, false);
 			g_resize_requested = true;
 			/* FALLTHROUGH */
 		case '\a':
@@ -963,6 +962,9 @@ readline(CSTRING prompt)
 		g_readline_loop		= true;
 		g_resize_requested	= false;
 		g_suggs_mode		= false;
+#ifdef HAVE_HUNSPELL
+		spell_readline_reset();
+#endif
 		ctx = new_session(prompt);
 		return process(ctx);
 	case READLINE_RESTART:
@@ -12,6 +12,7 @@
 #endif
 
 #include <setjmp.h> /* want type jmp_buf */
+#include "prefixTrie.h"
 #include "textBuffer.h"
 
 #define READLINE_PROCESS	0
@@ -80,6 +81,7 @@ typedef struct tagTAB_COMPLETION {
 
 	PTEXTBUF	matches;
 	PTEXTBUF_ELMT	elmt;
+	PREFIX_RANGE	range; /* walked instead if 'matches' is NULL */
 } TAB_COMPLETION, *PTAB_COMPLETION;
 
 struct readline_session_context {
@@ -11,6 +11,16 @@
 #error Cannot determine Curses header file!
 #endif
 
+/*
+ * Full-width length, i.e. the number of column positions required to
+ * display a full width wide character. (Windows behaves differently.)
+ */
+#if defined(UNIX)
+#define FWLEN 2
+#elif defined(WIN32)
+#define FWLEN 1
+#endif
+
 //lint -printf(2, readline_ferror)
 //lint -sem(readline_error, r_no) doesn't return because of longjmp()
 //lint -sem(readline_ferror, r_no) likewise
@@ -367,6 +367,7 @@ readline_tab_comp_ctx_new(void)
 
 	ctx.matches = NULL;
 	ctx.elmt = NULL;
+	BZERO(&ctx.range, sizeof ctx.range);
 
 	return (&ctx);
 }
@@ -417,6 +418,7 @@ readline_tab_comp_ctx_reset(PTAB_COMPLETION ctx)
 
 		ctx->matches = NULL;
 		ctx->elmt = NULL;
+		BZERO(&ctx->range, sizeof ctx->range);
 	}
 }
 
@@ -531,15 +533,20 @@ init_mode_for_ftp(volatile struct readline_session_context *ctx)
 static void
 init_mode_for_help(volatile struct readline_session_context *ctx)
 {
-	immutable_cp_t cp = addrof(ctx->tc->search_var[6]);
+	CSTRING			 first;
+	const char * const	*cmds;
+	immutable_cp_t		 cp = addrof(ctx->tc->search_var[6]);
+	size_t			 count;
+
+	cmds = get_sorted_commands(&count);
 
-	if ((ctx->tc->matches = get_list_of_matching_commands(cp)) == NULL) {
+	if ((first = prefixRange_first(&ctx->tc->range, cmds, count, cp)) ==
+	    NULL) {
 		output_error("no magic");
 		return;
 	}
 
-	ctx->tc->elmt = textBuf_head(ctx->tc->matches);
-	auto_complete_help(ctx, ctx->tc->elmt->text);
+	auto_complete_help(ctx, first);
 	ctx->tc->isInCirculationModeFor.Help = true;
 }
 
@@ -751,7 +758,10 @@ get_service_hosts(const char *search_var)
 static void
 init_mode_for_set(volatile struct readline_session_context *ctx)
 {
-	immutable_cp_t cp = addrof(ctx->tc->search_var[5]);
+	CSTRING			 first;
+	const char * const	*settings;
+	immutable_cp_t		 cp = addrof(ctx->tc->search_var[5]);
+	size_t			 count;
 
 	if (strncmp(cp, "chanserv_host ", 14) == 0 ||
 	    strncmp(cp, "nickserv_host ", 14) == 0) {
@@ -759,14 +769,20 @@ init_mode_for_set(volatile struct readline_session_context *ctx)
 			output_error("no magic");
 			return;
 		}
-	} else if ((ctx->tc->matches = get_list_of_matching_settings(cp)) ==
-	    NULL) {
-		output_error("no magic");
-		return;
+
+		ctx->tc->elmt = textBuf_head(ctx->tc->matches);
+		first = ctx->tc->elmt->text;
+	} else {
+		settings = get_sorted_settings(&count);
+
+		if ((first = prefixRange_first(&ctx->tc->range, settings,
+		    count, cp)) == NULL) {
+			output_error("no magic");
+			return;
+		}
 	}
 
-	ctx->tc->elmt = textBuf_head(ctx->tc->matches);
-	auto_complete_setting(ctx, ctx->tc->elmt->text);
+	auto_complete_setting(ctx, first);
 	ctx->tc->isInCirculationModeFor.Settings = true;
 }
 
@@ -896,16 +912,20 @@ static void
 init_mode_for_commands(volatile struct readline_session_context *ctx,
     const bool numins_greater_than_one)
 {
-	immutable_cp_t cp = addrof(ctx->tc->search_var[1]);
+	CSTRING			 first = NULL;
+	const char * const	*cmds;
+	immutable_cp_t		 cp = addrof(ctx->tc->search_var[1]);
+	size_t			 count;
 
-	if (!numins_greater_than_one || (ctx->tc->matches =
-	    get_list_of_matching_commands(cp)) == NULL) {
+	cmds = get_sorted_commands(&count);
+
+	if (!numins_greater_than_one || (first =
+	    prefixRange_first(&ctx->tc->range, cmds, count, cp)) == NULL) {
 		output_error("no magic");
 		return;
 	}
 
-	ctx->tc->elmt = textBuf_head(ctx->tc->matches);
-	auto_complete_command(ctx, ctx->tc->elmt->text);
+	auto_complete_command(ctx, first);
 	ctx->tc->isInCirculationModeFor.Cmds = true;
 }
 
@@ -1028,10 +1048,18 @@ init_mode(volatile struct readline_session_context *ctx)
 static void
 ac_doit(AC_FUNC ac, volatile struct readline_session_context *ctx)
 {
-	if (ctx->tc->elmt == textBuf_tail(ctx->tc->matches))
+	CSTRING next;
+
+	if (ctx->tc->matches == NULL) {
+		if ((next = prefixRange_next(&ctx->tc->range)) == NULL)
+			no_more_matches(ctx);
+		else
+			ac(ctx, next);
+	} else if (ctx->tc->elmt == textBuf_tail(ctx->tc->matches)) {
 		no_more_matches(ctx);
-	else
+	} else {
 		ac(ctx, next_text(ctx->tc));
+	}
 }
 
 /*
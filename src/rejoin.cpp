@@ -0,0 +1,428 @@
+/* Prioritized, paced rejoining of channels after a reconnect
+   Copyright (C) 2026 Markus Uhlin. All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   - Neither the name of the author nor the names of its contributors may be
+     used to endorse or promote products derived from this software without
+     specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+   BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE. */
+
+#include "common.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "isupport.h"
+#include "network.h"
+#include "printtext.h"
+#include "rejoin.h"
+#include "strHand.h"
+
+/*
+ * JOIN lines sent at once, before the pacing starts
+ */
+static const int	burst_lines = 2;
+
+/*
+ * Seconds between the JOIN lines after the burst
+ */
+static const double	line_interval = 2.0;
+
+/*
+ * Seconds to wait for the end of the MOTD (and thereby ISUPPORT)
+ * before starting anyway
+ */
+static const double	motd_wait = 3.0;
+
+/*
+ * Seconds after the last JOIN line before channels that the server
+ * never confirmed are given up on
+ */
+static const double	confirm_wait = 30.0;
+
+static std::mutex	rejoin_mtx;
+
+/*
+ * Server limits from ISUPPORT (005). Zero means unlimited.
+ */
+static std::vector<std::pair<std::string, size_t>>	chanlimits;
+
+/*
+ * The plan: channels to send in priority order and the channels the
+ * server hasn't confirmed yet
+ */
+static bool				active = false;
+static bool				motd_done = false;
+static bool				limits_applied = false;
+static std::vector<std::string>		pending;
+static std::unordered_set<std::string>	unconfirmed;
+static size_t				nplanned = 0;
+static size_t				nskipped = 0;
+static int				lines_sent = 0;
+static double				plan_time = 0.0;
+static double				last_send = 0.0;
+
+static double
+steady_seconds(void)
+{
+	const auto since_epoch =
+	    std::chrono::steady_clock::now().time_since_epoch();
+
+	return std::chrono::duration<double>(since_epoch).count();
+}
+
+REJOIN_CLOCK_FN rejoin_clock = steady_seconds;
+
+static double
+seconds_since(const double then, const double now)
+{
+	return (now - then);
+}
+
+static size_t
+parse_limit(const char *str)
+{
+	char		*ep = nullptr;
+	unsigned long	 val;
+
+	if (str == nullptr || *str == '\0')
+		return 0;
+	errno = 0;
+	val = strtoul(str, &ep, 10);
+	if (errno != 0 || ep == str)
+		return 0;
+	return static_cast<size_t>(val);
+}
+
+/*
+ * Packs as many channels as fit into a comma-separated list in 'line'
+ * (of 'size' bytes), and no more than 'max_targets' unless it's zero.
+ * Returns the number of channels packed.
+ */
+size_t
+rejoin_pack(const char * const *chans, size_t count, size_t max_targets,
+    char *line, size_t size)
+{
+	size_t len = 0;
+	size_t n = 0;
+
+	if (line == nullptr || size == 0)
+		return 0;
+
+	*line = '\0';
+
+	while (n < count && (max_targets == 0 || n < max_targets)) {
+		const size_t chan_len = strlen(chans[n]);
+		const size_t needed = chan_len + (n > 0 ? 1 : 0);
+
+		if (len + needed >= size)
+			break;
+		if (n > 0)
+			line[len++] = ',';
+		memcpy(&line[len], chans[n], chan_len + 1);
+		len += chan_len;
+		n++;
+	}
+
+	return n;
+}
+
+/*
+ * Drops the channels that exceed CHANLIMIT, counting per group of
+ * channel prefixes. Called with 'rejoin_mtx' locked.
+ */
+static void
+apply_chanlimits(void)
+{
+	std::vector<size_t>		counts(chanlimits.size(), 0);
+	std::vector<std::string>	kept;
+
+	for (std::string &chan : pending) {
+		bool over = false;
+
+		for (size_t i = 0; i < chanlimits.size(); i++) {
+			const std::string &prefixes = chanlimits[i].first;
+
+			if (!prefixes.empty() &&
+			    prefixes.find(chan[0]) == std::string::npos)
+				continue;
+			if (chanlimits[i].second != 0 &&
+			    ++counts[i] > chanlimits[i].second)
+				over = true;
+			break;
+		}
+
+		if (over) {
+			unconfirmed.erase(isupport_fold_str(chan.c_str()));
+			nskipped++;
+		} else {
+			kept.emplace_back(std::move(chan));
+		}
+	}
+
+	pending.swap(kept);
+}
+
+/*
+ * Takes the next JOIN line off the plan. Called with 'rejoin_mtx'
+ * locked.
+ */
+static std::string
+next_line(void)
+{
+	std::vector<const char *>	chans;
+	char				line[REJOIN_LINE_MAX + 1 - 5];
+	size_t				n;
+
+	for (const std::string &chan : pending)
+		chans.push_back(chan.c_str());
+	n = rejoin_pack(chans.data(), chans.size(), isupport_targmax("JOIN"),
+	    line, sizeof line);
+	if (n == 0) {
+		/* too long to ever be sent */
+		unconfirmed.erase(isupport_fold_str(pending[0].c_str()));
+		nskipped++;
+		n = 1;
+	}
+	pending.erase(pending.begin(), pending.begin() + n);
+	return std::string(line);
+}
+
+/*
+ * Ends the plan if all channels are confirmed, or given up on, and
+ * returns what to report. Called with 'rejoin_mtx' locked.
+ */
+static std::string
+check_done(const double now)
+{
+	char msg[200] = { '\0' };
+
+	if (!active || !pending.empty() || (!unconfirmed.empty() &&
+	    seconds_since(last_send, now) < confirm_wait))
+		return std::string("");
+
+	const size_t	ntotal = nplanned;
+	const size_t	njoined = ntotal - nskipped - unconfirmed.size();
+	const double	secs = seconds_since(plan_time, now);
+
+	if (njoined == ntotal) {
+		(void) snprintf(msg, sizeof msg, "Rejoined %zu channel%s in "
+		    "%.1f seconds", njoined, (njoined == 1 ? "" : "s"), secs);
+	} else {
+		(void) snprintf(msg, sizeof msg, "Rejoined %zu of %zu channels "
+		    "in %.1f seconds (%zu over the server's limit, %zu "
+		    "unconfirmed)", njoined, ntotal, secs, nskipped,
+		    unconfirmed.size());
+	}
+
+	active = false;
+	unconfirmed.clear();
+	return std::string(msg);
+}
+
+static void
+report(const std::string &msg)
+{
+	PRINTTEXT_CONTEXT ctx;
+
+	if (msg.empty())
+		return;
+	printtext_context_init(&ctx, g_status_window, TYPE_SPEC1_SUCCESS,
+	    true);
+	printtext(&ctx, "%s", msg.c_str());
+}
+
+/*
+ * Adds a channel to the plan. Channels are joined in the order they
+ * were added.
+ */
+void
+rejoin_add(const char *channel)
+{
+	std::lock_guard<std::mutex> lock(rejoin_mtx);
+
+	if (channel == nullptr ||
+	    !unconfirmed.insert(isupport_fold_str(channel)).second)
+		return;
+	pending.emplace_back(channel);
+}
+
+/*
+ * Starts sending the planned channels
+ */
+void
+rejoin_start(void)
+{
+	std::lock_guard<std::mutex> lock(rejoin_mtx);
+
+	if (pending.empty())
+		return;
+	active = true;
+	limits_applied = false;
+	nplanned = pending.size();
+	nskipped = 0;
+	lines_sent = 0;
+	plan_time = last_send = rejoin_clock();
+}
+
+/*
+ * Picks up CHANLIMIT and MAXCHANNELS from an ISUPPORT token
+ */
+void
+rejoin_isupport(const char *token)
+{
+	std::lock_guard<std::mutex>	lock(rejoin_mtx);
+	const char			*val;
+
+	if (token == nullptr || (val = strchr(token, '=')) == nullptr)
+		return;
+	val++;
+
+	if (!strncmp(token, "CHANLIMIT=", 10)) {
+		std::string	list(val);
+		size_t		pos = 0;
+
+		chanlimits.clear();
+
+		while (pos < list.size()) {
+			size_t		end = list.find(',', pos);
+			std::string	item;
+			size_t		colon;
+
+			if (end == std::string::npos)
+				end = list.size();
+			item = list.substr(pos, end - pos);
+			if ((colon = item.find(':')) != std::string::npos &&
+			    colon > 0) {
+				chanlimits.emplace_back(item.substr(0, colon),
+				    parse_limit(item.c_str() + colon + 1));
+			}
+			pos = end + 1;
+		}
+	} else if (!strncmp(token, "MAXCHANNELS=", 12) && chanlimits.empty()) {
+		chanlimits.emplace_back("", parse_limit(val));
+	}
+}
+
+void
+rejoin_motd_done(void)
+{
+	std::lock_guard<std::mutex> lock(rejoin_mtx);
+
+	motd_done = true;
+}
+
+/*
+ * The server has sent the names of a channel
+ */
+void
+rejoin_joined(const char *channel)
+{
+	std::string msg;
+
+	if (channel == nullptr)
+		return;
+
+	std::unique_lock<std::mutex> lock(rejoin_mtx);
+
+	if (!active || unconfirmed.erase(isupport_fold_str(channel)) == 0)
+		return;
+	msg = check_done(rejoin_clock());
+	lock.unlock();
+
+	report(msg);
+}
+
+/*
+ * Sends the next JOIN lines when they're due. Called from the receive
+ * loop.
+ */
+void
+rejoin_run_bkgd_task(void)
+{
+	std::vector<std::string>	lines;
+	std::string			msg;
+
+	std::unique_lock<std::mutex> lock(rejoin_mtx);
+
+	if (!active)
+		return;
+
+	const double now = rejoin_clock();
+
+	if (!pending.empty() && (motd_done ||
+	    seconds_since(plan_time, now) >= motd_wait)) {
+		if (!limits_applied) {
+			apply_chanlimits();
+			limits_applied = true;
+		}
+
+		while (!pending.empty() && (lines_sent < burst_lines ||
+		    seconds_since(last_send, now) >= line_interval)) {
+			lines.push_back(next_line());
+			lines_sent++;
+			last_send = now;
+		}
+	}
+
+	msg = check_done(now);
+	lock.unlock();
+
+	for (const std::string &line : lines) {
+		if (!line.empty() && net_send("JOIN %s", line.c_str()) < 0)
+			break;
+	}
+	report(msg);
+}
+
+/* ----------------------------------------------------------------- */
+
+/*
+ * Forgets the server limits when a connection starts. The plan is kept,
+ * as it's made before the connection is listened on, and is forgotten
+ * by rejoin_deinit().
+ */
+void
+rejoin_init(void)
+{
+	std::lock_guard<std::mutex> lock(rejoin_mtx);
+
+	chanlimits.clear();
+	motd_done = false;
+}
+
+void
+rejoin_deinit(void)
+{
+	std::lock_guard<std::mutex> lock(rejoin_mtx);
+
+	active = false;
+	pending.clear();
+	unconfirmed.clear();
+}
@@ -0,0 +1,32 @@
+#ifndef SRC_REJOIN_H_
+#define SRC_REJOIN_H_
+
+/*
+ * Longest JOIN line sent, not counting the CR-LF
+ */
+#define REJOIN_LINE_MAX 510
+
+typedef double (*REJOIN_CLOCK_FN)(void);
+
+__SWIRC_BEGIN_DECLS
+/*
+ * Seconds on a steady clock, by which the JOIN lines are paced. The
+ * unit tests replace it.
+ */
+extern REJOIN_CLOCK_FN rejoin_clock;
+
+size_t	rejoin_pack(const char * const *chans, size_t count,
+	    size_t max_targets, char *line, size_t size);
+
+void	rejoin_add(const char *channel);
+void	rejoin_start(void);
+void	rejoin_isupport(const char *token);
+void	rejoin_motd_done(void);
+void	rejoin_joined(const char *channel);
+void	rejoin_run_bkgd_task(void);
+
+void	rejoin_init(void);
+void	rejoin_deinit(void);
+__SWIRC_END_DECLS
+
+#endif
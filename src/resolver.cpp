@@ -0,0 +1,455 @@
+/* Asynchronous, caching host name resolver
+   Copyright (C) 2026 Markus Uhlin. All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   - Neither the name of the author nor the names of its contributors may be
+     used to endorse or promote products derived from this software without
+     specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+   BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE. */
+
+#include "common.h"
+
+#ifdef UNIX
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include <netdb.h>
+#endif
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "errHand.h"
+#include "i18n.h"
+#include "libUtils.h"
+#include "resolver.h"
+#include "strHand.h"
+
+typedef std::chrono::steady_clock resolver_clock;
+
+/*
+ * Lookups that may run at the same time
+ */
+static const int max_workers = 2;
+
+static int
+sys_getaddrinfo(CSTRING host, CSTRING port, const struct addrinfo *hints,
+    struct addrinfo **res)
+{
+	return getaddrinfo(host, port, hints, res);
+}
+
+struct resolver_addr {
+	int			family;
+	int			socktype;
+	int			protocol;
+	socklen_t		addrlen;
+	struct sockaddr_storage	addr;
+};
+
+struct resolver_entry {
+	int				error;
+	std::string			canonname;
+	std::vector<resolver_addr>	addrs;
+	resolver_clock::time_point	expires;
+};
+
+struct resolver_query {
+	std::string				key;
+	std::string				host;
+	std::string				port;
+	struct addrinfo				hints;
+	bool					done;
+	std::shared_ptr<resolver_entry>		entry;
+};
+
+typedef std::shared_ptr<resolver_query> query_ptr;
+
+/*
+ * The workers are detached, as getaddrinfo() can't be interrupted, and
+ * each holds a reference to the state so that it outlives them.
+ */
+struct resolver_state {
+	std::mutex				mtx;
+	std::condition_variable			work_cond;
+	std::condition_variable			done_cond;
+	std::deque<query_ptr>			queue;
+	std::unordered_map<std::string, query_ptr>
+						inflight;
+	std::unordered_map<std::string, std::shared_ptr<resolver_entry>>
+						cache;
+	resolver_backend_t			backend = sys_getaddrinfo;
+	unsigned long int			cancel_gen = 0;
+	int					workers = 0;
+	int					idle = 0;
+	bool					stop = false;
+};
+
+static std::shared_ptr<resolver_state>
+    state(std::make_shared<resolver_state>());
+
+static std::string
+make_key(CSTRING host, CSTRING port, const struct addrinfo *hints)
+{
+	std::string key(host);
+
+	key.append(" ").append(port ? port : "");
+	if (hints) {
+		key.append(" ").append(std::to_string(hints->ai_family));
+		key.append(" ").append(std::to_string(hints->ai_socktype));
+		key.append(" ").append(std::to_string(hints->ai_protocol));
+		key.append(" ").append(std::to_string(hints->ai_flags));
+	}
+	return key;
+}
+
+static std::shared_ptr<resolver_entry>
+run_query(resolver_backend_t backend, CSTRING host, CSTRING port,
+    const struct addrinfo *hints)
+{
+	auto entry = std::make_shared<resolver_entry>();
+	struct addrinfo *res = nullptr;
+
+	if ((entry->error = backend(host, port, hints, &res)) == 0) {
+		for (const struct addrinfo *rp = res; rp; rp = rp->ai_next) {
+			resolver_addr addr;
+
+			if (rp->ai_addr == nullptr ||
+			    rp->ai_addrlen > sizeof addr.addr)
+				continue;
+			BZERO(&addr, sizeof addr);
+			addr.family	= rp->ai_family;
+			addr.socktype	= rp->ai_socktype;
+			addr.protocol	= rp->ai_protocol;
+			addr.addrlen	= static_cast<socklen_t>(
+			    rp->ai_addrlen);
+			memcpy(&addr.addr, rp->ai_addr, rp->ai_addrlen);
+			entry->addrs.push_back(addr);
+		}
+
+		if (res && res->ai_canonname)
+			entry->canonname.assign(res->ai_canonname);
+		if (res)
+			freeaddrinfo(res);
+		if (entry->addrs.empty())
+			entry->error = EAI_NONAME;
+	}
+
+	entry->expires = resolver_clock::now() + std::chrono::seconds(
+	    entry->error == 0 ? RESOLVER_TTL : RESOLVER_NEG_TTL);
+	return entry;
+}
+
+static struct addrinfo *
+make_list(const resolver_entry &entry, const struct addrinfo *hints)
+{
+	struct addrinfo *head = nullptr;
+	struct addrinfo **tail = &head;
+
+	for (const resolver_addr &addr : entry.addrs) {
+		auto ai = static_cast<struct addrinfo *>(xcalloc(1, sizeof
+		    (struct addrinfo)));
+
+		ai->ai_flags	= (hints ? hints->ai_flags : 0);
+		ai->ai_family	= addr.family;
+		ai->ai_socktype	= addr.socktype;
+		ai->ai_protocol	= addr.protocol;
+		ai->ai_addrlen	= addr.addrlen;
+		ai->ai_addr	= static_cast<struct sockaddr *>(xmalloc(
+		    addr.addrlen));
+		memcpy(ai->ai_addr, &addr.addr, addr.addrlen);
+
+		if (head == nullptr && !entry.canonname.empty())
+			ai->ai_canonname = sw_strdup(entry.canonname.c_str());
+
+		*tail = ai;
+		tail = &ai->ai_next;
+	}
+
+	return head;
+}
+
+static void
+store(resolver_state &st, const std::string &key,
+    const std::shared_ptr<resolver_entry> &entry)
+{
+	if (entry->error != EAI_AGAIN)
+		st.cache[key] = entry;
+}
+
+static void
+worker_main(std::shared_ptr<resolver_state> st)
+{
+	std::unique_lock<std::mutex> lock(st->mtx);
+
+	for (;;) {
+		st->idle++;
+		st->work_cond.wait(lock, [&st] {
+			return (st->stop || !st->queue.empty());
+		});
+		st->idle--;
+
+		if (st->stop)
+			break;
+
+		query_ptr q(st->queue.front());
+		st->queue.pop_front();
+		resolver_backend_t backend = st->backend;
+		lock.unlock();
+
+		auto entry = run_query(backend, q->host.c_str(),
+		    (q->port.empty() ? nullptr : q->port.c_str()), &q->hints);
+
+		lock.lock();
+		q->entry = entry;
+		q->done = true;
+		store(*st, q->key, entry);
+		st->inflight.erase(q->key);
+		st->done_cond.notify_all();
+	}
+
+	st->workers--;
+}
+
+/*
+ * Hands the query to a worker, starting one if none is idle. Returns
+ * false if there's no worker to take it. Call with the state locked.
+ */
+static bool
+dispatch(resolver_state &st, const query_ptr &q)
+{
+	if (st.stop)
+		return false;
+	if (st.idle == 0 && st.workers < max_workers) {
+		try {
+			std::thread(worker_main, state).detach();
+			st.workers++;
+		} catch (const std::system_error &e) {
+			err_log(0, "resolver: %s", e.what());
+		}
+	}
+	if (st.workers == 0)
+		return false;
+
+	st.queue.push_back(q);
+	st.inflight[q->key] = q;
+	st.work_cond.notify_one();
+	return true;
+}
+
+static int
+answer(const resolver_entry &entry, const struct addrinfo *hints,
+    struct addrinfo **res)
+{
+	if (entry.error == 0)
+		*res = make_list(entry, hints);
+	return entry.error;
+}
+
+/*
+ * Resolves 'host' like getaddrinfo() but on a worker thread, so that
+ * the wait can be given up on (by resolver_cancel() or after
+ * RESOLVER_WAIT_MAX seconds), and answers are cached. The result must
+ * be freed with resolver_freeaddrinfo().
+ */
+int
+resolver_lookup(CSTRING host, CSTRING port, const struct addrinfo *hints,
+    struct addrinfo **res)
+{
+	query_ptr		q;
+	std::string		key;
+	struct addrinfo		numeric;
+	unsigned long int	gen;
+
+	if (res == nullptr)
+		return EAI_FAIL;
+
+	*res = nullptr;
+
+	if (host == nullptr)
+		return EAI_NONAME;
+
+	/*
+	 * Addresses need no lookup
+	 */
+	if (hints)
+		memcpy(&numeric, hints, sizeof numeric);
+	else
+		BZERO(&numeric, sizeof numeric);
+	numeric.ai_flags |= AI_NUMERICHOST;
+
+	auto lit = run_query(sys_getaddrinfo, host, port, &numeric);
+
+	if (lit->error == 0)
+		return answer(*lit, hints, res);
+
+	key = make_key(host, port, hints);
+	std::unique_lock<std::mutex> lock(state->mtx);
+	gen = state->cancel_gen;
+
+	auto it = state->cache.find(key);
+
+	if (it != state->cache.end()) {
+		if (it->second->expires > resolver_clock::now())
+			return answer(*it->second, hints, res);
+		state->cache.erase(it);
+	}
+
+	auto inflight = state->inflight.find(key);
+
+	if (inflight != state->inflight.end()) {
+		q = inflight->second;
+	} else {
+		q = std::make_shared<resolver_query>();
+		q->key.assign(key);
+		q->host.assign(host);
+		q->port.assign(port ? port : "");
+		if (hints)
+			memcpy(&q->hints, hints, sizeof q->hints);
+		else
+			BZERO(&q->hints, sizeof q->hints);
+		q->done = false;
+
+		if (!dispatch(*state, q)) {
+			resolver_backend_t backend = state->backend;
+
+			lock.unlock();
+			auto entry = run_query(backend, host, port, hints);
+			lock.lock();
+			store(*state, key, entry);
+			return answer(*entry, hints, res);
+		}
+	}
+
+	const bool done = state->done_cond.wait_for(lock,
+	    std::chrono::seconds(RESOLVER_WAIT_MAX), [&q, gen] {
+		return (q->done || state->cancel_gen != gen);
+	});
+
+	if (q->done)
+		return answer(*q->entry, hints, res);
+	return (done ? RESOLVER_CANCELED : RESOLVER_TIMEDOUT);
+}
+
+void
+resolver_freeaddrinfo(struct addrinfo *res)
+{
+	while (res != nullptr) {
+		struct addrinfo *next = res->ai_next;
+
+		free(res->ai_addr);
+		free(res->ai_canonname);
+		free(res);
+		res = next;
+	}
+}
+
+CSTRING
+resolver_strerror(int error)
+{
+	switch (error) {
+	case RESOLVER_CANCELED:
+		return _("Lookup canceled");
+	case RESOLVER_TIMEDOUT:
+		return _("Lookup timed out");
+	}
+
+	return gai_strerror(error);
+}
+
+/*
+ * Makes waiting lookups return RESOLVER_CANCELED. The lookups
+ * themselves finish in the background and are cached.
+ */
+void
+resolver_cancel(void)
+{
+	std::lock_guard<std::mutex> lock(state->mtx);
+
+	state->cancel_gen++;
+	state->done_cond.notify_all();
+}
+
+/*
+ * Drops the cached answers for 'host', e.g. when none of its addresses
+ * could be connected to
+ */
+void
+resolver_forget(CSTRING host)
+{
+	if (host == nullptr)
+		return;
+
+	const std::string prefix(std::string(host) + " ");
+	std::lock_guard<std::mutex> lock(state->mtx);
+
+	for (auto it = state->cache.begin(); it != state->cache.end();) {
+		if (it->first.compare(0, prefix.size(), prefix) == 0)
+			it = state->cache.erase(it);
+		else
+			++it;
+	}
+}
+
+void
+resolver_flush(void)
+{
+	std::lock_guard<std::mutex> lock(state->mtx);
+
+	state->cache.clear();
+}
+
+/*
+ * Replaces getaddrinfo(), for testing. Null restores it.
+ */
+void
+resolver_set_backend(resolver_backend_t backend)
+{
+	std::lock_guard<std::mutex> lock(state->mtx);
+
+	state->backend = (backend ? backend : sys_getaddrinfo);
+	state->cache.clear();
+}
+
+void
+resolver_deinit(void)
+{
+	std::lock_guard<std::mutex> lock(state->mtx);
+
+	state->stop = true;
+	state->cancel_gen++;
+	state->queue.clear();
+	state->inflight.clear();
+	state->cache.clear();
+	state->work_cond.notify_all();
+	state->done_cond.notify_all();
+}
@@ -0,0 +1,44 @@
+#ifndef SRC_RESOLVER_H_
+#define SRC_RESOLVER_H_
+
+struct addrinfo;
+
+/*
+ * Returned by resolver_lookup() in addition to the getaddrinfo()
+ * error codes
+ */
+#define RESOLVER_CANCELED	0x7ffe
+#define RESOLVER_TIMEDOUT	0x7fff
+
+/*
+ * getaddrinfo() doesn't tell the TTLs of the records, so answers are
+ * kept for at most this many seconds. Failures are kept for a shorter
+ * while, except for temporary ones (EAI_AGAIN) which aren't kept at
+ * all.
+ */
+#define RESOLVER_TTL		300
+#define RESOLVER_NEG_TTL	30
+
+/*
+ * Longest time a caller waits for an answer
+ */
+#define RESOLVER_WAIT_MAX	30
+
+typedef int (*resolver_backend_t)(const char *, const char *,
+    const struct addrinfo *, struct addrinfo **);
+
+__SWIRC_BEGIN_DECLS
+int		 resolver_lookup(const char *host, const char *port,
+		     const struct addrinfo *hints, struct addrinfo **res);
+void		 resolver_freeaddrinfo(struct addrinfo *);
+const char	*resolver_strerror(int);
+
+void		 resolver_cancel(void);
+void		 resolver_forget(const char *host);
+void		 resolver_flush(void);
+void		 resolver_set_backend(resolver_backend_t);
+
+void		 resolver_deinit(void);
+__SWIRC_END_DECLS
+
+#endif
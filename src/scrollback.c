@@ -0,0 +1,747 @@
+/* Binary scrollback store
+   Copyright (C) 2026 Markus Uhlin. All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   - Neither the name of the author nor the names of its contributors may be
+     used to endorse or promote products derived from this software without
+     specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+   BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE. */
+
+#include "common.h"
+
+#if UNIX
+#include <sys/mman.h>
+#endif
+
+#include <stdint.h>
+
+#include "config.h"
+#include "errHand.h"
+#include "libUtils.h"
+#include "log.h"
+#include "scrollback.h"
+#include "strHand.h"
+
+#if WIN32
+#define fstat _fstat
+#define ftruncate _chsize_s
+#define stat _stat
+#endif
+
+/*
+ * A store is a header followed by records that are only ever appended.
+ * Every record ends with a copy of its length, so that the newest
+ * records can be found by walking backwards from the end of the file.
+ * The text is stored with its text decoration and a terminating null
+ * character, i.e. exactly as it's held by a text buffer, and is
+ * restored without being parsed.
+ */
+struct store_header {
+	char		magic[4];
+	uint32_t	version; /* also detects a foreign byte order */
+};
+
+struct record_head {
+	uint32_t	len; /* length of the text */
+	int32_t		indent;
+	int64_t		time;
+};
+
+#define RECORD_OVERHEAD (sizeof(struct record_head) + sizeof(uint32_t))
+
+static const struct store_header header_v1 = {
+	.magic = { 'S', 'W', 'S', 'B' },
+	.version = 1,
+};
+
+const char g_scrollback_filesuffix[5] = ".sbk";
+
+/**
+ * Get the path of the store that belongs to a log
+ *
+ * @param logpath Path returned by log_get_path()
+ * @return The path (dynamically allocated) or NULL
+ */
+char *
+scrollback_get_path(const char *logpath)
+{
+	char		*path;
+	size_t		 len;
+	const size_t	 suffix_len = strlen(g_log_filesuffix);
+
+	if (logpath == NULL || (len = strlen(logpath)) <= suffix_len ||
+	    strcmp(&logpath[len - suffix_len], g_log_filesuffix) != 0)
+		return NULL;
+	path = sw_strdup(logpath);
+	memcpy(&path[len - suffix_len], g_scrollback_filesuffix, suffix_len);
+	return path;
+}
+
+/**
+ * Get the number of lines to restore when a window is opened. Zero
+ * turns the stores off.
+ */
+int
+scrollback_lines(void)
+{
+	struct integer_context intctx = {
+		.setting_name = "scrollback_restore_lines",
+		.lo_limit = 0,
+		.hi_limit = 4700,
+		.fallback_default = 200,
+	};
+
+	return ((int) config_integer(&intctx));
+}
+
+/*
+ * Validates the record at 'start', which must end no later than 'end',
+ * and returns its length (or zero).
+ */
+static size_t
+record_len(const char *data, size_t start, size_t end)
+{
+	struct record_head	head;
+	uint32_t		tail;
+
+	if (end - start < RECORD_OVERHEAD + 1)
+		return 0;
+
+	memcpy(&head, &data[start], sizeof head);
+
+	if (head.len == 0 || head.len > SCROLLBACK_TEXT_MAX ||
+	    head.indent < 0 || head.len > end - start - RECORD_OVERHEAD)
+		return 0;
+
+	memcpy(&tail, &data[start + sizeof head + head.len], sizeof tail);
+
+	if (tail != head.len || data[start + sizeof head + head.len - 1] !=
+	    '\0')
+		return 0;
+	return (RECORD_OVERHEAD + head.len);
+}
+
+/*
+ * Walks backwards from 'end' and stores the offsets of at most
+ * 'maxlines' records in 'offs', the newest first.
+ */
+static int
+find_records(const char *data, size_t first, size_t end, size_t *offs,
+    int maxlines, size_t maxbytes)
+{
+	int	n = 0;
+	size_t	bytes = 0;
+
+	while (n < maxlines && end - first >= RECORD_OVERHEAD + 1) {
+		size_t		reclen;
+		uint32_t	tail;
+
+		memcpy(&tail, &data[end - sizeof tail], sizeof tail);
+
+		if (tail > end - first - RECORD_OVERHEAD)
+			break;
+
+		const size_t start = end - RECORD_OVERHEAD - tail;
+
+		if ((reclen = record_len(data, start, end)) != end - start ||
+		    (bytes += reclen) > maxbytes)
+			break;
+		offs[n++] = start;
+		end = start;
+	}
+
+	return n;
+}
+
+/*
+ * The end of the last intact record, found by walking forwards. Used
+ * if the last record is torn, e.g. by a full disk.
+ */
+static size_t
+find_intact_end(const char *data, size_t first, size_t end)
+{
+	size_t reclen;
+
+	while ((reclen = record_len(data, first, end)) != 0)
+		first += reclen;
+	return first;
+}
+
+/*
+ * The start of the oldest record that can be reached by walking
+ * backwards from 'end'
+ */
+static size_t
+find_oldest_record(const char *data, size_t first, size_t end)
+{
+	while (end - first >= RECORD_OVERHEAD + 1) {
+		uint32_t tail;
+
+		memcpy(&tail, &data[end - sizeof tail], sizeof tail);
+
+		if (tail > end - first - RECORD_OVERHEAD)
+			break;
+
+		const size_t start = end - RECORD_OVERHEAD - tail;
+
+		if (record_len(data, start, end) != end - start)
+			break;
+		end = start;
+	}
+
+	return end;
+}
+
+static bool
+seek_to(int fd, size_t offset)
+{
+#if defined(UNIX)
+	return (lseek(fd, (off_t) offset, SEEK_SET) == (off_t) offset);
+#elif defined(WIN32)
+	return (_lseeki64(fd, (__int64) offset, SEEK_SET) ==
+	    (__int64) offset);
+#endif
+}
+
+/*
+ * Reads at most 'want' bytes from the end of a store. The number of
+ * bytes read is stored in 'got'.
+ */
+static char *
+read_tail(int fd, size_t end, size_t want, size_t *got)
+{
+	char *data;
+
+	if (want > end - sizeof header_v1)
+		want = end - sizeof header_v1;
+
+	data = xmalloc(want + 1);
+
+	if (!seek_to(fd, end - want) ||
+	    read(fd, data, want) != (ssize_t) want) {
+		free(data);
+		return NULL;
+	}
+
+	*got = want;
+	return data;
+}
+
+/*
+ * Opens a store for reading and writing. Unless 'create' is true the
+ * store must exist and have a valid header, otherwise a missing store
+ * is created and a foreign one is emptied. The size is stored in
+ * 'size'.
+ */
+static int
+open_store(const char *path, bool create, size_t *size)
+{
+	int			fd;
+	struct stat		sb = { 0 };
+	struct store_header	hdr;
+
+#if defined(UNIX)
+	fd = open(path, O_RDWR | (create ? O_CREAT : 0), g_open_modes);
+#elif defined(WIN32)
+	if (_sopen_s(&fd, path, _O_RDWR | _O_BINARY | (create ? _O_CREAT :
+	    0), _SH_DENYWR, g_open_modes) != 0)
+		fd = -1;
+#endif
+
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &sb) != 0) {
+		(void) close(fd);
+		return -1;
+	}
+
+	*size = (size_t) sb.st_size;
+
+	if (*size >= sizeof hdr && read(fd, &hdr, sizeof hdr) ==
+	    (ssize_t) sizeof hdr && memcmp(&hdr, &header_v1, sizeof hdr) == 0)
+		return fd;
+	if (!create || ftruncate(fd, 0) != 0 || !seek_to(fd, 0) ||
+	    write(fd, &header_v1, sizeof header_v1) !=
+	    (ssize_t) sizeof header_v1) {
+		(void) close(fd);
+		return -1;
+	}
+
+	*size = sizeof header_v1;
+	return fd;
+}
+
+/*
+ * Keeps the newest records of a store that fit in 'keep' bytes, and
+ * drops the others
+ */
+static bool
+compact_store(int fd, size_t end, size_t keep)
+{
+	bool	ok;
+	char	*data;
+	size_t	got, start;
+
+	if ((data = read_tail(fd, end, keep, &got)) == NULL)
+		return false;
+
+	start = find_oldest_record(data, 0, got);
+	ok = (seek_to(fd, sizeof header_v1) &&
+	    write(fd, &data[start], got - start) == (ssize_t) (got - start) &&
+	    ftruncate(fd, sizeof header_v1 + got - start) == 0);
+	free(data);
+	return ok;
+}
+
+/*
+ * Stores that are appended to are kept open, the least recently used
+ * one is closed when another one is needed. The size is only tracked
+ * to know when to compact a store, and is refreshed when it's done.
+ */
+#define OPEN_STORES_MAX 8
+
+struct open_store {
+	char		*path;
+	int		 fd;
+	size_t		 size;
+	unsigned int	 last_use;
+};
+
+static struct open_store	open_stores[OPEN_STORES_MAX];
+static unsigned int		use_count = 0;
+
+static void
+close_store(struct open_store *store)
+{
+	if (store->path == NULL)
+		return;
+	(void) close(store->fd);
+	free(store->path);
+	store->path = NULL;
+	store->fd = -1;
+	store->size = 0;
+}
+
+/*
+ * Opens a store for appending, writing the header if it's new. Writes
+ * are appended even if the store is written by another process too.
+ */
+static bool
+open_for_append(struct open_store *store, char *path)
+{
+	struct stat sb = { 0 };
+
+#if defined(UNIX)
+	store->fd = open(path, g_open_flags[OPFL_APPEND], g_open_modes);
+#elif defined(WIN32)
+	if (_sopen_s(&store->fd, path, g_open_flags[OPFL_APPEND] | _O_BINARY,
+	    _SH_DENYWR, g_open_modes) != 0)
+		store->fd = -1;
+#endif
+
+	if (store->fd < 0) {
+		free(path);
+		return false;
+	} else if (fstat(store->fd, &sb) != 0 || (sb.st_size == 0 &&
+	    write(store->fd, &header_v1, sizeof header_v1) !=
+	    (ssize_t) sizeof header_v1)) {
+		(void) close(store->fd);
+		store->fd = -1;
+		free(path);
+		return false;
+	}
+
+	store->path = path;
+	store->size = (sb.st_size == 0 ? sizeof header_v1 :
+	    (size_t) sb.st_size);
+	return true;
+}
+
+/*
+ * Gets the open store with the given path, or opens it. Takes over
+ * 'path'.
+ */
+static struct open_store *
+get_open_store(char *path)
+{
+	struct open_store *lru = &open_stores[0];
+
+	for (struct open_store *store = &open_stores[0];
+	    store < &open_stores[OPEN_STORES_MAX]; store++) {
+		if (store->path != NULL && strcmp(store->path, path) == 0) {
+			free(path);
+			store->last_use = ++use_count;
+			return store;
+		} else if (store->path == NULL || (lru->path != NULL &&
+		    store->last_use < lru->last_use)) {
+			lru = store;
+		}
+	}
+
+	close_store(lru);
+
+	if (!open_for_append(lru, path))
+		return NULL;
+	lru->last_use = ++use_count;
+	return lru;
+}
+
+/*
+ * Compacts a store to SCROLLBACK_STORE_KEEP bytes. An appending
+ * descriptor can't overwrite the store, therefore it's reopened.
+ */
+static void
+compact_open_store(struct open_store *store)
+{
+	bool	 ok = false;
+	char	*path;
+	int	 fd;
+	size_t	 size = 0;
+
+	path = store->path;
+	store->path = NULL;
+	(void) close(store->fd);
+	store->fd = -1;
+
+	if ((fd = open_store(path, false, &size)) >= 0) {
+		ok = (size <= SCROLLBACK_STORE_MAX ||
+		    compact_store(fd, size, SCROLLBACK_STORE_KEEP));
+		(void) close(fd);
+	}
+
+	if (!ok)
+		debug("%s: cannot compact %s", __func__, path);
+	if (!open_for_append(store, path))
+		return;
+	if (!ok) {
+		/* don't retry until it has grown again */
+		store->size = SCROLLBACK_STORE_KEEP;
+	}
+}
+
+/**
+ * Append a line to the store that belongs to a log. The record is
+ * written with a single write() so that it's never interleaved with
+ * another one. Once a store has grown past SCROLLBACK_STORE_MAX bytes
+ * only its newest SCROLLBACK_STORE_KEEP bytes are kept. Not thread
+ * safe, vprinttext() serializes the calls.
+ *
+ * @param logpath Path returned by log_get_path()
+ * @param t       Time of the line
+ * @param text    Text as held by the text buffer
+ * @param indent  Indentation
+ * @return 0 on success, and -1 on failure
+ */
+int
+scrollback_msg(const char *logpath, time_t t, const char *text, int indent)
+{
+	char			*path, *rec, *cp;
+	int			 ret = -1;
+	size_t			 len, size;
+	struct open_store	*store;
+	struct record_head	 head;
+	uint32_t		 tail;
+
+	if (text == NULL || (len = strlen(text) + 1) > SCROLLBACK_TEXT_MAX ||
+	    (path = scrollback_get_path(logpath)) == NULL ||
+	    (store = get_open_store(path)) == NULL)
+		return -1;
+
+	size = RECORD_OVERHEAD + len;
+	rec = cp = xmalloc(size);
+
+	head.len = tail = (uint32_t) len;
+	head.indent = indent;
+	head.time = t;
+	memcpy(cp, &head, sizeof head);
+	cp += sizeof head;
+	memcpy(cp, text, len);
+	cp += len;
+	memcpy(cp, &tail, sizeof tail);
+
+	if (write(store->fd, rec, size) == (ssize_t) size) {
+		ret = 0;
+		if ((store->size += size) > SCROLLBACK_STORE_MAX)
+			compact_open_store(store);
+	} else {
+		close_store(store);
+	}
+
+	free(rec);
+	return ret;
+}
+
+/**
+ * Close the stores that are kept open by scrollback_msg()
+ */
+void
+scrollback_deinit(void)
+{
+	for (struct open_store *store = &open_stores[0];
+	    store < &open_stores[OPEN_STORES_MAX]; store++)
+		close_store(store);
+}
+
+/**
+ * Restore the newest lines of the store that belongs to a log into a
+ * text buffer. On UNIX the store is mapped into memory, elsewhere only
+ * its tail is read.
+ *
+ * @param logpath  Path returned by log_get_path()
+ * @param buf      Text buffer
+ * @param maxlines Max number of lines to restore
+ * @param maxbytes Max number of bytes to restore
+ * @return The number of restored lines
+ */
+int
+scrollback_restore(const char *logpath, PTEXTBUF buf, int maxlines,
+    size_t maxbytes)
+{
+	char			*path;
+	const char		*data;
+	int			 fd, n;
+	size_t			*offs;
+	size_t			 first, end;
+	struct stat		 sb = { 0 };
+	struct store_header	 hdr;
+
+	if (buf == NULL || maxlines <= 0 ||
+	    (path = scrollback_get_path(logpath)) == NULL)
+		return 0;
+
+#if defined(UNIX)
+	fd = open(path, O_RDONLY);
+#elif defined(WIN32)
+	if (_sopen_s(&fd, path, _O_RDONLY | _O_BINARY, _SH_DENYNO, 0) != 0)
+		fd = -1;
+#endif
+
+	free(path);
+
+	if (fd < 0)
+		return 0;
+	if (fstat(fd, &sb) != 0 || (size_t) sb.st_size <= sizeof hdr ||
+	    read(fd, &hdr, sizeof hdr) != (ssize_t) sizeof hdr ||
+	    memcmp(&hdr, &header_v1, sizeof hdr) != 0) {
+		(void) close(fd);
+		return 0;
+	}
+
+	end = (size_t) sb.st_size;
+
+#if defined(UNIX)
+	void *map;
+
+	if ((map = mmap(NULL, end, PROT_READ, MAP_PRIVATE, fd, 0)) ==
+	    MAP_FAILED) {
+		err_log(errno, "%s: mmap", __func__);
+		(void) close(fd);
+		return 0;
+	}
+
+	data = map;
+	first = sizeof hdr;
+#elif defined(WIN32)
+	char	*tail_buf;
+	size_t	 tail_size;
+
+	tail_size = maxbytes + (size_t) maxlines * RECORD_OVERHEAD;
+	if (tail_size > end - sizeof hdr)
+		tail_size = end - sizeof hdr;
+	tail_buf = xmalloc(tail_size);
+
+	if (_lseeki64(fd, (__int64) (end - tail_size), SEEK_SET) < 0 ||
+	    _read(fd, tail_buf, (unsigned int) tail_size) != (int) tail_size) {
+		free(tail_buf);
+		(void) close(fd);
+		return 0;
+	}
+
+	/* offsets are relative to the tail */
+	data = tail_buf;
+	first = 0;
+	end = tail_size;
+#endif
+
+	offs = xcalloc((size_t) maxlines, sizeof *offs);
+
+	if ((n = find_records(data, first, end, offs, maxlines,
+	    maxbytes)) == 0 && first == sizeof hdr) {
+		const size_t intact_end = find_intact_end(data, first, end);
+
+		if (intact_end != end) {
+			debug("%s: torn record at %zu", __func__, intact_end);
+			n = find_records(data, first, intact_end, offs,
+			    maxlines, maxbytes);
+		}
+	}
+
+	for (int i = n - 1; i >= 0; i--) {
+		struct record_head head;
+
+		memcpy(&head, &data[offs[i]], sizeof head);
+		textBuf_emplace_back(__func__, buf,
+		    &data[offs[i] + sizeof head], head.indent);
+	}
+
+	free(offs);
+#if defined(UNIX)
+	(void) munmap(map, (size_t) sb.st_size);
+#elif defined(WIN32)
+	free(tail_buf);
+#endif
+	(void) close(fd);
+	return n;
+}
+
+/**
+ * Move the oldest lines of a text buffer to a spill store, which gives
+ * them back with scrollback_unspill(). The lines are removed from the
+ * buffer even if they couldn't be written. The store only keeps the
+ * newest 'maxbytes' of what it's given.
+ *
+ * @param path      Path of the spill store, or NULL to drop the lines
+ * @param buf       Text buffer
+ * @param bytes     Bytes to free
+ * @param keeplines Lines that are never moved
+ * @param maxbytes  Max size of the store
+ * @return The number of moved lines
+ */
+int
+scrollback_spill(const char *path, PTEXTBUF buf, size_t bytes,
+    int keeplines, size_t maxbytes)
+{
+	PTEXTBUF_ELMT	 element;
+	char		*rec, *cp;
+	int		 count = 0;
+	int		 fd;
+	size_t		 freed = 0;
+	size_t		 size = 0;
+	size_t		 end;
+
+	for (element = textBuf_head(buf);
+	    element != NULL && freed < bytes &&
+	    textBuf_size(buf) - count > keeplines;
+	    element = element->next) {
+		const size_t len = strlen(element->text) + 1;
+
+		if (len <= SCROLLBACK_TEXT_MAX)
+			size += RECORD_OVERHEAD + len;
+		freed += textBuf_elmt_bytes(element);
+		count++;
+	}
+
+	if (count == 0)
+		return 0;
+	if (path != NULL && size > 0 && (fd = open_store(path, true, &end)) >=
+	    0) {
+		rec = cp = xmalloc(size);
+		element = textBuf_head(buf);
+
+		for (int i = 0; i < count; i++, element = element->next) {
+			struct record_head	head;
+			uint32_t		tail;
+			const size_t		len = strlen(element->text) + 1;
+
+			if (len > SCROLLBACK_TEXT_MAX)
+				continue;
+
+			head.len = tail = (uint32_t) len;
+			head.indent = element->indent;
+			head.time = 0;
+			memcpy(cp, &head, sizeof head);
+			cp += sizeof head;
+			memcpy(cp, element->text, len);
+			cp += len;
+			memcpy(cp, &tail, sizeof tail);
+			cp += sizeof tail;
+		}
+
+		if (!seek_to(fd, end) || write(fd, rec, size) != (ssize_t) size)
+			err_log(errno, "%s: %s", __func__, path);
+		else if (end + size > 2 * maxbytes + sizeof header_v1 &&
+		    !compact_store(fd, end + size, maxbytes))
+			err_log(errno, "%s: compact: %s", __func__, path);
+
+		free(rec);
+		(void) close(fd);
+	}
+
+	for (int i = 0; i < count; i++)
+		textBuf_pop_head(__func__, buf);
+	return count;
+}
+
+/**
+ * Give back the newest lines of a spill store to the head of a text
+ * buffer, and remove them from the store
+ *
+ * @param path     Path of the spill store
+ * @param buf      Text buffer
+ * @param maxlines Max number of lines to give back
+ * @param maxbytes Max number of bytes to give back
+ * @return The number of lines given back
+ */
+int
+scrollback_unspill(const char *path, PTEXTBUF buf, int maxlines,
+    size_t maxbytes)
+{
+	char	*data;
+	int	 fd, n;
+	size_t	*offs;
+	size_t	 end, got;
+
+	if (path == NULL || buf == NULL || maxlines <= 0 || maxbytes == 0 ||
+	    (fd = open_store(path, false, &end)) < 0)
+		return 0;
+	if (end <= sizeof header_v1 ||
+	    (data = read_tail(fd, end, maxbytes, &got)) == NULL) {
+		(void) close(fd);
+		return 0;
+	}
+
+	offs = xcalloc((size_t) maxlines, sizeof *offs);
+	n = find_records(data, 0, got, offs, maxlines, maxbytes);
+
+	for (int i = 0; i < n; i++) {
+		struct record_head	 head;
+		const char		*text = &data[offs[i] + sizeof head];
+
+		memcpy(&head, &data[offs[i]], sizeof head);
+
+		if (textBuf_size(buf) == 0) {
+			textBuf_emplace_back(__func__, buf, text, head.indent);
+		} else if ((errno = textBuf_ins_prev(buf, textBuf_head(buf),
+		    text, head.indent)) != 0) {
+			err_sys("%s: textBuf_ins_prev", __func__);
+		}
+	}
+
+	if (n > 0 && ftruncate(fd, end - got + offs[n - 1]) != 0)
+		err_log(errno, "%s: ftruncate: %s", __func__, path);
+
+	free(offs);
+	free(data);
+	(void) close(fd);
+	return n;
+}
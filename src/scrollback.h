@@ -0,0 +1,38 @@
+#ifndef SRC_SCROLLBACK_H_
+#define SRC_SCROLLBACK_H_
+
+#include <time.h>
+
+#include "textBuffer.h"
+
+/*
+ * Longest line, including its terminating null character, that is
+ * written to a store
+ */
+#define SCROLLBACK_TEXT_MAX 8192
+
+/*
+ * A store that grows past SCROLLBACK_STORE_MAX bytes is compacted to
+ * its newest SCROLLBACK_STORE_KEEP bytes
+ */
+#define SCROLLBACK_STORE_MAX	(4 * 1024 * 1024)
+#define SCROLLBACK_STORE_KEEP	(2 * 1024 * 1024)
+
+__SWIRC_BEGIN_DECLS
+extern const char	g_scrollback_filesuffix[5];
+
+char	*scrollback_get_path(const char *logpath);
+int	 scrollback_lines(void);
+int	 scrollback_msg(const char *logpath, time_t, const char *text,
+	     int indent);
+void	 scrollback_deinit(void);
+int	 scrollback_restore(const char *logpath, PTEXTBUF, int maxlines,
+	     size_t maxbytes);
+
+int	 scrollback_spill(const char *path, PTEXTBUF, size_t bytes,
+	     int keeplines, size_t maxbytes);
+int	 scrollback_unspill(const char *path, PTEXTBUF, int maxlines,
+	     size_t maxbytes);
+__SWIRC_END_DECLS
+
+#endif
@@ -65,12 +65,22 @@ signal_handler(int signum)
 	if (signum == SIGWINCH) {
 		struct timespec ts;
 
+		/*
+		 * Debounce: while a resize key is queued, further
+		 * SIGWINCHs are absorbed by it. The flag is cleared as
+		 * soon as the key is read, and term_resize_all() reads
+		 * the terminal size when it runs.
+		 */
+		if (atomic_swap_bool(&g_resize_pending, true))
+			return;
+
 		ts.tv_sec	= 0;
 		ts.tv_nsec	= 250000000;
 
-		if (nanosleep(&ts, NULL) == 0 && !atomic_load_bool
-		    (&g_connection_in_progress))
-			(void) unget_wch(MY_KEY_RESIZE);
+		if (nanosleep(&ts, NULL) != 0 || atomic_load_bool
+		    (&g_connection_in_progress) || unget_wch(MY_KEY_RESIZE) ==
+		    ERR)
+			(void) atomic_swap_bool(&g_resize_pending, false);
 	} else {
 		clean_up();
 		print_sig_message(signum);
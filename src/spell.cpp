@@ -34,10 +34,18 @@
 
 #include <climits>
 #include <clocale>
+#include <condition_variable>
 #include <cwchar>
 #include <cwctype>
+#include <deque>
+#include <list>
+#include <mutex>
 #include <stdexcept>
 #include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 
 #include "commands/fetchdic.h"
 
@@ -50,22 +58,70 @@
 #include "main.h"
 #include "nestHome.h"
 #include "printtext.h"
+#include "readlineAPI.h"
 #include "spell.h"
 #include "strHand.h"
+#include "terminal.h"
 #ifdef UNIX
 #include "swircpaths.h"
 #endif
 #endif // HAVE_HUNSPELL
 
 #define MAXWORDLEN 50
+#define SPELL_CACHE_SIZE 512
 
 bool g_suggs_mode = false;
 
 #ifdef HAVE_HUNSPELL
+/*
+ * The result of checking one word. The suggestions are only computed
+ * on demand since Hunspell_suggest() is what's slow.
+ */
+struct spell_result {
+	bool correct;
+	bool suggs_done;
+	std::vector<std::string> suggs;
+
+	spell_result()
+	    : correct(false)
+	    , suggs_done(false)
+	{}
+};
+
+struct spell_request {
+	std::string word;
+	bool want_suggs;
+};
+
+using spell_lru_t = std::list<std::pair<std::string, spell_result>>;
+
 static Hunhandle			*pHunspell = nullptr;
-static std::vector<sugg_ptr>		*rl_suggs = nullptr;
-static std::vector<sugg_ptr>::iterator	 suggs_it;
-static std::wstring			 rl_word;
+static std::mutex			 hunspell_mtx;
+
+/*
+ * Worker thread state. 'spell_mtx' guards everything below, up to and
+ * including the cache.
+ */
+static std::condition_variable		 spell_cond;
+static std::deque<spell_request>	 spell_queue;
+static std::mutex			 spell_mtx;
+static std::thread			 spell_thread;
+static bool				 spell_stop = false;
+
+static spell_lru_t			 spell_lru;
+static std::unordered_map<std::string, spell_lru_t::iterator>
+					 spell_cache;
+
+/*
+ * Readline state. Only accessed by the readline thread.
+ */
+static std::vector<std::wstring>		 rl_suggs;
+static std::vector<std::wstring>::iterator	 suggs_it;
+static std::wstring				 rl_word;
+static std::string				 rl_pending;
+static int					 rl_pending_pos = -1;
+static std::wstring				 inline_word;
+static int					 inline_pos = -1;
 
 suggestion::suggestion()
     : word(nullptr)
@@ -192,6 +248,203 @@ suggestion::get_wide_word(void) const
 	return (this->wide_word);
 }
 
+/*
+ * Looks up a word in the cache and marks it as most recently used.
+ * Call with 'spell_mtx' locked.
+ */
+static spell_result *
+cache_lookup(const std::string &word)
+{
+	auto it = spell_cache.find(word);
+
+	if (it == spell_cache.end())
+		return nullptr;
+	spell_lru.splice(spell_lru.begin(), spell_lru, it->second);
+	return &(it->second->second);
+}
+
+/*
+ * Call with 'spell_mtx' locked.
+ */
+static void
+cache_store(const std::string &word, spell_result &&res)
+{
+	auto it = spell_cache.find(word);
+
+	if (it != spell_cache.end()) {
+		it->second->second = std::move(res);
+		spell_lru.splice(spell_lru.begin(), spell_lru, it->second);
+		return;
+	}
+
+	spell_lru.emplace_front(word, std::move(res));
+	spell_cache[word] = spell_lru.begin();
+
+	while (spell_lru.size() > SPELL_CACHE_SIZE) {
+		spell_cache.erase(spell_lru.back().first);
+		spell_lru.pop_back();
+	}
+}
+
+static inline bool
+is_satisfied(const spell_result *res, const bool want_suggs)
+{
+	return (res != nullptr && (!want_suggs || res->correct ||
+	    res->suggs_done));
+}
+
+static spell_result
+compute_result(const std::string &word, const bool want_suggs)
+{
+	std::lock_guard<std::mutex>	lock(hunspell_mtx);
+	spell_result			res;
+
+	if (pHunspell == nullptr) {
+		res.correct = true;
+		res.suggs_done = true;
+		return res;
+	}
+
+	res.correct = (Hunspell_spell(pHunspell, word.c_str()) != 0);
+
+	if (!res.correct && want_suggs) {
+		char	**list;
+		int	  nsuggs;
+
+		if ((nsuggs = Hunspell_suggest(pHunspell, &list,
+		    word.c_str())) > 0) {
+			for (int i = 0; i < nsuggs; i++)
+				res.suggs.emplace_back(list[i]);
+			Hunspell_free_list(pHunspell, &list, nsuggs);
+		}
+
+		res.suggs_done = true;
+	}
+
+	return res;
+}
+
+static void
+spell_worker(void)
+{
+	for (;;) {
+		spell_request req;
+
+		{
+			std::unique_lock<std::mutex> lock(spell_mtx);
+
+			spell_cond.wait(lock, [] {
+				return (spell_stop || !spell_queue.empty());
+			});
+			if (spell_stop)
+				break;
+			req = std::move(spell_queue.front());
+			spell_queue.pop_front();
+
+			if (is_satisfied(cache_lookup(req.word),
+			    req.want_suggs))
+				continue;
+		}
+
+		spell_result res(compute_result(req.word, req.want_suggs));
+
+		std::lock_guard<std::mutex> lock(spell_mtx);
+		cache_store(req.word, std::move(res));
+	}
+}
+
+static void
+start_worker(void)
+{
+	try {
+		spell_stop = false;
+		spell_thread = std::thread(spell_worker);
+	} catch (const std::system_error &e) {
+		err_log(0, "%s: %s", __func__, e.what());
+	}
+}
+
+static void
+stop_worker(void)
+{
+	if (!spell_thread.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(spell_mtx);
+		spell_stop = true;
+	}
+
+	spell_cond.notify_one();
+	spell_thread.join();
+}
+
+static void
+clear_cache(void)
+{
+	std::lock_guard<std::mutex> lock(spell_mtx);
+
+	spell_queue.clear();
+	spell_cache.clear();
+	spell_lru.clear();
+}
+
+/*
+ * Returns the result for the given word, computing it in the calling
+ * thread if it isn't cached.
+ */
+static spell_result
+get_result_now(const std::string &word, const bool want_suggs)
+{
+	{
+		std::lock_guard<std::mutex>	lock(spell_mtx);
+		const spell_result		*res;
+
+		if (is_satisfied((res = cache_lookup(word)), want_suggs))
+			return *res;
+	}
+
+	spell_result res(compute_result(word, want_suggs));
+
+	std::lock_guard<std::mutex> lock(spell_mtx);
+	cache_store(word, spell_result(res));
+	return res;
+}
+
+/*
+ * Copies the cached result for the given word into 'out' if it's
+ * available. If not: the word is queued for the worker and false is
+ * returned. Without a worker the result is computed right away.
+ */
+static bool
+request_result(const std::string &word, const bool want_suggs,
+    spell_result &out)
+{
+	std::unique_lock<std::mutex>	lock(spell_mtx);
+	const spell_result		*res;
+
+	if (is_satisfied((res = cache_lookup(word)), want_suggs)) {
+		out = *res;
+		return true;
+	} else if (!spell_thread.joinable()) {
+		lock.unlock();
+		out = get_result_now(word, want_suggs);
+		return true;
+	}
+
+	for (spell_request &req : spell_queue) {
+		if (req.word == word) {
+			req.want_suggs = (req.want_suggs || want_suggs);
+			return false;
+		}
+	}
+
+	spell_queue.push_back({ word, want_suggs });
+	lock.unlock();
+	spell_cond.notify_one();
+	return false;
+}
+
 void
 spell_init(bool report_nonexistent)
 {
@@ -225,6 +478,9 @@ spell_init(bool report_nonexistent)
 		}
 	}
 
+	stop_worker();
+	clear_cache();
+
 	if (pHunspell)
 		Hunspell_destroy(pHunspell);
 
@@ -232,12 +488,19 @@ spell_init(bool report_nonexistent)
 	if ((pHunspell = Hunspell_create(aff.c_str(), dic.c_str())) == nullptr)
 		printtext_print("err", "%s: error", __func__);
 	restore_stderr();
+
+	if (pHunspell)
+		start_worker();
 }
 
 void
 spell_deinit(void)
 {
 	g_suggs_mode = false;
+	spell_readline_reset();
+
+	stop_worker();
+	clear_cache();
 
 	if (pHunspell)
 		Hunspell_destroy(pHunspell);
@@ -283,42 +546,69 @@ get_mbs(CWSTRING wcs)
 	return out;
 }
 
+/*
+ * Converts a wide-character word to its multibyte form. Returns an
+ * empty string if it's too long or can't be converted.
+ */
+static std::string
+get_mbs_word(const std::wstring &wcs)
+{
+	STRING		mbs;
+	std::string	out("");
+
+	if (wcs.empty() || wcs.size() > MAXWORDLEN ||
+	    (mbs = get_mbs(wcs.c_str())) == nullptr)
+		return out;
+	out.assign(mbs);
+	free(mbs);
+	return out;
+}
+
+static std::wstring
+get_wcs_word(const std::string &mbs)
+{
+	std::wstring	out(mbs.size() + 1, L'\0');
+	size_t		len;
+
+	if ((len = xmbstowcs(&out[0], mbs.c_str(), mbs.size())) ==
+	    g_conversion_failed)
+		return L"";
+	out.resize(len);
+	return out;
+}
+
 std::vector<sugg_ptr> *
 spell_get_suggs(CSTRING mbs, CWSTRING wcs)
 {
-	char**			 list;
-	int			 nsuggs;
+	spell_result		 res;
+	std::string		 word("");
 	std::vector<sugg_ptr>	*suggs;
 	sugg_ptr		 ptr;
 
 	if (mbs == nullptr && wcs == nullptr)
 		return nullptr;
-	else if (mbs) {
-		if (strcmp(mbs, "") == STRINGS_MATCH ||
-		    (nsuggs = Hunspell_suggest(pHunspell, &list, mbs)) < 1)
-			return nullptr;
-	} else if (wcs) {
-		STRING word;
-
-		if (wcscmp(wcs, L"") == STRINGS_MATCH ||
-		    wcslen(wcs) > MAXWORDLEN)
-			return nullptr;
-
-		if ((word = get_mbs(wcs)) == nullptr ||
-		    (nsuggs = Hunspell_suggest(pHunspell, &list, word)) < 1) {
-			free(word);
-			return nullptr;
-		}
-
-		free(word);
-	} else
+	else if (mbs)
+		word.assign(mbs);
+	else if (wcs)
+		word = get_mbs_word(wcs);
+	else
 		sw_assert_not_reached();
 
+	if (word.empty())
+		return nullptr;
+
+	res = get_result_now(word, true);
+
+	if (res.correct || res.suggs.empty())
+		return nullptr;
+
 	suggs = new std::vector<sugg_ptr>();
 
-	for (int i = 0; i < nsuggs; i++) {
+	for (const std::string &str : res.suggs) {
+		ptr = nullptr;
+
 		try {
-			ptr = new suggestion(list[i]);
+			ptr = new suggestion(str.c_str());
 			suggs->push_back(ptr);
 		} catch (const std::bad_alloc &e) {
 			err_exit(ENOMEM, "%s: fatal: %s", __func__, e.what());
@@ -331,7 +621,6 @@ spell_get_suggs(CSTRING mbs, CWSTRING wcs)
 		}
 	}
 
-	Hunspell_free_list(pHunspell, &list, nsuggs);
 	return suggs;
 }
 
@@ -371,7 +660,7 @@ spell_word(CSTRING word)
 	if (pHunspell == nullptr || word == nullptr ||
 	    strcmp(word, "") == STRINGS_MATCH)
 		return false;
-	return (Hunspell_spell(pHunspell, word) != 0 ? true : false);
+	return get_result_now(word, false).correct;
 }
 
 static void
@@ -392,41 +681,79 @@ type_word(volatile struct readline_session_context *ctx,
 static void
 auto_complete_next_sugg(volatile struct readline_session_context *ctx)
 {
-	std::wstring	 word(L"");
-	sugg_ptr	 ptr;
+	std::wstring word(L"");
 
-	if (suggs_it == rl_suggs->end()) {
+	if (suggs_it == rl_suggs.end()) {
 		printtext_print("warn", "%s", _("no more suggestions"));
 		g_suggs_mode = false;
-		spell_destroy_suggs(rl_suggs);
-		rl_suggs = nullptr;
+		rl_suggs.clear();
 		return;
 	}
 
 	if (!rl_word.empty())
 		word.assign(rl_word);
-	else {
-		ptr = *(suggs_it - 1);
-		word.assign(ptr->get_wide_word());
-	}
+	else
+		word.assign(*(suggs_it - 1));
 
 	erase_word(ctx, word.size());
 	if (!rl_word.empty())
 		rl_word.assign(L"");
 
-	ptr = *suggs_it;
-	word.assign(ptr->get_wide_word());
-	type_word(ctx, word);
+	type_word(ctx, *suggs_it);
 	++suggs_it;
 }
 
 static void
-print_suggestions(std::vector<sugg_ptr> *suggs)
+print_suggestions(const std::vector<std::wstring> &suggs)
 {
 	printtext_print(nullptr, "%s", _("suggestions:"));
 
-	for (auto it = suggs->begin(); it != suggs->end(); ++it)
-		printtext_print(nullptr, "  %ls", (*it)->get_wide_word());
+	for (const std::wstring &str : suggs)
+		printtext_print(nullptr, "  %ls", str.c_str());
+}
+
+/*
+ * Outputs the result for 'rl_word' and enters suggestions mode if
+ * there's anything to cycle through.
+ */
+static void
+report_result(const spell_result &res)
+{
+	if (res.correct) {
+		printtext_print("success", _("%ls is correct"),
+		    rl_word.c_str());
+		return;
+	}
+
+	printtext_print("err", _("%ls is incorrect"), rl_word.c_str());
+
+	rl_suggs.clear();
+	for (const std::string &str : res.suggs) {
+		std::wstring wcs(get_wcs_word(str));
+
+		if (!wcs.empty())
+			rl_suggs.push_back(std::move(wcs));
+	}
+	if (rl_suggs.empty())
+		return;
+	print_suggestions(rl_suggs);
+	g_suggs_mode = true;
+	suggs_it = rl_suggs.begin();
+}
+
+/*
+ * Returns the start of the word ending at 'end', or -1.
+ */
+static int
+get_word_start(volatile struct readline_session_context *ctx, const int end)
+{
+	int pos = end;
+
+	if (end < 1 || !iswalpha(ctx->buffer[end - 1]))
+		return -1;
+	while (pos != 0 && iswalpha(ctx->buffer[pos - 1]))
+		pos--;
+	return pos;
 }
 
 void
@@ -437,62 +764,169 @@ spell_word_readline(volatile struct readline_session_context *ctx)
 		return;
 
 	if (!g_suggs_mode) {
-		int pos;
+		int		pos;
+		spell_result	res;
+		std::string	word("");
 
 		if (ctx->bufpos < 1)
 			return;
-		pos = ctx->bufpos;
-
-		if ((ctx->buffer[pos] != L'\0' && ctx->buffer[pos] != L' ') ||
-		    !iswalpha(ctx->buffer[pos - 1]))
+		if ((ctx->buffer[ctx->bufpos] != L'\0' &&
+		    ctx->buffer[ctx->bufpos] != L' ') ||
+		    (pos = get_word_start(ctx, ctx->bufpos)) < 0)
 			return;
-		while (pos != 0 && iswalpha(ctx->buffer[pos - 1]))
-			pos--;
 		rl_word.assign(&ctx->buffer[pos], ctx->bufpos - pos);
+		rl_pending.assign("");
+		rl_pending_pos = -1;
 
-		if (spell_wide_word(rl_word.c_str())) {
-			printtext_print("success", _("%ls is correct"),
+		if ((word = get_mbs_word(rl_word)).empty()) {
+			printtext_print("err", _("%ls is incorrect"),
+			    rl_word.c_str());
+			return;
+		} else if (!request_result(word, true, res)) {
+			rl_pending.assign(word);
+			rl_pending_pos = pos;
+			printtext_print("sp1", _("checking %ls..."),
 			    rl_word.c_str());
 			return;
 		}
 
-		printtext_print("err", _("%ls is incorrect"), rl_word.c_str());
-
-		if (rl_suggs)
-			spell_destroy_suggs(rl_suggs);
-		if ((rl_suggs = spell_get_suggs(nullptr, rl_word.c_str())) ==
-		    nullptr)
-			return;
-		print_suggestions(rl_suggs);
-		g_suggs_mode = true;
-		suggs_it = rl_suggs->begin();
+		report_result(res);
 		return;
 	}
 
-	if (rl_suggs)
+	if (!rl_suggs.empty())
 		auto_complete_next_sugg(ctx);
 	else
-		err_log(EINVAL, "%s: readline suggestions null", __func__);
+		err_log(EINVAL, "%s: readline suggestions empty", __func__);
+}
+
+/*
+ * Reports a pending F2 lookup once the worker has finished it, as long
+ * as the word is still under the cursor.
+ */
+static void
+poll_pending(volatile struct readline_session_context *ctx)
+{
+	const int	len = size_to_int(rl_word.size());
+	spell_result	res;
+
+	if (g_suggs_mode || rl_pending_pos + len != ctx->bufpos ||
+	    (ctx->buffer[ctx->bufpos] != L'\0' &&
+	    ctx->buffer[ctx->bufpos] != L' ') ||
+	    rl_word.compare(0, len, &ctx->buffer[rl_pending_pos], len) != 0) {
+		rl_pending.assign("");
+		rl_pending_pos = -1;
+		return;
+	} else if (!request_result(rl_pending, true, res)) {
+		return;
+	}
+
+	rl_pending.assign("");
+	rl_pending_pos = -1;
+	report_result(res);
+}
+
+static int
+get_width(volatile struct readline_session_context *ctx, int from,
+    const int to)
+{
+	int width = 0;
+
+	while (from < to)
+		width += readline_wcwidth(ctx->buffer[from++], FWLEN);
+	return width;
+}
+
+/*
+ * Underlines the word at [start, end) in the readline window, if it's
+ * entirely visible. The word must end before the cursor.
+ */
+static void
+underline_word(volatile struct readline_session_context *ctx,
+    const int start, const int end)
+{
+	const int			len = get_width(ctx, start, end);
+	int				col;
+	short int			pair;
+	struct current_cursor_pos	yx;
+
+	yx = term_get_pos(ctx->act);
+	col = yx.curx - get_width(ctx, end, ctx->bufpos) - len;
+
+	if (col < ctx->prompt_size)
+		return;
+
+	mutex_lock(&g_puts_mutex);
+	pair = static_cast<short int>(PAIR_NUMBER(mvwinch(ctx->act, yx.cury,
+	    col) & A_COLOR));
+	(void) mvwchgat(ctx->act, yx.cury, col, len, A_UNDERLINE, pair,
+	    nullptr);
+	(void) wmove(ctx->act, yx.cury, yx.curx);
+	(void) wrefresh(ctx->act);
+	mutex_unlock(&g_puts_mutex);
+}
+
+/*
+ * Inline mode: checks the word that was just completed (i.e. the word
+ * before the char preceding the cursor) and underlines it if it's
+ * misspelled. The check is queued and picked up at a later poll.
+ */
+static void
+check_inline(volatile struct readline_session_context *ctx)
+{
+	const int	end = ctx->bufpos - 1;
+	int		start;
+	spell_result	res;
+	std::string	mbs("");
+	std::wstring	word(L"");
+
+	if (end < 1 || iswalpha(ctx->buffer[end]) ||
+	    (start = get_word_start(ctx, end)) < 0)
+		return;
+	word.assign(&ctx->buffer[start], end - start);
+	if (start == inline_pos && word == inline_word)
+		return;
+
+	if (!(mbs = get_mbs_word(word)).empty() &&
+	    !request_result(mbs, false, res))
+		return;
+
+	inline_pos = start;
+	inline_word.assign(word);
+
+	if (!mbs.empty() && !res.correct)
+		underline_word(ctx, start, end);
+}
+
+void
+spell_readline_poll(volatile struct readline_session_context *ctx)
+{
+	if (pHunspell == nullptr || !config_bool("spell", true))
+		return;
+	if (rl_pending_pos >= 0)
+		poll_pending(ctx);
+	if (config_bool("spell_inline", false))
+		check_inline(ctx);
+}
+
+void
+spell_readline_reset(void)
+{
+	rl_pending.assign("");
+	rl_pending_pos = -1;
+	inline_word.assign(L"");
+	inline_pos = -1;
 }
 
 bool
 spell_wide_word(CWSTRING word)
 {
-	STRING	mbs;
-	bool	ret;
+	std::string mbs("");
 
 	if (pHunspell == nullptr || word == nullptr ||
-	    wcscmp(word, L"") == STRINGS_MATCH ||
-	    wcslen(word) > MAXWORDLEN)
-		return false;
-
-	if ((mbs = get_mbs(word)) == nullptr)
+	    (mbs = get_mbs_word(word)).empty())
 		return false;
-
-	ret = (Hunspell_spell(pHunspell, mbs) != 0 ? true : false);
-	free(mbs);
-
-	return ret;
+	return get_result_now(mbs, false).correct;
 }
 #else
 #pragma message("Consider installing Hunspell")
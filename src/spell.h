@@ -46,6 +46,8 @@ void	 spell_test2(CWSTRING);
 
 bool	 spell_word(CSTRING);
 void	 spell_word_readline(volatile struct readline_session_context *);
+void	 spell_readline_poll(volatile struct readline_session_context *);
+void	 spell_readline_reset(void);
 bool	 spell_wide_word(CWSTRING);
 #endif // HAVE_HUNSPELL
 __SWIRC_END_DECLS
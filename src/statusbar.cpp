@@ -40,6 +40,7 @@
 #include "errHand.h"
 #include "i18n.h"
 #include "irc.h"
+#include "perf.h"
 #include "printtext.h"
 #include "readline.h"
 #include "statusbar.h"
@@ -231,6 +232,8 @@ statusbar_update(void)
 	if (term_is_too_small())
 		return;
 
+	perf_scope scope(PERF_STATUSBAR_UPDATE);
+
 	pair_n = get_pair_num();
 	win = panel_window(statusbar_pan);
 
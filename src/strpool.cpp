@@ -0,0 +1,223 @@
+/* Interned strings
+   Copyright (C) 2026 Markus Uhlin. All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   - Neither the name of the author nor the names of its contributors may be
+     used to endorse or promote products derived from this software without
+     specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+   BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE. */
+
+#include "common.h"
+
+#include <cstring>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+#include "isupport.h"
+#include "libUtils.h"
+#include "strpool.h"
+
+/*
+ * Precedes the characters of each interned string
+ */
+struct strpool_entry {
+	unsigned int	refs;
+	unsigned int	hash;
+	size_t		len;
+};
+
+static unsigned int
+djb(std::string_view sv)
+{
+	unsigned int hashval = 5381;
+
+	for (const char c : sv)
+		hashval = ((hashval << 5) + hashval) + c;
+	return hashval;
+}
+
+struct view_hash {
+	size_t
+	operator()(std::string_view sv) const
+	{
+		return djb(sv);
+	}
+};
+
+static std::mutex pool_mtx;
+static std::unordered_map<std::string_view, strpool_entry *, view_hash> pool;
+
+static inline strpool_entry *
+entry_of(const char *str)
+{
+	return (reinterpret_cast<strpool_entry *>(const_cast<char *>(str)) -
+	    1);
+}
+
+static inline char *
+chars_of(strpool_entry *entry)
+{
+	return reinterpret_cast<char *>(entry + 1);
+}
+
+static const char *
+intern(std::string_view sv)
+{
+	std::lock_guard<std::mutex> lock(pool_mtx);
+	const auto it = pool.find(sv);
+
+	if (it != pool.end()) {
+		it->second->refs++;
+		return chars_of(it->second);
+	}
+
+	strpool_entry *entry = static_cast<strpool_entry *>
+	    (xmalloc(sizeof *entry + sv.size() + 1));
+	char *chars = chars_of(entry);
+
+	entry->refs = 1;
+	entry->hash = djb(sv);
+	entry->len = sv.size();
+	memcpy(chars, sv.data(), sv.size());
+	chars[sv.size()] = '\0';
+
+	(void) pool.emplace(std::string_view(chars, sv.size()), entry);
+	return chars;
+}
+
+static const char *
+find(std::string_view sv)
+{
+	std::lock_guard<std::mutex> lock(pool_mtx);
+	const auto it = pool.find(sv);
+
+	return (it != pool.end() ? chars_of(it->second) : nullptr);
+}
+
+/*
+ * Returns an interned copy of 'str', with a reference taken, or NULL
+ * if 'str' is NULL.
+ */
+const char *
+strpool_intern(const char *str)
+{
+	if (str == nullptr)
+		return nullptr;
+	return intern(str);
+}
+
+/*
+ * Like strpool_intern() but interns the key of 'name'
+ */
+const char *
+strpool_intern_key(const char *name)
+{
+	char key[ISUPPORT_KEY_MAX];
+
+	if (name == nullptr)
+		return nullptr;
+	return intern(isupport_fold(name, key, sizeof key));
+}
+
+/*
+ * Returns the interned copy of 'str' without taking a reference, or
+ * NULL if 'str' isn't interned.
+ */
+const char *
+strpool_find(const char *str)
+{
+	if (str == nullptr)
+		return nullptr;
+	return find(str);
+}
+
+const char *
+strpool_find_key(const char *name)
+{
+	char key[ISUPPORT_KEY_MAX];
+
+	if (name == nullptr)
+		return nullptr;
+	return find(isupport_fold(name, key, sizeof key));
+}
+
+/*
+ * Takes another reference of an interned string
+ */
+const char *
+strpool_ref(const char *str)
+{
+	if (str != nullptr) {
+		std::lock_guard<std::mutex> lock(pool_mtx);
+
+		entry_of(str)->refs++;
+	}
+
+	return str;
+}
+
+/*
+ * Gives back a reference. The string is freed with the last one.
+ */
+void
+strpool_release(const char *str)
+{
+	if (str == nullptr)
+		return;
+
+	std::lock_guard<std::mutex> lock(pool_mtx);
+	strpool_entry *entry = entry_of(str);
+
+	if (--entry->refs > 0)
+		return;
+	(void) pool.erase(std::string_view(str, entry->len));
+	free(entry);
+}
+
+/*
+ * Returns the hash of an interned string. Reduced modulo N it equals
+ * isupport_key_hash(str, N).
+ */
+unsigned int
+strpool_hash(const char *str)
+{
+	return entry_of(str)->hash;
+}
+
+size_t
+strpool_len(const char *str)
+{
+	return entry_of(str)->len;
+}
+
+/*
+ * Returns the number of distinct strings in the pool
+ */
+size_t
+strpool_size(void)
+{
+	std::lock_guard<std::mutex> lock(pool_mtx);
+
+	return pool.size();
+}
@@ -0,0 +1,28 @@
+#ifndef SRC_STRPOOL_H_
+#define SRC_STRPOOL_H_
+
+/*
+ * Interned strings: one counted copy of each, shared by everybody who
+ * interned it, and with its hash computed once. Two interned strings
+ * are equal if, and only if, the pointers are.
+ *
+ * The keys returned by strpool_intern_key() are names case-folded by
+ * the casemapping of the server, which makes case variants of a nick
+ * or channel the same pointer.
+ */
+
+__SWIRC_BEGIN_DECLS
+const char	*strpool_intern(const char *);
+const char	*strpool_intern_key(const char *name);
+const char	*strpool_find(const char *);
+const char	*strpool_find_key(const char *name);
+
+const char	*strpool_ref(const char *);
+void		 strpool_release(const char *);
+
+unsigned int	 strpool_hash(const char *);
+size_t		 strpool_len(const char *);
+size_t		 strpool_size(void);
+__SWIRC_END_DECLS
+
+#endif
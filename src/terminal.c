@@ -39,6 +39,7 @@
 #include "titlebar.h"
 #include "window.h"
 
+volatile bool g_resize_pending = false;
 volatile bool g_resizing_term = false;
 
 static const short int TermMinimumRows = 10;
@@ -117,8 +118,10 @@ term_remove_panel(PANEL *pan)
 void
 term_resize_all(void)
 {
-	const struct winsize	size = term_get_size();
-	int			rows, cols;
+	struct winsize	size;
+	int		rows, cols;
+
+	size = term_get_size();
 
 	if (size.ws_row < TermMinimumRows || size.ws_col < TermMinimumCols ||
 	    !is_term_resized(size.ws_row, size.ws_col) ||
@@ -41,6 +41,7 @@ struct current_cursor_pos {
 };
 
 __SWIRC_BEGIN_DECLS
+extern volatile bool g_resize_pending;
 extern volatile bool g_resizing_term;
 
 void	 term_init(void);
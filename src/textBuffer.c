@@ -1,10 +1,12 @@
 /* Text storage with help of a linked list algorithm. ISBN: 978-1-56592-453-6 */
 
 #include "common.h"
+
+#include <string.h>
+
 #include "assertAPI.h"
 #include "errHand.h"
 #include "libUtils.h"
-#include "strHand.h"
 #include "textBuffer.h"
 
 static int
@@ -16,14 +18,21 @@ check_args(PTEXTBUF buf, PTEXTBUF_ELMT element, const char *text)
 	return 0;
 }
 
+/*
+ * The element and its text share one allocation
+ */
 static PTEXTBUF_ELMT
 get_new_elmt(const char *text, int indent)
 {
 	PTEXTBUF_ELMT	new_element;
+	const size_t	size = strlen(text) + 1;
 
-	new_element = xcalloc(sizeof *new_element, 1);
-	new_element->text = sw_strdup(text);
+	new_element = xmalloc(sizeof *new_element + size);
+	new_element->text = (char *) (new_element + 1);
+	memcpy(new_element->text, text, size);
 	new_element->indent = indent;
+	new_element->prev = NULL;
+	new_element->next = NULL;
 
 	return new_element;
 }
@@ -43,6 +52,7 @@ textBuf_new(void)
 	PTEXTBUF	buf = xcalloc(sizeof *buf, 1);
 
 	buf->size = 0;
+	buf->bytes = 0;
 	buf->head = NULL;
 	buf->tail = NULL;
 
@@ -106,6 +116,7 @@ textBuf_ins_next(PTEXTBUF buf, PTEXTBUF_ELMT element, const char *text,
 	}
 
 	(buf->size)++;
+	buf->bytes += textBuf_elmt_bytes(new_element);
 	return 0;
 }
 
@@ -137,6 +148,7 @@ textBuf_ins_prev(PTEXTBUF buf, PTEXTBUF_ELMT element, const char *text,
 	}
 
 	(buf->size)++;
+	buf->bytes += textBuf_elmt_bytes(new_element);
 	return 0;
 }
 
@@ -162,7 +174,7 @@ textBuf_remove(PTEXTBUF buf, PTEXTBUF_ELMT element)
 			element->next->prev = element->prev;
 	}
 
-	free(element->text);
+	buf->bytes -= textBuf_elmt_bytes(element);
 	free(element);
 
 	(buf->size)--;
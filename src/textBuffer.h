@@ -1,6 +1,8 @@
 #ifndef TEXTBUFFER_H
 #define TEXTBUFFER_H
 
+#include <string.h>
+
 #include "atomicops.h"
 
 typedef struct tagTEXTBUF_ELMT {
@@ -12,6 +14,7 @@ typedef struct tagTEXTBUF_ELMT {
 
 typedef struct tagTEXTBUF {
 	_Atomic(int)	size;
+	_Atomic(size_t)	bytes; /* memory held by the elements */
 	PTEXTBUF_ELMT	head;
 	PTEXTBUF_ELMT	tail;
 } TEXTBUF, *PTEXTBUF;
@@ -41,6 +44,21 @@ textBuf_size(const TEXTBUF *buf)
 	return (buf->size);
 }
 
+static SW_INLINE size_t
+textBuf_bytes(const TEXTBUF *buf)
+{
+	return (buf->bytes);
+}
+
+/*
+ * Memory held by an element
+ */
+static SW_INLINE size_t
+textBuf_elmt_bytes(const TEXTBUF_ELMT *element)
+{
+	return (sizeof *element + strlen(element->text) + 1);
+}
+
 static SW_INLINE PTEXTBUF_ELMT
 textBuf_head(const TEXTBUF *buf)
 {
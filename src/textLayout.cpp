@@ -0,0 +1,258 @@
+/* Text layout: word wrapping of decoded lines
+   Copyright (C) 2026 Markus Uhlin. All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   - Neither the name of the author nor the names of its contributors may be
+     used to endorse or promote products derived from this software without
+     specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+   BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE. */
+
+#include "common.h"
+
+#include "dataClassify.h"
+#include "printtext.h"
+#include "textLayout.h"
+
+/*
+ * Display width of a character. Control characters, including the
+ * text decoration, occupy no columns.
+ */
+static int
+char_width(const wchar_t wc)
+{
+	if (wc < 0x20 || (wc >= 0x7F && wc < 0xA0))
+		return 0;
+	return xwcwidth(wc, 2);
+}
+
+static inline bool
+is_digit(const wchar_t wc)
+{
+	return (wc >= L'0' && wc <= L'9');
+}
+
+/*
+ * Width of the word starting at 'wcp', i.e. up to the next space,
+ * newline or end of line
+ */
+static int
+word_width(const wchar_t *wcp)
+{
+	int width = 0;
+
+	while (*wcp != L'\0' && *wcp != L' ' && *wcp != L'\n') {
+		if (*wcp == COLOR) {
+			wcp += textLayout_color_len(wcp);
+			continue;
+		}
+		width += char_width(*wcp++);
+	}
+
+	return width;
+}
+
+/**
+ * Get the length of a color code, i.e. ^C followed by an optional
+ * foreground with one or two digits and an optional background with a
+ * comma and one or two digits.
+ *
+ * @param wcp Points to the ^C
+ * @return The number of characters that make up the color code
+ */
+size_t
+textLayout_color_len(const wchar_t *wcp)
+{
+	size_t len = 1;
+
+	if (!is_digit(wcp[len]))
+		return len;
+	if (is_digit(wcp[++len]))
+		len++;
+	if (wcp[len] == L',' && is_digit(wcp[len + 1])) {
+		len += 2;
+
+		if (is_digit(wcp[len]))
+			len++;
+	}
+
+	return len;
+}
+
+/**
+ * Get the indent that a layout with the given width uses. An indent
+ * that leaves no room for the text is dropped.
+ */
+int
+textLayout_indent(int cols, int indent)
+{
+	return (indent > 0 && indent < cols ? indent : 0);
+}
+
+/**
+ * Compute the rows of a line when it's wrapped to the given number of
+ * columns. Rows are broken at the space preceding a word that doesn't
+ * fit, and words that are too long for a row of their own are broken
+ * at the last character that fits. Every row but the first is indented
+ * with 'indent' blanks.
+ *
+ * @param[in]  text    Decoded line
+ * @param[in]  cols    Columns available
+ * @param[in]  indent  Indent of continuation rows
+ * @param[out] rows    Array where the rows are stored
+ * @param[in]  maxrows Size of the array
+ * @return The total number of rows, which may be greater than
+ *         'maxrows'. In that case, only the first 'maxrows' rows are
+ *         stored.
+ */
+size_t
+textLayout_wrap(const wchar_t *text, int cols, int indent,
+    struct layout_row *rows, size_t maxrows)
+{
+	int	col = 0;
+	int	row_col = 0;
+	size_t	i = 0;
+	size_t	nrows = 0;
+	size_t	start = 0;
+
+	if (cols < 1)
+		cols = 1;
+	indent = textLayout_indent(cols, indent);
+
+#define ADD_ROW(_end, _next) do {			\
+		if (nrows < maxrows) {			\
+			rows[nrows].start = start;	\
+			rows[nrows].end = _end;		\
+		}					\
+		nrows++;				\
+		start = _next;				\
+		col = row_col = indent;			\
+	} while (0)
+
+	while (text[i] != L'\0') {
+		const wchar_t	wc = text[i];
+		int		width;
+
+		if (wc == L'\n') {
+			ADD_ROW(i, i + 1);
+			i++;
+			continue;
+		} else if (wc == COLOR) {
+			i += textLayout_color_len(&text[i]);
+			continue;
+		} else if (wc == L' ') {
+			const int next = word_width(&text[i + 1]);
+
+			if (col + 1 + next <= cols) {
+				col++;
+			} else if (text[i + 1] == L'\0' ||
+			    text[i + 1] == L'\n') {
+				/* trailing space: drop it */;
+			} else if (col > row_col) {
+				ADD_ROW(i, i + 1);
+			} else {
+				col++;
+			}
+
+			i++;
+			continue;
+		}
+
+		if ((width = char_width(wc)) > 0 && col + width > cols &&
+		    col > row_col)
+			ADD_ROW(i, i);
+		col += width;
+		i++;
+	}
+
+	ADD_ROW(i, i);
+#undef ADD_ROW
+	return nrows;
+}
+
+/*
+ * ----------------------------------------------------------------------
+ */
+
+text_layout_cache::text_layout_cache(decoder_t p_decode, size_t p_capacity)
+    : decode(p_decode)
+    , capacity(p_capacity > 0 ? p_capacity : 1)
+{
+	this->index.reserve(this->capacity);
+}
+
+/**
+ * Get the layout of a line, computing it on a cache miss
+ *
+ * @param buf    Line as stored in the text buffers
+ * @param cols   Columns available
+ * @param indent Indent of continuation rows
+ * @return The layout. It stays valid until the next call.
+ */
+const text_layout &
+text_layout_cache::get(const char *buf, int cols, int indent)
+{
+	const key	k = { std::string_view(buf), cols, indent };
+	auto		it = this->index.find(k);
+
+	if (it != this->index.end()) {
+		this->lru.splice(this->lru.begin(), this->lru, it->second);
+		return it->second->layout;
+	}
+
+	if (this->lru.size() >= this->capacity) {
+		const entry &last = this->lru.back();
+
+		this->index.erase(key{ last.buf, last.cols, last.indent });
+		this->lru.pop_back();
+	}
+
+	this->lru.emplace_front();
+	entry		&ent = this->lru.front();
+	text_layout	&layout = ent.layout;
+	size_t		 nrows;
+
+	ent.buf.assign(buf);
+	ent.cols = cols;
+	ent.indent = indent;
+	this->decode(buf, layout.text);
+	layout.indent = textLayout_indent(cols, indent);
+	layout.rows.resize(4);
+
+	if ((nrows = textLayout_wrap(layout.text.c_str(), cols, indent,
+	    layout.rows.data(), layout.rows.size())) > layout.rows.size()) {
+		layout.rows.resize(nrows);
+		(void) textLayout_wrap(layout.text.c_str(), cols, indent,
+		    layout.rows.data(), layout.rows.size());
+	}
+
+	layout.rows.resize(nrows);
+	this->index.emplace(key{ ent.buf, cols, indent }, this->lru.begin());
+	return layout;
+}
+
+void
+text_layout_cache::clear(void)
+{
+	this->index.clear();
+	this->lru.clear();
+}
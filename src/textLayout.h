@@ -0,0 +1,92 @@
+#ifndef SRC_TEXT_LAYOUT_H_
+#define SRC_TEXT_LAYOUT_H_
+
+#include <stddef.h>
+#include <wchar.h>
+
+/*
+ * A row of a wrapped line: the characters [start, end) of the line. A
+ * space or newline that a row break consumed belongs to neither row.
+ */
+struct layout_row {
+	size_t	start;
+	size_t	end;
+};
+
+__SWIRC_BEGIN_DECLS
+size_t	textLayout_color_len(const wchar_t *);
+int	textLayout_indent(int cols, int indent);
+size_t	textLayout_wrap(const wchar_t *, int cols, int indent,
+	    struct layout_row *, size_t maxrows);
+__SWIRC_END_DECLS
+
+#ifdef __cplusplus
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * A decoded line and its rows at a given width and indent
+ */
+struct text_layout {
+	std::wstring			text;
+	std::vector<layout_row>		rows;
+	int				indent;
+};
+
+/*
+ * Least recently used cache of layouts, keyed on the undecoded line,
+ * the width and the indent. Not thread-safe.
+ */
+class text_layout_cache {
+public:
+	typedef void (*decoder_t)(const char *, std::wstring &);
+
+	text_layout_cache(decoder_t, size_t capacity);
+
+	const text_layout	&get(const char *, int cols, int indent);
+	void			 clear(void);
+
+private:
+	struct key {
+		std::string_view	buf;
+		int			cols;
+		int			indent;
+
+		bool
+		operator==(const key &other) const
+		{
+			return (this->cols == other.cols &&
+			    this->indent == other.indent &&
+			    this->buf == other.buf);
+		}
+	};
+
+	struct key_hash {
+		size_t
+		operator()(const key &k) const
+		{
+			return (std::hash<std::string_view>()(k.buf) ^
+			    (static_cast<size_t>(k.cols) << 16) ^
+			    static_cast<size_t>(k.indent));
+		}
+	};
+
+	struct entry {
+		std::string	buf;
+		int		cols;
+		int		indent;
+		text_layout	layout;
+	};
+
+	decoder_t						 decode;
+	size_t							 capacity;
+	std::list<entry>					 lru;
+	std::unordered_map<key, std::list<entry>::iterator, key_hash>
+								 index;
+};
+#endif
+
+#endif
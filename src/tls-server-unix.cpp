@@ -36,8 +36,6 @@
 #include "errHand.h"
 #include "tls-server.h"
 
-#include "commands/dcc.h"
-
 static void *
 accept_thread(void *arg)
 {
@@ -50,16 +48,6 @@ accept_thread(void *arg)
 	return nullptr;
 }
 
-static void *
-com_thread(void *arg)
-{
-	SSL *ssl = static_cast<SSL *>(arg);
-
-	dcc::handle_incoming_conn(ssl);
-	SSL_free(ssl);
-	return nullptr;
-}
-
 void
 tls_server::begin(const int port)
 {
@@ -74,17 +62,6 @@ tls_server::begin(const int port)
 		err_sys("%s: pthread_detach", __func__);
 }
 
-void
-tls_server::com_with_client(SSL *ssl)
-{
-	pthread_t tid;
-
-	if ((errno = pthread_create(&tid, nullptr, com_thread, ssl)) != 0)
-		err_sys("%s: pthread_create", __func__);
-	else if ((errno = pthread_detach(tid)) != 0)
-		err_sys("%s: pthread_detach", __func__);
-}
-
 NORETURN void
 tls_server::exit_thread(void)
 {
@@ -36,8 +36,6 @@
 #include "errHand.h"
 #include "tls-server.h"
 
-#include "commands/dcc.h"
-
 typedef void __cdecl VoidCdecl;
 
 const uintptr_t g_beginthread_failed = static_cast<uintptr_t>(-1L);
@@ -51,16 +49,6 @@ accept_thread(void *arg)
 	tls_server::exit_thread();
 }
 
-static VoidCdecl
-com_thread(void *arg)
-{
-	SSL *ssl = static_cast<SSL *>(arg);
-
-	dcc::handle_incoming_conn(ssl);
-	SSL_free(ssl);
-	_endthread();
-}
-
 void
 tls_server::begin(const int port)
 {
@@ -72,13 +60,6 @@ tls_server::begin(const int port)
 		err_sys("%s: _beginthread", __func__);
 }
 
-void
-tls_server::com_with_client(SSL *ssl)
-{
-	if (_beginthread(com_thread, 0, ssl) == g_beginthread_failed)
-		err_sys("%s: _beginthread", __func__);
-}
-
 NORETURN void
 tls_server::exit_thread(void)
 {
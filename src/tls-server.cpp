@@ -29,6 +29,10 @@
 
 #include "common.h"
 
+#if defined(UNIX)
+#include <poll.h>
+#endif
+
 /*
  * OpenSSL 1.1.1 API compat
  */
@@ -37,8 +41,16 @@
 #include <openssl/err.h>
 #include <openssl/pem.h>
 
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
 
 #include "atomicops.h"
 #include "config.h"
@@ -52,6 +64,51 @@
 #include "strdup_printf.h"
 #include "tls-server.h"
 
+#include "commands/dcc.h"
+
+#if defined(WIN32)
+#define poll WSAPoll
+#endif
+
+/*
+ * How long a client may take to complete the handshake and start its
+ * request (seconds)
+ */
+#define HANDSHAKE_TIMEOUT 15
+
+/*
+ * Wait at most this long (milliseconds) between checks whether to stop
+ * accepting
+ */
+#define POLL_TIMEOUT 250
+
+enum conn_state {
+	STATE_HANDSHAKE,
+	STATE_REQUEST
+};
+
+struct pending_conn {
+	SSL		*ssl;
+	int		 fd;
+	enum conn_state	 state;
+	short int	 events;
+	time_t		 deadline;
+};
+
+/*
+ * The workers are detached and each holds a reference to the pool so
+ * that it outlives them. A new pool is made every time the server is
+ * started.
+ */
+struct worker_pool {
+	std::mutex		mtx;
+	std::condition_variable	cond;
+	std::deque<SSL *>	queue;
+	int			workers = 0;
+	int			idle = 0;
+	bool			stop = false;
+};
+
 const char g_suite_secure[] = "TLSv1.3:TLSv1.2+AEAD+ECDHE:TLSv1.2+AEAD+DHE";
 const char g_suite_compat[] = "HIGH:!aNULL";
 const char g_suite_legacy[] = "ALL:!ADH:!EXP:!LOW:!MD5:@STRENGTH";
@@ -62,6 +119,11 @@ volatile bool tls_server::accepting_new_connections = false;
 static DH	*dh2048 = nullptr;
 static DH	*dh4096 = nullptr;
 
+static SSL_CTX				*server_ctx = nullptr;
+static std::shared_ptr<worker_pool>	 pool;
+
+static const unsigned char sid_ctx[] = "swirc-dcc";
+
 /*lint -sem(tmp_dh_callback, r_null) */
 /*lint -sem(tls_server::setup_context, r_null) */
 
@@ -189,14 +251,217 @@ verify_callback(int ok, X509_STORE_CTX *ctx)
 	return ok;
 }
 
+static void
+worker_main(std::shared_ptr<worker_pool> wp)
+{
+	std::unique_lock<std::mutex> lock(wp->mtx);
+
+	block_signals();
+
+	for (;;) {
+		wp->idle++;
+		wp->cond.wait(lock, [&wp] {
+			return (wp->stop || !wp->queue.empty());
+		});
+		wp->idle--;
+
+		if (wp->stop)
+			break;
+
+		SSL *ssl = wp->queue.front();
+		wp->queue.pop_front();
+		lock.unlock();
+
+		dcc::handle_incoming_conn(ssl);
+		SSL_free(ssl);
+
+		lock.lock();
+	}
+
+	wp->workers--;
+}
+
+static void
+drop_conn(SSL *ssl)
+{
+	dcc::shutdown_conn(ssl);
+	SSL_free(ssl);
+}
+
+static void
+stop_pool(void)
+{
+	std::deque<SSL *> queue;
+
+	if (pool == nullptr)
+		return;
+
+	std::unique_lock<std::mutex> lock(pool->mtx);
+
+	pool->stop = true;
+	queue.swap(pool->queue);
+	pool->cond.notify_all();
+	lock.unlock();
+
+	for (SSL *ssl : queue)
+		drop_conn(ssl);
+	pool.reset();
+}
+
+/*
+ * Adds a connection from the accept socket. Returns false if it was
+ * dropped.
+ */
+static bool
+add_conn(BIO *abio, std::list<pending_conn> &conns)
+{
+	BIO		*cbio;
+	SSL		*ssl;
+	int		 fd = -1;
+	pending_conn	 conn;
+
+	if ((cbio = BIO_pop(abio)) == nullptr)
+		return false;
+	if (conns.size() >= TLS_SERVER_HANDSHAKES_MAX) {
+		debug("%s: too many handshakes in progress", __func__);
+		BIO_free_all(cbio);
+		return false;
+	}
+	if (BIO_get_fd(cbio, &fd) < 0 || !BIO_socket_nbio(fd, 1)) {
+		err_log(0, "%s: cannot make the socket non-blocking",
+		    __func__);
+		BIO_free_all(cbio);
+		return false;
+	}
+	if ((ssl = SSL_new(server_ctx)) == nullptr)
+		err_exit(ENOMEM, "%s", _("Out of memory"));
+	SSL_set_accept_state(ssl);
+	SSL_set_bio(ssl, cbio, cbio);
+
+	conn.ssl = ssl;
+	conn.fd = fd;
+	conn.state = STATE_HANDSHAKE;
+	conn.events = POLLIN;
+	conn.deadline = time(nullptr) + HANDSHAKE_TIMEOUT;
+	conns.push_back(conn);
+	return true;
+}
+
+/*
+ * Sets what to wait for next, given the result of an I/O function.
+ * Returns false on error.
+ */
+static bool
+want_io(pending_conn &conn, const int ret)
+{
+	switch (SSL_get_error(conn.ssl, ret)) {
+	case SSL_ERROR_WANT_READ:
+		conn.events = POLLIN;
+		return true;
+	case SSL_ERROR_WANT_WRITE:
+		conn.events = POLLOUT;
+		return true;
+	default:
+		break;
+	}
+
+	return false;
+}
+
+/*
+ * Advances a connection. Returns true once it's done with, either
+ * handed to a worker or dropped.
+ */
+static bool
+advance_conn(pending_conn &conn)
+{
+	char	c;
+	int	ret;
+
+	ERR_clear_error();
+
+	if (conn.state == STATE_HANDSHAKE) {
+		if ((ret = SSL_do_handshake(conn.ssl)) != 1) {
+			if (want_io(conn, ret))
+				return false;
+			debug("%s: handshake failed", __func__);
+			drop_conn(conn.ssl);
+			return true;
+		}
+
+		debug("%s: handshake completed (%s)", __func__,
+		    (SSL_session_reused(conn.ssl) ? "resumed" : "full"));
+		conn.state = STATE_REQUEST;
+	}
+
+	/*
+	 * Don't occupy a worker until the client has started its
+	 * request
+	 */
+	if ((ret = SSL_peek(conn.ssl, &c, 1)) <= 0) {
+		if (want_io(conn, ret))
+			return false;
+		drop_conn(conn.ssl);
+		return true;
+	}
+
+	tls_server::com_with_client(conn.ssl);
+	return true;
+}
+
+static void
+poll_conns(BIO *abio, std::list<pending_conn> &conns)
+{
+	const time_t			now = time(nullptr);
+	std::vector<struct pollfd>	fds;
+	struct pollfd			pfd;
+
+	pfd.fd = BIO_get_fd(abio, nullptr);
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	fds.push_back(pfd);
+
+	for (auto it = conns.begin(); it != conns.end();) {
+		if (now >= it->deadline) {
+			debug("%s: timed out", __func__);
+			drop_conn(it->ssl);
+			it = conns.erase(it);
+			continue;
+		}
+
+		pfd.fd = it->fd;
+		pfd.events = it->events;
+		fds.push_back(pfd);
+		++it;
+	}
+
+	if (poll(fds.data(), fds.size(), POLL_TIMEOUT) <= 0)
+		return;
+
+	size_t i = 1;
+
+	for (auto it = conns.begin(); it != conns.end(); i++) {
+		if (fds[i].revents != 0 && advance_conn(*it))
+			it = conns.erase(it);
+		else
+			++it;
+	}
+
+	if (fds[0].revents & POLLIN) {
+		while (BIO_do_accept(abio) > 0) {
+			if (add_conn(abio, conns) &&
+			    advance_conn(conns.back()))
+				conns.pop_back();
+		}
+	}
+}
+
 void
 tls_server::accept_new_connections(const int port)
 {
-	BIO			*abio = nullptr;
-	BIO			*cbio = nullptr;
-	PRINTTEXT_CONTEXT	 ptext_ctx;
-	SSL			*ssl = nullptr;
-	SSL_CTX			*ctx = nullptr;
+	BIO				*abio = nullptr;
+	PRINTTEXT_CONTEXT		 ptext_ctx;
+	std::list<pending_conn>		 conns;
 
 	printtext_context_init(&ptext_ctx, g_status_window, TYPE_SPEC1_FAILURE,
 	    true);
@@ -211,7 +476,8 @@ tls_server::accept_new_connections(const int port)
 	}
 
 	try {
-		if ((ctx = tls_server::setup_context()) == nullptr) {
+		if ((server_ctx = tls_server::setup_context()) ==
+		    nullptr) {
 			throw std::runtime_error("Error setting up TLS server "
 			    "context. Check the error log.");
 		} else if ((abio = tls_server::get_accept_bio(port)) ==
@@ -219,38 +485,73 @@ tls_server::accept_new_connections(const int port)
 			throw std::runtime_error("Operation failed");
 		}
 	} catch (const std::runtime_error &e) {
-		SSL_CTX_free(ctx);
+		SSL_CTX_free(server_ctx);
+		server_ctx = nullptr;
 		printtext(&ptext_ctx, "%s", e.what());
 		(void) atomic_swap_bool(&tls_server::accepting_new_connections,
 		    false);
 		return;
 	}
 
+	pool = std::make_shared<worker_pool>();
+
 	ptext_ctx.spec_type = TYPE_SPEC1_SUCCESS;
 	printtext(&ptext_ctx, _("Accepting DCC connections at port: %d"), port);
 	block_signals();
 
-	do {
-		if (BIO_do_accept(abio) <= 0) {
-			(void) napms(100);
-			continue;
-		}
+	while (atomic_load_bool(&tls_server::accepting_new_connections))
+		poll_conns(abio, conns);
 
-		cbio = BIO_pop(abio);
-
-		if ((ssl = SSL_new(ctx)) == nullptr)
-			err_exit(ENOMEM, "%s", _("Out of memory"));
-		SSL_set_accept_state(ssl);
-		SSL_set_bio(ssl, cbio, cbio);
-		tls_server::com_with_client(ssl);
-	} while (atomic_load_bool(&tls_server::accepting_new_connections));
+	for (const pending_conn &conn : conns)
+		drop_conn(conn.ssl);
+	stop_pool();
 
 	BIO_vfree(abio);
-	SSL_CTX_free(ctx);
+	SSL_CTX_free(server_ctx);
+	server_ctx = nullptr;
 	ptext_ctx.spec_type = TYPE_SPEC1_WARN;
 	printtext(&ptext_ctx, "%s", _("Stopped accepting DCC connections"));
 }
 
+/*
+ * Hands a connection to a worker, starting one if none is idle and
+ * there are fewer than TLS_SERVER_WORKERS. The connection is dropped
+ * if the queue is full.
+ */
+void
+tls_server::com_with_client(SSL *ssl)
+{
+	std::unique_lock<std::mutex> lock(pool->mtx);
+
+	if (pool->queue.size() >= TLS_SERVER_QUEUE_MAX) {
+		lock.unlock();
+		err_log(0, "%s: queue full: dropping connection", __func__);
+		drop_conn(ssl);
+		return;
+	}
+
+	if (!BIO_socket_nbio(SSL_get_fd(ssl), 0))
+		err_log(0, "%s: cannot make the socket blocking", __func__);
+
+	if (pool->idle == 0 && pool->workers < TLS_SERVER_WORKERS) {
+		try {
+			std::thread(worker_main, pool).detach();
+			pool->workers++;
+		} catch (const std::system_error &e) {
+			err_log(0, "%s: %s", __func__, e.what());
+		}
+	}
+
+	if (pool->workers == 0) {
+		lock.unlock();
+		drop_conn(ssl);
+		return;
+	}
+
+	pool->queue.push_back(ssl);
+	pool->cond.notify_one();
+}
+
 void
 tls_server::end(void)
 {
@@ -272,12 +573,16 @@ tls_server::get_accept_bio(const int port)
 		if ((bio = BIO_new_accept(port_str)) == nullptr)
 			throw std::runtime_error("Error creating accept BIO");
 		free_and_null(&port_str);
-		if (BIO_set_nbio_accept(bio, 1) != 1) {
-			throw std::runtime_error("Error setting accept socket "
-			    "to non-blocking mode");
-		} else if (BIO_set_bind_mode(bio, BIO_BIND_REUSEADDR) != 1) {
+		/*
+		 * The bind mode must be set first, as it would otherwise
+		 * clear the non-blocking flag
+		 */
+		if (BIO_set_bind_mode(bio, BIO_BIND_REUSEADDR) != 1) {
 			throw std::runtime_error("Error setting bind mode "
 			    "(REUSEADDR)");
+		} else if (BIO_set_nbio_accept(bio, 1) != 1) {
+			throw std::runtime_error("Error setting accept socket "
+			    "to non-blocking mode");
 		} else if (BIO_do_accept(bio) != 1) {
 			throw std::runtime_error("Error creating accept socket "
 			    "or bind an address to it");
@@ -376,6 +681,21 @@ tls_server::setup_context(void)
 
 		SSL_CTX_set_tmp_dh_callback(ctx, tmp_dh_callback);
 
+		/*
+		 * Let repeat peers resume their sessions, either by
+		 * ticket or by ID
+		 */
+		if (!SSL_CTX_set_session_id_context(ctx, sid_ctx,
+		    sizeof sid_ctx - 1)) {
+			throw std::runtime_error("Error setting session ID "
+			    "context");
+		}
+		(void) SSL_CTX_set_session_cache_mode(ctx,
+		    SSL_SESS_CACHE_SERVER);
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L && !defined(LIBRESSL_VERSION_NUMBER)
+		(void) SSL_CTX_set_num_tickets(ctx, 1);
+#endif
+
 		set_server_ciphers_doit(ctx);
 	} catch (const std::runtime_error &ex) {
 		const unsigned long err = ERR_peek_last_error();
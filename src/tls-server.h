@@ -16,6 +16,14 @@
 #define SERVER_MIN_PORT 1024
 #define SERVER_MAX_PORT 65535
 
+/*
+ * Connections are handshaked by the accept thread and then streamed to
+ * by a bounded pool of workers. Further connections wait in a queue.
+ */
+#define TLS_SERVER_WORKERS		4
+#define TLS_SERVER_QUEUE_MAX		16
+#define TLS_SERVER_HANDSHAKES_MAX	32
+
 __SWIRC_BEGIN_DECLS
 extern const char	g_suite_secure[];
 extern const char	g_suite_compat[];
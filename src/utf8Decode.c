@@ -0,0 +1,205 @@
+/* Locale-free UTF-8 to wide-character decoder
+   Copyright (C) 2026 Markus Uhlin. All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   - Neither the name of the author nor the names of its contributors may be
+     used to endorse or promote products derived from this software without
+     specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+   BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE. */
+
+#include "common.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "libUtils.h"
+#include "utf8Decode.h"
+
+#define HIGH_BITS UINT64_C(0x8080808080808080)
+
+#if WCHAR_MAX <= 0xFFFF
+#define WCHAR_IS_UTF16 1
+#else
+#define WCHAR_IS_UTF16 0
+#endif
+
+static inline bool
+is_cont(const unsigned char c)
+{
+	return ((c & 0xC0) == 0x80);
+}
+
+/*
+ * Returns the length of the UTF-8 sequence at 'p' and stores its code
+ * point in 'cp', or returns zero if the sequence is invalid
+ * (truncated, overlong, surrogate or beyond U+10FFFF).
+ */
+static size_t
+get_seq(const unsigned char *p, const unsigned char *end, uint32_t *cp)
+{
+	const unsigned char	c = p[0];
+	const size_t		avail = (size_t) (end - p);
+
+	if (c >= 0xC2 && c <= 0xDF) {
+		if (avail < 2 || !is_cont(p[1]))
+			return 0;
+		*cp = ((c & 0x1Fu) << 6) | (p[1] & 0x3Fu);
+		return 2;
+	} else if (c >= 0xE0 && c <= 0xEF) {
+		if (avail < 3 || !is_cont(p[1]) || !is_cont(p[2]) ||
+		    (c == 0xE0 && p[1] < 0xA0) ||
+		    (c == 0xED && p[1] > 0x9F))
+			return 0;
+		*cp = ((c & 0x0Fu) << 12) | ((p[1] & 0x3Fu) << 6) |
+		    (p[2] & 0x3Fu);
+		return 3;
+	} else if (c >= 0xF0 && c <= 0xF4) {
+		if (avail < 4 || !is_cont(p[1]) || !is_cont(p[2]) ||
+		    !is_cont(p[3]) ||
+		    (c == 0xF0 && p[1] < 0x90) ||
+		    (c == 0xF4 && p[1] > 0x8F))
+			return 0;
+		*cp = ((c & 0x07u) << 18) | ((p[1] & 0x3Fu) << 12) |
+		    ((p[2] & 0x3Fu) << 6) | (p[3] & 0x3Fu);
+		return 4;
+	}
+
+	return 0;
+}
+
+static inline bool
+is_ascii_word(const unsigned char *p)
+{
+	uint64_t word;
+
+	memcpy(&word, p, sizeof word);
+	return ((word & HIGH_BITS) == 0);
+}
+
+/**
+ * Check whether a buffer is valid UTF-8
+ *
+ * @param buf Buffer
+ * @param len Its length in bytes
+ * @return True or false
+ */
+bool
+utf8_is_valid(const char *buf, size_t len)
+{
+	const unsigned char	*p = (const unsigned char *) buf;
+	const unsigned char	*end = p + len;
+	uint32_t		 cp;
+
+	while (p < end) {
+		size_t n;
+
+		while ((size_t) (end - p) >= 8 && is_ascii_word(p))
+			p += 8;
+		if (p == end)
+			break;
+		if (*p < 0x80) {
+			p++;
+			continue;
+		}
+		if ((n = get_seq(p, end, &cp)) == 0)
+			return false;
+		p += n;
+	}
+
+	return true;
+}
+
+/**
+ * Decode UTF-8 without consulting the locale. Bytes that aren't part
+ * of a valid sequence are decoded as ISO 8859-1, which never
+ * fails. The output isn't null-terminated.
+ *
+ * @param[out] out     Destination. Room for 'len' characters is enough.
+ * @param[in]  in      Buffer to decode
+ * @param[in]  len     Its length in bytes
+ * @param[out] invalid Number of bytes decoded with the fallback
+ *                     (passing NULL is ok)
+ * @return The number of wide characters written
+ */
+size_t
+utf8_decode(wchar_t *out, const char *in, size_t len, size_t *invalid)
+{
+	const unsigned char	*p = (const unsigned char *) in;
+	const unsigned char	*end = p + len;
+	size_t			 nbad = 0;
+	wchar_t			*op = out;
+
+	while (p < end) {
+		size_t		n;
+		uint32_t	cp;
+
+		while ((size_t) (end - p) >= 8 && is_ascii_word(p)) {
+			for (int i = 0; i < 8; i++)
+				*op++ = (wchar_t) p[i];
+			p += 8;
+		}
+		if (p == end)
+			break;
+
+		if (*p < 0x80) {
+			*op++ = (wchar_t) *p++;
+		} else if ((n = get_seq(p, end, &cp)) == 0) {
+			*op++ = (wchar_t) *p++; /* ISO 8859-1 */
+			nbad++;
+		} else {
+#if WCHAR_IS_UTF16
+			if (cp > 0xFFFF) {
+				cp -= 0x10000;
+				*op++ = (wchar_t) (0xD800 + (cp >> 10));
+				*op++ = (wchar_t) (0xDC00 + (cp & 0x3FF));
+			} else {
+				*op++ = (wchar_t) cp;
+			}
+#else
+			*op++ = (wchar_t) cp;
+#endif
+			p += n;
+		}
+	}
+
+	if (invalid != NULL)
+		*invalid = nbad;
+	return ((size_t) (op - out));
+}
+
+/**
+ * Like utf8_decode() but for a null-terminated string. The storage is
+ * dynamically allocated.
+ *
+ * @param in String to decode
+ * @return A null-terminated wide-character string
+ */
+wchar_t *
+utf8_decode_dup(const char *in)
+{
+	const size_t	 len = strlen(in);
+	wchar_t		*out = xcalloc(len + 1, sizeof *out);
+
+	out[utf8_decode(out, in, len, NULL)] = L'\0';
+	return out;
+}
@@ -0,0 +1,14 @@
+#ifndef SRC_UTF8_DECODE_H_
+#define SRC_UTF8_DECODE_H_
+
+#include <stddef.h>
+#include <wchar.h>
+
+__SWIRC_BEGIN_DECLS
+bool	 utf8_is_valid(const char *, size_t);
+size_t	 utf8_decode(wchar_t *out, const char *in, size_t len,
+	     size_t *invalid);
+wchar_t	*utf8_decode_dup(const char *);
+__SWIRC_END_DECLS
+
+#endif
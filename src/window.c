@@ -28,9 +28,21 @@
    POSSIBILITY OF SUCH DAMAGE. */
 
 #include "common.h"
+#ifdef UNIT_TESTING
+#undef UNIT_TESTING
+#include <setjmp.h>
+#include <cmocka.h>
+#define UNIT_TESTING 1
+
+#include <sys/stat.h>	/* mkdir() */
+#include <unistd.h>	/* getpid() */
+#endif
 #if defined(UNIX) && USE_LIBNOTIFY
 #include <libnotify/notify.h>
 #endif
+#if defined(UNIX)
+#include <sched.h> /* sched_yield() */
+#endif
 #include "commands/log.h"
 #include "commands/misc.h"
 #ifdef WIN32
@@ -50,31 +62,36 @@
 #include "dataClassify.h"
 #include "errHand.h"
 #include "io-loop.h"		/* get_prompt() */
+#include "isupport.h"
 #include "libUtils.h"
+#include "log.h"
 #include "main.h"
+#include "nestHome.h"
 #include "network.h"
 #include "nicklist.h"
 #include "printtext.h"		/* includes window.h */
 #include "readline.h"		/* readline_top_panel() */
+#include "rejoin.h"
+#include "scrollback.h"
 #include "statusbar.h"
 #include "strHand.h"
+#include "strdup_printf.h"
 #include "terminal.h"
 #include "titlebar.h"
 
-#define FOREACH_HASH_TABLE_ENTRY()\
-	for (PIRC_WINDOW *entry_p = &hash_table[0];\
-	     entry_p < &hash_table[ARRAY_SIZE(hash_table)];\
-	     entry_p++)
-#define FOREACH_WINDOW_IN_ENTRY()\
-	for (PIRC_WINDOW window = *entry_p;\
-	     window != NULL;\
-	     window = window->next)
+/*
+ * Iterates over the open windows in refnum order. Must be used with
+ * 'g_win_htbl_mtx' locked.
+ */
+#define FOREACH_WINDOW()\
+	for (PIRC_WINDOW *window_p = registry_begin(),\
+	     *window_end = registry_end();\
+	     window_p < window_end;\
+	     window_p++)
 
 #define IS_AT_TOP \
 	(window->saved_size > 0 && window->saved_size == window->scroll_count)
 
-#define hash(str) hash_djb_g(str, true, ARRAY_SIZE(hash_table))
-
 /* Structure definitions
    ===================== */
 
@@ -82,7 +99,25 @@ struct hInstall_context {
 	STRING	 label;
 	STRING	 title;
 	PANEL	*pan;
-	int	 refnum;
+};
+
+struct registry_slot {
+	PIRC_WINDOW	 window;
+	unsigned int	 hash;
+	const char	*key;
+};
+
+/*
+ * An immutable snapshot of the open windows. 'windows[i]' has refnum
+ * i + 1 and 'slots' is an open-addressing hash table of the same
+ * windows, keyed on the label folded per the server's casemapping.
+ * The slots and the keys live in the same allocation as the header.
+ */
+struct window_registry {
+	int			 count;
+	size_t			 mask;
+	struct registry_slot	*slots;
+	PIRC_WINDOW		 windows[];
 };
 
 /* Objects with external linkage
@@ -106,10 +141,205 @@ HANDLE			g_win_htbl_mtx; // Window hash table mutex
 /* Objects with internal linkage
    ============================= */
 
-static PIRC_WINDOW hash_table[800] = { NULL };
+/*
+ * The current registry snapshot. Readers never lock: they announce
+ * themselves in 'registry_readers' and load the pointer. Writers hold
+ * 'g_win_htbl_mtx', publish a new snapshot and wait for the readers
+ * to drain before freeing the old one.
+ */
+static _Atomic(struct window_registry *) registry = NULL;
+static _Atomic(int) registry_readers = 0;
+
+/*
+ * Labels of open channels and queries, for tab completion. Protected
+ * by 'g_win_htbl_mtx'.
+ */
+static PPREFIX_TRIE chan_trie = NULL;
+static PPREFIX_TRIE query_trie = NULL;
+
+/*
+ * Memory held by the scrollback of all open windows. Protected by
+ * 'g_win_htbl_mtx'.
+ */
+static size_t scrollback_bytes = 0;
+
+/*
+ * Lines that the global scrollback cap never takes away from a window
+ */
+#define SCROLLBACK_KEEP_LINES 100
+
+/*
+ * Set when 'scrollback_bytes' exceeds the total budget. The UI thread
+ * then moves lines of inactive windows to their spill stores, since
+ * it's the one that draws them.
+ */
+static volatile bool trim_pending = false;
+
+/*
+ * Names the spill stores of this process
+ */
+static unsigned int spill_serial = 0;
+
+static void window_recreate(PIRC_WINDOW, int, int);
+static void unspill(PIRC_WINDOW);
 
 /* -------------------------------------------------- */
 
+static struct window_registry *
+registry_enter(void)
+{
+	registry_readers++;
+	return registry;
+}
+
+static void
+registry_leave(void)
+{
+	registry_readers--;
+}
+
+/*
+ * Called with 'g_win_htbl_mtx' locked
+ */
+static PIRC_WINDOW *
+registry_begin(void)
+{
+	struct window_registry *reg = registry;
+
+	return (reg != NULL ? &reg->windows[0] : NULL);
+}
+
+/*
+ * Called with 'g_win_htbl_mtx' locked
+ */
+static PIRC_WINDOW *
+registry_end(void)
+{
+	struct window_registry *reg = registry;
+
+	return (reg != NULL ? &reg->windows[reg->count] : NULL);
+}
+
+/*
+ * Builds a snapshot of the given windows and renumbers them
+ */
+static struct window_registry *
+registry_new(PIRC_WINDOW *windows, const int count)
+{
+	char			*keys;
+	struct window_registry	*reg;
+	size_t			 keybytes = 0;
+	size_t			 nslots = 16;
+
+	while (nslots < (size_t) count * 2)
+		nslots *= 2;
+	for (int i = 0; i < count; i++)
+		keybytes += strlen(windows[i]->label) + 1;
+
+	reg = xmalloc(sizeof *reg + count * sizeof(PIRC_WINDOW) +
+	    nslots * sizeof(struct registry_slot) + keybytes);
+	reg->count = count;
+	reg->mask = nslots - 1;
+	reg->slots = (struct registry_slot *) &reg->windows[count];
+	BZERO(reg->slots, nslots * sizeof(struct registry_slot));
+	keys = (char *) &reg->slots[nslots];
+
+	for (int i = 0; i < count; i++) {
+		const size_t	 len = strlen(windows[i]->label) + 1;
+		unsigned int	 hash;
+		size_t		 n;
+
+		hash = isupport_key_hash(isupport_fold(windows[i]->label, keys,
+		    len), UINT_MAX);
+		n = hash & reg->mask;
+
+		while (reg->slots[n].window != NULL)
+			n = (n + 1) & reg->mask;
+		reg->slots[n].window = reg->windows[i] = windows[i];
+		reg->slots[n].hash = hash;
+		reg->slots[n].key = keys;
+		windows[i]->refnum = i + 1;
+		keys += len;
+	}
+
+	return reg;
+}
+
+/*
+ * Publishes 'reg' and frees the previous snapshot once no reader can
+ * see it anymore. Called with 'g_win_htbl_mtx' locked.
+ */
+static void
+registry_replace(struct window_registry *reg)
+{
+	struct window_registry *old = registry;
+
+	registry = reg;
+
+	while (registry_readers > 0) {
+#if defined(UNIX)
+		(void) sched_yield();
+#elif defined(WIN32)
+		(void) SwitchToThread();
+#endif
+	}
+
+	free(old);
+}
+
+/*
+ * Called with 'g_win_htbl_mtx' locked
+ */
+static void
+registry_rebuild(void)
+{
+	struct window_registry *reg = registry;
+
+	if (reg != NULL)
+		registry_replace(registry_new(reg->windows, reg->count));
+}
+
+/*
+ * Called with 'g_win_htbl_mtx' locked
+ */
+static void
+registry_add(PIRC_WINDOW window)
+{
+	struct window_registry	*reg = registry;
+	PIRC_WINDOW		*windows;
+	int			 count = (reg != NULL ? reg->count : 0);
+
+	windows = xcalloc(count + 1, sizeof(PIRC_WINDOW));
+	if (count > 0)
+		memcpy(windows, reg->windows, count * sizeof(PIRC_WINDOW));
+	windows[count] = window;
+	registry_replace(registry_new(windows, count + 1));
+	free(windows);
+}
+
+/*
+ * Removes a window and shifts the following ones down by one refnum.
+ * Called with 'g_win_htbl_mtx' locked.
+ */
+static void
+registry_remove(PIRC_WINDOW window)
+{
+	struct window_registry	*reg = registry;
+	PIRC_WINDOW		*windows;
+	int			 count = 0;
+
+	if (reg == NULL)
+		return;
+
+	windows = xcalloc(reg->count + 1, sizeof(PIRC_WINDOW));
+	for (int i = 0; i < reg->count; i++) {
+		if (reg->windows[i] != window)
+			windows[count++] = reg->windows[i];
+	}
+	registry_replace(registry_new(windows, count));
+	free(windows);
+}
+
 /**
  * Apply window options
  */
@@ -121,7 +351,7 @@ apply_window_options(WINDOW *win)
 }
 
 static errno_t
-change_window(PIRC_WINDOW window)
+select_window(PIRC_WINDOW window)
 {
 	WINDOW *pwin;
 
@@ -129,7 +359,12 @@ change_window(PIRC_WINDOW window)
 		return ENOENT; /* window not found */
 	else if (is_the_active_window(window))
 		return 0; /* window already active */
-	else if (top_panel(window->pan) == ERR)
+
+	unspill(window);
+
+	if (window->geometry_dirty)
+		window_recreate(window, LINES, COLS);
+	if (top_panel(window->pan) == ERR)
 		return EPERM;
 
 	if (window->nicklist.pan != NULL)
@@ -138,6 +373,12 @@ change_window(PIRC_WINDOW window)
 	mutex_lock(&g_actwin_mtx);
 	g_active_window = window;
 	mutex_unlock(&g_actwin_mtx);
+
+	mutex_lock(&g_win_htbl_mtx);
+	(void) prefixTrie_touch(is_irc_channel(window->label) ? chan_trie :
+	    query_trie, window->label);
+	mutex_unlock(&g_win_htbl_mtx);
+
 	titlebar(" %s ", (window->title != NULL ? window->title : ""));
 	statusbar_update();
 
@@ -155,6 +396,174 @@ change_window(PIRC_WINDOW window)
 	return 0;
 }
 
+/*
+ * Selects a window with the text buffers locked, so that its lines
+ * and those of the window it replaces aren't spilled meanwhile
+ */
+static errno_t
+change_window(PIRC_WINDOW window)
+{
+	errno_t ret;
+
+	printtext_lock_buffers();
+	ret = select_window(window);
+	printtext_unlock_buffers();
+	return ret;
+}
+
+static long int
+get_total_budget(void)
+{
+	struct integer_context intctx = {
+		.setting_name = "textbuffer_total_kb",
+		.lo_limit = 1024,
+		.hi_limit = 4194304,
+		.fallback_default = 65536,
+	};
+
+	return config_integer(&intctx);
+}
+
+static long int
+get_window_budget(void)
+{
+	struct integer_context intctx = {
+		.setting_name = "textbuffer_window_kb",
+		.lo_limit = 64,
+		.hi_limit = 1048576,
+		.fallback_default = 1024,
+	};
+
+	return config_integer(&intctx);
+}
+
+static int
+get_textbuffer_size(void)
+{
+	struct integer_context intctx = {
+		.setting_name = "textbuffer_size_absolute",
+		.lo_limit = 350,
+		.hi_limit = 4700,
+		.fallback_default = 1000,
+	};
+
+	return ((int) config_integer(&intctx));
+}
+
+/*
+ * Restores the newest lines of a window from its scrollback store, if
+ * one was written during an earlier session. The window isn't drawn
+ * yet.
+ */
+static void
+restore_scrollback(PIRC_WINDOW window)
+{
+	STRING	logpath;
+	int	lines;
+
+	if ((lines = scrollback_lines()) == 0 || g_server_hostname == NULL ||
+	    (logpath = log_get_path(g_server_hostname, window->label)) ==
+	    NULL)
+		return;
+	if (lines >= get_textbuffer_size())
+		lines = get_textbuffer_size() - 1;
+	if (scrollback_restore(logpath, window->buf, lines,
+	    (size_t) get_window_budget() * 1024) > 0)
+		window_scrollback_account(window, 0);
+	free(logpath);
+}
+
+/*
+ * Gives back to a window that's being selected the lines that were
+ * spilled while it was inactive, as many as its budget allows
+ */
+static void
+unspill(PIRC_WINDOW window)
+{
+	const size_t	budget = (size_t) get_window_budget() * 1024;
+	const size_t	prev_bytes = textBuf_bytes(window->buf);
+	const int	maxlines = get_textbuffer_size() - 1 -
+			    textBuf_size(window->buf);
+
+	if (window->spill_path == NULL || prev_bytes >= budget)
+		return;
+	if (scrollback_unspill(window->spill_path, window->buf, maxlines,
+	    budget - prev_bytes) > 0)
+		window_scrollback_account(window, prev_bytes);
+}
+
+/*
+ * Returns the inactive window with the largest scrollback that still
+ * has lines to give. The size of the second largest is stored in
+ * 'runner_up'. Called with 'g_win_htbl_mtx' locked.
+ */
+static PIRC_WINDOW
+largest_inactive_window(const IRC_WINDOW *active, size_t *runner_up)
+{
+	PIRC_WINDOW	largest = NULL;
+
+	*runner_up = 0;
+
+	FOREACH_WINDOW() {
+		PIRC_WINDOW	window = *window_p;
+		const size_t	bytes = textBuf_bytes(window->buf);
+
+		if (window == active || window->scroll_mode ||
+		    textBuf_size(window->buf) <= SCROLLBACK_KEEP_LINES)
+			continue;
+		if (largest == NULL ||
+		    bytes > textBuf_bytes(largest->buf)) {
+			if (largest != NULL)
+				*runner_up = textBuf_bytes(largest->buf);
+			largest = window;
+		} else if (bytes > *runner_up) {
+			*runner_up = bytes;
+		}
+	}
+
+	return largest;
+}
+
+/*
+ * Returns the spill store of a window, naming it first if it has none.
+ * Called with 'g_win_htbl_mtx' locked.
+ */
+static const char *
+get_spill_path(PIRC_WINDOW window)
+{
+	if (window->spill_path == NULL && g_tmp_dir != NULL) {
+		window->spill_path = strdup_printf("%s%sspill-%ld-%u%s",
+		    g_tmp_dir, SLASH, g_pid, ++spill_serial,
+		    g_scrollback_filesuffix);
+	}
+
+	return window->spill_path;
+}
+
+/*
+ * Moves the oldest lines of the largest inactive windows to their
+ * spill stores until the total is down to 'target'. Called with the
+ * text buffers and 'g_win_htbl_mtx' locked.
+ */
+static void
+trim_inactive_windows(const IRC_WINDOW *active, const size_t target)
+{
+	PIRC_WINDOW	window;
+	const size_t	window_budget = (size_t) get_window_budget() * 1024;
+	size_t		runner_up;
+
+	while (scrollback_bytes > target &&
+	    (window = largest_inactive_window(active, &runner_up)) != NULL) {
+		const size_t bytes = textBuf_bytes(window->buf);
+
+		if (scrollback_spill(get_spill_path(window), window->buf,
+		    MIN(scrollback_bytes - target, bytes - runner_up + 1),
+		    SCROLLBACK_KEEP_LINES, window_budget) == 0)
+			break;
+		scrollback_bytes -= bytes - textBuf_bytes(window->buf);
+	}
+}
+
 static int
 first_page_up(PIRC_WINDOW window)
 {
@@ -234,13 +643,12 @@ get_dynamic_scroll_amount(PIRC_WINDOW window, plus_minus_t pm)
 }
 
 /**
- * spawn_chat_window() helper
+ * Creates a window that isn't installed yet
  */
 static PIRC_WINDOW
-hInstall(const struct hInstall_context *ctx)
+new_window(const struct hInstall_context *ctx)
 {
 	PIRC_WINDOW	entry;
-	unsigned int	hashval;
 
 	entry      = xcalloc(sizeof *entry, 1);
 	entry->pan = ctx->pan;
@@ -251,7 +659,9 @@ hInstall(const struct hInstall_context *ctx)
 		*n_ent = NULL;
 	}
 
+	entry->names_trie           = prefixTrie_new();
 	entry->buf                  = textBuf_new();
+	entry->geometry_dirty       = false;
 	entry->is_logwin            = false;
 	entry->logging              = false;
 	entry->received_chancreated = false;
@@ -261,6 +671,7 @@ hInstall(const struct hInstall_context *ctx)
 	BZERO(entry->chanmodes, sizeof entry->chanmodes);
 
 	entry->label = sw_strdup(ctx->label);
+	entry->spill_path = NULL;
 	entry->title = ((ctx->title == NULL || strings_match(ctx->title, ""))
 			? NULL
 			: sw_strdup(ctx->title));
@@ -277,15 +688,46 @@ hInstall(const struct hInstall_context *ctx)
 	entry->nicklist.scroll_pos = 0;
 	entry->nicklist.width      = 0;
 
-	entry->refnum       = ctx->refnum;
+	entry->refnum       = 0;
 	entry->saved_size   = 0;
 	entry->scroll_count = 0;
 
-	hashval             = hash(ctx->label);
-	entry->next         = hash_table[hashval];
-	hash_table[hashval] = entry;
+	return entry;
+}
+
+/**
+ * Called with 'g_win_htbl_mtx' locked
+ */
+static void
+hInstall(PIRC_WINDOW entry)
+{
+	registry_add(entry);
+
+	if (is_irc_channel(entry->label))
+		(void) prefixTrie_insert(chan_trie, entry->label);
+	else if (!strings_match_ignore_case(entry->label,
+	    g_status_window_label))
+		(void) prefixTrie_insert(query_trie, entry->label);
 
 	g_ntotal_windows++;
+}
+
+/**
+ * spawn_chat_window() helper. The scrollback is restored before the
+ * window is installed, as no other thread can reach its buffer until
+ * then.
+ */
+static PIRC_WINDOW
+install_window(const struct hInstall_context *ctx)
+{
+	PIRC_WINDOW entry;
+
+	entry = new_window(ctx);
+	restore_scrollback(entry);
+
+	mutex_lock(&g_win_htbl_mtx);
+	hInstall(entry);
+	mutex_unlock(&g_win_htbl_mtx);
 
 	return entry;
 }
@@ -295,20 +737,26 @@ static void hUndef(PIRC_WINDOW) NONNULL;
 static void
 hUndef(PIRC_WINDOW entry)
 {
-	PIRC_WINDOW *indirect;
+	registry_remove(entry);
 
-	indirect = addrof(hash_table[hash(entry->label)]);
-	while (*indirect != entry)
-		indirect = addrof((*indirect)->next);
-	*indirect = entry->next;
+	(void) prefixTrie_remove(is_irc_channel(entry->label) ? chan_trie :
+	    query_trie, entry->label);
 
-	term_remove_panel(entry->pan);
+	if (entry->pan != NULL)
+		term_remove_panel(entry->pan);
 	event_names_htbl_remove_all(entry);
+	prefixTrie_destroy(entry->names_trie);
+	scrollback_bytes -= textBuf_bytes(entry->buf);
 	textBuf_destroy(entry->buf);
 
 	free(entry->label);
 	free(entry->title);
 
+	if (entry->spill_path != NULL) {
+		(void) remove(entry->spill_path);
+		free(entry->spill_path);
+	}
+
 	if (nicklist_destroy(entry) != 0)
 		debug("%s: nicklist_destroy: error", __func__);
 
@@ -316,33 +764,6 @@ hUndef(PIRC_WINDOW entry)
 	g_ntotal_windows--;
 }
 
-/**
- * Reassign reference numbers (refnums) for all open windows
- */
-static void
-reassign_window_refnums(void)
-{
-	int ref_count = 1;
-
-	mutex_lock(&g_win_htbl_mtx);
-
-	FOREACH_HASH_TABLE_ENTRY() {
-		FOREACH_WINDOW_IN_ENTRY() {
-			/*
-			 * skip status window and assign new num
-			 */
-			if (!strings_match_ignore_case(window->label,
-			    g_status_window_label))
-				window->refnum = ++ref_count;
-		}
-	}
-
-	mutex_unlock(&g_win_htbl_mtx);
-
-	sw_assert(g_status_window->refnum == 1);
-	sw_assert(ref_count == g_ntotal_windows);
-}
-
 #if 0
 static bool
 shouldLimitOutputYesNoRandom(void)
@@ -410,6 +831,8 @@ window_recreate(PIRC_WINDOW window, int rows, int cols)
 {
 	const int HEIGHT = rows - 3;
 
+	window->geometry_dirty = false;
+
 	if (!is_irc_channel(window->label)) {
 		const struct term_window_size newsize = {
 			.rows = rows - 2,
@@ -515,9 +938,9 @@ windowSystem_init(void)
 #endif
 
 	mutex_lock(&g_win_htbl_mtx);
-	FOREACH_HASH_TABLE_ENTRY() {
-		*entry_p = NULL;
-	}
+	registry_replace(NULL);
+	chan_trie = prefixTrie_new();
+	query_trie = prefixTrie_new();
 	mutex_unlock(&g_win_htbl_mtx);
 
 	g_status_window = g_active_window = NULL;
@@ -535,15 +958,15 @@ windowSystem_init(void)
 void
 windowSystem_deinit(void)
 {
-	PIRC_WINDOW p, tmp;
+	PIRC_WINDOW *window_p;
 
 	mutex_lock(&g_win_htbl_mtx);
-	FOREACH_HASH_TABLE_ENTRY() {
-		for (p = *entry_p; p != NULL; p = tmp) {
-			tmp = p->next;
-			hUndef(p);
-		}
-	}
+	while ((window_p = registry_end()) != registry_begin())
+		hUndef(window_p[-1]);
+	registry_replace(NULL);
+	prefixTrie_destroy(chan_trie);
+	prefixTrie_destroy(query_trie);
+	chan_trie = query_trie = NULL;
 	mutex_unlock(&g_win_htbl_mtx);
 
 #if defined(UNIX) && USE_LIBNOTIFY
@@ -575,22 +998,21 @@ make_window_title(CSTRING nick)
 	}
 
 	mutex_lock(&g_win_htbl_mtx);
-	FOREACH_HASH_TABLE_ENTRY() {
-		FOREACH_WINDOW_IN_ENTRY() {
-			PNAMES n;
-
-			if (!is_irc_channel(window->label))
-				continue;
-			n = event_names_htbl_lookup(nick, window->label);
-			if (n == NULL ||
-			    n->account == NULL ||
-			    n->rl_name == NULL)
-				continue;
-			(void) snprintf(title, sizeof title, "%s (%s): %s",
-			    nick, n->account, n->rl_name);
-			mutex_unlock(&g_win_htbl_mtx);
-			return addrof(title[0]);
-		}
+	FOREACH_WINDOW() {
+		PIRC_WINDOW	window = *window_p;
+		PNAMES		n;
+
+		if (!is_irc_channel(window->label))
+			continue;
+		n = event_names_htbl_lookup(nick, window->label);
+		if (n == NULL ||
+		    n->account == NULL ||
+		    n->rl_name == NULL)
+			continue;
+		(void) snprintf(title, sizeof title, "%s (%s): %s",
+		    nick, n->account, n->rl_name);
+		mutex_unlock(&g_win_htbl_mtx);
+		return addrof(title[0]);
 	}
 	mutex_unlock(&g_win_htbl_mtx);
 
@@ -605,22 +1027,37 @@ make_window_title(CSTRING nick)
 PIRC_WINDOW
 window_by_label(CSTRING label)
 {
-	PIRC_WINDOW window;
+	PIRC_WINDOW		 window = NULL;
+	char			 buf[ISUPPORT_KEY_MAX];
+	char			*key;
+	size_t			 len;
+	struct window_registry	*reg;
+	unsigned int		 hash;
 
 	if (label == NULL || strings_match(label, ""))
 		return NULL;
 
-	mutex_lock(&g_win_htbl_mtx);
-	for (window = hash_table[hash(label)]; window != NULL;
-	     window = window->next) {
-		if (strings_match_ignore_case(label, window->label)) {
-			mutex_unlock(&g_win_htbl_mtx);
-			return window;
+	len = strlen(label) + 1;
+	key = (len <= sizeof buf ? &buf[0] : xmalloc(len));
+	hash = isupport_key_hash(isupport_fold(label, key, len), UINT_MAX);
+
+	if ((reg = registry_enter()) != NULL) {
+		size_t n = hash & reg->mask;
+
+		while (reg->slots[n].window != NULL) {
+			if (reg->slots[n].hash == hash &&
+			    strings_match(reg->slots[n].key, key)) {
+				window = reg->slots[n].window;
+				break;
+			}
+			n = (n + 1) & reg->mask;
 		}
 	}
-	mutex_unlock(&g_win_htbl_mtx);
+	registry_leave();
 
-	return NULL;
+	if (key != &buf[0])
+		free(key);
+	return window;
 }
 
 /**
@@ -630,73 +1067,48 @@ window_by_label(CSTRING label)
 PIRC_WINDOW
 window_by_refnum(int refnum)
 {
-	if (refnum < 1 || refnum > g_ntotal_windows)
-		return NULL;
+	PIRC_WINDOW		 window = NULL;
+	struct window_registry	*reg;
 
-	mutex_lock(&g_win_htbl_mtx);
-	FOREACH_HASH_TABLE_ENTRY() {
-		FOREACH_WINDOW_IN_ENTRY() {
-			if (refnum == window->refnum) {
-				mutex_unlock(&g_win_htbl_mtx);
-				return window;
-			}
-		}
-	}
-	mutex_unlock(&g_win_htbl_mtx);
+	if ((reg = registry_enter()) != NULL && refnum >= 1 &&
+	    refnum <= reg->count)
+		window = reg->windows[refnum - 1];
+	registry_leave();
 
-	return NULL;
+	return window;
 }
 
+/**
+ * Get a list of open channels starting with the given search
+ * variable, most recently active first. The caller is responsible
+ * for destroying the list.
+ */
 PTEXTBUF
 get_list_of_matching_channels(CSTRING search_var)
 {
-	PTEXTBUF	matches = textBuf_new();
-	const size_t	varlen = strlen(search_var);
+	PTEXTBUF matches;
 
 	mutex_lock(&g_win_htbl_mtx);
-	FOREACH_HASH_TABLE_ENTRY() {
-		FOREACH_WINDOW_IN_ENTRY() {
-			if (is_irc_channel(window->label) &&
-			    !strncasecmp(search_var, window->label, varlen)) {
-				textBuf_emplace_back(__func__, matches,
-				    window->label, 0);
-			}
-		}
-	}
+	matches = prefixTrie_matches(chan_trie, search_var);
 	mutex_unlock(&g_win_htbl_mtx);
 
-	if (textBuf_size(matches) == 0) {
-		textBuf_destroy(matches);
-		return NULL;
-	}
-
 	return matches;
 }
 
+/**
+ * Get a list of open queries starting with the given search variable,
+ * most recently active first. The caller is responsible for
+ * destroying the list.
+ */
 PTEXTBUF
 get_list_of_matching_queries(CSTRING search_var)
 {
-	PTEXTBUF	matches = textBuf_new();
-	const size_t	varlen = strlen(search_var);
+	PTEXTBUF matches;
 
 	mutex_lock(&g_win_htbl_mtx);
-	FOREACH_HASH_TABLE_ENTRY() {
-		FOREACH_WINDOW_IN_ENTRY() {
-			if (!is_irc_channel(window->label) &&
-			    window != g_status_window &&
-			    !strncasecmp(search_var, window->label, varlen)) {
-				textBuf_emplace_back(__func__, matches,
-				    window->label, 0);
-			}
-		}
-	}
+	matches = prefixTrie_matches(query_trie, search_var);
 	mutex_unlock(&g_win_htbl_mtx);
 
-	if (textBuf_size(matches) == 0) {
-		textBuf_destroy(matches);
-		return NULL;
-	}
-
 	return matches;
 }
 
@@ -748,7 +1160,7 @@ destroy_chat_window(CSTRING label)
 	hUndef(window);
 	mutex_unlock(&g_win_htbl_mtx);
 
-	reassign_window_refnums();
+	sw_assert(g_status_window->refnum == 1);
 	errno = change_window_by_refnum(g_ntotal_windows);
 	sw_assert_perror(errno);
 
@@ -779,15 +1191,11 @@ spawn_chat_window(CSTRING label, CSTRING title)
 	struct hInstall_context inst_ctx;
 	PIRC_WINDOW entry;
 
-	inst_ctx.label  = (STRING) label;
-	inst_ctx.title  = (STRING) title;
-	inst_ctx.pan    = term_new_panel(LINES - 2, 0, 1, 0);
-	inst_ctx.refnum = g_ntotal_windows + 1;
-
-	mutex_lock(&g_win_htbl_mtx);
-	entry = hInstall(&inst_ctx);
-	mutex_unlock(&g_win_htbl_mtx);
+	inst_ctx.label = (STRING) label;
+	inst_ctx.title = (STRING) title;
+	inst_ctx.pan   = term_new_panel(LINES - 2, 0, 1, 0);
 
+	entry = install_window(&inst_ctx);
 	apply_window_options(panel_window(entry->pan));
 	errno = change_window_by_label(entry->label);
 	sw_assert_perror(errno);
@@ -833,23 +1241,22 @@ window_close_all_priv_conv(void)
 
 	mutex_lock(&g_win_htbl_mtx);
 
-	FOREACH_HASH_TABLE_ENTRY() {
-		FOREACH_WINDOW_IN_ENTRY() {
-			if (window == g_status_window ||
-			    is_irc_channel(window->label) ||
-			    window->is_logwin)
-				continue;
-			if (window->label &&
-			    pc_assigned < ARRAY_SIZE(priv_conv)) {
-				priv_conv[pc_assigned++] =
-				    sw_strdup(window->label);
-			}
-			if (pc_assigned == ARRAY_SIZE(priv_conv))
-				goto out_of_both_loops;
+	FOREACH_WINDOW() {
+		PIRC_WINDOW window = *window_p;
+
+		if (window == g_status_window ||
+		    is_irc_channel(window->label) ||
+		    window->is_logwin)
+			continue;
+		if (window->label &&
+		    pc_assigned < ARRAY_SIZE(priv_conv)) {
+			priv_conv[pc_assigned++] =
+			    sw_strdup(window->label);
 		}
+		if (pc_assigned == ARRAY_SIZE(priv_conv))
+			break;
 	}
 
-  out_of_both_loops:
 	mutex_unlock(&g_win_htbl_mtx);
 
 	if (pc_assigned == 0) {
@@ -871,38 +1278,43 @@ void
 window_foreach_destroy_names(void)
 {
 	mutex_lock(&g_win_htbl_mtx);
-	FOREACH_HASH_TABLE_ENTRY() {
-		FOREACH_WINDOW_IN_ENTRY() {
-			if (is_irc_channel(window->label)) {
-				event_names_htbl_remove_all(window);
-				/*
-				 * TODO: Investigate if the code below
-				 * should be moved too.
-				 */
-				BZERO(window->chanmodes,
-				    sizeof window->chanmodes);
-				window->received_chanmodes = false;
-				window->received_chancreated = false;
-			}
+	FOREACH_WINDOW() {
+		PIRC_WINDOW window = *window_p;
+
+		if (is_irc_channel(window->label)) {
+			event_names_htbl_remove_all(window);
+			/*
+			 * TODO: Investigate if the code below
+			 * should be moved too.
+			 */
+			BZERO(window->chanmodes,
+			    sizeof window->chanmodes);
+			window->received_chanmodes = false;
+			window->received_chancreated = false;
 		}
 	}
 	mutex_unlock(&g_win_htbl_mtx);
 }
 
 /**
- * Rejoin all IRC channels
+ * Rejoin all IRC channels. The active window is joined first and the
+ * others in refnum order.
  */
 void
 window_foreach_rejoin_all_channels(void)
 {
 	mutex_lock(&g_win_htbl_mtx);
-	FOREACH_HASH_TABLE_ENTRY() {
-		FOREACH_WINDOW_IN_ENTRY() {
-			if (is_irc_channel(window->label))
-				(void) net_send("JOIN %s", window->label);
-		}
+	if (g_active_window != NULL && is_irc_channel(g_active_window->label))
+		rejoin_add(g_active_window->label);
+	FOREACH_WINDOW() {
+		PIRC_WINDOW window = *window_p;
+
+		if (is_irc_channel(window->label))
+			rejoin_add(window->label);
 	}
 	mutex_unlock(&g_win_htbl_mtx);
+
+	rejoin_start();
 }
 
 void
@@ -911,6 +1323,17 @@ window_recreate_exported(PIRC_WINDOW window, int rows, int cols)
 	window_recreate(window, rows, cols);
 }
 
+/**
+ * Fold the labels anew, i.e. after the casemapping changed
+ */
+void
+window_refold_labels(void)
+{
+	mutex_lock(&g_win_htbl_mtx);
+	registry_rebuild();
+	mutex_unlock(&g_win_htbl_mtx);
+}
+
 /**
  * Scroll down
  */
@@ -997,6 +1420,70 @@ window_scroll_up(PIRC_WINDOW window, const int amount)
 	}
 }
 
+/**
+ * Account for a change of the scrollback of a window and apply the
+ * memory budgets. If the window exceeds 'textbuffer_window_kb' its
+ * oldest lines are moved to its spill store, down to 7/8 of the budget
+ * so that it isn't written for every line. If all windows together
+ * exceed 'textbuffer_total_kb' window_scrollback_trim() is asked to
+ * spill lines of the largest inactive windows.
+ *
+ * @param window     Window
+ * @param prev_bytes What its buffer held before the change
+ * @return Void
+ */
+void
+window_scrollback_account(PIRC_WINDOW window, size_t prev_bytes)
+{
+	const size_t	window_budget = (size_t) get_window_budget() * 1024;
+	const size_t	total_budget = (size_t) get_total_budget() * 1024;
+
+	mutex_lock(&g_win_htbl_mtx);
+	if (textBuf_bytes(window->buf) > window_budget) {
+		(void) scrollback_spill(get_spill_path(window), window->buf,
+		    textBuf_bytes(window->buf) - window_budget +
+		    window_budget / 8, 1, window_budget);
+	}
+
+	scrollback_bytes += textBuf_bytes(window->buf);
+	scrollback_bytes -= prev_bytes;
+
+	if (scrollback_bytes > total_budget)
+		(void) atomic_swap_bool(&trim_pending, true);
+	mutex_unlock(&g_win_htbl_mtx);
+}
+
+/**
+ * Apply the total memory budget, if it has been exceeded, by moving
+ * the oldest lines of the largest inactive windows to temporary files.
+ * They're given back when the windows are selected. Called by the UI
+ * thread when it's idle.
+ *
+ * @return Void
+ */
+void
+window_scrollback_trim(void)
+{
+	PIRC_WINDOW	active;
+	const size_t	total_budget = (size_t) get_total_budget() * 1024;
+
+	if (!atomic_swap_bool(&trim_pending, false))
+		return;
+
+	printtext_lock_buffers();
+
+	mutex_lock(&g_actwin_mtx);
+	active = g_active_window;
+	mutex_unlock(&g_actwin_mtx);
+
+	mutex_lock(&g_win_htbl_mtx);
+	if (scrollback_bytes > total_budget)
+		trim_inactive_windows(active, total_budget - total_budget / 8);
+	mutex_unlock(&g_win_htbl_mtx);
+
+	printtext_unlock_buffers();
+}
+
 /**
  * Switch to the active window plus 1
  */
@@ -1065,17 +1552,374 @@ windows_list_all(void)
 		print_win(window);
 }
 
+static void
+print_win_stats(PIRC_WINDOW win)
+{
+	printtext_print("none", "%6d %-20ls %7d %9.1f",
+	    win->refnum, get_label(win->label), textBuf_size(win->buf),
+	    textBuf_bytes(win->buf) / 1024.0);
+}
+
+void
+windows_list_stats(void)
+{
+	PIRC_WINDOW	window;
+	int		i = 1;
+	size_t		total;
+
+	printtext_print("none", "%6s %-20s %7s %9s", "Refnum", "Label", "Lines",
+	    "KB");
+
+	while ((window = window_by_refnum(i++)) != NULL)
+		print_win_stats(window);
+
+	mutex_lock(&g_win_htbl_mtx);
+	total = scrollback_bytes;
+	mutex_unlock(&g_win_htbl_mtx);
+
+	printtext_print("none", "Total: %.1f KB of %ld KB (%ld KB per window)",
+	    total / 1024.0, get_total_budget(), get_window_budget());
+}
+
 /**
- * Recreate all open windows by calling window_recreate() on each
+ * Recreate the active window with given rows and cols. The other
+ * windows are hidden behind it and only marked as geometry-dirty, so
+ * that change_window() relayouts them once they're selected.
  */
 void
 windows_recreate_all(int rows, int cols)
 {
 	mutex_lock(&g_win_htbl_mtx);
-	FOREACH_HASH_TABLE_ENTRY() {
-		FOREACH_WINDOW_IN_ENTRY() {
+	FOREACH_WINDOW() {
+		PIRC_WINDOW window = *window_p;
+
+		if (is_the_active_window(window))
 			window_recreate(window, rows, cols);
-		}
+		else
+			window->geometry_dirty = true;
 	}
 	mutex_unlock(&g_win_htbl_mtx);
 }
+
+#ifdef UNIT_TESTING
+static _Atomic(bool) readers_stop = false;
+
+/*
+ * Opens the window system without curses and without a status window
+ */
+static void
+open_window_system(void)
+{
+	create_mutexes();
+	mutex_lock(&g_win_htbl_mtx);
+	registry_replace(NULL);
+	chan_trie = prefixTrie_new();
+	query_trie = prefixTrie_new();
+	mutex_unlock(&g_win_htbl_mtx);
+}
+
+/*
+ * Installs a window that has no panel
+ */
+static PIRC_WINDOW
+install_test_window(CSTRING label)
+{
+	struct hInstall_context ctx = {
+		.label = (STRING) label,
+		.title = NULL,
+		.pan = NULL,
+	};
+
+	return install_window(&ctx);
+}
+
+static void
+remove_test_window(PIRC_WINDOW window)
+{
+	mutex_lock(&g_win_htbl_mtx);
+	hUndef(window);
+	mutex_unlock(&g_win_htbl_mtx);
+}
+
+static void *
+registry_reader(void *arg)
+{
+	PIRC_WINDOW	stay = arg;
+	uintptr_t	errors = 0;
+
+	while (!readers_stop) {
+		if (window_by_label("#STAY") != stay ||
+		    window_by_refnum(2) != stay ||
+		    window_by_label("#nowhere") != NULL)
+			errors++;
+	}
+
+	return (void *) errors;
+}
+
+/*
+ * Keeps the total over budget and trims, over and over
+ */
+static void *
+scrollback_trimmer(void *arg)
+{
+	const size_t ballast = (size_t) get_total_budget() * 2048;
+
+	while (!readers_stop) {
+		mutex_lock(&g_win_htbl_mtx);
+		scrollback_bytes += ballast;
+		mutex_unlock(&g_win_htbl_mtx);
+
+		(void) atomic_swap_bool(&trim_pending, true);
+		window_scrollback_trim();
+
+		mutex_lock(&g_win_htbl_mtx);
+		scrollback_bytes -= ballast;
+		mutex_unlock(&g_win_htbl_mtx);
+	}
+
+	UNUSED_PARAM(arg);
+	return NULL;
+}
+
+/*
+ * Returns the number of windows that got a spill store since 'serial'
+ */
+static unsigned int
+spills_since(const unsigned int serial)
+{
+	unsigned int count;
+
+	mutex_lock(&g_win_htbl_mtx);
+	count = spill_serial - serial;
+	mutex_unlock(&g_win_htbl_mtx);
+
+	return count;
+}
+
+void
+window_registry_test1(void **state)
+{
+	PIRC_WINDOW status, chan, query;
+
+	isupport_reset();
+	isupport_feed("CASEMAPPING=rfc1459");
+	open_window_system();
+
+	status = install_test_window(g_status_window_label);
+	chan = install_test_window("#Chan[1]");
+	query = install_test_window("Nick");
+	assert_ptr_equal(window_by_refnum(1), status);
+	assert_ptr_equal(window_by_refnum(2), chan);
+	assert_ptr_equal(window_by_refnum(3), query);
+	assert_null(window_by_refnum(0));
+	assert_null(window_by_refnum(4));
+	assert_ptr_equal(window_by_label("#chan{1}"), chan);
+	assert_ptr_equal(window_by_label("NICK"), query);
+	assert_null(window_by_label("#chan"));
+
+	/* a new casemapping needs the labels folded anew */
+	isupport_feed("CASEMAPPING=ascii");
+	window_refold_labels();
+	assert_null(window_by_label("#chan{1}"));
+	assert_ptr_equal(window_by_label("#CHAN[1]"), chan);
+
+	/* the following windows move down */
+	remove_test_window(chan);
+	assert_ptr_equal(window_by_refnum(2), query);
+	assert_int_equal(query->refnum, 2);
+	assert_null(window_by_refnum(3));
+	assert_null(window_by_label("#chan[1]"));
+
+	windowSystem_deinit();
+	isupport_reset();
+	UNUSED_PARAM(state);
+}
+
+void
+window_registry_test2(void **state)
+{
+	PIRC_WINDOW	stay;
+	pthread_t	readers[4];
+
+	open_window_system();
+	(void) install_test_window(g_status_window_label);
+	stay = install_test_window("#stay");
+	readers_stop = false;
+
+	for (size_t i = 0; i < ARRAY_SIZE(readers); i++) {
+		if ((errno = pthread_create(&readers[i], NULL, registry_reader,
+		    stay)) != 0)
+			fail();
+	}
+
+	/* snapshots are swapped while the readers look up windows */
+	for (int i = 0; i < 500; i++)
+		remove_test_window(install_test_window("#gone"));
+
+	readers_stop = true;
+
+	for (size_t i = 0; i < ARRAY_SIZE(readers); i++) {
+		void *errors = NULL;
+
+		(void) pthread_join(readers[i], &errors);
+		assert_null(errors);
+	}
+
+	windowSystem_deinit();
+	UNUSED_PARAM(state);
+}
+
+void
+window_spawn_test1(void **state)
+{
+	PIRC_WINDOW	 open[4] = { NULL };
+	static char	 dir[40] = { '\0' };
+	char		*logpaths[ARRAY_SIZE(open)];
+	char		 label[10] = { '\0' };
+	char		 line[20] = { '\0' };
+	pthread_t	 trimmer;
+	unsigned int	 serial;
+
+	/* log_get_path() lowercases the whole path */
+	(void) snprintf(dir, sizeof dir, "/tmp/window-%ld",
+	    (long int) getpid());
+	if (mkdir(dir, S_IRWXU) != 0)
+		fail();
+	g_log_dir = g_tmp_dir = dir;
+	g_server_hostname = (STRING) "irc.test";
+	(void) config_item_install("scrollback_restore_lines", "200");
+	(void) config_item_install("textbuffer_size_absolute", "1000");
+	(void) config_item_install("textbuffer_total_kb", "1024");
+	(void) config_item_install("textbuffer_window_kb", "1024");
+	open_window_system();
+	(void) install_test_window(g_status_window_label);
+
+	for (size_t n = 0; n < ARRAY_SIZE(open); n++) {
+		(void) snprintf(label, sizeof label, "#chan%zu", n);
+		logpaths[n] = log_get_path(g_server_hostname, label);
+
+		for (int i = 0; i < 400; i++) {
+			(void) snprintf(line, sizeof line, "line %d", i);
+			assert_int_equal(scrollback_msg(logpaths[n], 1000 + i,
+			    line, 0), 0);
+		}
+	}
+
+	serial = spills_since(0);
+	readers_stop = false;
+	if ((errno = pthread_create(&trimmer, NULL, scrollback_trimmer,
+	    NULL)) != 0)
+		fail();
+
+	/*
+	 * Reopens the windows one by one, so that the trimmer spills the
+	 * others meanwhile
+	 */
+	for (int i = 0; i < 100000 && spills_since(serial) < 100; i++) {
+		const size_t n = (size_t) i % ARRAY_SIZE(open);
+
+		if (open[n] != NULL)
+			remove_test_window(open[n]);
+		(void) snprintf(label, sizeof label, "#chan%zu", n);
+		open[n] = install_test_window(label);
+
+		printtext_lock_buffers();
+		assert_true(textBuf_size(open[n]->buf) >=
+		    SCROLLBACK_KEEP_LINES);
+		assert_string_equal(textBuf_tail(open[n]->buf)->text,
+		    "line 399");
+		printtext_unlock_buffers();
+	}
+
+	readers_stop = true;
+	(void) pthread_join(trimmer, NULL);
+	assert_true(spills_since(serial) >= 100);
+
+	/* every byte was accounted for */
+	for (size_t n = 0; n < ARRAY_SIZE(open); n++)
+		remove_test_window(open[n]);
+	assert_int_equal(scrollback_bytes, 0);
+	windowSystem_deinit();
+	scrollback_deinit();
+
+	for (size_t n = 0; n < ARRAY_SIZE(open); n++) {
+		char *path;
+
+		if ((path = scrollback_get_path(logpaths[n])) != NULL)
+			(void) remove(path);
+		free(path);
+		free(logpaths[n]);
+	}
+
+	(void) rmdir(dir);
+	(void) config_item_undef("scrollback_restore_lines");
+	(void) config_item_undef("textbuffer_size_absolute");
+	(void) config_item_undef("textbuffer_total_kb");
+	(void) config_item_undef("textbuffer_window_kb");
+	g_log_dir = g_tmp_dir = NULL;
+	g_server_hostname = NULL;
+	UNUSED_PARAM(state);
+}
+
+void
+window_budget_test1(void **state)
+{
+	PIRC_WINDOW	 window;
+	PTEXTBUF_ELMT	 head;
+	static char	 dir[40] = { '\0' };
+	char		 line[100] = { '\0' };
+	char		*expected;
+	int		 size;
+
+	(void) snprintf(dir, sizeof dir, "/tmp/window-budget-%ld",
+	    (long int) getpid());
+	if (mkdir(dir, S_IRWXU) != 0)
+		fail();
+	g_tmp_dir = dir;
+	(void) config_item_install("textbuffer_size_absolute", "4700");
+	(void) config_item_install("textbuffer_total_kb", "1024");
+	(void) config_item_install("textbuffer_window_kb", "64");
+	open_window_system();
+	window = install_test_window("#chan");
+
+	for (int i = 0; i < 2000; i++) {
+		const size_t prev_bytes = textBuf_bytes(window->buf);
+
+		(void) snprintf(line, sizeof line, "%-60s %04d", "line", i);
+		textBuf_emplace_back(__func__, window->buf, line, 0);
+		window_scrollback_account(window, prev_bytes);
+	}
+
+	/* the oldest lines were spilled, not dropped */
+	assert_true(textBuf_bytes(window->buf) <= 64 * 1024);
+	assert_non_null(window->spill_path);
+	head = textBuf_head(window->buf);
+	assert_string_not_equal(head->text + 61, "0000");
+	expected = strdup_printf("%-60s %04d", "line",
+	    atoi(head->text + 61) - 1);
+
+	/* and are given back as the budget allows */
+	size = textBuf_size(window->buf);
+	(void) config_item_undef("textbuffer_window_kb");
+	(void) config_item_install("textbuffer_window_kb", "128");
+	unspill(window);
+	assert_true(textBuf_size(window->buf) > size);
+	assert_ptr_equal(head->prev->next, head);
+	assert_string_equal(head->prev->text, expected);
+	free(expected);
+
+	remove_test_window(window);
+	windowSystem_deinit();
+	(void) rmdir(dir);
+	(void) config_item_undef("textbuffer_size_absolute");
+	(void) config_item_undef("textbuffer_total_kb");
+	(void) config_item_undef("textbuffer_window_kb");
+	g_tmp_dir = NULL;
+	UNUSED_PARAM(state);
+}
+
+/*
+ * UNIT_TESTING
+ */
+#endif
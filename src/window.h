@@ -13,6 +13,7 @@
 
 #include "atomicops.h"
 #include "mutex.h"
+#include "prefixTrie.h"
 #include "textBuffer.h"
 
 #define ACTWINLABEL g_active_window->label
@@ -23,23 +24,45 @@ typedef enum {
 	MINUS	= '-'
 } plus_minus_t;
 
+/*
+ * Channel privileges (NAMES.privs). The highest set bit decides the
+ * prefix and the counter of a member.
+ */
+#define NAMES_PRIV_VOICE	0x01
+#define NAMES_PRIV_HALFOP	0x02
+#define NAMES_PRIV_OP		0x04
+#define NAMES_PRIV_SUPEROP	0x08
+#define NAMES_PRIV_OWNER	0x10
+
+/*
+ * Longest nickname of a member
+ */
+#define NAMES_NICK_MAX 45
+
+/*
+ * A member of a channel: one allocation, with the nickname followed by
+ * its key (the nickname folded per the casemapping) at the end. The
+ * account and real name are interned, i.e. shared by all channels.
+ */
 typedef struct tagNAMES {
-	char	*nick;
-	char	*account;
-	char	*rl_name;
-
-	bool	 is_owner;
-	bool	 is_superop;
-	bool	 is_op;
-	bool	 is_halfop;
-	bool	 is_voice;
-	struct tagNAMES *next;
+	struct tagNAMES	*next;
+	const char	*account;
+	const char	*rl_name;
+	unsigned int	 hash;	 /* of the key */
+	unsigned char	 privs;
+	char		 prefix; /* of the highest privilege, or a space */
+	unsigned char	 len;	 /* of the nickname */
+	char		 nick[];
 } NAMES, *PNAMES;
 
+#define NAMES_KEY(names) (&(names)->nick[(names)->len + 1])
+
 typedef struct tagIRC_WINDOW {
 	PANEL		*pan;
 	PNAMES		 names_hash[NAMES_HASH_TABLE_SIZE];
+	PPREFIX_TRIE	 names_trie; /* nicks, for tab completion */
 	PTEXTBUF	 buf;
+	bool		 geometry_dirty; /* relayout on change_window() */
 	bool		 is_logwin;
 	bool		 logging;
 	bool		 received_chancreated;
@@ -48,6 +71,7 @@ typedef struct tagIRC_WINDOW {
 	bool		 scroll_mode;
 	char		 chanmodes[256];
 	STRING		 label; /* Should not be case-sensitive */
+	STRING		 spill_path; /* lines taken by the global budget */
 	STRING		 title;
 
 	int	num_owners;
@@ -67,7 +91,6 @@ typedef struct tagIRC_WINDOW {
 	int	refnum;
 	int	saved_size;
 	int	scroll_count;
-	struct tagIRC_WINDOW *next;
 } IRC_WINDOW, *PIRC_WINDOW;
 
 __SWIRC_BEGIN_DECLS
@@ -89,6 +112,13 @@ extern HANDLE		g_win_htbl_mtx;
 void windowSystem_init(void);
 void windowSystem_deinit(void);
 
+#ifdef UNIT_TESTING
+void	window_budget_test1(void **);
+void	window_registry_test1(void **);
+void	window_registry_test2(void **);
+void	window_spawn_test1(void **);
+#endif
+
 /*lint -sem(window_by_label, r_null) */
 /*lint -sem(window_by_refnum, r_null) */
 /*lint -sem(get_list_of_matching_channels, r_null) */
@@ -109,11 +139,15 @@ void		window_close_all_priv_conv(void);
 void		window_foreach_destroy_names(void);
 void		window_foreach_rejoin_all_channels(void);
 void		window_recreate_exported(PIRC_WINDOW, int rows, int cols);
+void		window_refold_labels(void);
 void		window_scroll_down(PIRC_WINDOW, const int);
 void		window_scroll_up(PIRC_WINDOW, const int);
+void		window_scrollback_account(PIRC_WINDOW, size_t prev_bytes);
+void		window_scrollback_trim(void);
 void		window_select_next(void);
 void		window_select_prev(void);
 void		windows_list_all(void);
+void		windows_list_stats(void);
 void		windows_recreate_all(int rows, int cols);
 __SWIRC_END_DECLS
 
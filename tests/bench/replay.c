@@ -0,0 +1,686 @@
+/* Headless protocol replay benchmark
+
+   Replays recorded (or generated) server traffic through the full
+   client pipeline, i.e. irc_handle_interpret_events() -> events ->
+   printtext -> text buffers and Curses, with a screen that's connected
+   to the null device instead of a terminal, and reports the throughput.
+   Each file is replayed by a fresh client in a process of its own.
+
+   usage: replay [-H home] [-p perf.json] file ...
+          replay -g names|netsplit|znc|colors|mixed|urls [-n count] */
+
+#include "common.h"
+
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <locale.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cursesInit.h"
+#include "curses-funcs.h"
+#include "dataClassify.h"
+#include "errHand.h"
+#include "irc.h"
+#include "libUtils.h"
+#include "main.h"
+#include "nestHome.h"
+#include "network.h"
+#include "perf.h"
+#include "printtext.h"
+#include "readline.h"
+#include "statusbar.h"
+#include "strHand.h"
+#include "titlebar.h"
+#include "window.h"
+
+#define BENCH_NICK	"bench"
+#define BENCH_CHAN	"#bench"
+#define BENCH_SERVER	"irc.bench.net"
+
+#define BENCH_COLS	160
+#define BENCH_LINES	50
+#define BENCH_TERM	"xterm-256color"
+#define BENCH_REDRAWS	100
+
+struct capture {
+	char	**lines;
+	size_t	  count;
+	size_t	  maxlen;
+	char	 *data;
+};
+
+static unsigned long int	rand_state = 0x5eed1234UL;
+static size_t			nallocs = 0;
+
+/*
+ * Count allocations by interposing the allocator. (glibc only.)
+ */
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+extern void	*__libc_calloc(size_t, size_t);
+extern void	*__libc_malloc(size_t);
+extern void	*__libc_realloc(void *, size_t);
+
+void *
+malloc(size_t size)
+{
+	__atomic_add_fetch(&nallocs, 1, __ATOMIC_RELAXED);
+	return __libc_malloc(size);
+}
+
+void *
+calloc(size_t nelem, size_t elsize)
+{
+	__atomic_add_fetch(&nallocs, 1, __ATOMIC_RELAXED);
+	return __libc_calloc(nelem, elsize);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+	__atomic_add_fetch(&nallocs, 1, __ATOMIC_RELAXED);
+	return __libc_realloc(ptr, size);
+}
+#define HAVE_ALLOC_COUNT 1
+#else
+#define HAVE_ALLOC_COUNT 0
+#endif
+
+static unsigned long int
+next_rand(void)
+{
+	rand_state ^= (rand_state << 13) & 0xffffffffUL;
+	rand_state ^= (rand_state >> 17);
+	rand_state ^= (rand_state << 5) & 0xffffffffUL;
+	return (rand_state & 0xffffffffUL);
+}
+
+static double
+now_usec(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+		err_sys("clock_gettime");
+	return (ts.tv_sec * 1e6 + ts.tv_nsec / 1e3);
+}
+
+static int
+cmp_double(const void *p1, const void *p2)
+{
+	const double d1 = *((const double *) p1);
+	const double d2 = *((const double *) p2);
+
+	return (d1 < d2 ? -1 : (d1 > d2 ? 1 : 0));
+}
+
+/****************************************************************
+*                                                               *
+*  --------------          Generators          --------------  *
+*                                                               *
+****************************************************************/
+
+static void
+gen_prologue(void)
+{
+	printf(":%s 001 %s :Welcome to the benchmark network %s\r\n",
+	    BENCH_SERVER, BENCH_NICK, BENCH_NICK);
+	printf(":%s 002 %s :Your host is %s\r\n", BENCH_SERVER, BENCH_NICK,
+	    BENCH_SERVER);
+	printf(":%s 003 %s :This server was created today\r\n", BENCH_SERVER,
+	    BENCH_NICK);
+	printf(":%s 004 %s %s 1.0 iow biklmnopstv\r\n", BENCH_SERVER,
+	    BENCH_NICK, BENCH_SERVER);
+	printf(":%s 005 %s CHANTYPES=# PREFIX=(ov)@+ NETWORK=Bench "
+	    ":are supported by this server\r\n", BENCH_SERVER, BENCH_NICK);
+	printf(":%s!~%s@bench.host JOIN :%s\r\n", BENCH_NICK, BENCH_NICK,
+	    BENCH_CHAN);
+}
+
+static void
+gen_names_reply(long int count)
+{
+	char	buf[512] = { '\0' };
+	int	len = 0;
+
+	for (long int i = 0; i < count; i++) {
+		const unsigned long int r = next_rand() % 20;
+		const char *prefix = (r == 0 ? "@" : (r < 3 ? "+" : ""));
+		const int n = snprintf(&buf[len], sizeof buf - len,
+		    "%s%su%06ld", (len > 0 ? " " : ""), prefix, i);
+
+		if (n < 0 || ((size_t) n) >= sizeof buf - len)
+			err_quit("%s: snprintf", __func__);
+		len += n;
+
+		if (len > 380 || i + 1 == count) {
+			printf(":%s 353 %s = %s :%s\r\n", BENCH_SERVER,
+			    BENCH_NICK, BENCH_CHAN, buf);
+			len = 0;
+		}
+	}
+
+	printf(":%s 366 %s %s :End of /NAMES list.\r\n", BENCH_SERVER,
+	    BENCH_NICK, BENCH_CHAN);
+}
+
+/*
+ * A NAMES burst as sent on joining a huge channel
+ */
+static void
+gen_names(long int count)
+{
+	gen_prologue();
+	gen_names_reply(count);
+}
+
+/*
+ * The users of a channel split off and join again
+ */
+static void
+gen_netsplit(long int count)
+{
+	gen_prologue();
+	gen_names_reply(count);
+
+	for (long int i = 0; i < count; i++) {
+		printf(":u%06ld!~user@host%ld.leaf.bench.net QUIT "
+		    ":hub.bench.net leaf.bench.net\r\n", i, i % 97);
+	}
+	for (long int i = 0; i < count; i++) {
+		printf(":u%06ld!~user@host%ld.leaf.bench.net JOIN :%s\r\n", i,
+		    i % 97, BENCH_CHAN);
+	}
+}
+
+/*
+ * A ZNC buffer playback with server-time tags
+ */
+static void
+gen_znc(long int count)
+{
+	static const char *words[] = {
+		"lorem", "ipsum", "dolor", "sit", "amet", "swirc", "irc",
+		"buffer", "playback", "client", "server", "network",
+	};
+
+	gen_prologue();
+	printf(":***!znc@znc.in PRIVMSG %s :Buffer Playback...\r\n",
+	    BENCH_CHAN);
+
+	for (long int i = 0; i < count; i++) {
+		const long int secs = i % 86400;
+
+		printf("@time=2026-01-01T%02ld:%02ld:%02ld.000Z "
+		    ":nick%ld!~user@host.bench.net PRIVMSG %s :", secs / 3600,
+		    (secs / 60) % 60, secs % 60, i % 250, BENCH_CHAN);
+
+		for (unsigned long int j = 0, n = 4 + next_rand() % 24; j < n;
+		    j++) {
+			printf("%s%s", (j > 0 ? " " : ""),
+			    words[next_rand() % ARRAY_SIZE(words)]);
+		}
+
+		printf("\r\n");
+	}
+
+	printf(":***!znc@znc.in PRIVMSG %s :Playback Complete.\r\n",
+	    BENCH_CHAN);
+}
+
+/*
+ * A channel where every message is heavily decorated
+ */
+static void
+gen_colors(long int count)
+{
+	static const char *words[] = {
+		"r\xc3\xa4ksm\xc3\xb6rg\xc3\xa5s", "\xe6\xbc\xa2\xe5\xad\x97",
+		"colour", "bold", "underline", "reverse", "swirc",
+	};
+
+	gen_prologue();
+
+	for (long int i = 0; i < count; i++) {
+		printf(":nick%ld!~user@host.bench.net PRIVMSG %s :", i % 100,
+		    BENCH_CHAN);
+
+		for (unsigned long int j = 0, n = 6 + next_rand() % 12; j < n;
+		    j++) {
+			const unsigned long int r = next_rand();
+
+			switch (r % 6) {
+			case 0:
+				printf("%c%lu,%lu", COLOR, r % 16,
+				    (r >> 4) % 16);
+				break;
+			case 1:
+				printf("%c%lu", COLOR, r % 100);
+				break;
+			case 2:
+				printf("%c", BOLD);
+				break;
+			case 3:
+				printf("%c", UNDERLINE);
+				break;
+			case 4:
+				printf("%c", REVERSE);
+				break;
+			default:
+				printf("%c", NORMAL);
+				break;
+			}
+
+			printf("%s ", words[r % ARRAY_SIZE(words)]);
+		}
+
+		printf("\r\n");
+	}
+}
+
+/*
+ * A multilingual channel where every tenth message comes from a
+ * client that still sends ISO 8859-1
+ */
+static void
+gen_mixed(long int count)
+{
+	static const char *words[] = {
+		"hello", "world", "irc", "swirc",
+		"r\xc3\xa4ksm\xc3\xb6rg\xc3\xa5s",		/* sv */
+		"\xc3\xbc" "ber", "Stra\xc3\x9f" "e",		/* de */
+		"\xd0\xbf\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82",	/* ru */
+		"\xce\xba\xce\xb1\xce\xbb\xce\xb7"
+		    "\xce\xbc\xce\xad\xcf\x81\xce\xb1",		/* el */
+		"\xe4\xbd\xa0\xe5\xa5\xbd",			/* zh */
+		"\xe3\x81\x93\xe3\x82\x93"
+		    "\xe3\x81\xab\xe3\x81\xa1\xe3\x81\xaf",	/* ja */
+		"\xd9\x85\xd8\xb1\xd8\xad\xd8\xa8\xd8\xa7",	/* ar */
+		"\xf0\x9f\x98\x80",				/* emoji */
+	};
+	static const char *latin1[] = {
+		"caf\xe9", "na\xefve", "\xe5ker", "gr\xfc\xdf" "e", "se\xf1or",
+	};
+
+	gen_prologue();
+
+	for (long int i = 0; i < count; i++) {
+		const bool	legacy = (i % 10 == 9);
+
+		printf(":nick%ld!~user@host.bench.net PRIVMSG %s :", i % 100,
+		    BENCH_CHAN);
+
+		for (unsigned long int j = 0, n = 4 + next_rand() % 16; j < n;
+		    j++) {
+			const unsigned long int r = next_rand();
+
+			printf("%s%s", (j > 0 ? " " : ""), (legacy ?
+			    latin1[r % ARRAY_SIZE(latin1)] :
+			    words[r % ARRAY_SIZE(words)]));
+		}
+
+		printf("\r\n");
+	}
+}
+
+/*
+ * Long messages full of links that wrap over several rows
+ */
+static void
+gen_urls(long int count)
+{
+	static const char *words[] = {
+		"see", "the", "log", "at", "and", "also", "this", "patch",
+		"fixes", "it", "mirror:", "r\xc3\xa4ksm\xc3\xb6rg\xc3\xa5s",
+	};
+	static const char *hosts[] = {
+		"github.com", "bugs.example.org", "paste.bench.net",
+		"www.youtube.com", "en.wikipedia.org",
+	};
+
+	gen_prologue();
+
+	for (long int i = 0; i < count; i++) {
+		printf(":nick%ld!~user@host.bench.net PRIVMSG %s :", i % 100,
+		    BENCH_CHAN);
+
+		for (unsigned long int j = 0, n = 20 + next_rand() % 40; j < n;
+		    j++) {
+			const unsigned long int r = next_rand();
+
+			if (j > 0)
+				printf(" ");
+			if (r % 5 != 0) {
+				printf("%s", words[r % ARRAY_SIZE(words)]);
+				continue;
+			}
+
+			printf("https://%s/", hosts[r % ARRAY_SIZE(hosts)]);
+
+			for (unsigned long int k = 0, m = 2 + (r >> 8) % 6;
+			    k < m; k++) {
+				printf("%s%08lx", (k > 0 ? "/" : ""),
+				    next_rand());
+			}
+
+			if (r & 0x10000)
+				printf("?q=%lu&lang=en#section-%lu", r % 9973,
+				    r % 17);
+		}
+
+		printf("\r\n");
+	}
+}
+
+static void
+generate(CSTRING workload, long int count)
+{
+	if (strings_match(workload, "names"))
+		gen_names(count > 0 ? count : 20000);
+	else if (strings_match(workload, "netsplit"))
+		gen_netsplit(count > 0 ? count : 1000);
+	else if (strings_match(workload, "znc"))
+		gen_znc(count > 0 ? count : 50000);
+	else if (strings_match(workload, "colors"))
+		gen_colors(count > 0 ? count : 20000);
+	else if (strings_match(workload, "mixed"))
+		gen_mixed(count > 0 ? count : 20000);
+	else if (strings_match(workload, "urls"))
+		gen_urls(count > 0 ? count : 20000);
+	else
+		err_quit("unknown workload: %s", workload);
+}
+
+/****************************************************************
+*                                                               *
+*  --------------            Replay            --------------  *
+*                                                               *
+****************************************************************/
+
+static void
+capture_load(CSTRING path, struct capture *cap)
+{
+	FILE		*fp;
+	char		*cp, *tokstate = "";
+	long int	 size;
+	size_t		 alloc = 1024;
+
+	if ((fp = xfopen(path, "rb")) == NULL)
+		err_sys("%s", path);
+	if (fseek(fp, 0L, SEEK_END) != 0 || (size = ftell(fp)) < 0 ||
+	    fseek(fp, 0L, SEEK_SET) != 0)
+		err_sys("%s: seek", path);
+
+	cap->data = xmalloc(size + 1);
+	if (fread(cap->data, 1, size, fp) != ((size_t) size))
+		err_sys("%s: fread", path);
+	cap->data[size] = '\0';
+	fclose(fp);
+
+	cap->lines = xcalloc(alloc, sizeof *cap->lines);
+	cap->count = 0;
+	cap->maxlen = 0;
+
+	for (cp = strtok_r(cap->data, "\r\n", &tokstate); cp != NULL;
+	    cp = strtok_r(NULL, "\r\n", &tokstate)) {
+		if (cap->count == alloc) {
+			alloc *= 2;
+			cap->lines = xrealloc(cap->lines, size_product(alloc,
+			    sizeof *cap->lines));
+		}
+		cap->lines[cap->count++] = cp;
+		cap->maxlen = MAX(cap->maxlen, strlen(cp));
+	}
+}
+
+static void
+capture_free(struct capture *cap)
+{
+	free(cap->lines);
+	free(cap->data);
+}
+
+static void
+replay(CSTRING path)
+{
+	char				*buf;
+	char				*message_concat = NULL;
+	double				*latency;
+	double				 redraw;
+	double				 start, stop;
+	enum message_concat_state	 state = CONCAT_BUFFER_IS_EMPTY;
+	size_t				 allocs;
+	struct capture			 cap;
+	struct rusage			 ru;
+
+	capture_load(path, &cap);
+
+	if (cap.count == 0) {
+		printf("%s: empty capture\n", path);
+		capture_free(&cap);
+		return;
+	}
+
+	buf = xmalloc(cap.maxlen + 3);
+	latency = xcalloc(cap.count, sizeof *latency);
+	allocs = __atomic_load_n(&nallocs, __ATOMIC_RELAXED);
+	start = now_usec();
+
+	for (size_t i = 0; i < cap.count; i++) {
+		const double t0 = now_usec();
+
+		(void) snprintf(buf, cap.maxlen + 3, "%s\r\n", cap.lines[i]);
+		irc_handle_interpret_events(buf, &message_concat, &state);
+		latency[i] = now_usec() - t0;
+	}
+
+	stop = now_usec();
+	allocs = __atomic_load_n(&nallocs, __ATOMIC_RELAXED) - allocs;
+
+	/*
+	 * Full redraws of the active window, as on scrolling or window
+	 * switches
+	 */
+	redraw = now_usec();
+	for (int i = 0; i < BENCH_REDRAWS; i++)
+		window_recreate_exported(g_active_window, LINES, COLS);
+	redraw = (now_usec() - redraw) / BENCH_REDRAWS;
+	qsort(latency, cap.count, sizeof *latency, cmp_double);
+
+	if (getrusage(RUSAGE_SELF, &ru) != 0)
+		err_sys("getrusage");
+
+	printf("%s\n", path);
+	printf("  lines:        %zu\n", cap.count);
+	printf("  elapsed:      %.3f s\n", (stop - start) / 1e6);
+	printf("  lines/s:      %.0f\n", cap.count / ((stop - start) / 1e6));
+	if (HAVE_ALLOC_COUNT)
+		printf("  allocs/line:  %.1f\n", (double) allocs / cap.count);
+	else
+		printf("  allocs/line:  n/a\n");
+	printf("  p50 latency:  %.1f us\n", latency[cap.count / 2]);
+	printf("  p99 latency:  %.1f us\n", latency[cap.count * 99 / 100]);
+	printf("  redraw:       %.1f us\n", redraw);
+	printf("  peak RSS:     %ld KB\n", ru.ru_maxrss);
+	(void) fflush(stdout);
+
+	free(buf);
+	free(latency);
+	free(message_concat);
+	capture_free(&cap);
+}
+
+/*
+ * The program asks the terminal connected to stdin for its size.
+ * Attach a pseudo terminal of a fixed size there.
+ */
+static void
+attach_pty(void)
+{
+	int		master, slave;
+	struct winsize	size = { 0 };
+
+	if ((master = open("/dev/ptmx", O_RDWR | O_NOCTTY)) == -1 ||
+	    grantpt(master) != 0 || unlockpt(master) != 0)
+		err_sys("%s: pseudo terminal master", __func__);
+	if ((slave = open(ptsname(master), O_RDWR | O_NOCTTY)) == -1)
+		err_sys("%s: pseudo terminal slave", __func__);
+
+	size.ws_row = BENCH_LINES;
+	size.ws_col = BENCH_COLS;
+
+	if (ioctl(slave, TIOCSWINSZ, &size) == -1)
+		err_sys("%s: ioctl: TIOCSWINSZ", __func__);
+	if (dup2(slave, STDIN_FILENO) == -1)
+		err_sys("%s: dup2", __func__);
+	(void) close(slave);
+}
+
+static void
+headless_init(CSTRING home)
+{
+	if (mkdir(home, S_IRWXU) != 0 && errno != EEXIST)
+		err_sys("mkdir: %s", home);
+	if (setenv("HOME", home, 1) != 0)
+		err_sys("setenv");
+	attach_pty();
+
+	xsetlocale = setlocale;
+	if (xsetlocale(LC_ALL, "") != NULL)
+		(void) sw_strcpy(g_locale, xsetlocale(LC_ALL, NULL),
+		    ARRAY_SIZE(g_locale));
+
+	nestHome_init();
+
+	if ((g_dev_null = xfopen(DEV_NULL, "w")) == NULL)
+		err_sys("%s", DEV_NULL);
+	if (curses_init_headless(BENCH_TERM, g_dev_null, stdin) != OK)
+		err_quit("headless curses initialization failed");
+
+	titlebar_init();
+	statusbar_init();
+	windowSystem_init();
+	readline_init();
+
+	net_send = net_send_fake;
+}
+
+static void
+headless_deinit(void)
+{
+	readline_deinit();
+	windowSystem_deinit();
+	statusbar_deinit();
+	titlebar_deinit();
+	escape_curses();
+	nestHome_deinit();
+
+	if (isValid(g_dev_null)) {
+		(void) fclose(g_dev_null);
+		g_dev_null = NULL;
+	}
+}
+
+/*
+ * Replays a capture in a process of its own, so that it starts with a
+ * fresh client (no windows, names or netsplits left over by a
+ * previous capture) and its peak RSS is its own. If 'n' is nonzero
+ * the perf counters go to '<perf_file>.<n>'.
+ */
+static bool
+replay_alone(CSTRING home, CSTRING path, CSTRING perf_file, const int n)
+{
+	char	file[PATH_MAX] = { '\0' };
+	int	status = 0;
+	pid_t	pid;
+
+	(void) fflush(stdout);
+
+	if ((pid = fork()) == -1) {
+		err_ret("fork");
+		return false;
+	} else if (pid == 0) {
+		headless_init(home);
+		perf_enable(perf_file != NULL);
+		replay(path);
+
+		if (perf_file != NULL) {
+			if (n != 0)
+				(void) snprintf(file, sizeof file, "%s.%d",
+				    perf_file, n);
+			else
+				(void) sw_strcpy(file, perf_file, sizeof file);
+			if (!perf_dump(file))
+				err_ret("%s", file);
+		}
+
+		headless_deinit();
+		_exit(EXIT_SUCCESS);
+	}
+
+	if (waitpid(pid, &status, 0) == -1) {
+		err_ret("waitpid");
+		return false;
+	}
+	return (WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: replay [-H home] [-p perf.json] file ...\n"
+	    "       replay -g names|netsplit|znc|colors|mixed|urls "
+	    "[-n count]\n");
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char *argv[])
+{
+	CSTRING		 home = "out/home";
+	CSTRING		 perf_file = NULL;
+	CSTRING		 workload = NULL;
+	int		 opt;
+	long int	 count = 0;
+
+	g_progname = "replay";
+
+	while ((opt = getopt(argc, argv, "H:g:n:p:")) != -1) {
+		switch (opt) {
+		case 'H':
+			home = optarg;
+			break;
+		case 'g':
+			workload = optarg;
+			break;
+		case 'n':
+			count = strtol(optarg, NULL, 10);
+			break;
+		case 'p':
+			perf_file = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+
+	if (workload != NULL) {
+		generate(workload, count);
+		return EXIT_SUCCESS;
+	} else if (optind == argc) {
+		usage();
+	}
+
+	for (int i = optind; i < argc; i++) {
+		if (!replay_alone(home, argv[i], perf_file, argc - optind > 1 ?
+		    i - optind + 1 : 0))
+			return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,100 @@
+#include "common.h"
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "isupport.h"
+#include "events/chanstate.h"
+
+static void
+canParse_test1(void **state)
+{
+	struct chanstate_change	changes[CHANSTATE_CHANGES_MAX];
+	char			input[] = "+ov-v+lk-l nick1 nick2 nick3 10 key";
+	size_t			n;
+
+	isupport_reset();
+	n = chanstate_parse(input, changes, ARRAY_SIZE(changes));
+	assert_int_equal(n, 6);
+
+	assert_int_equal(changes[0].mode, 'o');
+	assert_int_equal(changes[0].type, 'P');
+	assert_true(changes[0].set);
+	assert_string_equal(changes[0].param, "nick1");
+
+	assert_int_equal(changes[2].mode, 'v');
+	assert_false(changes[2].set);
+	assert_string_equal(changes[2].param, "nick3");
+
+	assert_int_equal(changes[3].type, 'C');
+	assert_string_equal(changes[3].param, "10");
+	assert_int_equal(changes[4].type, 'B');
+	assert_string_equal(changes[4].param, "key");
+
+	/* 'l' has no parameter when unset */
+	assert_int_equal(changes[5].mode, 'l');
+	assert_null(changes[5].param);
+	UNUSED_PARAM(state);
+}
+
+static void
+followsIsupport_test1(void **state)
+{
+	struct chanstate_change	changes[CHANSTATE_CHANGES_MAX];
+	char			input1[] = "+qo-b mask1 nick1 mask2";
+	char			input2[] = "+qo-b nick1 nick2 mask2";
+	size_t			n;
+
+	/* ircd-seven: +q is a list (quiet) */
+	isupport_reset();
+	isupport_feed("PREFIX=(ov)@+");
+	isupport_feed("CHANMODES=eIbq,k,flj,CFLMPQScgimnprstuz");
+	n = chanstate_parse(input1, changes, ARRAY_SIZE(changes));
+	assert_int_equal(n, 3);
+	assert_int_equal(changes[0].type, 'A');
+	assert_string_equal(changes[0].param, "mask1");
+	assert_int_equal(changes[1].type, 'P');
+	assert_string_equal(changes[1].param, "nick1");
+
+	/* InspIRCd: +q makes a channel owner */
+	isupport_feed("PREFIX=(qaohv)~&@%+");
+	isupport_feed("CHANMODES=IXbeg,k,FHJLfjl,ABCDKMNOPQRSTcimnprstuz");
+	n = chanstate_parse(input2, changes, ARRAY_SIZE(changes));
+	assert_int_equal(n, 3);
+	assert_int_equal(changes[0].type, 'P');
+	assert_string_equal(changes[0].param, "nick1");
+	assert_int_equal(changes[2].type, 'A');
+	assert_false(changes[2].set);
+	isupport_reset();
+	UNUSED_PARAM(state);
+}
+
+static void
+stopsAtMissingParam_test1(void **state)
+{
+	struct chanstate_change	changes[CHANSTATE_CHANGES_MAX];
+	char			input1[] = "+vvv nick1 nick2";
+	char			input2[] = "+nt";
+	char			input3[] = "+oooo a b c d";
+
+	isupport_reset();
+	assert_int_equal(chanstate_parse(input1, changes, ARRAY_SIZE(changes)),
+	    2);
+	assert_int_equal(chanstate_parse(input2, changes, ARRAY_SIZE(changes)),
+	    2);
+	assert_int_equal(changes[1].type, 'D');
+	assert_int_equal(chanstate_parse(input3, changes, 3), 3);
+	UNUSED_PARAM(state);
+}
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(canParse_test1),
+		cmocka_unit_test(followsIsupport_test1),
+		cmocka_unit_test(stopsAtMissingParam_test1),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
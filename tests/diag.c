@@ -0,0 +1,142 @@
+#include "common.h"
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <time.h>
+
+#include "diag.h"
+#include "main.h"
+#include "nestHome.h"
+#include "strHand.h"
+
+static char log_dir[] = "/tmp/diag.XXXXXX";
+
+static void
+use_temp_log_dir(void)
+{
+	if (g_log_dir != NULL)
+		return;
+	if (mkdtemp(log_dir) == NULL)
+		fail();
+	g_log_dir = log_dir;
+	g_progname = "diag";
+}
+
+static void
+wait_for_next_second(void)
+{
+	const time_t		start = time(NULL);
+	const struct timespec	ts = { 0, 10000000L };
+
+	while (time(NULL) == start)
+		(void) nanosleep(&ts, NULL);
+}
+
+static bool
+log_contains(CSTRING name, CSTRING needle)
+{
+	FILE	*fp;
+	bool	 found = false;
+	char	 line[1400] = { '\0' };
+	char	 path[100] = { '\0' };
+
+	(void) snprintf(path, sizeof path, "%s/%s", log_dir, name);
+
+	if ((fp = fopen(path, "r")) == NULL)
+		return false;
+	while (!found && fgets(line, sizeof line, fp) != NULL)
+		found = (strstr(line, needle) != NULL);
+	(void) fclose(fp);
+	return found;
+}
+
+static void
+canRateLimit_test1(void **state)
+{
+	static const char site = 0;
+	int admitted = 0;
+
+	use_temp_log_dir();
+	wait_for_next_second();
+
+	for (int i = 0; i < DIAG_BURST + 5; i++) {
+		if (diag_admit(DIAG_DEBUG_LOG, &site, "rate %d"))
+			admitted++;
+	}
+
+	assert_int_equal(admitted, DIAG_BURST);
+	wait_for_next_second();
+	diag_flush();
+	assert_true(log_contains("debug.log",
+	    "(suppressed 5 messages like \"rate %d\")"));
+	assert_true(diag_admit(DIAG_DEBUG_LOG, &site, "rate %d"));
+	UNUSED_PARAM(state);
+}
+
+static void
+canWriteAsync_test1(void **state)
+{
+	use_temp_log_dir();
+	diag_write(DIAG_DEBUG_LOG, "hello from the ring");
+	diag_write(DIAG_ERROR_LOG, "an error");
+	diag_flush();
+	assert_true(log_contains("debug.log", "hello from the ring"));
+	assert_true(log_contains("error.log", "an error"));
+	UNUSED_PARAM(state);
+}
+
+static void
+canRotate_test1(void **state)
+{
+	char msg[1001];
+
+	use_temp_log_dir();
+	BZERO(msg, sizeof msg);
+	(void) memset(msg, 'x', sizeof msg - 1);
+	diag_write(DIAG_DEBUG_LOG, "before the rotation");
+	diag_flush();
+
+	for (long int i = 0; i < DIAG_ROTATE_SIZE / 1000 + 64; i++) {
+		diag_write(DIAG_DEBUG_LOG, msg);
+
+		if (i % 32 == 0)
+			diag_flush();
+	}
+
+	diag_flush();
+	assert_true(log_contains("debug.log.1", "before the rotation"));
+	assert_false(log_contains("debug.log", "before the rotation"));
+	UNUSED_PARAM(state);
+}
+
+static void
+canDeinit_test1(void **state)
+{
+	char cmd[100] = { '\0' };
+
+	use_temp_log_dir();
+	diag_deinit();
+
+	/* now written synchronously */
+	diag_write(DIAG_ERROR_LOG, "after deinit");
+	assert_true(log_contains("error.log", "after deinit"));
+
+	g_log_dir = NULL;
+	(void) snprintf(cmd, sizeof cmd, "rm -rf %s", log_dir);
+	assert_int_equal(system(cmd), 0);
+	UNUSED_PARAM(state);
+}
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(canRateLimit_test1),
+		cmocka_unit_test(canWriteAsync_test1),
+		cmocka_unit_test(canRotate_test1),
+		cmocka_unit_test(canDeinit_test1),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
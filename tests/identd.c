@@ -0,0 +1,240 @@
+#include "common.h"
+
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <time.h>
+#include <unistd.h>
+
+#include "identd.h"
+
+#define PORT		18113
+#define LOAD_QUERIES	10000
+
+static const char query[] = "6667 , 50000\r\n";
+static const char reply[] = "6667 , 50000 : ERROR : NO-USER\r\n";
+
+static void
+sleep_ms(const long int ms)
+{
+	const struct timespec ts = { ms / 1000, ms % 1000 * 1000000L };
+
+	(void) nanosleep(&ts, NULL);
+}
+
+static bool
+wait_until_listening(const bool yesno)
+{
+	struct identd_stats stats;
+
+	for (int i = 0; i < 500; i++) {
+		identd_get_stats(&stats);
+
+		if (stats.listening == yesno)
+			return true;
+		sleep_ms(10);
+	}
+
+	return false;
+}
+
+static int
+connect_to_identd(void)
+{
+	int			fd;
+	struct sockaddr_in	sin;
+
+	if ((fd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+		return -1;
+
+	BZERO(&sin, sizeof sin);
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(PORT);
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if (connect(fd, (struct sockaddr *) &sin, sizeof sin) != 0) {
+		(void) close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/*
+ * Reads until the daemon closes the connection. Returns the number of
+ * bytes read.
+ */
+static ssize_t
+read_answer(const int fd, char *buf, const size_t size)
+{
+	ssize_t n, total = 0;
+
+	while ((size_t) total < size - 1 && (n = recv(fd, &buf[total],
+	    size - 1 - total, 0)) > 0)
+		total += n;
+	buf[total] = '\0';
+	return total;
+}
+
+static void
+canStart_test1(void **state)
+{
+	identd_start(PORT);
+	assert_true(wait_until_listening(true));
+	UNUSED_PARAM(state);
+}
+
+static void
+canAnswer_test1(void **state)
+{
+	char	buf[100] = { '\0' };
+	int	fd;
+
+	identd_set_ip_limits(100, 100);
+	assert_true((fd = connect_to_identd()) != -1);
+	assert_int_equal(send(fd, query, strlen(query), 0), strlen(query));
+	(void) read_answer(fd, buf, sizeof buf);
+	assert_string_equal(buf, reply);
+	(void) close(fd);
+	UNUSED_PARAM(state);
+}
+
+static void
+rejectsInvalid_test1(void **state)
+{
+	static const char	*invalid[] = {
+		"6667 , abc\r\n",
+		"0 , 50000\r\n",
+		"6667 , 50000 , 1\r\n",
+		"66676667666766676667",
+	};
+	char			 buf[100] = { '\0' };
+	int			 fd;
+
+	identd_set_ip_limits(100, 100);
+
+	for (size_t i = 0; i < ARRAY_SIZE(invalid); i++) {
+		assert_true((fd = connect_to_identd()) != -1);
+		(void) send(fd, invalid[i], strlen(invalid[i]), 0);
+		assert_int_equal(read_answer(fd, buf, sizeof buf), 0);
+		(void) close(fd);
+	}
+
+	UNUSED_PARAM(state);
+}
+
+static void
+limitsRate_test1(void **state)
+{
+	char			buf[100] = { '\0' };
+	int			answered = 0;
+	struct identd_stats	before, after;
+
+	identd_set_ip_limits(3, 0);
+	sleep_ms(1100);
+	identd_get_stats(&before);
+
+	for (int i = 0; i < 5; i++) {
+		int fd;
+
+		assert_true((fd = connect_to_identd()) != -1);
+		(void) send(fd, query, strlen(query), 0);
+		if (read_answer(fd, buf, sizeof buf) > 0)
+			answered++;
+		(void) close(fd);
+	}
+
+	identd_get_stats(&after);
+	assert_int_equal(answered, 3);
+	assert_int_equal(after.refused - before.refused, 2);
+	UNUSED_PARAM(state);
+}
+
+static void
+limitsClients_test1(void **state)
+{
+	char	buf[100] = { '\0' };
+	int	fds[IDENTD_IP_CLIENTS_MAX + 1];
+
+	identd_set_ip_limits(100, 100);
+	sleep_ms(1100);
+
+	for (int i = 0; i < IDENTD_IP_CLIENTS_MAX + 1; i++)
+		assert_true((fds[i] = connect_to_identd()) != -1);
+
+	/* the last one is over the limit and disconnected at once */
+	assert_int_equal(read_answer(fds[IDENTD_IP_CLIENTS_MAX], buf,
+	    sizeof buf), 0);
+
+	for (int i = 0; i < IDENTD_IP_CLIENTS_MAX; i++) {
+		(void) send(fds[i], query, strlen(query), 0);
+		(void) read_answer(fds[i], buf, sizeof buf);
+		assert_string_equal(buf, reply);
+		(void) close(fds[i]);
+	}
+
+	(void) close(fds[IDENTD_IP_CLIENTS_MAX]);
+	UNUSED_PARAM(state);
+}
+
+static void
+canServeLoad_test1(void **state)
+{
+	char			buf[100] = { '\0' };
+	int			fds[IDENTD_IP_CLIENTS_MAX];
+	struct identd_stats	before, after;
+
+	identd_set_ip_limits(LOAD_QUERIES, LOAD_QUERIES);
+	sleep_ms(1100);
+	identd_get_stats(&before);
+
+	for (int i = 0; i < LOAD_QUERIES; i += IDENTD_IP_CLIENTS_MAX) {
+		for (int j = 0; j < IDENTD_IP_CLIENTS_MAX; j++) {
+			assert_true((fds[j] = connect_to_identd()) != -1);
+			(void) send(fds[j], query, strlen(query), 0);
+		}
+		for (int j = 0; j < IDENTD_IP_CLIENTS_MAX; j++) {
+			(void) read_answer(fds[j], buf, sizeof buf);
+			assert_string_equal(buf, reply);
+			(void) close(fds[j]);
+		}
+	}
+
+	identd_get_stats(&after);
+	assert_int_equal(after.answered - before.answered, LOAD_QUERIES);
+	assert_int_equal(after.refused, before.refused);
+	UNUSED_PARAM(state);
+}
+
+static void
+canStop_test1(void **state)
+{
+	struct identd_stats stats;
+
+	identd_stop();
+	assert_true(wait_until_listening(false));
+	identd_get_stats(&stats);
+	assert_int_equal(stats.clients, 0);
+	UNUSED_PARAM(state);
+}
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(canStart_test1),
+		cmocka_unit_test(canAnswer_test1),
+		cmocka_unit_test(rejectsInvalid_test1),
+		cmocka_unit_test(limitsRate_test1),
+		cmocka_unit_test(limitsClients_test1),
+		cmocka_unit_test(canServeLoad_test1),
+		cmocka_unit_test(canStop_test1),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,149 @@
+#include "common.h"
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "isupport.h"
+
+static void
+hasDefaults_test1(void **state)
+{
+	isupport_reset();
+	assert_int_equal(isupport_casemapping(), CASEMAPPING_RFC1459);
+	assert_true(isupport_is_chantype('#'));
+	assert_true(isupport_is_chantype('&'));
+	assert_false(isupport_is_chantype('!'));
+	assert_int_equal(isupport_prefix_mode('@'), 'o');
+	assert_int_equal(isupport_prefix_symbol('v'), '+');
+	assert_int_equal(isupport_chanmode_type('b'), 'A');
+	assert_int_equal(isupport_chanmode_type('k'), 'B');
+	assert_int_equal(isupport_chanmode_type('l'), 'C');
+	assert_int_equal(isupport_chanmode_type('n'), 'D');
+	assert_int_equal(isupport_chanmode_type('o'), 'P');
+	assert_int_equal(isupport_chanmode_type('Z'), '\0');
+	assert_false(isupport_get("NETWORK", NULL, 0));
+	UNUSED_PARAM(state);
+}
+
+static void
+canParseTokens_test1(void **state)
+{
+	char value[40] = { '\0' };
+
+	isupport_reset();
+	isupport_feed("NETWORK=Example\\x20Net");
+	isupport_feed("PREFIX=(qaohv)~&@%+");
+	isupport_feed("CHANMODES=beI,k,l,imnpstCT");
+	isupport_feed("CHANTYPES=#");
+	isupport_feed("NICKLEN=30");
+	isupport_feed("TARGMAX=PRIVMSG:4,NOTICE:4,JOIN:");
+	isupport_feed("MAXLIST=beI:100,q:50");
+	isupport_feed("EXCEPTS");
+
+	assert_true(isupport_get("NETWORK", value, sizeof value));
+	assert_string_equal(value, "Example Net");
+	assert_true(isupport_get("EXCEPTS", value, sizeof value));
+	assert_string_equal(value, "");
+
+	assert_int_equal(isupport_prefix_rank('q'), 0);
+	assert_int_equal(isupport_prefix_rank('v'), 4);
+	assert_int_equal(isupport_prefix_rank('b'), -1);
+	assert_int_equal(isupport_prefix_mode('%'), 'h');
+	assert_int_equal(isupport_prefix_symbol('a'), '&');
+	assert_int_equal(isupport_chanmode_type('T'), 'D');
+	assert_false(isupport_is_chantype('&'));
+
+	assert_int_equal(isupport_nicklen(), 30);
+	assert_int_equal(isupport_targmax("privmsg"), 4);
+	assert_int_equal(isupport_targmax("JOIN"), 0);
+	assert_int_equal(isupport_maxlist('I'), 100);
+	assert_int_equal(isupport_maxlist('q'), 50);
+	assert_int_equal(isupport_maxlist('l'), 0);
+	UNUSED_PARAM(state);
+}
+
+static void
+canNegate_test1(void **state)
+{
+	isupport_reset();
+	isupport_feed("PREFIX=(ohv)@%+");
+	isupport_feed("CASEMAPPING=ascii");
+	assert_int_equal(isupport_prefix_mode('%'), 'h');
+
+	isupport_feed("-PREFIX");
+	isupport_feed("-CASEMAPPING");
+	assert_int_equal(isupport_prefix_mode('%'), '\0');
+	assert_int_equal(isupport_prefix_mode('@'), 'o');
+	assert_int_equal(isupport_casemapping(), CASEMAPPING_RFC1459);
+	assert_false(isupport_get("PREFIX", NULL, 0));
+
+	/* a malformed prefix means none */
+	isupport_feed("PREFIX=(ov)@");
+	assert_int_equal(isupport_prefix_mode('@'), '\0');
+	UNUSED_PARAM(state);
+}
+
+static void
+canFoldRfc1459_test1(void **state)
+{
+	char key[ISUPPORT_KEY_MAX];
+
+	isupport_reset();
+	isupport_feed("CASEMAPPING=rfc1459");
+	assert_string_equal(isupport_fold("Nick[A]\\~", key, sizeof key),
+	    "nick{a}|^");
+	assert_true(isupport_match("[Away]", "{away}"));
+	assert_true(isupport_match("x\\y~", "X|Y^"));
+	assert_false(isupport_match("abc", "abcd"));
+	assert_int_equal(isupport_key_hash(isupport_fold("#Chan[1]", key,
+	    sizeof key), 512), isupport_key_hash("#chan{1}", 512));
+
+	/* truncated to the size of the key */
+	assert_string_equal(isupport_fold("ABCDEF", key, 4), "abc");
+	UNUSED_PARAM(state);
+}
+
+static void
+canFoldStrict_test1(void **state)
+{
+	char key[ISUPPORT_KEY_MAX];
+
+	isupport_reset();
+	isupport_feed("CASEMAPPING=strict-rfc1459");
+	assert_int_equal(isupport_casemapping(), CASEMAPPING_STRICT_RFC1459);
+	assert_string_equal(isupport_fold("[]\\~", key, sizeof key), "{}|~");
+	assert_false(isupport_match("~", "^"));
+	assert_true(isupport_match("\\", "|"));
+	UNUSED_PARAM(state);
+}
+
+static void
+canFoldAscii_test1(void **state)
+{
+	char key[ISUPPORT_KEY_MAX];
+
+	isupport_reset();
+	isupport_feed("CASEMAPPING=ascii");
+	assert_int_equal(isupport_casemapping(), CASEMAPPING_ASCII);
+	assert_string_equal(isupport_fold("NiCK[]", key, sizeof key),
+	    "nick[]");
+	assert_false(isupport_match("[", "{"));
+	assert_int_equal(isupport_tolower('Q'), 'q');
+	isupport_reset();
+	UNUSED_PARAM(state);
+}
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(hasDefaults_test1),
+		cmocka_unit_test(canParseTokens_test1),
+		cmocka_unit_test(canNegate_test1),
+		cmocka_unit_test(canFoldRfc1459_test1),
+		cmocka_unit_test(canFoldStrict_test1),
+		cmocka_unit_test(canFoldAscii_test1),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
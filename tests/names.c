@@ -0,0 +1,19 @@
+#include "common.h"
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "irc.h"
+#include "events/names.h"
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(event_names_rank_test1),
+		cmocka_unit_test(event_names_record_test1),
+		cmocka_unit_test(event_names_staging_test1),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,105 @@
+#include "common.h"
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "perf.h"
+
+static void
+disabledRecordsNothing_test1(void **state)
+{
+	struct perf_stage_stats st;
+
+	perf_enable(false);
+	perf_reset();
+	assert_true(perf_begin() == 0);
+	assert_true(perf_end(PERF_LOG_MSG, perf_begin()) == 0);
+	perf_count_bytes(PERF_NET_RECV, 512);
+
+	perf_get_stage(PERF_LOG_MSG, &st);
+	assert_true(st.calls == 0);
+	perf_get_stage(PERF_NET_RECV, &st);
+	assert_true(st.bytes == 0);
+	UNUSED_PARAM(state);
+}
+
+static void
+canRecordStages_test1(void **state)
+{
+	struct perf_stage_stats st;
+
+	perf_enable(true);
+	perf_reset();
+
+	for (int i = 0; i < 10; i++)
+		(void) perf_end(PERF_VPRINTTEXT, perf_begin());
+	perf_count_bytes(PERF_NET_RECV, 100);
+	perf_count_bytes(PERF_NET_RECV, 28);
+
+	perf_get_stage(PERF_VPRINTTEXT, &st);
+	assert_true(st.calls == 10);
+	assert_true(st.max_ns <= st.total_ns);
+	assert_true(perf_percentile(&st, 50) <= perf_percentile(&st, 99));
+	assert_true(perf_percentile(&st, 99) <= st.max_ns);
+
+	perf_get_stage(PERF_NET_RECV, &st);
+	assert_true(st.calls == 2);
+	assert_true(st.bytes == 128);
+
+	perf_reset();
+	perf_get_stage(PERF_VPRINTTEXT, &st);
+	assert_true(st.calls == 0);
+	perf_enable(false);
+	UNUSED_PARAM(state);
+}
+
+static void
+canEstimatePercentiles_test1(void **state)
+{
+	struct perf_stage_stats st = { 0 };
+
+	st.calls = 100;
+	st.max_ns = 50000;
+	st.hist[0] = 90; /* < 1024 ns */
+	st.hist[5] = 10; /* < 32768 ns */
+
+	assert_true(perf_percentile(&st, 50) == perf_hist_bound(0));
+	assert_true(perf_percentile(&st, 90) == perf_hist_bound(0));
+	assert_true(perf_percentile(&st, 99) == perf_hist_bound(5));
+	assert_true(perf_percentile(&st, 0) == 0);
+	UNUSED_PARAM(state);
+}
+
+static void
+canAggregateEvents_test1(void **state)
+{
+	struct perf_event_stats ev[2];
+
+	perf_enable(true);
+	perf_reset();
+	(void) perf_end_event("PRIVMSG", perf_begin());
+	(void) perf_end_event("PRIVMSG", perf_begin());
+	(void) perf_end_event("353", perf_begin());
+	(void) perf_end_event("JOIN", perf_begin());
+
+	assert_int_equal(perf_get_events(ev, ARRAY_SIZE(ev)), 2);
+	assert_true(ev[0].total_ns >= ev[1].total_ns);
+	assert_int_equal(perf_get_events(ev, 1), 1);
+	perf_reset();
+	assert_int_equal(perf_get_events(ev, ARRAY_SIZE(ev)), 0);
+	perf_enable(false);
+	UNUSED_PARAM(state);
+}
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(disabledRecordsNothing_test1),
+		cmocka_unit_test(canRecordStages_test1),
+		cmocka_unit_test(canEstimatePercentiles_test1),
+		cmocka_unit_test(canAggregateEvents_test1),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
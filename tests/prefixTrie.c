@@ -0,0 +1,145 @@
+#include "common.h"
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "prefixTrie.h"
+
+static PPREFIX_TRIE
+new_populated_trie(void)
+{
+	PPREFIX_TRIE trie = prefixTrie_new();
+
+	(void) prefixTrie_insert(trie, "Alice");
+	(void) prefixTrie_insert(trie, "alan");
+	(void) prefixTrie_insert(trie, "Albert");
+	(void) prefixTrie_insert(trie, "al");
+	(void) prefixTrie_insert(trie, "bob");
+	return trie;
+}
+
+static void
+canMatchCaseInsensitively_test1(void **state)
+{
+	PPREFIX_TRIE	trie = new_populated_trie();
+	PTEXTBUF	matches;
+
+	if ((matches = prefixTrie_matches(trie, "AL")) == NULL)
+		fail();
+	assert_int_equal(textBuf_size(matches), 4);
+	assert_string_equal(textBuf_head(matches)->text, "al");
+	assert_string_equal(textBuf_head(matches)->next->text, "alan");
+	assert_string_equal(textBuf_head(matches)->next->next->text,
+	    "Albert");
+	assert_string_equal(textBuf_tail(matches)->text, "Alice");
+	textBuf_destroy(matches);
+	prefixTrie_destroy(trie);
+	UNUSED_PARAM(state);
+}
+
+static void
+canMatchMidEdge_test1(void **state)
+{
+	PPREFIX_TRIE	trie = new_populated_trie();
+	PTEXTBUF	matches;
+
+	if ((matches = prefixTrie_matches(trie, "ali")) == NULL)
+		fail();
+	assert_int_equal(textBuf_size(matches), 1);
+	assert_string_equal(textBuf_head(matches)->text, "Alice");
+	textBuf_destroy(matches);
+	assert_null(prefixTrie_matches(trie, "alix"));
+	assert_null(prefixTrie_matches(trie, "c"));
+	prefixTrie_destroy(trie);
+	UNUSED_PARAM(state);
+}
+
+static void
+putsActiveEntriesFirst_test1(void **state)
+{
+	PPREFIX_TRIE	trie = new_populated_trie();
+	PTEXTBUF	matches;
+
+	assert_true(prefixTrie_touch(trie, "albert"));
+	assert_true(prefixTrie_touch(trie, "ALAN"));
+	assert_false(prefixTrie_touch(trie, "alb"));
+
+	if ((matches = prefixTrie_matches(trie, "a")) == NULL)
+		fail();
+	assert_string_equal(textBuf_head(matches)->text, "alan");
+	assert_string_equal(textBuf_head(matches)->next->text, "Albert");
+	assert_string_equal(textBuf_head(matches)->next->next->text, "al");
+	textBuf_destroy(matches);
+	prefixTrie_destroy(trie);
+	UNUSED_PARAM(state);
+}
+
+static void
+canInsertAndRemove_test1(void **state)
+{
+	PPREFIX_TRIE	trie = new_populated_trie();
+	PTEXTBUF	matches;
+
+	assert_int_equal(prefixTrie_size(trie), 5);
+	assert_false(prefixTrie_insert(trie, "ALICE"));
+	assert_true(prefixTrie_remove(trie, "al"));
+	assert_false(prefixTrie_remove(trie, "al"));
+	assert_false(prefixTrie_remove(trie, "alb"));
+	assert_true(prefixTrie_remove(trie, "ALAN"));
+	assert_int_equal(prefixTrie_size(trie), 3);
+
+	if ((matches = prefixTrie_matches(trie, "al")) == NULL)
+		fail();
+	assert_int_equal(textBuf_size(matches), 2);
+	assert_string_equal(textBuf_head(matches)->text, "Albert");
+	assert_string_equal(textBuf_tail(matches)->text, "Alice");
+	textBuf_destroy(matches);
+
+	assert_true(prefixTrie_insert(trie, "al"));
+	assert_true(prefixTrie_touch(trie, "al"));
+	prefixTrie_clear(trie);
+	assert_int_equal(prefixTrie_size(trie), 0);
+	assert_null(prefixTrie_matches(trie, ""));
+	prefixTrie_destroy(trie);
+	UNUSED_PARAM(state);
+}
+
+static void
+canWalkSortedRange_test1(void **state)
+{
+	PREFIX_RANGE	 range;
+	const char	*names[] = { "set", "say", "Sasl", "sasl", "join" };
+
+	prefixRange_sort(names, ARRAY_SIZE(names));
+	assert_string_equal(prefixRange_first(&range, names,
+	    ARRAY_SIZE(names), "sa"), "sasl");
+	assert_string_equal(prefixRange_next(&range), "say");
+	assert_null(prefixRange_next(&range));
+	assert_null(prefixRange_next(&range));
+
+	/* case-sensitive */
+	assert_string_equal(prefixRange_first(&range, names,
+	    ARRAY_SIZE(names), "S"), "Sasl");
+	assert_null(prefixRange_next(&range));
+
+	assert_null(prefixRange_first(&range, names, ARRAY_SIZE(names),
+	    "x"));
+	assert_null(prefixRange_next(&range));
+	assert_string_equal(prefixRange_first(&range, names,
+	    ARRAY_SIZE(names), ""), "Sasl");
+	UNUSED_PARAM(state);
+}
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(canMatchCaseInsensitively_test1),
+		cmocka_unit_test(canMatchMidEdge_test1),
+		cmocka_unit_test(putsActiveEntriesFirst_test1),
+		cmocka_unit_test(canInsertAndRemove_test1),
+		cmocka_unit_test(canWalkSortedRange_test1),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
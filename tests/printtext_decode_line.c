@@ -0,0 +1,17 @@
+#include "common.h"
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "printtext.h"
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(printtext_decode_line_test1),
+		cmocka_unit_test(printtext_decode_line_test2),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -1,2 +1,4 @@
-RECOMPILE = $(SRC_DIR)icb.o\
-	$(SRC_DIR)printtext.o
+RECOMPILE = $(EVENTS_DIR)names.o\
+	$(SRC_DIR)icb.o\
+	$(SRC_DIR)printtext.o\
+	$(SRC_DIR)window.o
@@ -0,0 +1,194 @@
+#include "common.h"
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "isupport.h"
+#include "network.h"
+#include "rejoin.h"
+
+static double	now = 1000.0;
+static char	sent[10][REJOIN_LINE_MAX + 1];
+static size_t	nsent = 0;
+
+static double
+fake_clock(void)
+{
+	return now;
+}
+
+static int
+fake_send(CSTRING fmt, ...)
+{
+	int	ret;
+	va_list	ap;
+
+	if (nsent >= ARRAY_SIZE(sent))
+		return -1;
+	va_start(ap, fmt);
+	ret = vsnprintf(sent[nsent++], sizeof sent[0], fmt, ap);
+	va_end(ap);
+	return ret;
+}
+
+/*
+ * Plans the given channels, with the end of the MOTD already received
+ * unless 'motd' is false
+ */
+static void
+plan(const char * const *chans, size_t count, const char *limits,
+    bool motd)
+{
+	rejoin_deinit();
+	rejoin_init();
+	isupport_reset();
+	net_send = fake_send;
+	rejoin_clock = fake_clock;
+	nsent = 0;
+
+	if (limits != NULL) {
+		isupport_feed(limits);
+		rejoin_isupport(limits);
+	}
+	for (size_t i = 0; i < count; i++)
+		rejoin_add(chans[i]);
+	rejoin_start();
+	if (motd)
+		rejoin_motd_done();
+}
+
+static void
+canPack_test1(void **state)
+{
+	const char	*chans[] = { "#one", "#two", "#three" };
+	char		 line[100];
+
+	assert_int_equal(rejoin_pack(chans, 3, 0, line, sizeof line), 3);
+	assert_string_equal(line, "#one,#two,#three");
+
+	assert_int_equal(rejoin_pack(chans, 1, 0, line, sizeof line), 1);
+	assert_string_equal(line, "#one");
+
+	assert_int_equal(rejoin_pack(chans, 0, 0, line, sizeof line), 0);
+	assert_string_equal(line, "");
+	UNUSED_PARAM(state);
+}
+
+static void
+honorsTargetLimit_test1(void **state)
+{
+	const char	*chans[] = { "#one", "#two", "#three" };
+	char		 line[100];
+
+	assert_int_equal(rejoin_pack(chans, 3, 2, line, sizeof line), 2);
+	assert_string_equal(line, "#one,#two");
+	UNUSED_PARAM(state);
+}
+
+static void
+honorsLineLength_test1(void **state)
+{
+	const char	*chans[] = { "#one", "#two", "#three" };
+	char		 line[10];
+
+	/* "#one,#two" plus the terminator is exactly 10 bytes */
+	assert_int_equal(rejoin_pack(chans, 3, 0, line, sizeof line), 2);
+	assert_string_equal(line, "#one,#two");
+
+	assert_int_equal(rejoin_pack(&chans[2], 1, 0, line, 5), 0);
+	assert_string_equal(line, "");
+	UNUSED_PARAM(state);
+}
+
+static void
+pacesLines_test1(void **state)
+{
+	const char *chans[] = {
+		"#c1", "#c2", "#c3", "#c4", "#c5", "#c6", "#c7", "#c8",
+	};
+
+	plan(chans, ARRAY_SIZE(chans), "TARGMAX=JOIN:2", true);
+
+	/* two lines at once... */
+	rejoin_run_bkgd_task();
+	assert_int_equal(nsent, 2);
+	assert_string_equal(sent[0], "JOIN #c1,#c2");
+	assert_string_equal(sent[1], "JOIN #c3,#c4");
+
+	/* ...and then one every other second */
+	now += 1.9;
+	rejoin_run_bkgd_task();
+	assert_int_equal(nsent, 2);
+	now += 0.1;
+	rejoin_run_bkgd_task();
+	assert_int_equal(nsent, 3);
+	assert_string_equal(sent[2], "JOIN #c5,#c6");
+	now += 1.0;
+	rejoin_run_bkgd_task();
+	assert_int_equal(nsent, 3);
+	now += 1.0;
+	rejoin_run_bkgd_task();
+	assert_int_equal(nsent, 4);
+	assert_string_equal(sent[3], "JOIN #c7,#c8");
+
+	rejoin_deinit();
+	isupport_reset();
+	UNUSED_PARAM(state);
+}
+
+static void
+honorsChanlimit_test1(void **state)
+{
+	const char *chans[] = { "#c1", "#c2", "&c3", "#c4", "#c5" };
+
+	plan(chans, ARRAY_SIZE(chans), "CHANLIMIT=#:3", true);
+	rejoin_run_bkgd_task();
+	assert_int_equal(nsent, 1);
+	assert_string_equal(sent[0], "JOIN #c1,#c2,&c3,#c4");
+
+	/* nothing left for later */
+	now += 10.0;
+	rejoin_run_bkgd_task();
+	assert_int_equal(nsent, 1);
+
+	rejoin_deinit();
+	isupport_reset();
+	UNUSED_PARAM(state);
+}
+
+static void
+splitsByTargmaxAndChanlimit_test1(void **state)
+{
+	const char *chans[] = { "#c1", "#c2", "#c3", "#c4", "#c5", "#c6" };
+
+	plan(chans, ARRAY_SIZE(chans), "CHANLIMIT=#:5", false);
+	isupport_feed("TARGMAX=JOIN:3");
+
+	/* waits for the end of the motd, at most three seconds */
+	rejoin_run_bkgd_task();
+	assert_int_equal(nsent, 0);
+	now += 3.0;
+	rejoin_run_bkgd_task();
+	assert_int_equal(nsent, 2);
+	assert_string_equal(sent[0], "JOIN #c1,#c2,#c3");
+	assert_string_equal(sent[1], "JOIN #c4,#c5");
+
+	rejoin_deinit();
+	isupport_reset();
+	UNUSED_PARAM(state);
+}
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(canPack_test1),
+		cmocka_unit_test(honorsTargetLimit_test1),
+		cmocka_unit_test(honorsLineLength_test1),
+		cmocka_unit_test(pacesLines_test1),
+		cmocka_unit_test(honorsChanlimit_test1),
+		cmocka_unit_test(splitsByTargmaxAndChanlimit_test1),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
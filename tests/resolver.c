@@ -0,0 +1,176 @@
+#include "common.h"
+
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <time.h>
+
+#include "resolver.h"
+
+static volatile int	queries = 0;
+static volatile bool	slow_released = false;
+
+/*
+ * A stub in place of the system resolver: "irc.test" has an address,
+ * "slow.test" answers when released and everything else is unknown.
+ */
+static int
+stub_backend(const char *host, const char *port,
+    const struct addrinfo *hints, struct addrinfo **res)
+{
+	const struct timespec	ts = { 0, 10000000L };
+	struct addrinfo		numeric;
+
+	queries++;
+
+	if (strcmp(host, "slow.test") == 0) {
+		while (!slow_released)
+			(void) nanosleep(&ts, NULL);
+	} else if (strcmp(host, "irc.test") != 0) {
+		return EAI_NONAME;
+	}
+
+	memcpy(&numeric, hints, sizeof numeric);
+	numeric.ai_flags |= AI_NUMERICHOST;
+	return getaddrinfo("127.0.0.1", port, &numeric, res);
+}
+
+static void
+get_hints(struct addrinfo *hints)
+{
+	BZERO(hints, sizeof *hints);
+	hints->ai_family = AF_INET;
+	hints->ai_socktype = SOCK_STREAM;
+}
+
+static void
+canResolveAndCache_test1(void **state)
+{
+	struct addrinfo		 hints;
+	struct addrinfo		*res = NULL;
+	struct sockaddr_in	*sin;
+
+	resolver_set_backend(stub_backend);
+	queries = 0;
+	get_hints(&hints);
+
+	for (int i = 0; i < 3; i++) {
+		assert_int_equal(resolver_lookup("irc.test", "6697", &hints,
+		    &res), 0);
+		assert_non_null(res);
+		assert_int_equal(res->ai_family, AF_INET);
+		sin = (struct sockaddr_in *) res->ai_addr;
+		assert_int_equal(ntohs(sin->sin_port), 6697);
+		assert_int_equal(ntohl(sin->sin_addr.s_addr), 0x7f000001);
+		resolver_freeaddrinfo(res);
+	}
+
+	assert_int_equal(queries, 1);
+
+	/* another port is another question */
+	assert_int_equal(resolver_lookup("irc.test", "6667", &hints, &res), 0);
+	resolver_freeaddrinfo(res);
+	assert_int_equal(queries, 2);
+
+	resolver_forget("irc.test");
+	assert_int_equal(resolver_lookup("irc.test", "6697", &hints, &res), 0);
+	resolver_freeaddrinfo(res);
+	assert_int_equal(queries, 3);
+	UNUSED_PARAM(state);
+}
+
+static void
+cachesFailures_test1(void **state)
+{
+	struct addrinfo		 hints;
+	struct addrinfo		*res = NULL;
+
+	resolver_set_backend(stub_backend);
+	queries = 0;
+	get_hints(&hints);
+
+	assert_int_equal(resolver_lookup("nx.test", "6697", &hints, &res),
+	    EAI_NONAME);
+	assert_null(res);
+	assert_int_equal(resolver_lookup("nx.test", "6697", &hints, &res),
+	    EAI_NONAME);
+	assert_int_equal(queries, 1);
+	UNUSED_PARAM(state);
+}
+
+static void
+skipsAddresses_test1(void **state)
+{
+	struct addrinfo		 hints;
+	struct addrinfo		*res = NULL;
+
+	resolver_set_backend(stub_backend);
+	queries = 0;
+	get_hints(&hints);
+
+	assert_int_equal(resolver_lookup("192.0.2.1", "6697", &hints, &res),
+	    0);
+	assert_non_null(res);
+	resolver_freeaddrinfo(res);
+	assert_int_equal(queries, 0);
+	UNUSED_PARAM(state);
+}
+
+static void *
+cancel_soon(void *arg)
+{
+	const struct timespec ts = { 0, 100000000L };
+
+	(void) nanosleep(&ts, NULL);
+	resolver_cancel();
+	UNUSED_PARAM(arg);
+	return NULL;
+}
+
+static void
+canCancel_test1(void **state)
+{
+	pthread_t		 tid;
+	struct addrinfo		 hints;
+	struct addrinfo		*res = NULL;
+	time_t			 start;
+
+	resolver_set_backend(stub_backend);
+	slow_released = false;
+	get_hints(&hints);
+
+	start = time(NULL);
+	assert_int_equal(pthread_create(&tid, NULL, cancel_soon, NULL), 0);
+	assert_int_equal(resolver_lookup("slow.test", "6697", &hints, &res),
+	    RESOLVER_CANCELED);
+	assert_null(res);
+	assert_true(time(NULL) - start < RESOLVER_WAIT_MAX);
+	assert_int_equal(pthread_join(tid, NULL), 0);
+
+	/* the answer is still cached when it comes */
+	slow_released = true;
+	assert_int_equal(resolver_lookup("slow.test", "6697", &hints, &res),
+	    0);
+	resolver_freeaddrinfo(res);
+	resolver_set_backend(NULL);
+	UNUSED_PARAM(state);
+}
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(canResolveAndCache_test1),
+		cmocka_unit_test(cachesFailures_test1),
+		cmocka_unit_test(skipsAddresses_test1),
+		cmocka_unit_test(canCancel_test1),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
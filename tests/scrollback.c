@@ -0,0 +1,250 @@
+#include "common.h"
+
+#include <sys/stat.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "scrollback.h"
+#include "strHand.h"
+
+static char dir[] = "/tmp/scrollback.XXXXXX";
+static char logpath[100] = { '\0' };
+
+static const char *
+use_temp_log(void)
+{
+	if (*logpath != '\0')
+		return logpath;
+	if (mkdtemp(dir) == NULL)
+		fail();
+	(void) snprintf(logpath, sizeof logpath, "%s/net-3-#chan.txt", dir);
+	return logpath;
+}
+
+static void
+assert_line(PTEXTBUF_ELMT element, const char *text, int indent)
+{
+	assert_non_null(element);
+	assert_string_equal(element->text, text);
+	assert_int_equal(element->indent, indent);
+}
+
+static void
+canGetPath_test1(void **state)
+{
+	char *path;
+
+	path = scrollback_get_path("/logs/net-3-#chan.txt");
+	assert_string_equal(path, "/logs/net-3-#chan.sbk");
+	free(path);
+
+	assert_null(scrollback_get_path("/logs/txt"));
+	assert_null(scrollback_get_path(NULL));
+	UNUSED_PARAM(state);
+}
+
+static void
+canRestoreNewest_test1(void **state)
+{
+	PTEXTBUF	buf;
+	char		line[40] = { '\0' };
+
+	use_temp_log();
+
+	for (int i = 0; i < 50; i++) {
+		(void) snprintf(line, sizeof line, "\00304line %d", i);
+		assert_int_equal(scrollback_msg(logpath, 1000 + i, line, i % 7),
+		    0);
+	}
+
+	buf = textBuf_new();
+	assert_int_equal(scrollback_restore(logpath, buf, 10, 4096), 10);
+	assert_int_equal(textBuf_size(buf), 10);
+	assert_line(textBuf_head(buf), "\00304line 40", 40 % 7);
+	assert_line(textBuf_tail(buf), "\00304line 49", 49 % 7);
+	textBuf_destroy(buf);
+
+	/* limited by bytes */
+	buf = textBuf_new();
+	assert_int_equal(scrollback_restore(logpath, buf, 50, 100), 3);
+	textBuf_destroy(buf);
+	UNUSED_PARAM(state);
+}
+
+static void
+handlesTornRecord_test1(void **state)
+{
+	FILE		*fp;
+	PTEXTBUF	 buf;
+	char		*path;
+
+	use_temp_log();
+	path = scrollback_get_path(logpath);
+
+	if ((fp = fopen(path, "ab")) == NULL)
+		fail();
+	(void) fwrite("\x20\0\0\0\0", 1, 5, fp);
+	(void) fclose(fp);
+	free(path);
+
+	buf = textBuf_new();
+	assert_int_equal(scrollback_restore(logpath, buf, 2, 4096), 2);
+	assert_line(textBuf_tail(buf), "\00304line 49", 49 % 7);
+	textBuf_destroy(buf);
+
+	/* appended after the torn record */
+	assert_int_equal(scrollback_msg(logpath, 2000, "after", 0), 0);
+	buf = textBuf_new();
+	assert_int_equal(scrollback_restore(logpath, buf, 2, 4096), 1);
+	assert_line(textBuf_tail(buf), "after", 0);
+	textBuf_destroy(buf);
+	UNUSED_PARAM(state);
+}
+
+static PTEXTBUF
+numbered_lines(int count)
+{
+	PTEXTBUF	buf = textBuf_new();
+	char		line[40] = { '\0' };
+
+	for (int i = 0; i < count; i++) {
+		(void) snprintf(line, sizeof line, "line %d", i);
+		textBuf_emplace_back(__func__, buf, line, i % 3);
+	}
+
+	return buf;
+}
+
+static void
+canSpillAndUnspill_test1(void **state)
+{
+	PTEXTBUF	buf;
+	char		path[100] = { '\0' };
+
+	use_temp_log();
+	(void) snprintf(path, sizeof path, "%s/spill-1.sbk", dir);
+
+	buf = numbered_lines(20);
+	assert_int_equal(scrollback_spill(path, buf, 1 << 20, 5, 1 << 20),
+	    15);
+	assert_int_equal(textBuf_size(buf), 5);
+	assert_line(textBuf_head(buf), "line 15", 0);
+
+	/* the newest spilled lines come back first */
+	assert_int_equal(scrollback_unspill(path, buf, 4, 1 << 20), 4);
+	assert_int_equal(textBuf_size(buf), 9);
+	assert_line(textBuf_head(buf), "line 11", 2);
+	assert_line(textBuf_head(buf)->next, "line 12", 0);
+
+	assert_int_equal(scrollback_unspill(path, buf, 100, 1 << 20), 11);
+	assert_int_equal(textBuf_size(buf), 20);
+	assert_line(textBuf_head(buf), "line 0", 0);
+	assert_line(textBuf_tail(buf), "line 19", 19 % 3);
+	assert_int_equal(scrollback_unspill(path, buf, 100, 1 << 20), 0);
+	textBuf_destroy(buf);
+	UNUSED_PARAM(state);
+}
+
+static void
+spillStoreIsCapped_test1(void **state)
+{
+	PTEXTBUF	buf;
+	char		path[100] = { '\0' };
+	int		n;
+
+	use_temp_log();
+	(void) snprintf(path, sizeof path, "%s/spill-2.sbk", dir);
+
+	buf = numbered_lines(100);
+	assert_int_equal(scrollback_spill(path, buf, 1 << 20, 0, 200), 100);
+	assert_int_equal(textBuf_size(buf), 0);
+
+	n = scrollback_unspill(path, buf, 100, 1 << 20);
+	assert_true(n > 0 && n < 10);
+	assert_line(textBuf_tail(buf), "line 99", 0);
+	textBuf_destroy(buf);
+
+	/* without a store the lines are only dropped */
+	buf = numbered_lines(10);
+	assert_int_equal(scrollback_spill(NULL, buf, 1, 0, 200), 1);
+	assert_line(textBuf_head(buf), "line 1", 1);
+	textBuf_destroy(buf);
+	UNUSED_PARAM(state);
+}
+
+static void
+storeIsCapped_test1(void **state)
+{
+	PTEXTBUF	 buf;
+	char		*path;
+	char		 line[4000] = { '\0' };
+	struct stat	 sb = { 0 };
+
+	use_temp_log();
+	memset(line, 'x', sizeof line - 1);
+
+	for (int i = 0; i < 1200; i++) {
+		(void) snprintf(line, 12, "%010d", i);
+		line[10] = 'x';
+		assert_int_equal(scrollback_msg(logpath, 3000 + i, line, 0),
+		    0);
+	}
+
+	path = scrollback_get_path(logpath);
+	assert_int_equal(stat(path, &sb), 0);
+	assert_true(sb.st_size <= SCROLLBACK_STORE_MAX);
+	free(path);
+
+	/* the newest lines are kept */
+	buf = textBuf_new();
+	assert_int_equal(scrollback_restore(logpath, buf, 2, 1 << 20), 2);
+	assert_true(strncmp(textBuf_tail(buf)->text, "0000001199", 10) ==
+	    0);
+	textBuf_destroy(buf);
+	UNUSED_PARAM(state);
+}
+
+static void
+ignoresForeignFiles_test1(void **state)
+{
+	FILE		*fp;
+	PTEXTBUF	 buf;
+	char		 cmd[100] = { '\0' };
+	char		*path;
+
+	use_temp_log();
+	path = scrollback_get_path(logpath);
+
+	if ((fp = fopen(path, "wb")) == NULL)
+		fail();
+	(void) fputs("2026-01-01 not a store\n", fp);
+	(void) fclose(fp);
+	free(path);
+
+	buf = textBuf_new();
+	assert_int_equal(scrollback_restore(logpath, buf, 10, 4096), 0);
+	assert_int_equal(textBuf_size(buf), 0);
+	textBuf_destroy(buf);
+
+	scrollback_deinit();
+	(void) snprintf(cmd, sizeof cmd, "rm -rf %s", dir);
+	assert_int_equal(system(cmd), 0);
+	UNUSED_PARAM(state);
+}
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(canGetPath_test1),
+		cmocka_unit_test(canRestoreNewest_test1),
+		cmocka_unit_test(handlesTornRecord_test1),
+		cmocka_unit_test(canSpillAndUnspill_test1),
+		cmocka_unit_test(spillStoreIsCapped_test1),
+		cmocka_unit_test(storeIsCapped_test1),
+		cmocka_unit_test(ignoresForeignFiles_test1),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
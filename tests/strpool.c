@@ -0,0 +1,89 @@
+#include "common.h"
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "isupport.h"
+#include "strpool.h"
+
+static void
+canIntern_test1(void **state)
+{
+	const size_t	 size = strpool_size();
+	char		 buf[] = "account1";
+	const char	*s1, *s2, *s3;
+
+	s1 = strpool_intern("account1");
+	s2 = strpool_intern(buf);
+	s3 = strpool_intern("account2");
+	assert_ptr_equal(s1, s2);
+	assert_true(s1 != buf);
+	assert_true(s1 != s3);
+	assert_string_equal(s1, "account1");
+	assert_int_equal(strpool_len(s1), 8);
+	assert_int_equal(strpool_size(), size + 2);
+	assert_ptr_equal(strpool_find("account2"), s3);
+
+	strpool_release(s1);
+	assert_ptr_equal(strpool_find("account1"), s2);
+	strpool_release(s2);
+	strpool_release(s3);
+	assert_null(strpool_find("account1"));
+	assert_null(strpool_find("account2"));
+	assert_int_equal(strpool_size(), size);
+	UNUSED_PARAM(state);
+}
+
+static void
+canRef_test1(void **state)
+{
+	const char *s1 = strpool_intern("ref1");
+
+	assert_ptr_equal(strpool_ref(s1), s1);
+	strpool_release(s1);
+	assert_ptr_equal(strpool_find("ref1"), s1);
+	strpool_release(s1);
+	assert_null(strpool_find("ref1"));
+
+	assert_null(strpool_intern(NULL));
+	assert_null(strpool_ref(NULL));
+	strpool_release(NULL);
+	UNUSED_PARAM(state);
+}
+
+static void
+keysFollowCasemapping_test1(void **state)
+{
+	const char *k1, *k2;
+
+	isupport_reset();
+	k1 = strpool_intern_key("Nick[a]");
+	k2 = strpool_intern_key("nICK{A}");
+	assert_ptr_equal(k1, k2);
+	assert_string_equal(k1, "nick{a}");
+	assert_ptr_equal(strpool_find_key("NICK[A]"), k1);
+	assert_int_equal(strpool_hash(k1) % 1000, isupport_key_hash(k1, 1000));
+	strpool_release(k1);
+	strpool_release(k2);
+
+	isupport_feed("CASEMAPPING=ascii");
+	k1 = strpool_intern_key("Nick[a]");
+	k2 = strpool_intern_key("nICK{A}");
+	assert_true(k1 != k2);
+	strpool_release(k1);
+	strpool_release(k2);
+	isupport_reset();
+	UNUSED_PARAM(state);
+}
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(canIntern_test1),
+		cmocka_unit_test(canRef_test1),
+		cmocka_unit_test(keysFollowCasemapping_test1),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
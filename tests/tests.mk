@@ -1,21 +1,31 @@
 # tests.mk
 
-TESTS = cmd_servlist.run\
+TESTS = chanstate.run\
+	cmd_servlist.run\
 	cmd_squery.run\
 	cmd_znc.run\
 	crypt.run\
 	destroy_null_bytes.run\
+	diag.run\
 	getuser.run\
+	identd.run\
 	icb_send_pm.run\
 	int_diff.run\
 	int_sum.run\
 	isValid.run\
+	isupport.run\
 	is_alphabetic.run\
 	is_cjk.run\
 	is_numeric.run\
-	printtext_convert_wc.run\
+	names.run\
+	perf.run\
+	prefixTrie.run\
+	printtext_decode_line.run\
 	realloc_strcat.run\
+	rejoin.run\
+	resolver.run\
 	rot13.run\
+	scrollback.run\
 	size_product.run\
 	squeeze.run\
 	squeeze_text_deco.run\
@@ -25,13 +35,17 @@ TESTS = cmd_servlist.run\
 	strToLower.run\
 	strToUpper.run\
 	strdup_printf.run\
+	strpool.run\
 	sw_snprintf.run\
 	sw_strcat.run\
 	sw_strcpy.run\
 	sw_strdup.run\
 	sw_wcscat.run\
 	sw_wcscpy.run\
+	textLayout.run\
 	trim.run\
+	utf8_decode.run\
+	window.run\
 	write_to_stream.run\
 	xstrnlen.run\
 	xwcswidth.run
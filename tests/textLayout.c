@@ -0,0 +1,114 @@
+#include "common.h"
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "textLayout.h"
+
+#define ROWS_MAX 16
+
+static void
+assert_row(const struct layout_row *row, size_t start, size_t end)
+{
+	assert_int_equal(row->start, start);
+	assert_int_equal(row->end, end);
+}
+
+static void
+canWrapAtSpaces_test1(void **state)
+{
+	struct layout_row rows[ROWS_MAX];
+
+	assert_int_equal(textLayout_wrap(L"hello world foo", 11, 0, rows,
+	    ROWS_MAX), 2);
+	assert_row(&rows[0], 0, 11);
+	assert_row(&rows[1], 12, 15);
+
+	assert_int_equal(textLayout_wrap(L"aaa bbb ccc", 7, 2, rows,
+	    ROWS_MAX), 2);
+	assert_row(&rows[0], 0, 7);
+	assert_row(&rows[1], 8, 11);
+
+	assert_int_equal(textLayout_wrap(L"ab\ncd", 80, 0, rows, ROWS_MAX),
+	    2);
+	assert_row(&rows[0], 0, 2);
+	assert_row(&rows[1], 3, 5);
+	UNUSED_PARAM(state);
+}
+
+static void
+canBreakLongWords_test1(void **state)
+{
+	struct layout_row rows[ROWS_MAX];
+
+	assert_int_equal(textLayout_wrap(L"abcdefghij", 4, 0, rows,
+	    ROWS_MAX), 3);
+	assert_row(&rows[0], 0, 4);
+	assert_row(&rows[1], 4, 8);
+	assert_row(&rows[2], 8, 10);
+
+	/* a link starts on a row of its own */
+	assert_int_equal(textLayout_wrap(L"see https://example.org/x", 10, 0,
+	    rows, ROWS_MAX), 4);
+	assert_row(&rows[0], 0, 3);
+	assert_row(&rows[1], 4, 14);
+	assert_row(&rows[2], 14, 24);
+	assert_row(&rows[3], 24, 25);
+
+	/* only the first rows are stored */
+	assert_int_equal(textLayout_wrap(L"abcdefghij", 4, 0, rows, 1), 3);
+	assert_row(&rows[0], 0, 4);
+	UNUSED_PARAM(state);
+}
+
+static void
+handlesWidths_test1(void **state)
+{
+	struct layout_row rows[ROWS_MAX];
+
+	/* text decoration occupies no columns */
+	assert_int_equal(textLayout_wrap(L"\x03" L"04,12red\x02 bold\x0f",
+	    8, 0, rows, ROWS_MAX), 1);
+
+	/* double-width characters */
+	assert_int_equal(textLayout_wrap(L"\x6f22\x5b57\x6f22\x5b57", 5, 0,
+	    rows, ROWS_MAX), 2);
+	assert_row(&rows[0], 0, 2);
+	assert_row(&rows[1], 2, 4);
+
+	/* trailing spaces don't make an empty row */
+	assert_int_equal(textLayout_wrap(L"abcd ", 4, 0, rows, ROWS_MAX), 1);
+
+	/* an indent that leaves no room is dropped */
+	assert_int_equal(textLayout_indent(4, 4), 0);
+	assert_int_equal(textLayout_indent(4, 3), 3);
+	assert_int_equal(textLayout_wrap(L"abcdefgh", 4, 4, rows, ROWS_MAX),
+	    2);
+	UNUSED_PARAM(state);
+}
+
+static void
+canMeasureColorCodes_test1(void **state)
+{
+	assert_int_equal(textLayout_color_len(L"\x03"), 1);
+	assert_int_equal(textLayout_color_len(L"\x03" L"x"), 1);
+	assert_int_equal(textLayout_color_len(L"\x03" L"4"), 2);
+	assert_int_equal(textLayout_color_len(L"\x03" L"123"), 3);
+	assert_int_equal(textLayout_color_len(L"\x03" L"1,x"), 2);
+	assert_int_equal(textLayout_color_len(L"\x03" L"12,3"), 5);
+	assert_int_equal(textLayout_color_len(L"\x03" L"12,345"), 6);
+	UNUSED_PARAM(state);
+}
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(canWrapAtSpaces_test1),
+		cmocka_unit_test(canBreakLongWords_test1),
+		cmocka_unit_test(handlesWidths_test1),
+		cmocka_unit_test(canMeasureColorCodes_test1),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
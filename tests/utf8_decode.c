@@ -0,0 +1,103 @@
+#include "common.h"
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "utf8Decode.h"
+
+static void
+canDecodeUtf8_test1(void **state)
+{
+	/* "räksmörgås 你好 €" followed by U+1F600 */
+	const char	 str[] = "r\xc3\xa4ksm\xc3\xb6rg\xc3\xa5s "
+			     "\xe4\xbd\xa0\xe5\xa5\xbd \xe2\x82\xac "
+			     "\xf0\x9f\x98\x80";
+	wchar_t		*out;
+
+	assert_true(utf8_is_valid(str, strlen(str)));
+	out = utf8_decode_dup(str);
+#if WCHAR_MAX > 0xFFFF
+	assert_true(wcscmp(out, L"räksmörgås 你好 "
+	    L"€ \U0001F600") == 0);
+#endif
+	free(out);
+	UNUSED_PARAM(state);
+}
+
+static void
+canFallBackToLatin_test1(void **state)
+{
+	/* "café ¤5" in ISO 8859-1 */
+	const char	 str[] = "caf\xe9 \xa4" "5";
+	wchar_t		*out;
+	size_t		 invalid = 0;
+	wchar_t		 buf[20];
+
+	assert_false(utf8_is_valid(str, strlen(str)));
+
+	out = utf8_decode_dup(str);
+	assert_true(wcscmp(out, L"café ¤5") == 0);
+	free(out);
+
+	assert_int_equal(utf8_decode(buf, str, strlen(str), &invalid), 7);
+	assert_int_equal(invalid, 2);
+	UNUSED_PARAM(state);
+}
+
+static void
+rejectsMalformedSequences_test1(void **state)
+{
+	static const char *const bad[] = {
+		"\xc0\xaf",		/* overlong '/' */
+		"\xe0\x80\xaf",		/* overlong '/' */
+		"\xed\xa0\x80",		/* surrogate */
+		"\xf4\x90\x80\x80",	/* beyond U+10FFFF */
+		"\xe2\x82",		/* truncated */
+		"\x80",			/* lone continuation byte */
+	};
+
+	for (size_t i = 0; i < ARRAY_SIZE(bad); i++) {
+		wchar_t	*out;
+		size_t	 len = strlen(bad[i]);
+
+		assert_false(utf8_is_valid(bad[i], len));
+		out = utf8_decode_dup(bad[i]);
+		assert_int_equal(wcslen(out), len);
+		assert_true(out[0] == (wchar_t) (unsigned char) bad[i][0]);
+		free(out);
+	}
+
+	UNUSED_PARAM(state);
+}
+
+static void
+handlesLongAsciiRuns_test1(void **state)
+{
+	const char	 str[] = "The quick brown fox jumps over the lazy dog "
+			     "\xc3\xa5\xc3\xa4\xc3\xb6 0123456789abcdef";
+	wchar_t		*out;
+
+	assert_true(utf8_is_valid(str, strlen(str)));
+	out = utf8_decode_dup(str);
+	assert_true(wcscmp(out, L"The quick brown fox jumps over the lazy dog "
+	    L"åäö 0123456789abcdef") == 0);
+	free(out);
+
+	out = utf8_decode_dup("");
+	assert_true(out[0] == L'\0');
+	free(out);
+	UNUSED_PARAM(state);
+}
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(canDecodeUtf8_test1),
+		cmocka_unit_test(canFallBackToLatin_test1),
+		cmocka_unit_test(rejectsMalformedSequences_test1),
+		cmocka_unit_test(handlesLongAsciiRuns_test1),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,19 @@
+#include "common.h"
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "window.h"
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(window_budget_test1),
+		cmocka_unit_test(window_registry_test1),
+		cmocka_unit_test(window_registry_test2),
+		cmocka_unit_test(window_spawn_test1),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -30,12 +30,43 @@ test2(void **state)
 	UNUSED_PARAM(state);
 }
 
+static void
+test3(void **state)
+{
+	/* Thumbs up with skin tone modifier, and a ZWJ family sequence */
+	const wchar_t str1[] = L"\U0001F44D\U0001F3FD ok";
+	const wchar_t str2[] = L"\U0001F468\u200D\U0001F469\u200D\U0001F467";
+
+	expected = 7;
+	assert_true(xwcswidth(str1, 2) == expected);
+	expected = 6;
+	assert_true(xwcswidth(str2, 2) == expected);
+	UNUSED_PARAM(state);
+}
+
+static void
+test4(void **state)
+{
+	/* Combining acute, zero width space and variation selector 16 */
+	const wchar_t str1[] = L"e\u0301\u200B\uFE0F";
+	/* Fullwidth 'AB', two Hangul syllables and a conjoining jamo pair */
+	const wchar_t str2[] = L"\uFF21\uFF22\uD55C\uAD6D\u1100\u1161";
+
+	expected = 1;
+	assert_true(xwcswidth(str1, 2) == expected);
+	expected = 10;
+	assert_true(xwcswidth(str2, 2) == expected);
+	UNUSED_PARAM(state);
+}
+
 int
 main(void)
 {
 	const struct CMUnitTest tests[] = {
 		cmocka_unit_test(test1),
 		cmocka_unit_test(test2),
+		cmocka_unit_test(test3),
+		cmocka_unit_test(test4),
 	};
 
 	return cmocka_run_group_tests(tests, NULL, NULL);